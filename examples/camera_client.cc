@@ -22,11 +22,10 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include "mapped_clip_source.h"
 #include "video_sink.h"
-#include <array>
 #include <atomic>
 #include <chrono>
-#include <fstream>
 #include <iostream>
 #include <memory>
 #include <string>
@@ -61,8 +60,6 @@ main(int argc, char** argv)
     string                  socket_path(argv[2]);
     string                  filename = argv[1];
     int                     instance_id = 0;
-    atomic<bool>            stop     = false;
-    thread                  file_src_thread;
     shared_ptr<VideoSink>   video_sink;
 
     UnixConnectionInfo conn_info = { socket_path, instance_id };
@@ -84,56 +81,43 @@ main(int argc, char** argv)
                     // frame resolution is k480p, make sure to have the same
                     // resolution.
 
-                    // Start thread that is going to push video input
-                    file_src_thread = thread([&stop, video_sink, &filename]() {
-                        // open file for reading
-                        fstream istrm(filename, istrm.binary | istrm.in);
-                        if (!istrm.is_open()) {
-                            cout << "Failed to open " << filename << '\n';
-                            exit(1);
-                        }
-                        cout << "Will start reading from file: " << filename
+                    // Map the clip once, it loops without any re-read.
+                    shared_ptr<MappedClipSource> clip;
+                    try {
+                        clip = make_shared<MappedClipSource>(
+                          filename,
+                          codec_type == VideoSink::VideoCodecType::kH265
+                            ? AnnexBPacketizer::Codec::kH265
+                            : AnnexBPacketizer::Codec::kH264);
+                    } catch (const std::exception& ex) {
+                        cout << "Failed to open " << filename << ": " << ex.what()
                              << '\n';
-                        const size_t av_input_buffer_padding_size = 64;
-                        const size_t inbuf_size                   = 4 * 1024;
-                        array<uint8_t, inbuf_size + av_input_buffer_padding_size>
-                          inbuf;
-                        while (!stop) {
-                            istrm.read(reinterpret_cast<char*>(inbuf.data()),
-                                       inbuf_size); // binary input
-                            if (!istrm.gcount() or istrm.eof()) {
-                                //   istrm.clear();
-                                //   istrm.seekg(0);
-                                istrm.close();
-                                istrm.open(filename, istrm.binary | istrm.in);
-                                if (!istrm.is_open()) {
-                                    cout << "Failed to open " << filename << '\n';
-                                    exit(1);
-                                }
-                                cout << "Closed and re-opened file: " << filename
-                                     << "\n";
-                                continue;
-                            }
-                            // Send payload
-                            if (auto [sent, error_msg] =
-                                  video_sink->SendDataPacket(inbuf.data(), inbuf_size);
-                                sent < 0) {
-                                cout << "Error in writing payload to Camera VHal: "
-                                     << error_msg << "\n";
-                                exit(1);
-                            }
-                            cout << "[rate=30fps] Sent " << istrm.gcount()
-                                 << " bytes to Camera VHal.\n";
-                            // sleep for 33ms to maintain 30 fps
-                            this_thread::sleep_for(33ms);
-                        }
-                    });
+                        exit(1);
+                    }
+                    cout << "Will start streaming " << clip->FrameCount()
+                         << " frames from file: " << filename << '\n';
+
+                    // Push one frame per packet, paced by the library at the
+                    // rate the Camera VHal expects.
+                    auto sink = video_sink.get();
+                    sink->StartFrameProducer(
+                      VideoSink::DefaultFps(), [sink, clip](uint64_t frame) {
+                          auto au = clip->Next();
+                          if (auto [sent, error_msg] = sink->SendAccessUnit(au);
+                              sent < 0) {
+                              cout << "Error in writing payload to Camera VHal: "
+                                   << error_msg << "\n";
+                              exit(1);
+                          }
+                          cout << "Sent frame " << frame << ", " << au.size
+                               << " bytes to Camera VHal.\n";
+                          return true;
+                      });
                     break;
                 }
                 case VideoSink::camera_cmd_t::CMD_CLOSE:
                     cout << "Received Close command from Camera VHal\n";
-                    stop = true;
-                    file_src_thread.join();
+                    video_sink->StopFrameProducer();
                     exit(0);
                 default:
                     cout << "Unknown Command received, exiting with failure\n";
@@ -149,10 +133,9 @@ main(int argc, char** argv)
 
     cout << "Waiting Camera Open callback..\n";
 
-    while (!video_sink->IsConnected())
-        this_thread::sleep_for(100ms);
+    // Both requests go out as soon as the Camera VHal is connected.
     cout << "Calling GetCameraCapabilty..\n";
-    video_sink->GetCameraCapabilty();
+    auto capability = video_sink->GetCameraCapabiltyAsync(30s);
 
     std::vector<VideoSink::camera_info_t> camera_info(NUM_OF_CAMERAS_REQUESTED);
 
@@ -161,7 +144,10 @@ main(int argc, char** argv)
         camera_info[i].resolution = VideoSink::FrameResolution::k1080p;
     }
     cout << "Calling SetCameraCapabilty..\n";
-    video_sink->SetCameraCapabilty(camera_info);
+    auto accepted = video_sink->SetCameraCapabiltyAsync(camera_info, 30s);
+    if (!capability.get() || !accepted.get()) {
+        cout << "Camera capability negotiation failed\n";
+    }
     // we need to be alive :)
     while (true) {
         this_thread::sleep_for(5ms);
@@ -23,6 +23,7 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include "frame_pacer.h"
 #include "unix_stream_socket_client.h"
 #include <array>
 #include <chrono>
@@ -123,8 +124,11 @@ main(int argc, char** argv)
             const size_t kSize = INBUF_SIZE + AV_INPUT_BUFFER_PADDING_SIZE;
             std::array<uint8_t, kSize> inbuf = { 0 };
             ssize_t                    data_size;
+            FramePacer                 pacer(30);
 
             while (true) {
+                // Absolute deadlines, so send time does not slow the rate.
+                pacer.Wait();
                 data_size = fread(inbuf.data(), 1, kSize, f);
                 if (data_size == 0) {
                     if (feof(f)) {
@@ -154,7 +158,6 @@ main(int argc, char** argv)
                 }
                 cout << "Sent " << data_size << " bytes to VHal\n";
                 cout << ">>>>>> Sending frames at 30fps...\n";
-                std::this_thread::sleep_for(33ms);
             }
         } else if (camera_sock_info.cmd == CMD_CLOSE_CAMERA) {
             cout << "Received CMD_CLOSE_CAMERA, exit\n";
@@ -351,10 +351,12 @@ int main(int argc, char** argv)
                     cout << "Received Open command from Camera VHal\n";
                     stop = false;
                     file_src_thread = thread([&stop,
-                                              &video_sink, &width, &height]() {
+                                              &video_sink, &width, &height, fps]() {
 
                        const size_t inbuf_size = width * height * 1.5;
+                        FramePacer   pacer(fps);
                         while (!stop) {
+                            pacer.Wait();
                             if(av_read_frame(stream_ctx->ifmt_ctx, pkt) < 0)
                                 cout << "Fail to read frame";
                             yuyv422_to_yuv420sp(pkt->data, buf_list[buf_count % BUF_COUNT], width, height, false);
@@ -370,8 +372,6 @@ int main(int argc, char** argv)
     //                        cout << "[rate=30fps] Sent "
   //                               << " bytes to Camera VHal.\n";
                             buf_count++;
-                            // sleep for 33ms to maintain 30 fps
-                            this_thread::sleep_for(33ms);
                         }
 
                     });
@@ -0,0 +1,98 @@
+/**
+ * @file pixel_convert_bench.cc
+ * @brief Measures the raw image to I420 conversion at each SIMD level
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "pixel_convert.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace vhal::client;
+using namespace std::chrono;
+
+int
+main(int argc, char* argv[])
+{
+    const uint32_t width  = argc > 2 ? atoi(argv[1]) : 1920;
+    const uint32_t height = argc > 2 ? atoi(argv[2]) : 1080;
+    const int      frames = argc > 3 ? atoi(argv[3]) : 200;
+
+    struct
+    {
+        const char* name;
+        PixelFormat format;
+        size_t      bpp;
+    } const formats[] = { { "NV12", PixelFormat::kNV12, 1 },
+                          { "YUYV", PixelFormat::kYUYV, 2 },
+                          { "UYVY", PixelFormat::kUYVY, 2 },
+                          { "RGB24", PixelFormat::kRGB24, 3 },
+                          { "RGBA", PixelFormat::kRGBA, 4 } };
+    struct
+    {
+        const char* name;
+        SimdLevel   level;
+    } const levels[] = { { "scalar", SimdLevel::kScalar },
+                         { "sse4.1", SimdLevel::kSse41 },
+                         { "avx2", SimdLevel::kAvx2 } };
+
+    std::vector<uint8_t> src(size_t(width) * height * 4, 0x80);
+    std::vector<uint8_t> dst(I420FrameSize(width, height));
+    if (dst.empty()) {
+        fprintf(stderr, "usage: %s [width height [frames]], width and height even\n", argv[0]);
+        return 1;
+    }
+
+    printf("%ux%u, %d frames, ms per frame\n", width, height, frames);
+    printf("%-6s %-10s", "format", "downscale");
+    for (auto& level : levels) {
+        printf(" %8s", level.name);
+    }
+    printf("\n");
+    for (auto& format : formats) {
+        raw_image_t image;
+        image.format  = format.format;
+        image.width   = width;
+        image.height  = height;
+        image.data[0] = src.data();
+        image.data[1] = src.data() + size_t(width) * height;
+        for (bool downscale : { false, true }) {
+            if (!I420FrameSize(width, height, downscale)) {
+                continue;
+            }
+            printf("%-6s %-10s", format.name, downscale ? "yes" : "no");
+            for (auto& level : levels) {
+                if (SetPixelConvertSimdLevel(level.level) != level.level) {
+                    printf(" %8s", "n/a");
+                    continue;
+                }
+                auto start = steady_clock::now();
+                for (int i = 0; i < frames; ++i) {
+                    ConvertToI420(image, dst.data(), dst.size(), downscale);
+                }
+                duration<double, std::milli> elapsed = steady_clock::now() - start;
+                printf(" %8.3f", elapsed.count() / frames);
+            }
+            printf("\n");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,115 @@
+/**
+ * @file annexb_packetizer.h
+ * @brief Splits H.264/H.265 Annex-B byte streams into access units
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ANNEXB_PACKETIZER_H
+#define ANNEXB_PACKETIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief Turns an H.264 or H.265 Annex-B elementary stream, fed in chunks of
+ * any size, into complete access units (one coded picture with the parameter
+ * sets and SEI that precede it), so that each one can be handed to
+ * VideoSink::SendAccessUnit() as a single packet.
+ *
+ * An access unit is only known to be complete once the first NAL unit of the
+ * next one has arrived, so the last one of a stream comes out of Flush().
+ *
+ * \code
+ * AnnexBPacketizer packetizer(AnnexBPacketizer::Codec::kH264);
+ * AnnexBPacketizer::access_unit_t au;
+ * while (size_t n = read(fd, buf, sizeof(buf))) {
+ *     packetizer.Push(buf, n);
+ *     while (packetizer.Next(au)) {
+ *         video_sink->SendAccessUnit(au);
+ *     }
+ * }
+ * \endcode
+ *
+ * Not thread safe.
+ */
+class AnnexBPacketizer
+{
+public:
+    enum class Codec
+    {
+        kH264,
+        kH265
+    };
+
+    /**
+     * @brief A complete access unit, start codes included. data points into
+     *        the packetizer and stays valid until the next Push() or Reset().
+     */
+    struct access_unit_t
+    {
+        const uint8_t* data           = nullptr;
+        size_t         size           = 0;
+        bool           key_frame      = false; // IDR (H.264) or IRAP (H.265) picture
+        bool           parameter_sets = false; // carries SPS/PPS (and VPS)
+    };
+
+    explicit AnnexBPacketizer(Codec codec = Codec::kH264);
+    ~AnnexBPacketizer();
+
+    AnnexBPacketizer(const AnnexBPacketizer&) = delete;
+    AnnexBPacketizer& operator=(const AnnexBPacketizer&) = delete;
+
+    /**
+     * @brief Append the next chunk of the stream. Bytes before the first
+     *        start code are discarded.
+     */
+    void Push(const uint8_t* data, size_t size);
+
+    /**
+     * @brief Pop the next complete access unit.
+     *
+     * @return true au was filled in.
+     * @return false No complete access unit is buffered.
+     */
+    bool Next(access_unit_t& au);
+
+    /**
+     * @brief End of stream: whatever is buffered becomes the last access
+     *        unit, to be popped with Next().
+     */
+    void Flush();
+
+    /**
+     * @brief Drop everything buffered, e.g. before seeking in the source.
+     */
+    void Reset();
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+} // namespace client
+} // namespace vhal
+
+#endif /* ANNEXB_PACKETIZER_H */
@@ -28,6 +28,7 @@
 #include "audio_common.h"
 #include "istream_socket_client.h"
 #include "libvhal_common.h"
+#include "reactor.h"
 #include <functional>
 #include <memory>
 #include <string>
@@ -54,9 +55,12 @@ public:
      * @param callback Audio callback function object or lambda function
      * pointer.
      * @param user_id Optional parameter to specify the user# in multi-user config.
+     * @param reactor Optional shared Reactor. When set, the VHAL connection is
+     *        served by the reactor thread instead of a dedicated thread.
      *
      */
-    AudioSink(TcpConnectionInfo tcp_conn_info, AudioCallback callback, const int32_t user_id = -1);
+    AudioSink(TcpConnectionInfo tcp_conn_info, AudioCallback callback, const int32_t user_id = -1,
+              std::shared_ptr<Reactor> reactor = nullptr);
 
     /**
      * @brief Destroy the AudioSink object
@@ -76,6 +80,14 @@ public:
      */
     IOResult SendDataPacket(const uint8_t* packet, size_t size);
 
+    /**
+     * @brief Same as SendDataPacket(), reporting errors as an error code, so
+     *        that nothing is allocated per packet.
+     *
+     * @return IOStatus, size is the packet size or -1 incase of failure.
+     */
+    IOStatus SendDataPacketNoAlloc(const uint8_t* packet, size_t size);
+
 private:
     class Impl;
     std::unique_ptr<Impl> impl_;
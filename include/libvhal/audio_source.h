@@ -28,6 +28,7 @@
 #include "audio_common.h"
 #include "istream_socket_client.h"
 #include "libvhal_common.h"
+#include "reactor.h"
 #include <functional>
 #include <memory>
 #include <string>
@@ -61,9 +62,12 @@ public:
      * @param callback Audio callback function object or lambda function
      * pointer.
      * @param user_id Optional parameter to specify the user# in multi-user config.
+     * @param reactor Optional shared Reactor. When set, the VHAL connection is
+     *        served by the reactor thread instead of a dedicated thread.
      *
      */
-    AudioSource(TcpConnectionInfo tcp_conn_info, AudioCallback callback, const int32_t user_id = -1);
+    AudioSource(TcpConnectionInfo tcp_conn_info, AudioCallback callback, const int32_t user_id = -1,
+              std::shared_ptr<Reactor> reactor = nullptr);
 
     /**
      * @brief Destroy the AudioSource object
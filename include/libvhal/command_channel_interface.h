@@ -27,6 +27,7 @@
 
 #include "istream_socket_client.h"
 #include "libvhal_common.h"
+#include "reactor.h"
 #include <functional>
 #include <memory>
 #include <string>
@@ -85,9 +86,13 @@ public:
      * function pointer.
      *
      * @param tcp_conn_info Information needed to connect to the tcp server socket.
+     * @param reactor Optional shared Reactor. When set, the three service
+     *        connections are served by the reactor thread instead of three
+     *        dedicated threads.
      *
      */
-    CommandChannelInterface(TcpConnectionInfo tcp_conn_info, CommandChannelCallback callback);
+    CommandChannelInterface(TcpConnectionInfo tcp_conn_info, CommandChannelCallback callback,
+                            std::shared_ptr<Reactor> reactor = nullptr);
 
     /**
      * @brief Destroy the CommandChannelInterface object
@@ -108,6 +113,13 @@ public:
      */
     IOResult SendDataPacket(MsgType msg_type, const uint8_t* message, size_t size);
 
+    /**
+     * @brief Same as SendDataPacket(), reporting errors as an error code.
+     *
+     * @return IOStatus, size is the message size or -1 incase of failure.
+     */
+    IOStatus SendDataPacketNoAlloc(MsgType msg_type, const uint8_t* message, size_t size);
+
 private:
     class Impl;
     std::unique_ptr<Impl> impl_;
@@ -160,9 +160,22 @@ struct display_control_t {
   } viewport;
 };
 
+/* CPU view of a buffer, see ConfigInfo::map_planes */
+struct plane_mapping_t {
+  const uint8_t* data;   /* first byte of the plane */
+  uint32_t       stride; /* bytes per row */
+  uint32_t       size;   /* bytes */
+};
+
+struct frame_mapping_t {
+  uint32_t        num_planes;
+  plane_mapping_t planes[DRV_MAX_PLANES];
+};
+
 struct frame_info_t {
-  cros_gralloc_handle* handle;
-  display_control_t*   ctrl;
+  cros_gralloc_handle*   handle;
+  display_control_t*     ctrl;
+  const frame_mapping_t* mapping = nullptr; /* valid until FRAME_REMOVE */
 };
 
 }
@@ -0,0 +1,121 @@
+/**
+ * @file frame_pacer.h
+ * @brief Paces frame production on absolute deadlines
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief Paces a frame producer at a fixed frame rate.
+ *
+ * Frame n is due at start + n / fps, computed from the start time rather
+ * than from the previous frame, and waited for with an absolute
+ * clock_nanosleep() on CLOCK_MONOTONIC. Time spent producing and sending a
+ * frame therefore does not push the following ones back, unlike a relative
+ * sleep_for() after each frame.
+ *
+ * \code
+ * FramePacer pacer(30);
+ * while (streaming) {
+ *     pacer.Wait();
+ *     video_sink->SendAccessUnit(clip.Next());
+ * }
+ * \endcode
+ *
+ * Wait() must be called from a single thread, Stats() from any.
+ */
+class FramePacer
+{
+public:
+    /**
+     * @brief What Wait() does when the producer fell more than one frame
+     *        behind schedule.
+     */
+    enum class OverrunPolicy
+    {
+        kCatchUp, // return the late frames back to back until on schedule
+        kSkip     // drop the missed deadlines and resume with the current one
+    };
+
+    /**
+     * @brief Pacing statistics. Lateness is how long after its deadline a
+     *        frame was released by Wait().
+     */
+    struct stats_t
+    {
+        uint64_t                 frames         = 0; // frames released
+        uint64_t                 late_frames    = 0; // released a full interval late or more
+        uint64_t                 skipped_frames = 0; // deadlines dropped by kSkip
+        std::chrono::nanoseconds drift{ 0 };         // lateness of the last frame
+        std::chrono::nanoseconds max_lateness{ 0 };
+        std::chrono::nanoseconds jitter{ 0 };        // smoothed lateness variation (RFC 3550)
+    };
+
+    /**
+     * @brief Throws std::invalid_argument if fps is not positive.
+     *
+     * @param fps Frame rate.
+     * @param policy Overrun policy.
+     */
+    explicit FramePacer(double fps, OverrunPolicy policy = OverrunPolicy::kSkip);
+    ~FramePacer();
+
+    FramePacer(const FramePacer&) = delete;
+    FramePacer& operator=(const FramePacer&) = delete;
+
+    /**
+     * @brief Sleep until the next frame is due. The first call returns right
+     *        away and starts the schedule.
+     *
+     * @return Index of the frame due, which jumps ahead when kSkip dropped
+     *         deadlines.
+     */
+    uint64_t Wait();
+
+    /**
+     * @brief Restart the schedule on the next Wait(), e.g. after the stream
+     *        was paused. Statistics are kept.
+     */
+    void Reset();
+
+    /**
+     * @brief Time between two frames.
+     */
+    std::chrono::nanoseconds Interval() const;
+
+    stats_t Stats() const;
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+} // namespace client
+} // namespace vhal
+
+#endif /* FRAME_PACER_H */
@@ -27,6 +27,7 @@
 #include <thread>
 #include "libvhal_common.h"
 #include "display-protocol.h"
+#include "reactor.h"
 
 namespace vhal {
 namespace client {
@@ -38,6 +39,12 @@ enum CommandType
     FRAME_DISPLAY = 2, // display frame
 };
 
+enum class DisplayDelivery
+{
+    kInline,  // FRAME_DISPLAY handled on the socket thread, every frame
+    kMailbox, // handled on a consumer thread, latest frame wins
+};
+
 struct ConfigInfo
 {
     UnixConnectionInfo unix_conn_info;
@@ -45,20 +52,105 @@ struct ConfigInfo
     int video_res_height = 0;
     std::string video_device = "";
     int user_id = 0;
+    // Frames Android may render ahead of us, reported as numFramebuffers.
+    // With an AsyncHwcHandler, at most this many DISPLAY_ACKs are pending.
+    int num_framebuffers = 2;
+    // With kMailbox, a consumer slower than the guest gets the newest frame
+    // and frames it had no time for are ACKed right away, which keeps the
+    // latency bounded. The handler is still never called concurrently.
+    DisplayDelivery delivery = DisplayDelivery::kInline;
+    // Map every buffer for reading once, on FRAME_CREATE, and hand out the
+    // planes in frame_info_t::mapping. CPU access to a FRAME_DISPLAY frame
+    // is bracketed with DMA_BUF_IOCTL_SYNC: it begins before the handler is
+    // called and ends when the frame is released (ACKed).
+    bool map_planes = false;
 };
 
 using HwcHandler = std::function<void(CommandType cmd, const frame_info_t* frame)>;
 
+/**
+ * @brief Handed out with every FRAME_DISPLAY to an AsyncHwcHandler. Android
+ *        waits for the frame to be released (its DISPLAY_ACK) before it
+ *        renders into the buffer again, so release it as soon as the
+ *        buffer has been consumed, e.g. once the encoder has read it.
+ *
+ * Copies share one release. The ACK goes out on Release(), from any
+ * thread, or when the last copy is destroyed. Releases after a reconnect
+ * or after stop() are dropped, since that session no longer waits for
+ * them.
+ */
+class DisplayReleaseToken
+{
+public:
+    // The release owed to the VHal, internal to the library.
+    class Pending;
+
+    DisplayReleaseToken() = default;
+
+    explicit DisplayReleaseToken(std::shared_ptr<Pending> pending)
+      : pending_{ std::move(pending) }
+    {}
+
+    /**
+     * @brief Sends the DISPLAY_ACK of the frame, if not sent yet.
+     */
+    void Release();
+
+    explicit operator bool() const { return pending_ != nullptr; }
+
+private:
+    std::shared_ptr<Pending> pending_;
+};
+
+/**
+ * @brief Frame handler for pipelined display. The token is empty for
+ *        FRAME_CREATE and FRAME_REMOVE. frame, and its ctrl, are only
+ *        valid during the call; the handle stays valid until FRAME_REMOVE.
+ */
+using AsyncHwcHandler = std::function<
+  void(CommandType cmd, const frame_info_t* frame, DisplayReleaseToken token)>;
+
 class VirtualHwcReceiver
 {
 public:
-    VirtualHwcReceiver(struct ConfigInfo info, HwcHandler handler);
+    /**
+     * @brief Constructor. Throws std::invalid_argument or std::logic_error.
+     *
+     * @param info HWC configuration.
+     * @param handler Frame handler.
+     * @param reactor Optional shared Reactor. When set, the HWC VHAL socket
+     *        is served by the reactor thread instead of a dedicated thread.
+     */
+    VirtualHwcReceiver(struct ConfigInfo info, HwcHandler handler,
+                       std::shared_ptr<Reactor> reactor = nullptr);
+
+    /**
+     * @brief Constructor for pipelined display: the DISPLAY_ACK of a frame
+     *        is deferred until its DisplayReleaseToken is released, so that
+     *        Android renders the next frames, up to info.num_framebuffers,
+     *        while this one is still being encoded. Throws
+     *        std::invalid_argument or std::logic_error.
+     *
+     * @param info HWC configuration.
+     * @param handler Frame handler.
+     * @param reactor Optional shared Reactor, see above.
+     */
+    VirtualHwcReceiver(struct ConfigInfo info, AsyncHwcHandler handler,
+                       std::shared_ptr<Reactor> reactor = nullptr);
     ~VirtualHwcReceiver();
     IOResult start();
     IOResult stop();
     IOResult setMode(int width, int height);
     IOResult setVideoAlpha(uint32_t action);
 
+    struct DisplayStats
+    {
+        uint64_t delivered = 0; // FRAME_DISPLAY handed to the handler
+        uint64_t dropped   = 0; // superseded in the mailbox, ACKed unseen
+    };
+
+    DisplayStats getDisplayStats();
+
 private:
     class Impl;
     std::unique_ptr<Impl> impl_;
@@ -0,0 +1,92 @@
+/**
+ * @file io_uring_queue.h
+ * @brief io_uring submission ring shared by stream socket clients
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef IO_URING_QUEUE_H
+#define IO_URING_QUEUE_H
+
+#include <memory>
+#include <sys/uio.h>
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief An io_uring instance that IoUringStreamSocketClient objects of many
+ * sessions submit their socket I/O to.
+ *
+ * Only one caller at a time waits in the kernel: it submits every pending
+ * send and receive and reaps every completion that is ready, waking the
+ * other callers. While it waits, one other caller at a time submits what has
+ * been queued meanwhile, so the I/O of concurrent sessions is submitted and
+ * collected in batches. Connected sockets are registered as fixed files.
+ *
+ * If io_uring can not be set up (old kernel, seccomp filter, ...),
+ * Available() returns false and clients silently use their transport.
+ */
+class IoUringQueue
+{
+public:
+    /**
+     * @param entries Submission queue size.
+     * @param max_files Number of fixed file slots, i.e. concurrently
+     *        connected clients using fixed files.
+     */
+    explicit IoUringQueue(unsigned entries = 256, unsigned max_files = 64);
+    ~IoUringQueue();
+
+    IoUringQueue(const IoUringQueue&) = delete;
+    IoUringQueue& operator=(const IoUringQueue&) = delete;
+
+    /**
+     * @brief Whether io_uring is usable on this system.
+     */
+    bool Available() const;
+
+    /**
+     * @brief Register (pin) buffers with the ring. Sends from memory that
+     *        lies within a registered buffer use it as a fixed buffer, on
+     *        kernels that support fixed buffer sends. Call it before traffic
+     *        starts; registering again replaces the previous set.
+     *
+     * @param iov Buffers to register.
+     * @param count Number of entries in iov.
+     *
+     * @return true Buffers registered.
+     * @return false io_uring unavailable or registration refused.
+     */
+    bool RegisterBuffers(const struct iovec* iov, int count);
+
+    /**
+     * @brief Drop the buffers registered with RegisterBuffers(). Must not race
+     *        with I/O on those buffers.
+     */
+    void UnregisterBuffers();
+
+private:
+    friend class IoUringStreamSocketClient;
+    class Impl;
+    std::unique_ptr<Impl> impl_;
+};
+} // namespace client
+} // namespace vhal
+
+#endif /* IO_URING_QUEUE_H */
@@ -0,0 +1,68 @@
+/**
+ * @file io_uring_stream_socket_client.h
+ * @brief Stream socket client that performs its I/O through a shared io_uring
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef IO_URING_STREAM_SOCKET_CLIENT_H
+#define IO_URING_STREAM_SOCKET_CLIENT_H
+
+#include "io_uring_queue.h"
+#include "istream_socket_client.h"
+#include <memory>
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief Wraps a Unix, TCP or vsock stream socket client and submits its
+ * Send(), SendV() and Recv() to an IoUringQueue, which may be shared by the
+ * clients of many sessions. Connecting and closing are left to the wrapped
+ * client; once connected, the socket is registered as a fixed file.
+ *
+ * When the queue is not Available(), every call is forwarded to the wrapped
+ * client unchanged.
+ */
+class IoUringStreamSocketClient final : public IStreamSocketClient
+{
+public:
+    IoUringStreamSocketClient(std::unique_ptr<IStreamSocketClient> transport,
+                              std::shared_ptr<IoUringQueue>        queue);
+    ~IoUringStreamSocketClient();
+
+    ConnectionResult Connect() override;
+    bool             Connected() const override;
+    int              GetNativeSocketFd() const override;
+    std::string      GetRemotePath() const override;
+    IOResult         Send(const uint8_t* data, size_t size) override;
+    IOResult         SendV(const struct iovec* iov, int iovcnt) override;
+    IOResult         Recv(uint8_t* data, size_t size, uint8_t flag = 0) override;
+    IOStatus         SendNoAlloc(const uint8_t* data, size_t size) override;
+    IOStatus         SendVNoAlloc(const struct iovec* iov, int iovcnt) override;
+    IOStatus         RecvNoAlloc(uint8_t* data, size_t size, uint8_t flag = 0) override;
+    void             Close() override;
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> impl_;
+};
+} // namespace client
+} // namespace vhal
+
+#endif /* IO_URING_STREAM_SOCKET_CLIENT_H */
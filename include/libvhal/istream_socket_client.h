@@ -31,7 +31,9 @@
 
 #include "libvhal_common.h"
 #include <cstdint>
+#include <string>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <tuple>
 
 namespace vhal {
@@ -83,6 +85,14 @@ public:
      */
     virtual int GetNativeSocketFd() const = 0;
 
+    /**
+     * @brief Get the filesystem path of the remote endpoint, so that callers
+     *        can wait for it to appear instead of retrying Connect().
+     *
+     * @return std::string Unix socket path, empty for TCP and vsock.
+     */
+    virtual std::string GetRemotePath() const { return ""; }
+
     /**
      * @brief Send raw data to server
      *
@@ -94,6 +104,21 @@ public:
      */
     virtual IOResult Send(const uint8_t* data, size_t size) = 0;
 
+    /**
+     * @brief Send scattered buffers to server as one contiguous message.
+     *        All buffers are handed to the kernel in a single sendmsg()
+     *        call, so a header and its payload leave in the same segment.
+     *        Short writes are resumed until every byte is sent or an error
+     *        occurs.
+     *
+     * @param iov Array of buffers to send, in order.
+     * @param iovcnt Number of entries in iov.
+     * @return IOResult
+     *         <Total number of bytes sent, Empty string> on Success
+     *         <-1, Error message on Failure> on Failure
+     */
+    virtual IOResult SendV(const struct iovec* iov, int iovcnt) = 0;
+
     /**
      * @brief
      *
@@ -109,6 +134,26 @@ public:
      */
     virtual IOResult Recv(uint8_t* data, size_t size, uint8_t flag = 0) = 0;
 
+    /**
+     * @brief Same as Send(), reporting errors as an error code instead of a
+     *        string. Send() is a wrapper around it.
+     *
+     * @return IOStatus
+     *         <Number of bytes sent, {}> on Success
+     *         <-1, error code> on Failure
+     */
+    virtual IOStatus SendNoAlloc(const uint8_t* data, size_t size) = 0;
+
+    /**
+     * @brief Same as SendV(), reporting errors as an error code.
+     */
+    virtual IOStatus SendVNoAlloc(const struct iovec* iov, int iovcnt) = 0;
+
+    /**
+     * @brief Same as Recv(), reporting errors as an error code.
+     */
+    virtual IOStatus RecvNoAlloc(uint8_t* data, size_t size, uint8_t flag = 0) = 0;
+
     /**
      * @brief Closes socket connection.
      */
@@ -0,0 +1,95 @@
+/**
+ * @file izero_copy_socket_client.h
+ * @brief Interface of stream socket clients able to send without copying
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef IZERO_COPY_SOCKET_CLIENT_H
+#define IZERO_COPY_SOCKET_CLIENT_H
+
+#include "libvhal_common.h"
+#include <cstdint>
+#include <functional>
+#include <sys/uio.h>
+#include <tuple>
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief Optional interface of stream socket clients supporting MSG_ZEROCOPY
+ * (TCP, and vsock on Linux 6.7+).
+ *
+ * Data sent with SendVZeroCopy() is not copied into the socket buffer; the
+ * kernel reads it from the caller's memory, which therefore must stay valid
+ * and unmodified until the release callback reports its cookie. Completions
+ * arrive on the socket error queue and are turned into release callbacks by
+ * ProcessZeroCopyCompletions(), which StreamTalker calls whenever the socket
+ * signals POLLERR, and which SendVZeroCopy() calls opportunistically.
+ */
+class IZeroCopySocketClient
+{
+public:
+    /**
+     * @brief Called once per SendVZeroCopy() call when its buffers can be
+     *        reused, possibly from another thread.
+     *
+     * @param cookie Value passed to SendVZeroCopy().
+     * @param copied true if the kernel copied the data after all, e.g. on
+     *        loopback. Zero-copy is then turned off for the connection.
+     */
+    using ReleaseCallback = std::function<void(uint64_t cookie, bool copied)>;
+
+    virtual ~IZeroCopySocketClient() = default;
+
+    /**
+     * @brief Opt in or out. Takes effect immediately and on every reconnect.
+     *        Pending buffers are released when the connection closes.
+     */
+    virtual void SetZeroCopy(bool enable, ReleaseCallback on_release) = 0;
+
+    /**
+     * @brief Whether SendVZeroCopy() currently avoids the copy. False when
+     *        disabled, not connected, or unsupported by the kernel.
+     */
+    virtual bool ZeroCopyActive() const = 0;
+
+    /**
+     * @brief Same as IStreamSocketClient::SendV(), without copying the data.
+     *        Falls back to a copying send, followed by an immediate release,
+     *        when zero-copy is not active.
+     *
+     * @param cookie Reported to the release callback.
+     */
+    virtual IOResult SendVZeroCopy(const struct iovec* iov,
+                                   int                 iovcnt,
+                                   uint64_t            cookie) = 0;
+
+    /**
+     * @brief Read the completion notifications pending on the error queue
+     *        and release the buffers they cover. Never blocks.
+     *
+     * @return Number of notifications read, -1 if the socket has an error.
+     */
+    virtual int ProcessZeroCopyCompletions() = 0;
+};
+} // namespace client
+} // namespace vhal
+
+#endif /* IZERO_COPY_SOCKET_CLIENT_H */
@@ -20,11 +20,20 @@
 #ifndef LIBVHAL_COMMON_H
 #define LIBVHAL_COMMON_H
 
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <system_error>
+#include <sys/types.h>
+#include <tuple>
 
 namespace vhal {
 namespace client {
 
+class IoUringQueue;
+
 /**
  * @brief TCP connection info to the Android instance
  *
@@ -41,6 +50,9 @@ struct TcpConnectionInfo
     uint16_t port = 0;
     // Status dir path to update the connection status.
     std::string status_dir = "";
+    // Optional io_uring shared with other sessions for socket I/O, see
+    // IoUringStreamSocketClient.
+    std::shared_ptr<IoUringQueue> io_uring = nullptr;
 };
 
 /**
@@ -56,6 +68,8 @@ struct UnixConnectionInfo
     int android_instance_id = -1;
     // Status dir path to update the connection status.
     std::string status_dir = "";
+    // Optional shared io_uring, see TcpConnectionInfo.
+    std::shared_ptr<IoUringQueue> io_uring = nullptr;
 };
 
 /**
@@ -66,6 +80,8 @@ struct VsockConnectionInfo
 {
     // Specifies the Context identifier of the Android VM instance.
     int android_vm_cid = -1;
+    // Optional shared io_uring, see TcpConnectionInfo.
+    std::shared_ptr<IoUringQueue> io_uring = nullptr;
 };
 
 /**
@@ -76,6 +92,54 @@ struct VsockConnectionInfo
  */
 using IOResult = std::tuple<ssize_t, std::string>;
 
+/**
+ * @brief IOStatus
+ *          Allocation-free counterpart of IOResult, returned by the *NoAlloc
+ *          functions. Trivially copyable, so nothing touches the heap on
+ *          the per-packet path.
+ *          { >=0, {} } on Success
+ *          { -1, error code } on Failure
+ */
+struct IOStatus
+{
+    ssize_t         size = 0;
+    std::error_code error;
+
+    /**
+     * @brief Failure status carrying the current errno.
+     */
+    static IOStatus FromErrno()
+    {
+        return { -1, std::error_code(errno, std::system_category()) };
+    }
+};
+
+/**
+ * @brief Converts an IOStatus into the string based IOResult.
+ */
+inline IOResult ToIOResult(const IOStatus& status)
+{
+    return { status.size, status.error ? status.error.message() : "" };
+}
+
+/**
+ * @brief Connection timing of a VHal session.
+ *        Durations are measured from the moment the client started waiting
+ *        for the VHal: its creation, or the loss of the previous connection.
+ *        A negative duration means that it has not happened yet.
+ */
+struct ConnectionStats
+{
+    // Successful connects since creation.
+    uint32_t connections = 0;
+    // Connect() calls made during the last wait, including the successful one.
+    uint32_t connect_attempts = 0;
+    // Wait until the VHal accepted the connection.
+    std::chrono::microseconds time_to_connect{ -1 };
+    // Wait until the first frame was sent over that connection.
+    std::chrono::microseconds time_to_first_frame{ -1 };
+};
+
 /**
  * @brief ConnectionResult
  *          { True, "" } on Success
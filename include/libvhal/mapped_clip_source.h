@@ -0,0 +1,108 @@
+/**
+ * @file mapped_clip_source.h
+ * @brief Loops an H.264/H.265 clip from a shared memory mapping
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MAPPED_CLIP_SOURCE_H
+#define MAPPED_CLIP_SOURCE_H
+
+#include "annexb_packetizer.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief Plays an Annex-B clip (.h264/.h265 file) in a loop, one access unit
+ * at a time, for test and replay streamers.
+ *
+ * The file is mapped read-only and split into access units once. Every
+ * MappedClipSource opened on the same file in the process shares that
+ * mapping and index, and across processes the pages are shared through the
+ * page cache, so running many instances costs no extra memory or I/O.
+ * Access units are handed out as spans of the mapping, ready for
+ * VideoSink::SendAccessUnit() without any copy.
+ *
+ * \code
+ * MappedClipSource clip("video-480p.h265", AnnexBPacketizer::Codec::kH265);
+ * while (streaming) {
+ *     video_sink->SendAccessUnit(clip.Next());
+ *     std::this_thread::sleep_for(33ms);
+ * }
+ * \endcode
+ *
+ * Not thread safe, use one object per stream.
+ */
+class MappedClipSource
+{
+public:
+    /**
+     * @brief Map the clip, or share the mapping of another source playing it.
+     *        Throws std::system_error if the file cannot be opened or mapped,
+     *        and std::invalid_argument if it holds no access unit.
+     *
+     * @param path Path of the clip.
+     * @param codec Codec of the clip.
+     */
+    MappedClipSource(const std::string&      path,
+                     AnnexBPacketizer::Codec codec = AnnexBPacketizer::Codec::kH264);
+    ~MappedClipSource();
+
+    MappedClipSource(const MappedClipSource&) = delete;
+    MappedClipSource& operator=(const MappedClipSource&) = delete;
+
+    /**
+     * @brief Next access unit of the clip. After the last one, playback
+     *        starts over from the first key frame. The data stays valid as
+     *        long as this object.
+     */
+    AnnexBPacketizer::access_unit_t Next();
+
+    /**
+     * @brief Make Next() return the last key frame at or before frame, so
+     *        that the stream stays decodable. Useful to start instances
+     *        playing the same clip at different points.
+     *
+     * @param frame Access unit index, taken modulo FrameCount().
+     */
+    void SeekToKeyFrame(size_t frame);
+
+    /**
+     * @brief Number of access units in the clip.
+     */
+    size_t FrameCount() const;
+
+    /**
+     * @brief Number of times playback wrapped around the end of the clip.
+     */
+    uint64_t Loops() const;
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+} // namespace client
+} // namespace vhal
+
+#endif /* MAPPED_CLIP_SOURCE_H */
@@ -0,0 +1,105 @@
+/**
+ * @file pixel_convert.h
+ * @brief Conversion of raw camera images to I420
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef PIXEL_CONVERT_H
+#define PIXEL_CONVERT_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief Pixel formats raw camera images can be converted from.
+ */
+enum class PixelFormat
+{
+    kNV12,  // Y plane, then interleaved U/V plane at half resolution
+    kYUYV,  // packed 4:2:2, Y0 U Y1 V
+    kUYVY,  // packed 4:2:2, U Y0 V Y1
+    kRGB24, // R G B
+    kRGBA   // R G B A, alpha is ignored
+};
+
+/**
+ * @brief A raw camera image. Only NV12 uses the second plane.
+ */
+struct raw_image_t
+{
+    PixelFormat    format    = PixelFormat::kNV12;
+    uint32_t       width     = 0;
+    uint32_t       height    = 0;
+    const uint8_t* data[2]   = {};
+    size_t         stride[2] = {}; // bytes per row, 0 if rows are packed
+};
+
+/**
+ * @brief Instruction sets the conversion may use.
+ */
+enum class SimdLevel
+{
+    kScalar,
+    kSse41,
+    kAvx2
+};
+
+/**
+ * @brief Size of the I420 frame ConvertToI420() produces for an image.
+ *
+ * @param downscale true for half the width and height.
+ *
+ * @return size_t Bytes, 0 if the dimensions can not be converted: width
+ *         and height must be even, multiples of 4 with downscale.
+ */
+size_t I420FrameSize(uint32_t width, uint32_t height, bool downscale = false);
+
+/**
+ * @brief Convert a raw image to packed I420 (Y, then U, then V plane), the
+ *        layout the Camera VHal expects for VideoCodecType::kI420. RGB is
+ *        converted with BT.601 limited range coefficients, chroma is the
+ *        average of each 2x2 block.
+ *
+ * @param image Source image.
+ * @param dst Destination, at least I420FrameSize() bytes.
+ * @param dst_size Size of dst.
+ * @param downscale Also halve the width and height, averaging 2x2 blocks.
+ *
+ * @return size_t Bytes written, 0 if the image or dst_size is invalid.
+ */
+size_t ConvertToI420(const raw_image_t& image, uint8_t* dst, size_t dst_size,
+                     bool downscale = false);
+
+/**
+ * @brief Cap the instruction set ConvertToI420() uses, e.g. to compare
+ *        against the scalar code. By default the best one the CPU supports
+ *        is used. May be called while other threads convert; conversions
+ *        in progress finish with the previous level.
+ *
+ * @return SimdLevel Level in effect, lower than max if the CPU lacks it.
+ */
+SimdLevel SetPixelConvertSimdLevel(SimdLevel max);
+
+} // namespace client
+} // namespace vhal
+
+#endif /* PIXEL_CONVERT_H */
@@ -0,0 +1,149 @@
+/**
+ * @file reactor.h
+ * @brief Shared epoll event loop for VHAL talkers
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief Single threaded epoll event loop that can be shared by the domain
+ * objects (VideoSink, AudioSink, AudioSource, SensorInterface,
+ * CommandChannelInterface, VirtualHwcReceiver) instead of each of them
+ * running its own talker thread.
+ *
+ * Every Reactor owns exactly one thread. To spread many Android instances
+ * over a few cores, create a few Reactors and hand them out round-robin.
+ *
+ * All handlers and tasks run on the reactor thread, so they must not block
+ * for long: a slow handler delays every other object served by the same
+ * Reactor. Domain object APIs that wait for a VHAL reply (for example
+ * VideoSink::GetCameraCapabilty()) must not be called from a handler.
+ *
+ * \code
+ * auto reactor = std::make_shared<Reactor>();
+ * VideoSink   sink0(conn_info0, camera_cb0, -1, reactor);
+ * VideoSink   sink1(conn_info1, camera_cb1, -1, reactor);
+ * \endcode
+ */
+class Reactor
+{
+public:
+    /**
+     * @brief Called on the reactor thread with the epoll event mask
+     *        (EPOLLIN, EPOLLERR, EPOLLHUP, ...) reported for the fd.
+     */
+    using FdHandler = std::function<void(uint32_t events)>;
+
+    /**
+     * @brief Deferred work executed on the reactor thread.
+     */
+    using Task = std::function<void()>;
+
+    /**
+     * @brief Identifies a timer created by RunAfter(). 0 is never a valid id.
+     */
+    using TimerId = uint64_t;
+
+    /**
+     * @brief Construct a new Reactor object and start its thread.
+     *        Throws std::system_error if epoll or eventfd cannot be created.
+     */
+    Reactor();
+
+    /**
+     * @brief Stops the reactor thread. Pending tasks and timers are dropped.
+     */
+    ~Reactor();
+
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
+
+    /**
+     * @brief Start watching fd.
+     *
+     * @param fd File descriptor to watch. It must stay open until RemoveFd().
+     * @param events epoll event mask, e.g. EPOLLIN.
+     * @param handler Invoked on the reactor thread when fd is ready.
+     *
+     * @return true fd is being watched.
+     * @return false epoll_ctl failed, fd is already registered or the reactor
+     *         Failed().
+     */
+    bool AddFd(int fd, uint32_t events, FdHandler handler);
+
+    /**
+     * @brief Stop watching fd. When called from another thread while the
+     *        fd handler is running, waits for the handler to return, so the
+     *        caller may close fd and release handler state right after.
+     *
+     * @param fd File descriptor previously passed to AddFd().
+     */
+    void RemoveFd(int fd);
+
+    /**
+     * @brief Run task on the reactor thread after delay.
+     *
+     * @return TimerId that can be passed to CancelTimer().
+     */
+    TimerId RunAfter(std::chrono::milliseconds delay, Task task);
+
+    /**
+     * @brief Cancel a timer that has not fired yet. When called from another
+     *        thread while the timer task is running, waits for it to return.
+     */
+    void CancelTimer(TimerId id);
+
+    /**
+     * @brief Run task on the reactor thread as soon as possible. Tasks are
+     *        executed in the order they were posted.
+     */
+    void Post(Task task);
+
+    /**
+     * @brief Returns true when called from the reactor thread.
+     */
+    bool InLoopThread() const;
+
+    /**
+     * @brief Returns true once the reactor can no longer wait for fd events.
+     *        When that happens, every fd handler is called once with
+     *        EPOLLERR and the fds are dropped; AddFd() fails from then on.
+     *        Tasks and timers keep running.
+     */
+    bool Failed() const;
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+} // namespace client
+} // namespace vhal
+
+#endif /* REACTOR_H */
@@ -27,6 +27,7 @@
 
 #include "istream_socket_client.h"
 #include "libvhal_common.h"
+#include "reactor.h"
 #include <functional>
 #include <memory>
 #include <string>
@@ -158,9 +159,12 @@ public:
      * @param callback Sensor callback function object or lambda or function
      * @param userId valid id >=0  for multi-client use case
      * pointer.
+     * @param reactor Optional shared Reactor. When set, the VHAL connection is
+     *        served by the reactor thread instead of a dedicated thread.
      */
     SensorInterface(UnixConnectionInfo unix_conn_info, SensorCallback callback,
-                                                        const int32_t userId);
+                                                        const int32_t userId,
+                    std::shared_ptr<Reactor> reactor = nullptr);
 
     /**
      * @brief Destroy the SensorInterface object
@@ -179,6 +183,17 @@ public:
      */
     IOResult SendDataPacket(const SensorDataPacket *event);
 
+    /**
+     * @brief Same as SendDataPacket(), reporting errors as an error code.
+     *
+     * @return IOStatus
+     *         { bytes sent, {} } on success
+     *         { 0, std::errc::not_connected } if VHAL is not connected
+     *         { -1, std::errc::not_supported } for unsupported sensor types
+     *         { -1, socket error } otherwise
+     */
+    IOStatus SendDataPacketNoAlloc(const SensorDataPacket *event);
+
     /**
      * @brief Get supported sensor list in bitmap format.
      *        Supported sensor's bit gets set using respective
@@ -0,0 +1,86 @@
+/**
+ * @file shm_ring_stream_client.h
+ * @brief Stream client over a shared-memory ring negotiated on a Unix socket
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef SHM_RING_STREAM_CLIENT_H
+#define SHM_RING_STREAM_CLIENT_H
+
+#include "istream_socket_client.h"
+#include <memory>
+#include <string>
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief Stream client for a host-local VHAL that moves data through shared
+ * memory instead of the socket.
+ *
+ * Connect() connects to the Unix socket at remote_server_path and hands the
+ * server a memfd holding one byte ring per direction, plus eventfd doorbells,
+ * over SCM_RIGHTS. After that, Send() and Recv() are plain memory copies; a
+ * doorbell syscall is only made when the other side is asleep waiting for
+ * data or space. The socket stays open to signal hang up only. The server
+ * must speak the handshake in shm_ring.h.
+ *
+ * GetNativeSocketFd() returns an epoll fd that becomes readable when data
+ * arrives or the server hangs up, so the client can be polled like a socket.
+ * It is only good for polling: file descriptors can not be passed and the
+ * send queue can not be queried, so GetRemotePath() returns an empty path
+ * and features that need a unix socket refuse this transport.
+ * Recv() honours MSG_PEEK and MSG_DONTWAIT and returns 0 once the server
+ * hung up. Send() only notices a hang up when it has to wait for space.
+ * Concurrent senders are serialized, each message is written whole; so are
+ * concurrent receivers.
+ */
+class ShmRingStreamClient final : public IStreamSocketClient
+{
+public:
+    static constexpr size_t kDefaultRingSize = 4 * 1024 * 1024;
+
+    /**
+     * @param remote_server_path Unix socket path of the ring-aware server.
+     * @param ring_size Bytes per direction, rounded up to a power of two.
+     */
+    ShmRingStreamClient(const std::string& remote_server_path,
+                        size_t             ring_size = kDefaultRingSize);
+    ~ShmRingStreamClient();
+
+    ConnectionResult Connect() override;
+    bool             Connected() const override;
+    int              GetNativeSocketFd() const override;
+    std::string      GetRemotePath() const override;
+    IOResult         Send(const uint8_t* data, size_t size) override;
+    IOResult         SendV(const struct iovec* iov, int iovcnt) override;
+    IOResult         Recv(uint8_t* data, size_t size, uint8_t flag = 0) override;
+    IOStatus         SendNoAlloc(const uint8_t* data, size_t size) override;
+    IOStatus         SendVNoAlloc(const struct iovec* iov, int iovcnt) override;
+    IOStatus         RecvNoAlloc(uint8_t* data, size_t size, uint8_t flag = 0) override;
+    void             Close() override;
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> impl_;
+};
+} // namespace client
+} // namespace vhal
+
+#endif /* SHM_RING_STREAM_CLIENT_H */
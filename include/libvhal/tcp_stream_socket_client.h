@@ -26,6 +26,7 @@
 #define TCP_STREAM_SOCKET_CLIENT_H
 
 #include "istream_socket_client.h"
+#include "izero_copy_socket_client.h"
 #include <iostream>
 #include <memory>
 #include <string>
@@ -33,7 +34,9 @@
 namespace vhal {
 namespace client {
 
-class TcpStreamSocketClient final : public IStreamSocketClient
+class TcpStreamSocketClient final
+  : public IStreamSocketClient
+  , public IZeroCopySocketClient
 {
 public:
     TcpStreamSocketClient(const std::string& remote_server_ip, const int port);
@@ -43,9 +46,20 @@ public:
     bool             Connected() const override;
     int              GetNativeSocketFd() const override;
     IOResult         Send(const uint8_t* data, size_t size) override;
+    IOResult         SendV(const struct iovec* iov, int iovcnt) override;
     IOResult         Recv(uint8_t* data, size_t size, uint8_t flag = 0) override;
+    IOStatus         SendNoAlloc(const uint8_t* data, size_t size) override;
+    IOStatus         SendVNoAlloc(const struct iovec* iov, int iovcnt) override;
+    IOStatus         RecvNoAlloc(uint8_t* data, size_t size, uint8_t flag = 0) override;
     void             Close() override;
 
+    void     SetZeroCopy(bool enable, ReleaseCallback on_release) override;
+    bool     ZeroCopyActive() const override;
+    IOResult SendVZeroCopy(const struct iovec* iov,
+                           int                 iovcnt,
+                           uint64_t            cookie) override;
+    int      ProcessZeroCopyCompletions() override;
+
 private:
     class Impl;
     std::unique_ptr<Impl> impl_;
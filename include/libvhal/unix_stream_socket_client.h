@@ -46,8 +46,13 @@ public:
     ConnectionResult Connect() override;
     bool             Connected() const override;
     int              GetNativeSocketFd() const override;
+    std::string      GetRemotePath() const override;
     IOResult         Send(const uint8_t* data, size_t size) override;
+    IOResult         SendV(const struct iovec* iov, int iovcnt) override;
     IOResult         Recv(uint8_t* data, size_t size, uint8_t flag = 0) override;
+    IOStatus         SendNoAlloc(const uint8_t* data, size_t size) override;
+    IOStatus         SendVNoAlloc(const struct iovec* iov, int iovcnt) override;
+    IOStatus         RecvNoAlloc(uint8_t* data, size_t size, uint8_t flag = 0) override;
     void             Close() override;
 
 private:
@@ -0,0 +1,93 @@
+/**
+ * @file vhal_log.h
+ * @brief Log levels and runtime logging controls
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef VHAL_LOG_H
+#define VHAL_LOG_H
+
+#include <functional>
+
+/**
+ * Log levels. The values are kept for compatibility and do not follow
+ * severity, filters compare LIBVHAL_LOG_RANK() instead: a threshold of
+ * LIBVHAL_WARNING keeps warnings and errors only.
+ */
+#define LIBVHAL_INFO 1
+#define LIBVHAL_DEBUG 2
+#define LIBVHAL_WARNING 3
+#define LIBVHAL_ERROR 4
+
+/**
+ * Severity rank of a level: DEBUG 0 < INFO 1 < WARNING 2 < ERROR 3.
+ */
+#define LIBVHAL_LOG_RANK(level)                                                \
+    ((level) == LIBVHAL_DEBUG ? 0 : (level) == LIBVHAL_INFO ? 1 : (level) - 1)
+
+/**
+ * Messages less severe than this level are compiled out. Define it (e.g.
+ * with -DLIBVHAL_LOG_MIN_LEVEL=1 for LIBVHAL_INFO) to strip debug logging
+ * from a build.
+ */
+#ifndef LIBVHAL_LOG_MIN_LEVEL
+#define LIBVHAL_LOG_MIN_LEVEL LIBVHAL_DEBUG
+#endif
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief Receives formatted log lines, without trailing newline. Called from
+ *        the logging thread, never from the thread that logged.
+ */
+using LogSink = std::function<void(int level, const char* line)>;
+
+/**
+ * @brief Set the runtime log threshold; messages less severe than level are
+ *        dropped before being formatted. Defaults to LIBVHAL_INFO, which
+ *        drops debug messages, or to the value of the LIBVHAL_LOG_LEVEL
+ *        environment variable.
+ *
+ * @param level One of LIBVHAL_INFO, LIBVHAL_DEBUG, LIBVHAL_WARNING,
+ *        LIBVHAL_ERROR.
+ */
+void SetLogLevel(int level);
+
+/**
+ * @brief Current runtime log threshold.
+ */
+int GetLogLevel();
+
+/**
+ * @brief Route log lines to sink instead of stdout (logcat on Android).
+ *        Pass nullptr to restore the default.
+ */
+void SetLogSink(LogSink sink);
+
+/**
+ * @brief Wait until every message logged before this call has reached the
+ *        sink.
+ */
+void FlushLog();
+
+} // namespace client
+} // namespace vhal
+
+#endif /* VHAL_LOG_H */
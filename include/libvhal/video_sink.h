@@ -27,11 +27,18 @@
 
 #include "istream_socket_client.h"
 #include "libvhal_common.h"
+#include "annexb_packetizer.h"
+#include "frame_pacer.h"
+#include "pixel_convert.h"
+#include "reactor.h"
+#include <chrono>
 #include <functional>
+#include <future>
 #include <memory>
 #include <string>
 #include <sys/types.h>
 #include <tuple>
+#include <vector>
 
 namespace vhal {
 namespace client {
@@ -66,7 +73,10 @@ public:
         CAMERA_DATA = 3,
         ACK = 4,
         CAMERA_INFO = 5,
-        CAMERA_USER_ID = 6
+        CAMERA_USER_ID = 6,
+        CAMERA_BUFFER_POOL = 7,    // client -> VHal, fds over SCM_RIGHTS
+        CAMERA_BUFFER_READY = 8,   // client -> VHal
+        CAMERA_BUFFER_RELEASE = 9  // VHal -> client
     };
 
     /**
@@ -195,6 +205,32 @@ public:
         camera_config_t camera_config;
     };
 
+    /**
+     * @brief Payload of CAMERA_BUFFER_POOL. The message carries count frame
+     *        buffer fds, buffer N being the Nth fd. It replaces any pool
+     *        registered before.
+     *
+     */
+    struct camera_buffer_pool_t {
+        uint32_t generation;  // echoed by ready and release messages
+        uint32_t count;
+        uint32_t buffer_size;
+        uint32_t reserved[5];
+    };
+
+    /**
+     * @brief Payload of CAMERA_BUFFER_READY and CAMERA_BUFFER_RELEASE. With
+     *        ready, the first size bytes of buffer index hold a frame and
+     *        belong to the VHal until it sends release for index.
+     *
+     */
+    struct camera_buffer_msg_t {
+        uint32_t generation;
+        uint32_t index;
+        uint32_t size;  // frame size, 0 in release
+        uint32_t reserved;
+    };
+
     /**
      * @brief Type of the Camera callback which Camera VHAL triggers for
      * OpenCamera and CloseCamera cases.
@@ -202,6 +238,279 @@ public:
      */
     using CameraCallback = std::function<void(const camera_config_cmd_t& ctrl_msg)>;
 
+    /**
+     * @brief Type of the callback driven by StartFrameProducer(). Called
+     *        from the pacing thread when a frame is due, it sends the frame
+     *        with any of the Send APIs. Returning false stops the producer.
+     *
+     */
+    using FrameProducer = std::function<bool(uint64_t frame)>;
+
+    /**
+     * @brief Frame rate the Camera VHal expects, see DefaultFps().
+     *
+     */
+    static constexpr double kDefaultFps = 30.0;
+
+    /**
+     * @brief What the asynchronous send queue does with a new frame when it
+     *        is already full.
+     *
+     */
+    enum class SendDropPolicy {
+        kDropOldest,      // evict the oldest queued frame
+        kDropNonKeyFrame, // drop non key frames up to the next key frame,
+                          // a key frame evicts everything queued before it
+        kBlock            // block the caller until the writer makes room
+    };
+
+    /**
+     * @brief Outcome of a frame handed to the asynchronous send queue.
+     *
+     */
+    struct send_completion_t {
+        uint64_t frame_id  = 0;     // 0 based, in SendDataPacket() call order
+        bool     key_frame = false;
+        bool     dropped   = false; // true if never written to the socket
+        IOResult result;            // result of the socket write, or drop reason
+    };
+
+    /**
+     * @brief Type of the callback invoked once for every queued frame. Called
+     *        from the writer thread, or from the sender thread for frames
+     *        dropped on arrival. Must not block.
+     *
+     */
+    using SendCompletionCallback =
+      std::function<void(const send_completion_t& completion)>;
+
+    /**
+     * @brief Type of the callback telling that the packet passed to
+     *        SendDataPacketZeroCopy() with this cookie may be reused.
+     *
+     */
+    using PacketReleaseCallback = std::function<void(uint64_t cookie)>;
+
+    /**
+     * @brief Asynchronous send queue configuration.
+     *
+     */
+    struct async_send_config_t {
+        size_t                 queue_depth = 4;
+        SendDropPolicy         drop_policy = SendDropPolicy::kDropOldest;
+        SendCompletionCallback on_complete = nullptr;
+    };
+
+    /**
+     * @brief What the congestion monitor asks of the encoder, see
+     *        EnableCongestionControl().
+     *
+     */
+    enum class CongestionEvent {
+        kReduceBitrate,   // the VHal does not keep up, encode at bitrate_scale
+        kRequestKeyFrame, // frames were dropped, send a key frame next
+        kRecovered        // back to normal, the full bitrate may be used again
+    };
+
+    /**
+     * @brief Congestion event with the measurements behind it.
+     *
+     */
+    struct congestion_signal_t {
+        CongestionEvent          event          = CongestionEvent::kRecovered;
+        double                   bitrate_scale  = 1.0; // of the nominal bitrate
+        std::chrono::nanoseconds send_latency{ 0 };    // of the last send
+        int64_t                  socket_backlog = -1;  // bytes, -1 if unknown
+        uint64_t                 frames_dropped = 0;   // since enabled
+    };
+
+    /**
+     * @brief Type of the callback receiving congestion events. Called from
+     *        the thread sending the frame. Must not block, and must not
+     *        enable or disable congestion control.
+     *
+     */
+    using CongestionCallback = std::function<void(const congestion_signal_t& signal)>;
+
+    /**
+     * @brief Congestion monitor configuration. A send is congested when it
+     *        takes longer than latency_threshold or leaves more than
+     *        backlog_threshold bytes in the socket.
+     *
+     */
+    struct congestion_config_t {
+        std::chrono::microseconds latency_threshold{ 20000 };
+        size_t                    backlog_threshold   = 1024 * 1024;
+        uint32_t                  congested_frames    = 3;  // in a row, to reduce bitrate
+        uint32_t                  clear_frames        = 30; // in a row, to recover
+        std::chrono::milliseconds min_interval{ 1000 };     // between reductions
+        bool                      drop_when_congested = false; // drop non key frames
+                                                               // while congested
+    };
+
+    /**
+     * @brief Summary of a histogram, see camera_telemetry_t. Percentiles
+     *        are accurate to within 1/16 of the value.
+     *
+     */
+    struct histogram_summary_t {
+        uint64_t count = 0;
+        uint64_t min   = 0;
+        uint64_t max   = 0;
+        double   mean  = 0;
+        uint64_t p50   = 0;
+        uint64_t p90   = 0;
+        uint64_t p99   = 0;
+        uint64_t p999  = 0;
+    };
+
+    /**
+     * @brief Send statistics of a VideoSink or of a CameraStream.
+     *
+     */
+    struct camera_telemetry_t {
+        uint64_t            frames_sent     = 0;
+        uint64_t            bytes_sent      = 0;
+        uint64_t            send_errors     = 0;
+        uint64_t            frames_dropped  = 0; // never written, by the send
+                                                 // queue or the congestion monitor
+        double              fps             = 0; // during the last full second
+        double              average_fps     = 0; // since the first frame
+        double              bitrate         = 0; // bits per second, last full second
+        double              average_bitrate = 0; // since the first frame
+        histogram_summary_t send_latency;        // nanoseconds per socket write
+        histogram_summary_t queue_depth;         // frames queued, sampled on
+                                                 // each asynchronous send
+        int64_t             socket_backlog  = -1; // bytes not yet read by the
+                                                  // VHal (SIOCOUTQ), -1 if unknown
+        uint32_t            connections     = 0;
+        uint32_t            reconnects      = 0;
+    };
+
+    /**
+     * @brief Frame buffer shared with the Camera VHal, see EnableBufferPool().
+     *
+     */
+    struct frame_buffer_t {
+        uint32_t index = 0;
+        uint8_t* data  = nullptr; // mapped for the pool's lifetime
+        size_t   size  = 0;       // capacity
+        int      fd    = -1;      // owned by the pool
+    };
+
+    /**
+     * @brief Frame buffer pool configuration.
+     *
+     */
+    struct buffer_pool_config_t {
+        uint32_t         count       = 4;
+        size_t           buffer_size = 0; // e.g. width * height * 3 / 2 for I420
+        std::vector<int> fds;             // optional dmabuf or memfd buffers,
+                                          // duplicated; memfds are created
+                                          // when empty
+    };
+
+    /**
+     * @brief Statistics of one CameraStream.
+     *
+     */
+    struct camera_stream_stats_t {
+        uint64_t            frames_sent    = 0;
+        uint64_t            bytes_sent     = 0;
+        uint64_t            frames_dropped = 0; // camera not opened by VHal,
+                                                // or dropped while congested
+        uint64_t            send_errors    = 0;
+        FramePacer::stats_t pacing;             // of the last producer started
+    };
+
+    /**
+     * @brief Data path of one camera of a multi-camera VideoSink session,
+     *        see OpenCameraStream(). Each stream has its own send queue,
+     *        frame producer and statistics, all streams share the session
+     *        socket.
+     *
+     * The data packet header carries no camera id, the Camera VHal hands
+     * every frame to the camera it opened last. So a stream only sends
+     * while its camera is that one, frames sent at other times are dropped
+     * and counted in frames_dropped. Producers of all cameras can run all
+     * the time, only the camera in use reaches the VHal.
+     *
+     * The stream detaches from the session when destroyed; once the
+     * VideoSink is destroyed its Send APIs fail.
+     */
+    class CameraStream
+    {
+    public:
+        ~CameraStream();
+
+        CameraStream(const CameraStream&) = delete;
+        CameraStream& operator=(const CameraStream&) = delete;
+
+        /**
+         * @brief cameraId this stream was opened for.
+         */
+        uint32_t CameraId() const;
+
+        /**
+         * @brief Returns true between the CMD_OPEN and CMD_CLOSE of this
+         *        camera, i.e. while its frames reach the Camera VHal.
+         */
+        bool IsOpen() const;
+
+        /**
+         * @brief Same as VideoSink::SendDataPacket(), for this camera.
+         *        Fails while the camera is not open, see IsOpen().
+         */
+        IOResult SendDataPacket(const uint8_t* packet, size_t size,
+                                bool key_frame = true);
+
+        /**
+         * @brief Same as VideoSink::SendAccessUnit(), for this camera.
+         */
+        IOResult SendAccessUnit(const AnnexBPacketizer::access_unit_t& au);
+
+        /**
+         * @brief Same as VideoSink::EnableAsyncSend(), with a queue of this
+         *        stream only.
+         */
+        bool EnableAsyncSend(const async_send_config_t& config);
+
+        /**
+         * @brief Same as VideoSink::DisableAsyncSend().
+         */
+        void DisableAsyncSend();
+
+        /**
+         * @brief Same as VideoSink::StartFrameProducer(), with a pacer of
+         *        this stream only.
+         */
+        bool StartFrameProducer(double fps, FrameProducer producer,
+                                FramePacer::OverrunPolicy policy =
+                                  FramePacer::OverrunPolicy::kSkip);
+
+        /**
+         * @brief Same as VideoSink::StopFrameProducer().
+         */
+        void StopFrameProducer();
+
+        /**
+         * @brief Frame counters and pacing statistics of this camera.
+         */
+        camera_stream_stats_t Stats() const;
+
+        /**
+         * @brief Same as VideoSink::GetTelemetry(), for the frames of this
+         *        camera.
+         */
+        camera_telemetry_t Telemetry() const;
+
+    private:
+        friend class VideoSink;
+        class Impl;
+        explicit CameraStream(std::shared_ptr<Impl> impl);
+        std::shared_ptr<Impl> impl_;
+    };
+
     /**
      * @brief Construct a default VideoSink object from the Android instance id.
      *        Throws std::invalid_argument excpetion.
@@ -210,19 +519,25 @@ public:
      * @param callback Camera callback function object or lambda or function
      *        pointer.
      * @param user_id Optional parameter to specify the user# in multi-user config.
+     * @param reactor Optional shared Reactor. When set, the VHAL connection is
+     *        served by the reactor thread instead of a dedicated thread.
      *
      */
-    VideoSink(UnixConnectionInfo unix_conn_info, CameraCallback callback, const int32_t user_id = -1);
+    VideoSink(UnixConnectionInfo unix_conn_info, CameraCallback callback,
+              const int32_t user_id = -1,
+              std::shared_ptr<Reactor> reactor = nullptr);
 
     /**
      * @brief Construct a default VideoSink object from the Android vm cid.
      *        Throws std::invalid_argument excpetion.
      *
      * @param vsock_conn_info Information needed to connect to the vsock vhal socket.
+     * @param reactor Optional shared Reactor, see above.
      *
      */
 
-    VideoSink(VsockConnectionInfo vsock_conn_info, CameraCallback callback);
+    VideoSink(VsockConnectionInfo vsock_conn_info, CameraCallback callback,
+              std::shared_ptr<Reactor> reactor = nullptr);
 
     /**
      * @brief Destroy the VideoSink object
@@ -242,10 +557,12 @@ public:
      * @brief Send an encoded Camera packet to VHAL.
      *
      * This function sends data packet with the header containing size of the data
-     * packet. It's call is equivalent to the following 2 calls of SendRawPacket:
+     * packet. Header and packet are written to the socket with a single
+     * scatter-gather call, so it is equivalent to, but cheaper than, the
+     * following 2 calls of SendRawPacket:
      *
      * \code
-     * SendRawPacket((uint8_t*)&size, sizeof(size));
+     * SendRawPacket((uint8_t*)&header, sizeof(header));
      * SendRawPacket(packet, size);
      * \endcode
      *
@@ -259,6 +576,127 @@ public:
      */
     IOResult SendDataPacket(const uint8_t* packet, size_t size);
 
+    /**
+     * @brief Same as above, with the key frame flag used by the
+     *        SendDropPolicy::kDropNonKeyFrame policy of the asynchronous send
+     *        queue. The two argument overload treats every packet as a key
+     *        frame.
+     *
+     * @param packet Encoded Camera packet.
+     * @param size Size of the Camera packet.
+     * @param key_frame true if the packet can be decoded on its own.
+     *
+     * @return IOResult tuple<ssize_t, std::string>, see above.
+     */
+    IOResult SendDataPacket(const uint8_t* packet, size_t size, bool key_frame);
+
+    /**
+     * @brief Same as SendDataPacket(), reporting errors as an error code, so
+     *        that the per-frame path does not allocate.
+     *
+     * @return IOStatus, size is the packet size, 0 if dropped by the
+     *         congestion monitor, or -1 incase of failure.
+     */
+    IOStatus SendDataPacketNoAlloc(const uint8_t* packet, size_t size,
+                                   bool key_frame = true);
+
+    /**
+     * @brief Send one access unit split out of an H.264/H.265 stream by
+     *        AnnexBPacketizer, as a single data packet. Its key frame flag
+     *        is used by the asynchronous send queue, see SendDataPacket().
+     *
+     * @param au Complete access unit, i.e. exactly one frame.
+     *
+     * @return IOResult tuple<ssize_t, std::string>, see SendDataPacket().
+     */
+    IOResult SendAccessUnit(const AnnexBPacketizer::access_unit_t& au);
+
+    /**
+     * @brief Switch SendDataPacket() to asynchronous mode. Packets are copied
+     *        into a bounded queue and written to VHAL by a dedicated writer
+     *        thread, so SendDataPacket() no longer waits for the socket. It
+     *        returns the packet size once the packet is queued, the final
+     *        outcome is reported through config.on_complete.
+     *        Calling it again replaces the queue, see DisableAsyncSend().
+     *
+     * @param config Queue depth, drop policy and completion callback.
+     *
+     * @return true Asynchronous mode enabled.
+     * @return false Invalid config (queue_depth is 0).
+     */
+    bool EnableAsyncSend(const async_send_config_t& config);
+
+    /**
+     * @brief Switch SendDataPacket() back to synchronous mode. Waits for the
+     *        frame being written, frames still queued are reported as dropped.
+     *
+     */
+    void DisableAsyncSend();
+
+    /**
+     * @brief Watch the latency of every send and the socket backlog, and
+     *        report congestion through callback so that the encoder can
+     *        lower its bitrate or send a key frame. Frames dropped by the
+     *        asynchronous send queue also trigger a key frame request.
+     *        Calling it again replaces the monitor. Applies to the frames of
+     *        every CameraStream too; raw frames count as key frames.
+     *
+     * A frame dropped by the monitor is not an error: the Send API returns
+     * 0 bytes written, and the frame is counted in frames_dropped of
+     * GetTelemetry() (and of CameraStream::Stats()).
+     *
+     * @param config Thresholds, and whether to drop non key frames while
+     *        the socket is backed up, which bounds the camera latency.
+     * @param callback Receives the congestion events.
+     *
+     * @return true Monitor enabled.
+     * @return false Invalid config (congested_frames or clear_frames is 0).
+     */
+    bool EnableCongestionControl(const congestion_config_t& config,
+                                 CongestionCallback         callback);
+
+    /**
+     * @brief Stop monitoring congestion.
+     *
+     */
+    void DisableCongestionControl();
+
+    /**
+     * @brief Opt in to zero-copy sends (MSG_ZEROCOPY) for
+     *        SendDataPacketZeroCopy(). Worth it for large payloads such as
+     *        raw I420 frames. Only available on the vsock transport.
+     *
+     * @param on_release Called, possibly from another thread, once a packet
+     *        may be reused.
+     *
+     * @return true Zero-copy requested; the kernel may still decline it, in
+     *         which case packets are copied and released right away.
+     * @return false The transport does not support it.
+     */
+    bool EnableZeroCopy(PacketReleaseCallback on_release);
+
+    /**
+     * @brief Go back to copying sends. Packets in flight are still released.
+     *
+     */
+    void DisableZeroCopy();
+
+    /**
+     * @brief Same as SendDataPacket(), but the kernel reads the packet from
+     *        the caller's memory. The packet must stay valid and unmodified
+     *        until on_release reports cookie. Small packets, and all packets
+     *        when zero-copy is off or the asynchronous send queue is enabled,
+     *        are copied and released before this returns.
+     *
+     * @param packet Encoded or raw Camera packet.
+     * @param size Size of the Camera packet.
+     * @param cookie Reported back through the release callback.
+     *
+     * @return IOResult tuple<ssize_t, std::string>, see SendDataPacket().
+     */
+    IOResult SendDataPacketZeroCopy(const uint8_t* packet, size_t size,
+                                    uint64_t cookie);
+
     /**
      * @brief Send an raw Camera packet to VHAL for cases like I420
      *        where data is fixed always. when using this api both
@@ -274,10 +712,19 @@ public:
      */
     IOResult SendRawPacket(const uint8_t* packet, size_t size);
 
+    /**
+     * @brief Same as SendRawPacket(), reporting errors as an error code.
+     *
+     * @return IOStatus, size is the number of bytes sent or -1 incase of
+     *         failure.
+     */
+    IOStatus SendRawPacketNoAlloc(const uint8_t* packet, size_t size);
+
     /**
      * @brief GetCameraCapabilty
-     *        api is called to get vhal capability
-     *        client should call this api after successful connection 
+     *        api is called to get vhal capability. Blocks until the vhal
+     *        answers, at most kNegotiationTimeout, see
+     *        GetCameraCapabiltyAsync().
      *
      * @return camera_capability_t which provides vhal capabilites
      * @return NULL on failure
@@ -286,15 +733,183 @@ public:
 
     /**
      * @brief SetCameraCapability() API is called to set client
-     *        requested capability to camera vHAL
+     *        requested capability to camera vHAL. Blocks until the vhal
+     *        acknowledges it, at most kNegotiationTimeout.
      *
      * @param camera_info_t
      *
-     * @return true libvhal able to send camera info
-     * @return false libvhal failed to send camera info
+     * @return true camera vHAL accepted the camera info
+     * @return false camera vHAL refused it, or did not answer in time
      */
     bool SetCameraCapabilty(std::vector<camera_info_t> camera_info);
 
+    /**
+     * @brief How long the blocking capability APIs wait for the vhal.
+     *
+     */
+    static constexpr std::chrono::milliseconds kNegotiationTimeout{ 5000 };
+
+    /**
+     * @brief Asynchronous GetCameraCapabilty(). May be called before the
+     *        vhal is connected: the request goes out as soon as it is, and
+     *        again after a reconnect if it was not answered yet.
+     *
+     * @param timeout Counted from this call, connection time included.
+     *
+     * @return std::future set to the capability of this request, or to
+     *         nullptr once timeout expires or the VideoSink is destroyed.
+     */
+    std::future<std::shared_ptr<camera_capability_t>>
+    GetCameraCapabiltyAsync(std::chrono::milliseconds timeout = kNegotiationTimeout);
+
+    /**
+     * @brief Asynchronous SetCameraCapabilty(), queued like
+     *        GetCameraCapabiltyAsync().
+     *
+     * @return std::future set to true if the vhal accepted the camera info,
+     *         false if it refused it or did not answer in time.
+     */
+    std::future<bool>
+    SetCameraCapabiltyAsync(std::vector<camera_info_t> camera_info,
+                            std::chrono::milliseconds  timeout = kNegotiationTimeout);
+
+    /**
+     * @brief Connection timing of the Camera vhal session, including the
+     *        time to first frame: from creation (or from the loss of the
+     *        previous connection) until the first data packet was sent.
+     *
+     * @return ConnectionStats
+     */
+    ConnectionStats GetConnectionStats();
+
+    /**
+     * @brief Send statistics of the session, covering every data path:
+     *        SendDataPacket() and friends, frame buffers and camera streams.
+     *        Only reads atomic counters, so a metrics thread may call it at
+     *        any rate without slowing down the senders.
+     *
+     * @return camera_telemetry_t
+     */
+    camera_telemetry_t GetTelemetry();
+
+    /**
+     * @brief Frame rate to stream at after CMD_OPEN. camera_config_t carries
+     *        no rate: the Camera VHal runs at kDefaultFps for every codec and
+     *        resolution it supports.
+     *
+     * @return double Frames per second.
+     */
+    static double DefaultFps();
+
+    /**
+     * @brief Start calling producer at fps from a dedicated thread, paced
+     *        by a FramePacer. Replaces a producer already running.
+     *
+     * @param fps Frame rate, e.g. DefaultFps().
+     * @param producer Sends one frame per call.
+     * @param policy What to do when the producer falls behind.
+     *
+     * @return true Producer started.
+     * @return false Invalid fps or null producer.
+     */
+    bool StartFrameProducer(double fps, FrameProducer producer,
+                            FramePacer::OverrunPolicy policy =
+                              FramePacer::OverrunPolicy::kSkip);
+
+    /**
+     * @brief Stop the producer. Waits for the current frame interval to
+     *        end, so it must not be called from the producer itself.
+     *
+     */
+    void StopFrameProducer();
+
+    /**
+     * @brief Pacing statistics of the last producer started.
+     *
+     * @return FramePacer::stats_t drift, jitter, late and skipped frames.
+     */
+    FramePacer::stats_t GetFramePacerStats();
+
+    /**
+     * @brief Switch raw frames to shared buffers. The pool is registered
+     *        with the Camera VHal once per connection, after that a frame
+     *        costs a small CAMERA_BUFFER_READY message instead of a copy
+     *        through the socket. Only available on the unix socket transport.
+     *        Calling it again replaces the pool.
+     *
+     * \code
+     * VideoSink::frame_buffer_t buffer;
+     * if (sink.AcquireFrameBuffer(buffer, 33ms)) {
+     *     ConvertToI420(image, buffer.data);
+     *     sink.SendFrameBuffer(buffer.index, buffer.size);
+     * }
+     * \endcode
+     *
+     * @param config Number and size of the buffers, or buffers to share.
+     *
+     * @return true Pool created, registered as soon as connected.
+     * @return false Invalid config, a buffer that can not be mapped, or the
+     *         transport can not pass fds.
+     */
+    bool EnableBufferPool(const buffer_pool_config_t& config);
+
+    /**
+     * @brief Drop the pool. Buffers still acquired must not be used anymore.
+     *
+     */
+    void DisableBufferPool();
+
+    /**
+     * @brief Take a buffer the Camera VHal has released, waiting up to
+     *        timeout for one.
+     *
+     * @return true buffer is the caller's until SendFrameBuffer().
+     * @return false No pool, or no buffer released in time.
+     */
+    bool AcquireFrameBuffer(frame_buffer_t&           buffer,
+                            std::chrono::milliseconds timeout);
+
+    /**
+     * @brief Hand a filled buffer to the Camera VHal. The buffer comes back
+     *        to the pool when the VHal releases it, or when the connection
+     *        is lost.
+     *
+     * @param index frame_buffer_t::index of an acquired buffer.
+     * @param size Frame size, at most frame_buffer_t::size.
+     *
+     * @return IOResult tuple<ssize_t, std::string>, size on success.
+     */
+    IOResult SendFrameBuffer(uint32_t index, size_t size);
+
+    /**
+     * @brief Convert a raw camera image to I420, see ConvertToI420(), and
+     *        send it like SendRawPacket(). With the buffer pool enabled the
+     *        image is converted straight into a shared frame buffer and sent
+     *        with SendFrameBuffer(), waiting up to one frame interval for a
+     *        free buffer.
+     *
+     * @param image NV12, YUYV, UYVY, RGB24 or RGBA image.
+     * @param downscale Halve the width and height.
+     *
+     * @return IOResult tuple<ssize_t, std::string>, I420 size on success.
+     */
+    IOResult SendRawFrame(const raw_image_t& image, bool downscale = false);
+
+    /**
+     * @brief Open the data path of one camera announced with
+     *        SetCameraCapabilty(). CMD_OPEN and CMD_CLOSE for cameraId are
+     *        then passed to callback instead of the session callback.
+     *
+     * @param camera_id cameraId of the camera_info_t.
+     * @param callback Called, from the connection thread, with the commands
+     *        of this camera.
+     *
+     * @return std::shared_ptr<CameraStream>
+     * @return nullptr A stream is already open for camera_id.
+     */
+    std::shared_ptr<CameraStream> OpenCameraStream(uint32_t camera_id,
+                                                   CameraCallback callback);
+
 private:
     class Impl;
     std::unique_ptr<Impl> impl_;
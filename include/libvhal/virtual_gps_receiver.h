@@ -20,6 +20,7 @@
 #define __VIRTUAL_GPS_RECEIVER_H__
 
 #include "libvhal_common.h"
+#include <condition_variable>
 #include <functional>
 #include <memory>
 #include <mutex>
@@ -125,6 +126,7 @@ private:
     volatile Command             mCommand = kGpsStop;
     std::unique_ptr<std::thread> mWorkThread;
     std::mutex                   mMutex;
+    std::condition_variable      mStopCond;
     bool                         mStop = false;
 };
 
@@ -30,6 +30,7 @@
 #define VSOCK_STREAM_SOCKET_CLIENT_H
 
 #include "istream_socket_client.h"
+#include "izero_copy_socket_client.h"
 #include <iostream>
 #include <memory>
 #include <string>
@@ -37,7 +38,9 @@
 namespace vhal {
 namespace client {
 
-class VsockStreamSocketClient final : public IStreamSocketClient
+class VsockStreamSocketClient final
+  : public IStreamSocketClient
+  , public IZeroCopySocketClient
 {
 public:
     VsockStreamSocketClient(const int android_vm_cid);
@@ -47,10 +50,21 @@ public:
     bool             Connected() const override;
     int              GetNativeSocketFd() const override;
     IOResult         Send(const uint8_t* data, size_t size) override;
+    IOResult         SendV(const struct iovec* iov, int iovcnt) override;
     IOResult         Recv(uint8_t* data, size_t size, uint8_t flag= 0) override;
+    IOStatus         SendNoAlloc(const uint8_t* data, size_t size) override;
+    IOStatus         SendVNoAlloc(const struct iovec* iov, int iovcnt) override;
+    IOStatus         RecvNoAlloc(uint8_t* data, size_t size, uint8_t flag = 0) override;
 
     void             Close() override;
 
+    void     SetZeroCopy(bool enable, ReleaseCallback on_release) override;
+    bool     ZeroCopyActive() const override;
+    IOResult SendVZeroCopy(const struct iovec* iov,
+                           int                 iovcnt,
+                           uint64_t            cookie) override;
+    int      ProcessZeroCopyCompletions() override;
+
 private:
     class Impl;
     std::unique_ptr<Impl> impl_;
@@ -0,0 +1,60 @@
+/**
+ * @file annexb_packetizer.cc
+ * @brief Splits H.264/H.265 Annex-B byte streams into access units
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "annexb_packetizer.h"
+#include "annexb_packetizer_impl.h"
+
+namespace vhal {
+namespace client {
+
+AnnexBPacketizer::AnnexBPacketizer(Codec codec)
+  : impl_{ std::make_unique<Impl>(codec) }
+{}
+
+AnnexBPacketizer::~AnnexBPacketizer() = default;
+
+void
+AnnexBPacketizer::Push(const uint8_t* data, size_t size)
+{
+    impl_->Push(data, size);
+}
+
+bool
+AnnexBPacketizer::Next(access_unit_t& au)
+{
+    return impl_->Next(au);
+}
+
+void
+AnnexBPacketizer::Flush()
+{
+    impl_->Flush();
+}
+
+void
+AnnexBPacketizer::Reset()
+{
+    impl_->Reset();
+}
+
+} // namespace client
+} // namespace vhal
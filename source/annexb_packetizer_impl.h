@@ -0,0 +1,279 @@
+/**
+ * @file annexb_packetizer_impl.h
+ * @brief Splits H.264/H.265 Annex-B byte streams into access units
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ANNEXB_PACKETIZER_IMPL_H
+#define ANNEXB_PACKETIZER_IMPL_H
+
+#include "annexb_packetizer.h"
+#include "start_code_scan.h"
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief Finds access unit boundaries in a stream held by the caller.
+ *
+ * Every Scan() is given the whole stream retained so far, starting at offset
+ * 0, and resumes where the previous one stopped. Complete units are queued as
+ * offsets into that stream. Shift() tells that the caller dropped bytes from
+ * the front.
+ */
+class AccessUnitSplitter
+{
+public:
+    // Location of a complete access unit in the stream.
+    struct Range
+    {
+        size_t offset;
+        size_t size;
+        bool   key_frame;
+        bool   parameter_sets;
+    };
+
+    explicit AccessUnitSplitter(AnnexBPacketizer::Codec codec)
+      : codec_{ codec }
+    {}
+
+    /**
+     * @param eof No more data will follow, handle start codes even if the
+     *        NAL header after them is cut short.
+     */
+    void Scan(const uint8_t* data, size_t size, bool eof)
+    {
+        // A start code is only handled once the header after it arrived,
+        // unless the stream ends there.
+        size_t end = eof ? size : (size > HeaderSize() ? size - HeaderSize() : 0);
+        while (scan_pos_ + 3 <= end) {
+            size_t found = scan_pos_ + FindStartCode(data + scan_pos_, end - scan_pos_);
+            if (found + 3 > end) {
+                // A start code may begin in the last 2 bytes scanned.
+                scan_pos_ = end - 2;
+                return;
+            }
+            OnStartCode(data, size, found);
+            scan_pos_ = found + 3;
+        }
+    }
+
+    /**
+     * @brief End of stream, queues the unit being built as the last one.
+     */
+    void Finish(const uint8_t* data, size_t size)
+    {
+        Scan(data, size, true);
+        if (au_start_ != kNone && au_start_ < size) {
+            Emit(size);
+        }
+        au_start_     = kNone;
+        last_payload_ = kNone;
+    }
+
+    /**
+     * @brief First offset still needed by the splitter or a queued unit.
+     */
+    size_t Retained() const
+    {
+        size_t keep = ready_.empty() ? (au_start_ != kNone ? au_start_ : scan_pos_)
+                                     : ready_.front().offset;
+        return std::min(keep, scan_pos_);
+    }
+
+    void Shift(size_t count)
+    {
+        for (auto& range : ready_) {
+            range.offset -= count;
+        }
+        scan_pos_ -= count;
+        if (au_start_ != kNone) {
+            au_start_ -= count;
+        }
+        if (last_payload_ != kNone) {
+            last_payload_ = last_payload_ > count ? last_payload_ - count : 0;
+        }
+    }
+
+    std::deque<Range>& Ready() { return ready_; }
+
+    void Reset()
+    {
+        ready_.clear();
+        scan_pos_     = 0;
+        au_start_     = kNone;
+        last_payload_ = kNone;
+        ResetFlags();
+    }
+
+private:
+    static constexpr size_t kNone = SIZE_MAX;
+
+    // What a NAL unit header tells about the access unit it belongs to.
+    struct NalInfo
+    {
+        bool vcl;          // coded slice
+        bool first_slice;  // first slice of a picture
+        bool prefix;       // non-VCL unit that opens a new access unit
+        bool key_frame;
+        bool parameter_set;
+    };
+
+    AnnexBPacketizer::Codec codec_;
+    std::deque<Range>       ready_;
+    size_t                  scan_pos_     = 0;
+    size_t                  au_start_     = kNone; // start of the unit being built
+    size_t                  last_payload_ = kNone; // first byte after the last start code
+    bool                    au_has_vcl_   = false;
+    bool                    au_key_frame_ = false;
+    bool                    au_params_    = false;
+
+    // NAL header bytes needed to classify a unit, including the first
+    // slice header byte.
+    size_t HeaderSize() const { return codec_ == AnnexBPacketizer::Codec::kH264 ? 2 : 3; }
+
+    void ResetFlags()
+    {
+        au_has_vcl_   = false;
+        au_key_frame_ = false;
+        au_params_    = false;
+    }
+
+    NalInfo Classify(const uint8_t* nal, size_t available) const
+    {
+        NalInfo info = {};
+        if (available == 0) {
+            return info;
+        }
+        if (codec_ == AnnexBPacketizer::Codec::kH264) {
+            int type           = nal[0] & 0x1f;
+            info.vcl           = type >= 1 && type <= 5;
+            // first_mb_in_slice is ue(v), a leading 1 bit means 0.
+            info.first_slice   = info.vcl && available > 1 && (nal[1] & 0x80);
+            info.prefix        = type == 6 || type == 7 || type == 8 || type == 9
+                                 || (type >= 14 && type <= 18);
+            info.key_frame     = type == 5;
+            info.parameter_set = type == 7 || type == 8;
+        } else {
+            int type           = (nal[0] >> 1) & 0x3f;
+            info.vcl           = type < 32;
+            // first_slice_segment_in_pic_flag follows the 2 byte header.
+            info.first_slice   = info.vcl && available > 2 && (nal[2] & 0x80);
+            info.prefix        = (type >= 32 && type <= 35) || type == 39
+                                 || (type >= 41 && type <= 44) || (type >= 48 && type <= 55);
+            info.key_frame     = type >= 16 && type <= 23;
+            info.parameter_set = type >= 32 && type <= 34;
+        }
+        return info;
+    }
+
+    void OnStartCode(const uint8_t* data, size_t size, size_t pos)
+    {
+        // The zero_byte of a 4 byte start code belongs to the next unit.
+        size_t cut = pos;
+        if (pos > 0 && data[pos - 1] == 0
+            && (last_payload_ == kNone || pos - 1 >= last_payload_)) {
+            cut = pos - 1;
+        }
+        size_t  payload = pos + 3;
+        NalInfo info    = Classify(data + payload, size - payload);
+        if (au_start_ == kNone) {
+            au_start_ = cut;
+        } else if (au_has_vcl_ && (info.prefix || info.first_slice)) {
+            Emit(cut);
+            au_start_ = cut;
+        }
+        last_payload_ = payload;
+        au_has_vcl_ |= info.vcl;
+        au_key_frame_ |= info.key_frame;
+        au_params_ |= info.parameter_set;
+    }
+
+    void Emit(size_t end)
+    {
+        ready_.push_back({ au_start_, end - au_start_, au_key_frame_, au_params_ });
+        ResetFlags();
+    }
+};
+
+class AnnexBPacketizer::Impl
+{
+public:
+    explicit Impl(Codec codec)
+      : splitter_{ codec }
+    {}
+
+    void Push(const uint8_t* data, size_t size)
+    {
+        Compact();
+        buffer_.insert(buffer_.end(), data, data + size);
+        splitter_.Scan(buffer_.data(), buffer_.size(), false);
+    }
+
+    bool Next(access_unit_t& au)
+    {
+        auto& ready = splitter_.Ready();
+        if (ready.empty()) {
+            return false;
+        }
+        const auto& range = ready.front();
+        au.data           = buffer_.data() + range.offset;
+        au.size           = range.size;
+        au.key_frame      = range.key_frame;
+        au.parameter_sets = range.parameter_sets;
+        ready.pop_front();
+        return true;
+    }
+
+    void Flush() { splitter_.Finish(buffer_.data(), buffer_.size()); }
+
+    void Reset()
+    {
+        buffer_.clear();
+        splitter_.Reset();
+    }
+
+private:
+    AccessUnitSplitter   splitter_;
+    std::vector<uint8_t> buffer_;
+
+    /**
+     * @brief Drops bytes nobody refers to any more. Only done once they make
+     *        up half of the buffer, so that a large picture arriving in small
+     *        chunks is not moved around on every Push().
+     */
+    void Compact()
+    {
+        size_t keep = splitter_.Retained();
+        if (keep == 0 || keep < buffer_.size() / 2) {
+            return;
+        }
+        buffer_.erase(buffer_.begin(), buffer_.begin() + keep);
+        splitter_.Shift(keep);
+    }
+};
+
+} // namespace client
+} // namespace vhal
+
+#endif /* ANNEXB_PACKETIZER_IMPL_H */
@@ -0,0 +1,289 @@
+/**
+ * @file async_logger.cc
+ * @brief Asynchronous logging backend behind AIC_LOG
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "async_logger.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+extern "C"
+{
+#include <sys/syscall.h>
+#include <unistd.h>
+#ifdef __android__
+#include <android/log.h>
+#endif
+}
+
+namespace vhal {
+namespace client {
+
+namespace {
+
+// How long a message may wait in its ring when nothing asks for a flush.
+constexpr auto kDrainInterval = std::chrono::milliseconds(10);
+
+int InitialThreshold()
+{
+    const char* env = std::getenv("LIBVHAL_LOG_LEVEL");
+    if (env == nullptr) {
+        return LIBVHAL_INFO;
+    }
+    int level = std::atoi(env);
+    return std::clamp(level, LIBVHAL_INFO, LIBVHAL_ERROR + 1);
+}
+
+const char* LevelName(int level)
+{
+    switch (level) {
+        case LIBVHAL_ERROR:
+            return "ERR";
+        case LIBVHAL_WARNING:
+            return "WRN";
+        case LIBVHAL_DEBUG:
+            return "DBG";
+        default:
+            return "INF";
+    }
+}
+
+} // namespace
+
+std::atomic<int> AsyncLogger::threshold_{ InitialThreshold() };
+
+AsyncLogger&
+AsyncLogger::Instance()
+{
+    // Never destroyed, threads may still log during static destruction.
+    // Pending messages are written out at exit.
+    static AsyncLogger* instance = []() {
+        auto logger = new AsyncLogger();
+        std::atexit([]() { Instance().Shutdown(); });
+        return logger;
+    }();
+    return *instance;
+}
+
+AsyncLogger::AsyncLogger()
+  : drain_thread_{ &AsyncLogger::DrainThread, this }
+{}
+
+AsyncLogger::RingHandle::~RingHandle()
+{
+    if (ring) {
+        ring->orphaned = true;
+    }
+}
+
+void
+AsyncLogger::Log(int level, const char* func, int line, const char* fmt, ...)
+{
+    va_list args;
+    if (shut_down_.load(std::memory_order_acquire)) {
+        // Too late for the drain thread, write it out directly.
+        Record record;
+        va_start(args, fmt);
+        Format(record, syscall(__NR_gettid), level, func, line, fmt, args);
+        va_end(args);
+        std::lock_guard<std::mutex> lock(mutex_);
+        Write(sink_, record.level, record.text);
+        fflush(stdout);
+        return;
+    }
+
+    Ring*  ring = LocalRing();
+    size_t head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->tail.load(std::memory_order_acquire) >= kRingSlots) {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    va_start(args, fmt);
+    Format(ring->slots[head % kRingSlots], ring->tid, level, func, line, fmt, args);
+    va_end(args);
+    ring->head.store(head + 1, std::memory_order_release);
+
+    // Errors are written out right away instead of at the next interval.
+    if (level >= LIBVHAL_ERROR) {
+        urgent_.store(true, std::memory_order_relaxed);
+        wake_.notify_one();
+    }
+}
+
+void
+AsyncLogger::SetSink(LogSink sink)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    sink_ = std::move(sink);
+}
+
+void
+AsyncLogger::Flush()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (stopped_) {
+        return;
+    }
+    uint64_t ticket = ++flush_requested_;
+    wake_.notify_one();
+    flushed_.wait(lock, [&]() { return flush_done_ >= ticket || stopped_; });
+}
+
+void
+AsyncLogger::Shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopped_) {
+            return;
+        }
+        stopped_ = true;
+    }
+    wake_.notify_one();
+    drain_thread_.join();
+    shut_down_.store(true, std::memory_order_release);
+    // Whatever was logged while the drain thread finished up.
+    std::lock_guard<std::mutex> lock(mutex_);
+    Drain(sink_);
+}
+
+AsyncLogger::Ring*
+AsyncLogger::LocalRing()
+{
+    thread_local RingHandle handle;
+    if (!handle.ring) {
+        auto ring = std::make_shared<Ring>();
+        ring->tid = syscall(__NR_gettid);
+        {
+            std::lock_guard<std::mutex> lock(rings_mutex_);
+            rings_.push_back(ring);
+        }
+        handle.ring = std::move(ring);
+    }
+    return handle.ring.get();
+}
+
+void
+AsyncLogger::Format(Record& record, long tid, int level, const char* func,
+                    int line, const char* fmt, va_list args)
+{
+    record.level = level;
+    int prefix   = snprintf(record.text, kLineSize, "%s %ld %s(%d): ",
+                            LevelName(level), tid, func, line);
+    size_t used = std::clamp(prefix, 0, static_cast<int>(kLineSize) - 1);
+    vsnprintf(record.text + used, kLineSize - used, fmt, args);
+}
+
+void
+AsyncLogger::Drain(const LogSink& sink)
+{
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+    for (auto& ring : rings_) {
+        bool   orphaned = ring->orphaned.load();
+        size_t tail     = ring->tail.load(std::memory_order_relaxed);
+        size_t head     = ring->head.load(std::memory_order_acquire);
+        for (; tail != head; ++tail) {
+            const Record& record = ring->slots[tail % kRingSlots];
+            Write(sink, record.level, record.text);
+        }
+        ring->tail.store(tail, std::memory_order_release);
+
+        if (uint64_t dropped = ring->dropped.exchange(0, std::memory_order_relaxed)) {
+            char text[kLineSize];
+            snprintf(text, sizeof(text), "WRN %ld %s: %llu log messages dropped",
+                     ring->tid, __FUNCTION__, static_cast<unsigned long long>(dropped));
+            Write(sink, LIBVHAL_WARNING, text);
+        }
+        if (orphaned && tail == ring->head.load(std::memory_order_acquire)) {
+            ring.reset();
+        }
+    }
+    rings_.erase(std::remove(rings_.begin(), rings_.end(), nullptr), rings_.end());
+    if (!sink) {
+        fflush(stdout);
+    }
+}
+
+void
+AsyncLogger::Write(const LogSink& sink, int level, const char* line)
+{
+    if (sink) {
+        sink(level, line);
+        return;
+    }
+#ifdef __android__
+    int priority = level == LIBVHAL_ERROR     ? ANDROID_LOG_ERROR
+                   : level == LIBVHAL_WARNING ? ANDROID_LOG_WARN
+                   : level == LIBVHAL_DEBUG   ? ANDROID_LOG_DEBUG
+                                              : ANDROID_LOG_INFO;
+    __android_log_write(priority, "libvhal", line);
+#else
+    fputs(line, stdout);
+    fputc('\n', stdout);
+#endif
+}
+
+void
+AsyncLogger::DrainThread()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        wake_.wait_for(lock, kDrainInterval, [this]() {
+            return stopped_ || flush_requested_ != flush_done_ || urgent_;
+        });
+        urgent_.store(false, std::memory_order_relaxed);
+        uint64_t requested = flush_requested_;
+        bool     stop      = stopped_;
+        Drain(sink_);
+        flush_done_ = requested;
+        flushed_.notify_all();
+        if (stop) {
+            break;
+        }
+    }
+}
+
+void
+SetLogLevel(int level)
+{
+    AsyncLogger::SetThreshold(level);
+}
+
+int
+GetLogLevel()
+{
+    return AsyncLogger::Threshold();
+}
+
+void
+SetLogSink(LogSink sink)
+{
+    AsyncLogger::Instance().SetSink(std::move(sink));
+}
+
+void
+FlushLog()
+{
+    AsyncLogger::Instance().Flush();
+}
+
+} // namespace client
+} // namespace vhal
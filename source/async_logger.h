@@ -0,0 +1,165 @@
+/**
+ * @file async_logger.h
+ * @brief Asynchronous logging backend behind AIC_LOG
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ASYNC_LOGGER_H
+#define ASYNC_LOGGER_H
+
+#include "vhal_log.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief Process wide logger. Each thread formats its messages into its own
+ * single-producer ring, and a background thread writes them out, so logging
+ * from a talker or sender thread costs no syscall and takes no lock.
+ *
+ * A message that does not fit in the ring of its thread is dropped and
+ * counted; the count is reported once there is room again. Lines longer than
+ * kLineSize are truncated.
+ */
+class AsyncLogger
+{
+public:
+    static constexpr size_t kLineSize  = 256;
+    static constexpr size_t kRingSlots = 128;
+
+    static AsyncLogger& Instance();
+
+    static bool Enabled(int level)
+    {
+        return LIBVHAL_LOG_RANK(level)
+               >= LIBVHAL_LOG_RANK(threshold_.load(std::memory_order_relaxed));
+    }
+
+    static void SetThreshold(int level)
+    {
+        threshold_.store(level, std::memory_order_relaxed);
+    }
+
+    static int Threshold() { return threshold_.load(std::memory_order_relaxed); }
+
+    void Log(int level, const char* func, int line, const char* fmt, ...)
+      __attribute__((format(printf, 5, 6)));
+
+    void SetSink(LogSink sink);
+
+    void Flush();
+
+private:
+    struct Record
+    {
+        int  level;
+        char text[kLineSize];
+    };
+
+    struct Ring
+    {
+        std::array<Record, kRingSlots> slots;
+        std::atomic<size_t>            head{ 0 }; // written by the producer
+        std::atomic<size_t>            tail{ 0 }; // written by the drain thread
+        std::atomic<uint64_t>          dropped{ 0 };
+        std::atomic<bool>              orphaned{ false };
+        long                           tid = 0;
+    };
+
+    // Lets the drain thread free a ring once its thread is gone.
+    struct RingHandle
+    {
+        std::shared_ptr<Ring> ring;
+        ~RingHandle();
+    };
+
+    static std::atomic<int> threshold_;
+
+    std::mutex                         rings_mutex_;
+    std::vector<std::shared_ptr<Ring>> rings_;
+
+    std::mutex              mutex_;
+    std::condition_variable wake_;
+    std::condition_variable flushed_;
+    uint64_t                flush_requested_ = 0;
+    uint64_t                flush_done_      = 0;
+    bool                    stopped_         = false;
+    std::atomic<bool>       shut_down_{ false };
+    std::atomic<bool>       urgent_{ false };
+    LogSink                 sink_;
+    std::thread             drain_thread_;
+
+    AsyncLogger();
+    void Shutdown();
+    Ring* LocalRing();
+    void Format(Record& record, long tid, int level, const char* func,
+                  int line, const char* fmt, va_list args);
+    void Drain(const LogSink& sink);
+    void Write(const LogSink& sink, int level, const char* line);
+    void DrainThread();
+};
+
+/**
+ * @brief Lets through at most one message per interval and counts the rest,
+ * for messages that repeat in a loop such as connect retries. Thread safe.
+ */
+class LogRateLimiter
+{
+public:
+    explicit LogRateLimiter(std::chrono::milliseconds interval)
+      : interval_{ std::chrono::duration_cast<std::chrono::steady_clock::duration>(interval)
+                     .count() }
+    {}
+
+    /**
+     * @brief Whether a message may be logged now. On true, suppressed is set
+     *        to the number of messages skipped since the previous one.
+     */
+    bool Allow(uint64_t& suppressed)
+    {
+        int64_t now  = std::chrono::steady_clock::now().time_since_epoch().count();
+        int64_t next = next_.load(std::memory_order_relaxed);
+        if (now < next || !next_.compare_exchange_strong(next, now + interval_)) {
+            suppressed_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    int64_t               interval_;
+    std::atomic<int64_t>  next_{ 0 };
+    std::atomic<uint64_t> suppressed_{ 0 };
+};
+
+} // namespace client
+} // namespace vhal
+
+#endif /* ASYNC_LOGGER_H */
@@ -24,6 +24,7 @@
 
 #include "audio_sink.h"
 #include "audio_sink_impl.h"
+#include "io_uring_stream_socket_client.h"
 #include "tcp_stream_socket_client.h"
 #include <functional>
 #include <memory>
@@ -35,12 +36,18 @@ namespace vhal {
 namespace client {
 namespace audio {
 
-AudioSink::AudioSink(TcpConnectionInfo tcp_conn_info, AudioCallback callback, const int32_t user_id)
+AudioSink::AudioSink(TcpConnectionInfo tcp_conn_info, AudioCallback callback, const int32_t user_id,
+                     std::shared_ptr<Reactor> reactor)
 {
-    auto tcp_sock_client =
+    std::unique_ptr<IStreamSocketClient> tcp_sock_client =
       std::make_unique<TcpStreamSocketClient>(tcp_conn_info.ip_addr,
       tcp_conn_info.port ? tcp_conn_info.port : LIBVHAL_AUDIO_RECORD_PORT);
-    impl_ = std::make_unique<Impl>(std::move(tcp_sock_client), callback, user_id);
+    if (tcp_conn_info.io_uring) {
+        tcp_sock_client = std::make_unique<IoUringStreamSocketClient>(
+          std::move(tcp_sock_client), tcp_conn_info.io_uring);
+    }
+    impl_ = std::make_unique<Impl>(std::move(tcp_sock_client), callback, user_id,
+                                   std::move(reactor));
 }
 
 AudioSink::~AudioSink() {}
@@ -50,6 +57,11 @@ IOResult AudioSink::SendDataPacket(const uint8_t* packet, size_t size)
     return impl_->SendDataPacket(packet, size);
 }
 
+IOStatus AudioSink::SendDataPacketNoAlloc(const uint8_t* packet, size_t size)
+{
+    return impl_->SendDataPacketNoAlloc(packet, size);
+}
+
 } // namespace audio
 } // namespace client
 } // namespace vhal
@@ -25,7 +25,10 @@
 #ifndef AUDIO_SINK_IMPL_H
 #define AUDIO_SINK_IMPL_H
 
+#include "framed_reader.h"
 #include "istream_socket_client.h"
+#include "receiver_log.h"
+#include "stream_talker.h"
 #include "audio_sink.h"
 #include <atomic>
 #include <chrono>
@@ -53,96 +56,81 @@ namespace audio {
 class AudioSink::Impl
 {
 public:
-    Impl(unique_ptr<IStreamSocketClient> socket_client, AudioCallback callback, const int32_t user_id)
-      : socket_client_{ move(socket_client) }, callback_{ move(callback) }
+    Impl(unique_ptr<IStreamSocketClient> socket_client,
+         AudioCallback                   callback,
+         const int32_t                   user_id,
+         shared_ptr<Reactor>             reactor = nullptr)
+      : callback_{ move(callback) },
+        socket_client_{ move(socket_client) },
+        user_id_{ user_id },
+        reader_{ socket_client_.get() },
+        talker_{ socket_client_.get(),
+                 "AudioSink",
+                 move(reactor),
+                 [this]() { OnConnected(); },
+                 [this]() { return OnMessage(); } }
     {
-        vhal_talker_thread_ = thread([this, user_id]() {
-            while (should_continue_) {
-                if (not socket_client_->Connected()) {
-                    auto [connected, error_msg] = socket_client_->Connect();
-                    if (!connected) {
-                        cout << "AudioSink Failed to connect to VHal: "
-                             << error_msg
-                             << ". Retry after 1s...\n";
-                        this_thread::sleep_for(1s);
-                        continue;
-                    }
-                }
-                // connected ...
-                cout << "Connected to Audio VHal(sink), Sending user_id: " << user_id << "\n";
-                if (user_id != -1) {
-                    CtrlMessage ctrl_msg;
-                    ctrl_msg.cmd = Command::kUserId;
-                    ctrl_msg.data = user_id;
-                    SendDataPacket(reinterpret_cast<const uint8_t *>(&ctrl_msg), sizeof(CtrlMessage));
-                }
-
-                struct pollfd fds[1];
-                const int     timeout_ms = 1 * 1000; // 1 sec timeout
-                int           ret;
-
-                // watch socket for input
-                fds[0].fd     = socket_client_->GetNativeSocketFd();
-                fds[0].events = POLLIN;
-
-                do {
-                    ret = poll(fds, std::size(fds), timeout_ms);
-                    if (ret == -1) {
-                        throw system_error(errno, system_category());
-                    }
-                    if (!ret) {
-                        continue;
-                    }
-                    if (fds[0].revents & POLLIN) {
-                        CtrlMessage ctrl_msg;
-                        auto [received, recv_err_msg] =
-                            socket_client_->Recv(
-                            reinterpret_cast<uint8_t*>(&ctrl_msg),
-                            sizeof(ctrl_msg));
-                        if (received != sizeof(CtrlMessage)) {
-                            cout << "Failed to read message from AudioSink: "
-                                 << recv_err_msg
-                                 << ", going to disconnect and reconnect.\n";
-                            socket_client_->Close();
-                            break;
-                        }
-                        // success, invoke client callback
-                        callback_(cref(ctrl_msg));
-                    } else {
-                        if (fds[0].revents & (POLLERR|POLLHUP)) {
-                            cout << "AudioSink Poll Fail event: "
-                                << fds[0].revents
-                                << ", reconnect\n";
-                            socket_client_->Close();
-                            break;
-                        }
-                        cout << "AudioSink : Poll revents " << fds[0].revents << "\n";
-                    }
-                } while (should_continue_);
-            }
-        });
+        talker_.Start();
     }
 
     ~Impl()
     {
-        should_continue_ = false;
-        vhal_talker_thread_.join();
+        talker_.Stop();
     }
 
     IOResult SendDataPacket(const uint8_t* packet, size_t size)
     {
-        auto [sent, error_msg] = socket_client_->Send(reinterpret_cast<const uint8_t*>(packet), size);
-        if (sent == -1)
-            return { sent, error_msg };
+        return ToIOResult(SendDataPacketNoAlloc(packet, size));
+    }
+
+    IOStatus SendDataPacketNoAlloc(const uint8_t* packet, size_t size)
+    {
+        auto status = socket_client_->SendNoAlloc(packet, size);
+        if (status.size == -1)
+            return status;
         // success
-        return { size, "" };
+        return { static_cast<ssize_t>(size), {} };
+    }
+
+    void OnConnected()
+    {
+        reader_.Reset();
+        AIC_LOG(LIBVHAL_INFO, "Connected to Audio VHal(sink), Sending user_id: %d", user_id_);
+        if (user_id_ != -1) {
+            CtrlMessage ctrl_msg;
+            ctrl_msg.cmd = Command::kUserId;
+            ctrl_msg.data = user_id_;
+            SendDataPacket(reinterpret_cast<const uint8_t *>(&ctrl_msg), sizeof(CtrlMessage));
+        }
+    }
+
+    StreamTalker::Status OnMessage()
+    {
+        // Drain every message the last fill brought in; poll() won't report
+        // them again.
+        do {
+            CtrlMessage ctrl_msg;
+            auto [received, recv_err_msg] = reader_.Read(&ctrl_msg, sizeof(ctrl_msg));
+            if (received != sizeof(CtrlMessage)) {
+                AIC_LOG(LIBVHAL_ERROR,
+                        "Failed to read message from AudioSink: %s, going to disconnect and reconnect.",
+                        recv_err_msg.c_str());
+                return StreamTalker::Status::kReconnect;
+            }
+            // success, invoke client callback
+            callback_(cref(ctrl_msg));
+        } while (reader_.Buffered() >= sizeof(CtrlMessage));
+        return StreamTalker::Status::kContinue;
     }
 
 private:
     AudioCallback                   callback_ = nullptr;
     unique_ptr<IStreamSocketClient> socket_client_;
-    thread                          vhal_talker_thread_;
-    atomic<bool>                    should_continue_ = true;
+    int32_t                         user_id_ = -1;
+    FramedReader                    reader_;
+
+    // Declared last: stopped before the state its handlers use goes away.
+    StreamTalker                    talker_;
 };
 
 } // namespace audio
@@ -24,6 +24,7 @@
 
 #include "audio_source.h"
 #include "audio_source_impl.h"
+#include "io_uring_stream_socket_client.h"
 #include "tcp_stream_socket_client.h"
 #include <functional>
 #include <memory>
@@ -35,12 +36,18 @@ namespace vhal {
 namespace client {
 namespace audio {
 
-AudioSource::AudioSource(TcpConnectionInfo tcp_conn_info, AudioCallback callback, const int32_t user_id)
+AudioSource::AudioSource(TcpConnectionInfo tcp_conn_info, AudioCallback callback, const int32_t user_id,
+                         std::shared_ptr<Reactor> reactor)
 {
-    auto tcp_sock_client =
+    std::unique_ptr<IStreamSocketClient> tcp_sock_client =
       std::make_unique<TcpStreamSocketClient>(tcp_conn_info.ip_addr,
       tcp_conn_info.port ? tcp_conn_info.port : LIBVHAL_AUDIO_PLAYBACK_PORT);
-    impl_ = std::make_unique<Impl>(std::move(tcp_sock_client), callback, user_id);
+    if (tcp_conn_info.io_uring) {
+        tcp_sock_client = std::make_unique<IoUringStreamSocketClient>(
+          std::move(tcp_sock_client), tcp_conn_info.io_uring);
+    }
+    impl_ = std::make_unique<Impl>(std::move(tcp_sock_client), callback, user_id,
+                                   std::move(reactor));
 }
 
 AudioSource::~AudioSource() {}
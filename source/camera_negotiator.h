@@ -0,0 +1,302 @@
+/**
+ * @file camera_negotiator.h
+ * @brief Capability requests to the Camera VHal and their responses
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef CAMERA_NEGOTIATOR_H
+#define CAMERA_NEGOTIATOR_H
+
+#include "receiver_log.h"
+#include "video_sink.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief Matches CAPABILITY and ACK responses to the requests that asked
+ *        for them, and fails requests that are not answered in time.
+ *
+ * The protocol carries no request ids, but the VHal answers each kind of
+ * request in order, so the oldest request sent of a kind owns the next
+ * response of that kind. Requests are only sent on a connection that
+ * OnConnected() reported; requests made earlier, and requests whose answer
+ * was lost with the previous connection, are (re)sent from there. A
+ * request that timed out after being sent still owns its late answer,
+ * which is dropped so that it is not taken for the next one. Requests are
+ * written outside the lock, one writer at a time, so a blocked socket holds
+ * up neither the answers nor the timeouts.
+ */
+class CameraNegotiator
+{
+public:
+    using Clock         = std::chrono::steady_clock;
+    using CapabilityPtr = std::shared_ptr<VideoSink::camera_capability_t>;
+    // Writes one complete request, returns false if the socket failed.
+    using Sender = std::function<bool(const std::vector<uint8_t>& message)>;
+
+    explicit CameraNegotiator(Sender sender) : sender_{ std::move(sender) } {}
+
+    ~CameraNegotiator()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopped_ = true;
+            online_  = false;
+        }
+        changed_.notify_all();
+        if (timer_thread_.joinable()) {
+            timer_thread_.join();
+        }
+        for (auto& request : requests_) {
+            Fail(request);
+        }
+    }
+
+    CameraNegotiator(const CameraNegotiator&) = delete;
+    CameraNegotiator& operator=(const CameraNegotiator&) = delete;
+
+    std::future<CapabilityPtr> RequestCapability(Clock::time_point deadline)
+    {
+        VideoSink::camera_header_t header{};
+        header.type = VideoSink::camera_packet_type_t::REQUEST_CAPABILITY;
+
+        Request request{ Kind::kCapability, Message(header, nullptr), deadline };
+        auto    future = request.capability.get_future();
+        Add(std::move(request));
+        return future;
+    }
+
+    std::future<bool> SendCameraInfo(const std::vector<VideoSink::camera_info_t>& camera_info,
+                                     Clock::time_point                           deadline)
+    {
+        VideoSink::camera_header_t header;
+        header.type = VideoSink::camera_packet_type_t::CAMERA_INFO;
+        header.size = camera_info.size() * sizeof(VideoSink::camera_info_t);
+
+        Request request{ Kind::kAck, Message(header, camera_info.data()), deadline };
+        auto    future = request.ack.get_future();
+        Add(std::move(request));
+        return future;
+    }
+
+    /**
+     * @brief A new connection is up: answers to requests sent on the old
+     *        one will never come, send every pending request again.
+     */
+    void OnConnected()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        online_ = true;
+        ++connection_;
+        late_answers_[0] = late_answers_[1] = 0;
+        for (auto& request : requests_) {
+            request.sent = false;
+        }
+        SendPending(lock);
+    }
+
+    void OnCapability(const VideoSink::camera_capability_t& capability)
+    {
+        Complete(Kind::kCapability, [&](Request& request) {
+            request.capability.set_value(
+              std::make_shared<VideoSink::camera_capability_t>(capability));
+        });
+    }
+
+    void OnAck(VideoSink::CameraAck ack)
+    {
+        Complete(Kind::kAck, [&](Request& request) {
+            request.ack.set_value(ack == VideoSink::CameraAck::ACK_CONFIG);
+        });
+    }
+
+private:
+    enum class Kind { kCapability, kAck };
+
+    struct Request
+    {
+        Kind                        kind;
+        std::vector<uint8_t>        message;
+        Clock::time_point           deadline;
+        uint64_t                    id   = 0;
+        bool                        sent = false;
+        std::promise<CapabilityPtr> capability;
+        std::promise<bool>          ack;
+    };
+
+    Sender                  sender_;
+    std::mutex              mutex_;
+    std::condition_variable changed_;
+    std::list<Request>      requests_;
+    bool                    online_  = false;
+    bool                    stopped_ = false;
+    bool                    sending_ = false;
+    uint64_t                next_id_ = 0;
+    // Bumped by OnConnected(), tells writes to an old connection apart.
+    uint64_t                connection_ = 0;
+    // Answers still due to timed out requests, by Kind.
+    unsigned                late_answers_[2] = {};
+    std::thread             timer_thread_;
+
+    static std::vector<uint8_t> Message(const VideoSink::camera_header_t& header,
+                                        const void*                       payload)
+    {
+        std::vector<uint8_t> message(sizeof(header) + header.size);
+        std::memcpy(message.data(), &header, sizeof(header));
+        if (payload) {
+            std::memcpy(message.data() + sizeof(header), payload, header.size);
+        }
+        return message;
+    }
+
+    static void Fail(Request& request)
+    {
+        if (request.kind == Kind::kCapability) {
+            request.capability.set_value(nullptr);
+        } else {
+            request.ack.set_value(false);
+        }
+    }
+
+    void Add(Request&& request)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (stopped_) {
+                Fail(request);
+                return;
+            }
+            request.id = ++next_id_;
+            requests_.push_back(std::move(request));
+            if (!timer_thread_.joinable()) {
+                timer_thread_ = std::thread(&CameraNegotiator::TimerThreadProc, this);
+            }
+            SendPending(lock);
+        }
+        changed_.notify_all();
+    }
+
+    /**
+     * Sends the requests not sent yet, oldest first. Called with mutex_
+     * held, which is released around each write; while a writer is busy,
+     * other callers leave their requests to it.
+     */
+    void SendPending(std::unique_lock<std::mutex>& lock)
+    {
+        if (sending_) {
+            return;
+        }
+        sending_ = true;
+        while (online_ && !stopped_) {
+            auto it = std::find_if(requests_.begin(), requests_.end(),
+                                   [](const Request& request) { return !request.sent; });
+            if (it == requests_.end()) {
+                break;
+            }
+            // Sent before the write: the answer may beat us to the lock.
+            it->sent        = true;
+            auto message    = it->message;
+            auto id         = it->id;
+            auto kind       = it->kind;
+            auto connection = connection_;
+            lock.unlock();
+            bool ok = sender_(message);
+            lock.lock();
+            if (ok || connection != connection_) {
+                // A new connection sends everything again anyway.
+                continue;
+            }
+            // Never reached the VHal: no answer will come. Wait for
+            // OnConnected() of the next connection.
+            online_ = false;
+            it = std::find_if(requests_.begin(), requests_.end(),
+                              [id](const Request& request) { return request.id == id; });
+            if (it != requests_.end()) {
+                it->sent = false;
+            } else if (late_answers_[static_cast<int>(kind)]) {
+                // Timed out meanwhile, and was counted as owed an answer.
+                --late_answers_[static_cast<int>(kind)];
+            }
+        }
+        sending_ = false;
+    }
+
+    template<typename Fulfill>
+    void Complete(Kind kind, Fulfill fulfill)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& late = late_answers_[static_cast<int>(kind)];
+        if (late) {
+            --late;
+            return;
+        }
+        for (auto it = requests_.begin(); it != requests_.end(); ++it) {
+            if (it->kind == kind && it->sent) {
+                fulfill(*it);
+                requests_.erase(it);
+                return;
+            }
+        }
+        AIC_LOG(LIBVHAL_DEBUG, "Camera VHal response without a pending request");
+    }
+
+    void TimerThreadProc()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stopped_) {
+            auto next = Clock::time_point::max();
+            auto now  = Clock::now();
+            for (auto it = requests_.begin(); it != requests_.end();) {
+                if (it->deadline <= now) {
+                    AIC_LOG(LIBVHAL_WARNING, "Camera VHal did not answer in time");
+                    if (it->sent) {
+                        ++late_answers_[static_cast<int>(it->kind)];
+                    }
+                    Fail(*it);
+                    it = requests_.erase(it);
+                } else {
+                    next = std::min(next, it->deadline);
+                    ++it;
+                }
+            }
+            if (next == Clock::time_point::max()) {
+                changed_.wait(lock);
+            } else {
+                changed_.wait_until(lock, next);
+            }
+        }
+    }
+};
+
+} // namespace client
+} // namespace vhal
+
+#endif /* CAMERA_NEGOTIATOR_H */
@@ -0,0 +1,250 @@
+/**
+ * @file camera_stream_impl.h
+ * @brief Per-camera data path of a multi-camera VideoSink session
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef CAMERA_STREAM_IMPL_H
+#define CAMERA_STREAM_IMPL_H
+
+#include "congestion_monitor.h"
+#include "frame_producer.h"
+#include "frame_send_queue.h"
+#include "send_telemetry.h"
+#include "video_sink.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+
+namespace vhal {
+namespace client {
+
+class VideoSink::CameraStream::Impl
+{
+public:
+    // Writes one data packet to the session socket.
+    using Writer = std::function<IOStatus(const uint8_t* data, size_t size)>;
+    // Returns the congestion monitor of the session, if enabled.
+    using Congestion = std::function<std::shared_ptr<CongestionMonitor>()>;
+
+    Impl(uint32_t camera_id, CameraCallback callback, Writer writer,
+         Congestion congestion, std::function<void()> on_close)
+      : camera_id_{ camera_id },
+        callback_{ std::move(callback) },
+        writer_{ std::move(writer) },
+        on_close_{ std::move(on_close) },
+        congestion_{ std::move(congestion) }
+    {}
+
+    ~Impl() { Detach(); }
+
+    uint32_t CameraId() const { return camera_id_; }
+
+    bool IsOpen() const { return open_; }
+
+    // Called by the session when the Camera VHal switches cameras.
+    void SetOpen(bool open) { open_ = open; }
+
+    void OnCommand(const camera_config_cmd_t& cmd)
+    {
+        if (callback_) {
+            callback_(cmd);
+        }
+    }
+
+    IOResult SendDataPacket(const uint8_t* packet, size_t size, bool key_frame)
+    {
+        if (!open_) {
+            ++frames_dropped_;
+            return { -1, "Camera " + std::to_string(camera_id_)
+                           + " is not opened by Camera VHal" };
+        }
+        if (auto monitor = GetCongestionMonitor();
+            monitor && monitor->ShouldDrop(key_frame)) {
+            ++frames_dropped_;
+            telemetry_.RecordDrop();
+            return { 0, "" };
+        }
+        std::shared_ptr<FrameSendQueue> queue;
+        {
+            std::lock_guard<std::mutex> lock(send_queue_mutex_);
+            queue = send_queue_;
+        }
+        if (queue) {
+            queue->Push(packet, size, key_frame);
+            telemetry_.RecordQueueDepth(queue->Depth());
+            return { static_cast<ssize_t>(size), "" };
+        }
+        auto status = Write(packet, size);
+        if (status.size == -1) {
+            return { -1, "Error in writing payload to Camera VHal: "
+                           + status.error.message() };
+        }
+        return ToIOResult(status);
+    }
+
+    bool EnableAsyncSend(const async_send_config_t& config)
+    {
+        if (config.queue_depth == 0) {
+            return false;
+        }
+        // Queue drops count like the session's, and ask for a key frame.
+        async_send_config_t queue_config = config;
+        queue_config.on_complete = [this, on_complete = config.on_complete](
+                                     const send_completion_t& completion) {
+            if (completion.dropped) {
+                telemetry_.RecordDrop();
+                if (auto monitor = GetCongestionMonitor()) {
+                    monitor->OnDropped();
+                }
+            }
+            if (on_complete) {
+                on_complete(completion);
+            }
+        };
+        auto queue = std::make_shared<FrameSendQueue>(
+          queue_config, [this](const uint8_t* data, size_t size) {
+              return ToIOResult(Write(data, size));
+          });
+        auto old = TakeSendQueue(std::move(queue));
+        if (old) {
+            old->Stop();
+        }
+        return true;
+    }
+
+    void DisableAsyncSend()
+    {
+        auto old = TakeSendQueue(nullptr);
+        if (old) {
+            old->Stop();
+        }
+    }
+
+    bool StartFrameProducer(double fps, FrameProducer producer,
+                            FramePacer::OverrunPolicy policy)
+    {
+        return producer_.Start(fps, std::move(producer), policy);
+    }
+
+    void StopFrameProducer() { producer_.Stop(); }
+
+    camera_stream_stats_t Stats()
+    {
+        camera_stream_stats_t stats;
+        stats.frames_sent    = frames_sent_;
+        stats.bytes_sent     = bytes_sent_;
+        stats.frames_dropped = frames_dropped_;
+        stats.send_errors    = send_errors_;
+        stats.pacing         = producer_.Stats();
+        return stats;
+    }
+
+    camera_telemetry_t Telemetry() const { return telemetry_.Snapshot(); }
+
+    /**
+     * Stops the producer and the queue and drops the session writer. When
+     * unregister is set, also removes the stream from the session.
+     */
+    void Detach(bool unregister = false)
+    {
+        producer_.Stop();
+        DisableAsyncSend();
+        {
+            std::lock_guard<std::mutex> lock(congestion_mutex_);
+            congestion_ = nullptr;
+        }
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        writer_ = nullptr;
+        open_   = false;
+        if (unregister && on_close_) {
+            on_close_();
+        }
+        on_close_ = nullptr;
+    }
+
+private:
+    const uint32_t       camera_id_;
+    const CameraCallback callback_;
+
+    std::mutex            writer_mutex_;
+    Writer                writer_;
+    std::function<void()> on_close_;
+    std::atomic<bool>     open_ = false;
+
+    // Not writer_mutex_, which is held for a whole socket write.
+    std::mutex congestion_mutex_;
+    Congestion congestion_;
+
+    std::mutex                      send_queue_mutex_;
+    std::shared_ptr<FrameSendQueue> send_queue_;
+
+    FrameProducerThread producer_;
+
+    std::atomic<uint64_t> frames_sent_    = 0;
+    std::atomic<uint64_t> bytes_sent_     = 0;
+    std::atomic<uint64_t> frames_dropped_ = 0;
+    std::atomic<uint64_t> send_errors_    = 0;
+    SendTelemetry         telemetry_;
+
+    IOStatus Write(const uint8_t* data, size_t size)
+    {
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        if (!writer_) {
+            return { -1, std::make_error_code(std::errc::not_connected) };
+        }
+        // The camera may have been closed while the frame was queued.
+        if (!open_) {
+            ++frames_dropped_;
+            return { -1, std::make_error_code(std::errc::operation_not_permitted) };
+        }
+        auto start  = SendTelemetry::Clock::now();
+        auto status = writer_(data, size);
+        if (status.size == -1) {
+            ++send_errors_;
+            telemetry_.RecordError(start);
+        } else {
+            ++frames_sent_;
+            bytes_sent_ += size;
+            telemetry_.RecordSend(size, start);
+        }
+        return status;
+    }
+
+    std::shared_ptr<CongestionMonitor> GetCongestionMonitor()
+    {
+        std::lock_guard<std::mutex> lock(congestion_mutex_);
+        return congestion_ ? congestion_() : nullptr;
+    }
+
+    std::shared_ptr<FrameSendQueue> TakeSendQueue(std::shared_ptr<FrameSendQueue> queue)
+    {
+        std::lock_guard<std::mutex> lock(send_queue_mutex_);
+        send_queue_.swap(queue);
+        return queue;
+    }
+};
+
+} // namespace client
+} // namespace vhal
+
+#endif /* CAMERA_STREAM_IMPL_H */
@@ -24,6 +24,7 @@
 
 #include "command_channel_interface.h"
 #include "command_channel_interface_impl.h"
+#include "io_uring_stream_socket_client.h"
 #include "tcp_stream_socket_client.h"
 #include <functional>
 #include <memory>
@@ -36,21 +37,31 @@
 namespace vhal {
 namespace client {
 
-CommandChannelInterface::CommandChannelInterface(TcpConnectionInfo tcp_conn_info, CommandChannelCallback callback)
+CommandChannelInterface::CommandChannelInterface(TcpConnectionInfo tcp_conn_info, CommandChannelCallback callback,
+                                                 std::shared_ptr<Reactor> reactor)
 {
-    auto tcp_sock_activity_monitor_client =
+    std::unique_ptr<IStreamSocketClient> tcp_sock_activity_monitor_client =
         std::make_unique<TcpStreamSocketClient>(tcp_conn_info.ip_addr,
         COMMAND_CHANNEL_ACTIVITY_MONITOR_PORT);
-    auto tcp_sock_aic_command_client =
+    std::unique_ptr<IStreamSocketClient> tcp_sock_aic_command_client =
         std::make_unique<TcpStreamSocketClient>(tcp_conn_info.ip_addr,
         COMMAND_CHANNEL_AIC_COMMAND_PORT);
-    auto tcp_sock_file_transfer_client =
+    std::unique_ptr<IStreamSocketClient> tcp_sock_file_transfer_client =
         std::make_unique<TcpStreamSocketClient>(tcp_conn_info.ip_addr,
         COMMAND_CHANNEL_FILE_TRANSFER_PORT);
+    if (tcp_conn_info.io_uring) {
+        tcp_sock_activity_monitor_client = std::make_unique<IoUringStreamSocketClient>(
+          std::move(tcp_sock_activity_monitor_client), tcp_conn_info.io_uring);
+        tcp_sock_aic_command_client = std::make_unique<IoUringStreamSocketClient>(
+          std::move(tcp_sock_aic_command_client), tcp_conn_info.io_uring);
+        tcp_sock_file_transfer_client = std::make_unique<IoUringStreamSocketClient>(
+          std::move(tcp_sock_file_transfer_client), tcp_conn_info.io_uring);
+    }
     impl_ = std::make_unique<Impl>(std::move(tcp_sock_activity_monitor_client),
                                    std::move(tcp_sock_aic_command_client),
                                    std::move(tcp_sock_file_transfer_client),
-                                   callback);
+                                   callback,
+                                   std::move(reactor));
 }
 
 CommandChannelInterface::~CommandChannelInterface() {}
@@ -60,5 +71,11 @@ IOResult CommandChannelInterface::SendDataPacket(MsgType msg_type, const uint8_t
     return impl_->SendDataPacket(msg_type, message, size);
 }
 
+IOStatus CommandChannelInterface::SendDataPacketNoAlloc(MsgType msg_type, const uint8_t* message,
+                                                        size_t size)
+{
+    return impl_->SendDataPacketNoAlloc(msg_type, message, size);
+}
+
 }; // namespace client
 } // namespace vhal
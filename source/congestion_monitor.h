@@ -0,0 +1,187 @@
+/**
+ * @file congestion_monitor.h
+ * @brief Detects a Camera VHal that falls behind and tells the encoder
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef CONGESTION_MONITOR_H
+#define CONGESTION_MONITOR_H
+
+#include "video_sink.h"
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <optional>
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief Classifies every send as congested or clear, from its latency and
+ *        the socket backlog after it, and turns runs of them into
+ *        VideoSink::CongestionEvent callbacks.
+ *
+ * A run of congested_frames congested sends asks for a lower bitrate,
+ * again at most every min_interval while it lasts; a run of clear_frames
+ * clear sends after that reports recovery; in between the link counts as
+ * congested, even across a single clear send. Once a frame was dropped,
+ * either here or by the asynchronous send queue, a key frame is requested
+ * and, with drop_when_congested, non key frames are dropped until it
+ * arrives, since the decoder could not use them anyway.
+ *
+ * Callbacks run on the sending thread, outside the monitor lock.
+ */
+class CongestionMonitor
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    CongestionMonitor(const VideoSink::congestion_config_t& config,
+                      VideoSink::CongestionCallback         callback)
+      : config_{ config }, callback_{ std::move(callback) }
+    {}
+
+    /**
+     * @brief Called before a frame is sent or queued.
+     *
+     * @return true The frame must be dropped.
+     */
+    bool ShouldDrop(bool key_frame)
+    {
+        std::optional<VideoSink::congestion_signal_t> signal;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (key_frame) {
+                waiting_for_key_ = false;
+                return false;
+            }
+            if (!config_.drop_when_congested) {
+                return false;
+            }
+            if (!waiting_for_key_ && !congested_) {
+                return false;
+            }
+            ++dropped_;
+            if (!waiting_for_key_) {
+                waiting_for_key_ = true;
+                signal = Signal(VideoSink::CongestionEvent::kRequestKeyFrame);
+            }
+        }
+        Emit(signal);
+        return true;
+    }
+
+    /**
+     * @brief A queued frame was dropped by the asynchronous send queue.
+     */
+    void OnDropped()
+    {
+        std::optional<VideoSink::congestion_signal_t> signal;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++dropped_;
+            if (!waiting_for_key_) {
+                waiting_for_key_ = true;
+                signal = Signal(VideoSink::CongestionEvent::kRequestKeyFrame);
+            }
+        }
+        Emit(signal);
+    }
+
+    /**
+     * @brief A frame was written to the socket.
+     *
+     * @param latency Time the write took, lock wait included.
+     * @param backlog Bytes left in the socket send queue, -1 if unknown.
+     */
+    void OnSent(std::chrono::nanoseconds latency, int64_t backlog)
+    {
+        std::optional<VideoSink::congestion_signal_t> signal;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            latency_ = latency;
+            backlog_ = backlog;
+            if (latency > config_.latency_threshold
+                || (backlog >= 0 && size_t(backlog) > config_.backlog_threshold)) {
+                ++congested_run_;
+                clear_run_ = 0;
+            } else {
+                ++clear_run_;
+                congested_run_ = 0;
+            }
+
+            const auto now = Clock::now();
+            if (congested_run_ >= config_.congested_frames
+                && (!congested_ || now - last_reduce_ >= config_.min_interval)) {
+                congested_     = true;
+                last_reduce_   = now;
+                bitrate_scale_ = std::max(bitrate_scale_ * kDecrease, kMinScale);
+                signal         = Signal(VideoSink::CongestionEvent::kReduceBitrate);
+            } else if (congested_ && clear_run_ >= config_.clear_frames) {
+                congested_     = false;
+                bitrate_scale_ = 1.0;
+                signal         = Signal(VideoSink::CongestionEvent::kRecovered);
+            }
+        }
+        Emit(signal);
+    }
+
+private:
+    // Multiplicative decrease per kReduceBitrate, and its floor.
+    static constexpr double kDecrease = 0.75;
+    static constexpr double kMinScale = 0.25;
+
+    const VideoSink::congestion_config_t config_;
+    const VideoSink::CongestionCallback  callback_;
+
+    std::mutex               mutex_;
+    uint32_t                 congested_run_   = 0;
+    uint32_t                 clear_run_       = 0;
+    bool                     congested_       = false;
+    bool                     waiting_for_key_ = false;
+    double                   bitrate_scale_   = 1.0;
+    uint64_t                 dropped_         = 0;
+    std::chrono::nanoseconds latency_{ 0 };
+    int64_t                  backlog_ = -1;
+    Clock::time_point        last_reduce_;
+
+    // Called with mutex_ held.
+    VideoSink::congestion_signal_t Signal(VideoSink::CongestionEvent event) const
+    {
+        VideoSink::congestion_signal_t signal;
+        signal.event          = event;
+        signal.bitrate_scale  = bitrate_scale_;
+        signal.send_latency   = latency_;
+        signal.socket_backlog = backlog_;
+        signal.frames_dropped = dropped_;
+        return signal;
+    }
+
+    void Emit(const std::optional<VideoSink::congestion_signal_t>& signal)
+    {
+        if (signal && callback_) {
+            callback_(*signal);
+        }
+    }
+};
+
+} // namespace client
+} // namespace vhal
+
+#endif /* CONGESTION_MONITOR_H */
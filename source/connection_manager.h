@@ -0,0 +1,211 @@
+/**
+ * @file connection_manager.h
+ * @brief Decides when to retry connecting to a VHal
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef CONNECTION_MANAGER_H
+#define CONNECTION_MANAGER_H
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+extern "C"
+{
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+}
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief Exponential backoff with jitter between connect attempts.
+ *
+ * Each failure doubles the delay, up to a cap, and the delay actually used is
+ * drawn from the upper half of it, so that many clients whose VHal restarted
+ * at the same moment do not retry in lockstep. Reset() after a successful
+ * connect starts over from the initial delay.
+ */
+class ConnectBackoff
+{
+public:
+    static constexpr auto kInitialDelay = std::chrono::milliseconds(20);
+    static constexpr auto kMaxDelay     = std::chrono::milliseconds(1000);
+
+    ConnectBackoff(std::chrono::milliseconds initial = kInitialDelay,
+                   std::chrono::milliseconds max     = kMaxDelay)
+      : initial_{ initial },
+        max_{ max },
+        delay_{ initial },
+        rng_{ std::random_device{}() }
+    {}
+
+    /**
+     * @brief Delay to wait before the next attempt.
+     */
+    std::chrono::milliseconds Next()
+    {
+        auto half   = delay_.count() / 2;
+        auto jitter = std::uniform_int_distribution<int64_t>(0, half)(rng_);
+        std::chrono::milliseconds wait(delay_.count() - half + jitter);
+        delay_ = std::min(delay_ * 2, max_);
+        return wait;
+    }
+
+    void Reset() { delay_ = initial_; }
+
+private:
+    std::chrono::milliseconds initial_;
+    std::chrono::milliseconds max_;
+    std::chrono::milliseconds delay_;
+    std::minstd_rand          rng_;
+};
+
+/**
+ * @brief Paces connect attempts to a VHal endpoint.
+ *
+ * TCP and vsock endpoints are retried with ConnectBackoff. For Unix domain
+ * endpoints the directory holding the socket is additionally watched with
+ * inotify: WatchFd() becomes readable when something is created there, and
+ * ConsumeWatchEvents() tells whether it was our socket, so the next attempt
+ * can be made as soon as the server binds instead of when the delay expires.
+ * While the socket file does not exist, the delay is only a safety net and
+ * is kept long.
+ *
+ * Not thread safe. Meant to be used from the talker thread only.
+ */
+class ConnectionManager
+{
+public:
+    static constexpr auto kWatchedDelay = std::chrono::milliseconds(5000);
+
+    /**
+     * @param remote_path Unix socket path of the VHal, empty for TCP and vsock.
+     */
+    explicit ConnectionManager(std::string remote_path = "")
+      : remote_path_{ std::move(remote_path) }
+    {
+        auto slash = remote_path_.rfind('/');
+        if (!remote_path_.empty() && remote_path_[0] != '@') {
+            dir_  = slash == std::string::npos ? "." : remote_path_.substr(0, slash + 1);
+            name_ = slash == std::string::npos ? remote_path_ : remote_path_.substr(slash + 1);
+        }
+    }
+
+    ~ConnectionManager()
+    {
+        if (inotify_fd_ >= 0) {
+            close(inotify_fd_);
+        }
+    }
+
+    ConnectionManager(const ConnectionManager&) = delete;
+    ConnectionManager& operator=(const ConnectionManager&) = delete;
+
+    /**
+     * @brief Call after every failed Connect().
+     *
+     * @return How long to wait before trying again, unless WatchFd() fires.
+     */
+    std::chrono::milliseconds OnConnectFailed()
+    {
+        auto delay = backoff_.Next();
+        if (!name_.empty() && ArmWatch() && !PathExists()) {
+            // Refused connections on an existing socket still back off, since
+            // no inotify event will tell when the server starts listening.
+            delay = kWatchedDelay;
+        }
+        return delay;
+    }
+
+    void OnConnected() { backoff_.Reset(); }
+
+    /**
+     * @brief inotify fd to poll for POLLIN alongside the retry delay, or -1
+     *        when the endpoint cannot be watched.
+     */
+    int WatchFd() const { return inotify_fd_; }
+
+    /**
+     * @brief Drains pending inotify events.
+     *
+     * @return true when the socket path was (re)created and a connect attempt
+     *         should be made right away.
+     */
+    bool ConsumeWatchEvents()
+    {
+        alignas(struct inotify_event) char buf[4096];
+        bool                               appeared = false;
+        ssize_t                            len;
+        while ((len = read(inotify_fd_, buf, sizeof(buf))) > 0) {
+            for (char* p = buf; p < buf + len;) {
+                auto event = reinterpret_cast<struct inotify_event*>(p);
+                if (event->mask & IN_IGNORED) {
+                    // The directory went away, watch it again next time.
+                    watch_ = -1;
+                } else if (event->len && name_ == event->name) {
+                    appeared = true;
+                }
+                p += sizeof(struct inotify_event) + event->len;
+            }
+        }
+        return appeared;
+    }
+
+private:
+    std::string    remote_path_;
+    std::string    dir_;
+    std::string    name_;
+    int            inotify_fd_ = -1;
+    int            watch_      = -1;
+    ConnectBackoff backoff_;
+
+    bool ArmWatch()
+    {
+        if (inotify_fd_ < 0) {
+            inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            if (inotify_fd_ < 0) {
+                return false;
+            }
+        }
+        if (watch_ < 0) {
+            // Fails while the socket dir itself does not exist yet, in which
+            // case we fall back to the backoff delay and try again later.
+            watch_ = inotify_add_watch(inotify_fd_, dir_.c_str(),
+                                       IN_CREATE | IN_MOVED_TO | IN_ATTRIB);
+        }
+        return watch_ >= 0;
+    }
+
+    bool PathExists() const
+    {
+        struct stat st;
+        return stat(remote_path_.c_str(), &st) == 0;
+    }
+};
+
+} // namespace client
+} // namespace vhal
+
+#endif /* CONNECTION_MANAGER_H */
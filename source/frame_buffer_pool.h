@@ -0,0 +1,294 @@
+/**
+ * @file frame_buffer_pool.h
+ * @brief Camera frame buffers shared with the Camera VHal by fd
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef FRAME_BUFFER_POOL_H
+#define FRAME_BUFFER_POOL_H
+
+#include "libvhal_common.h"
+#include "video_sink.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+extern "C"
+{
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+}
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief Frame buffers registered with the Camera VHal over SCM_RIGHTS.
+ *
+ * A buffer is free, acquired by the client while it fills it, or in flight
+ * from CAMERA_BUFFER_READY until the VHal sends CAMERA_BUFFER_RELEASE. The
+ * generation tells releases meant for a replaced pool apart.
+ */
+class FrameBufferPool
+{
+public:
+    // Well below SCM_MAX_FD, all fds travel in one message.
+    static constexpr uint32_t kMaxBuffers = 64;
+
+    /**
+     * @brief Create memfds, or duplicate config.fds, and map them.
+     *
+     * @return nullptr on failure, with error set, including an fd that can
+     *         not be mapped.
+     */
+    static std::unique_ptr<FrameBufferPool>
+    Create(const VideoSink::buffer_pool_config_t& config, std::string& error)
+    {
+        const uint32_t count = config.fds.empty()
+                                 ? config.count
+                                 : static_cast<uint32_t>(config.fds.size());
+        if (count == 0 || count > kMaxBuffers || config.buffer_size == 0
+            || config.buffer_size > UINT32_MAX) {
+            error = "invalid buffer pool config";
+            return nullptr;
+        }
+        std::unique_ptr<FrameBufferPool> pool(new FrameBufferPool(config.buffer_size));
+        for (uint32_t i = 0; i < count; ++i) {
+            int fd;
+            if (config.fds.empty()) {
+                fd = memfd_create("vhal-camera-frame", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+                if (fd != -1 && ftruncate(fd, config.buffer_size) != 0) {
+                    close(fd);
+                    fd = -1;
+                }
+                if (fd != -1) {
+                    // The VHal maps the buffers too, nobody may resize them.
+                    fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+                }
+            } else {
+                fd = fcntl(config.fds[i], F_DUPFD_CLOEXEC, 0);
+            }
+            if (fd == -1) {
+                error = std::strerror(errno);
+                return nullptr;
+            }
+            void* data = mmap(nullptr, config.buffer_size, PROT_READ | PROT_WRITE,
+                              MAP_SHARED, fd, 0);
+            if (data == MAP_FAILED) {
+                error = std::strerror(errno);
+                close(fd);
+                return nullptr;
+            }
+            pool->buffers_.push_back({ fd, static_cast<uint8_t*>(data), State::kFree });
+            pool->free_.push_back(i);
+        }
+        return pool;
+    }
+
+    ~FrameBufferPool()
+    {
+        for (auto& buffer : buffers_) {
+            munmap(buffer.data, buffer_size_);
+            close(buffer.fd);
+        }
+    }
+
+    FrameBufferPool(const FrameBufferPool&) = delete;
+    FrameBufferPool& operator=(const FrameBufferPool&) = delete;
+
+    uint32_t Generation() const { return generation_; }
+
+    /**
+     * @brief Send the CAMERA_BUFFER_POOL message with all fds on sock_fd.
+     */
+    IOStatus Register(int sock_fd) const
+    {
+        VideoSink::camera_header_t header = {
+            VideoSink::camera_packet_type_t::CAMERA_BUFFER_POOL,
+            sizeof(VideoSink::camera_buffer_pool_t)
+        };
+        VideoSink::camera_buffer_pool_t payload = {};
+        payload.generation  = generation_;
+        payload.count       = static_cast<uint32_t>(buffers_.size());
+        payload.buffer_size = static_cast<uint32_t>(buffer_size_);
+
+        struct iovec iov[2] = { { &header, sizeof(header) },
+                                { &payload, sizeof(payload) } };
+        char          control[CMSG_SPACE(sizeof(int) * kMaxBuffers)] = {};
+        struct msghdr msg = {};
+        msg.msg_iov        = iov;
+        msg.msg_iovlen     = std::size(iov);
+        msg.msg_control    = control;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * buffers_.size());
+
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level     = SOL_SOCKET;
+        cmsg->cmsg_type      = SCM_RIGHTS;
+        cmsg->cmsg_len       = CMSG_LEN(sizeof(int) * buffers_.size());
+        for (size_t i = 0; i < buffers_.size(); ++i) {
+            std::memcpy(CMSG_DATA(cmsg) + i * sizeof(int), &buffers_[i].fd, sizeof(int));
+        }
+
+        ssize_t sent = ::sendmsg(sock_fd, &msg, MSG_NOSIGNAL);
+        if (sent == -1) {
+            return IOStatus::FromErrno();
+        }
+        if (sent != static_cast<ssize_t>(sizeof(header) + sizeof(payload))) {
+            return { -1, std::make_error_code(std::errc::message_size) };
+        }
+        return { sent, {} };
+    }
+
+    bool Acquire(VideoSink::frame_buffer_t& out, std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!released_.wait_for(lock, timeout,
+                                [this]() { return shutdown_ || !free_.empty(); })
+            || shutdown_) {
+            return false;
+        }
+        uint32_t index = free_.front();
+        free_.pop_front();
+        auto& buffer = buffers_[index];
+        buffer.state = State::kAcquired;
+        out.index    = index;
+        out.data     = buffer.data;
+        out.size     = buffer_size_;
+        out.fd       = buffer.fd;
+        return true;
+    }
+
+    /**
+     * @brief Move an acquired buffer in flight. Returns false if index was
+     *        not acquired or size does not fit.
+     */
+    bool MarkReady(uint32_t index, size_t size)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (index >= buffers_.size() || buffers_[index].state != State::kAcquired
+            || size > buffer_size_) {
+            return false;
+        }
+        buffers_[index].state = State::kInFlight;
+        return true;
+    }
+
+    /**
+     * @brief Return a buffer to the free list, e.g. when it could not be
+     *        sent.
+     */
+    void Release(uint32_t index)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (index >= buffers_.size() || buffers_[index].state == State::kFree) {
+                return;
+            }
+            buffers_[index].state = State::kFree;
+            free_.push_back(index);
+        }
+        released_.notify_one();
+    }
+
+    /**
+     * @brief The VHal released a buffer. Only a buffer in flight is the
+     *        VHal's to release: one the client still fills is left alone.
+     *
+     * @return false if index was not in flight.
+     */
+    bool ReleaseInFlight(uint32_t index)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (index >= buffers_.size() || buffers_[index].state != State::kInFlight) {
+                return false;
+            }
+            buffers_[index].state = State::kFree;
+            free_.push_back(index);
+        }
+        released_.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief The VHal lost the connection and with it the buffers it held.
+     */
+    void ReleaseInFlight()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (uint32_t i = 0; i < buffers_.size(); ++i) {
+                if (buffers_[i].state == State::kInFlight) {
+                    buffers_[i].state = State::kFree;
+                    free_.push_back(i);
+                }
+            }
+        }
+        released_.notify_all();
+    }
+
+    /**
+     * @brief Wake up and fail every Acquire(), the pool is being replaced.
+     */
+    void Shutdown()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            shutdown_ = true;
+        }
+        released_.notify_all();
+    }
+
+private:
+    enum class State { kFree, kAcquired, kInFlight };
+
+    struct Buffer
+    {
+        int      fd;
+        uint8_t* data;
+        State    state;
+    };
+
+    explicit FrameBufferPool(size_t buffer_size)
+      : buffer_size_{ buffer_size }, generation_{ ++next_generation_ }
+    {}
+
+    const size_t            buffer_size_;
+    const uint32_t          generation_;
+    std::vector<Buffer>     buffers_;
+    std::mutex              mutex_;
+    std::condition_variable released_;
+    std::deque<uint32_t>    free_;
+    bool                    shutdown_ = false;
+
+    static inline std::atomic<uint32_t> next_generation_ = 0;
+};
+
+} // namespace client
+} // namespace vhal
+
+#endif /* FRAME_BUFFER_POOL_H */
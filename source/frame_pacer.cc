@@ -0,0 +1,60 @@
+/**
+ * @file frame_pacer.cc
+ * @brief Paces frame production on absolute deadlines
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "frame_pacer.h"
+#include "frame_pacer_impl.h"
+
+namespace vhal {
+namespace client {
+
+FramePacer::FramePacer(double fps, OverrunPolicy policy)
+  : impl_{ std::make_unique<Impl>(fps, policy) }
+{}
+
+FramePacer::~FramePacer() = default;
+
+uint64_t
+FramePacer::Wait()
+{
+    return impl_->Wait();
+}
+
+void
+FramePacer::Reset()
+{
+    impl_->Reset();
+}
+
+std::chrono::nanoseconds
+FramePacer::Interval() const
+{
+    return impl_->Interval();
+}
+
+FramePacer::stats_t
+FramePacer::Stats() const
+{
+    return impl_->Stats();
+}
+
+} // namespace client
+} // namespace vhal
@@ -0,0 +1,136 @@
+/**
+ * @file frame_pacer_impl.h
+ * @brief Paces frame production on absolute deadlines
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef FRAME_PACER_IMPL_H
+#define FRAME_PACER_IMPL_H
+
+#include "frame_pacer.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <mutex>
+#include <stdexcept>
+extern "C"
+{
+#include <time.h>
+}
+
+namespace vhal {
+namespace client {
+
+class FramePacer::Impl
+{
+public:
+    Impl(double fps, OverrunPolicy policy)
+      : fps_{ fps },
+        policy_{ policy }
+    {
+        if (!(fps > 0)) {
+            throw std::invalid_argument("Frame rate must be positive");
+        }
+    }
+
+    uint64_t Wait()
+    {
+        if (!started_) {
+            started_       = true;
+            start_         = Now();
+            next_frame_    = 0;
+            last_lateness_ = 0;
+        }
+
+        int64_t now = Now();
+        if (policy_ == OverrunPolicy::kSkip && now - Deadline(next_frame_) >= Interval().count()) {
+            // Resume with the frame whose slot we are in.
+            uint64_t current = static_cast<uint64_t>(std::floor((now - start_) * fps_ / 1e9));
+            if (current > next_frame_) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stats_.skipped_frames += current - next_frame_;
+                next_frame_ = current;
+            }
+        }
+
+        int64_t         deadline = Deadline(next_frame_);
+        struct timespec ts       = { static_cast<time_t>(deadline / 1000000000),
+                                     static_cast<long>(deadline % 1000000000) };
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+        }
+
+        int64_t lateness = Now() - deadline;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.frames++;
+            if (lateness >= Interval().count()) {
+                stats_.late_frames++;
+            }
+            stats_.drift        = std::chrono::nanoseconds(lateness);
+            stats_.max_lateness = std::max(stats_.max_lateness, stats_.drift);
+            // Interarrival jitter estimator from RFC 3550, section 6.4.1.
+            int64_t delta = std::llabs(lateness - last_lateness_);
+            stats_.jitter += std::chrono::nanoseconds((delta - stats_.jitter.count()) / 16);
+        }
+        last_lateness_ = lateness;
+        return next_frame_++;
+    }
+
+    void Reset() { started_ = false; }
+
+    std::chrono::nanoseconds Interval() const
+    {
+        return std::chrono::nanoseconds(static_cast<int64_t>(1e9 / fps_));
+    }
+
+    stats_t Stats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+private:
+    double             fps_;
+    OverrunPolicy      policy_;
+    bool               started_       = false;
+    int64_t            start_         = 0;
+    uint64_t           next_frame_    = 0;
+    int64_t            last_lateness_ = 0;
+    mutable std::mutex mutex_;
+    stats_t            stats_;
+
+    static int64_t Now()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+    // Computed from the start every time, so that rounding does not add up.
+    int64_t Deadline(uint64_t frame) const
+    {
+        return start_ + static_cast<int64_t>(std::llround(frame * 1e9 / fps_));
+    }
+};
+
+} // namespace client
+} // namespace vhal
+
+#endif /* FRAME_PACER_IMPL_H */
@@ -0,0 +1,95 @@
+/**
+ * @file frame_producer.h
+ * @brief Thread calling a frame producer at the pace of a FramePacer
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef FRAME_PRODUCER_H
+#define FRAME_PRODUCER_H
+
+#include "frame_pacer.h"
+#include "video_sink.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief Drives a VideoSink::FrameProducer from a dedicated thread, one call
+ *        per FramePacer deadline. Shared by VideoSink and its CameraStreams.
+ */
+class FrameProducerThread
+{
+public:
+    FrameProducerThread() = default;
+    ~FrameProducerThread() { Stop(); }
+
+    FrameProducerThread(const FrameProducerThread&) = delete;
+    FrameProducerThread& operator=(const FrameProducerThread&) = delete;
+
+    bool Start(double fps, VideoSink::FrameProducer producer,
+               FramePacer::OverrunPolicy policy)
+    {
+        if (!(fps > 0) || !producer) {
+            return false;
+        }
+        Stop();
+        std::lock_guard<std::mutex> lock(mutex_);
+        pacer_ = std::make_shared<FramePacer>(fps, policy);
+        stop_  = false;
+        thread_ = std::thread([this, pacer = pacer_, producer = std::move(producer)]() {
+            while (!stop_) {
+                uint64_t frame = pacer->Wait();
+                if (stop_ || !producer(frame)) {
+                    break;
+                }
+            }
+        });
+        return true;
+    }
+
+    void Stop()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (thread_.joinable()) {
+            stop_ = true;
+            thread_.join();
+        }
+    }
+
+    FramePacer::stats_t Stats()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pacer_ ? pacer_->Stats() : FramePacer::stats_t{};
+    }
+
+private:
+    std::mutex                  mutex_;
+    std::shared_ptr<FramePacer> pacer_;
+    std::thread                 thread_;
+    std::atomic<bool>           stop_ = false;
+};
+
+} // namespace client
+} // namespace vhal
+
+#endif /* FRAME_PRODUCER_H */
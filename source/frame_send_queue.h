@@ -0,0 +1,258 @@
+/**
+ * @file frame_send_queue.h
+ * @brief Bounded queue of owned camera frames drained by a writer thread
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef FRAME_SEND_QUEUE_H
+#define FRAME_SEND_QUEUE_H
+
+#include "libvhal_common.h"
+#include "video_sink.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief Decouples VideoSink::SendDataPacket() callers from the VHAL socket.
+ *
+ * Push() copies the frame into a recycled buffer and returns; a dedicated
+ * writer thread hands queued frames to the socket in order. When the queue
+ * is full, the configured VideoSink::SendDropPolicy decides which frame
+ * gives way. Every frame pushed is reported exactly once through the
+ * completion callback, whether it was sent, dropped or failed.
+ */
+class FrameSendQueue
+{
+public:
+    using Writer = std::function<IOResult(const uint8_t* data, size_t size)>;
+
+    FrameSendQueue(const VideoSink::async_send_config_t& config, Writer writer)
+      : depth_{ config.queue_depth ? config.queue_depth : 1 },
+        policy_{ config.drop_policy },
+        on_complete_{ config.on_complete },
+        writer_{ std::move(writer) }
+    {
+        writer_thread_ = std::thread(&FrameSendQueue::WriterThreadProc, this);
+    }
+
+    ~FrameSendQueue() { Stop(); }
+
+    FrameSendQueue(const FrameSendQueue&) = delete;
+    FrameSendQueue& operator=(const FrameSendQueue&) = delete;
+
+    /**
+     * @brief Queue a copy of the frame. Only blocks with kBlock policy while
+     *        the queue is full.
+     *
+     * @return Id that the completion callback reports for this frame.
+     */
+    uint64_t Push(const uint8_t* data, size_t size, bool key_frame)
+    {
+        Frame frame;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            frame.id = next_id_++;
+            if (!free_buffers_.empty()) {
+                frame.data = std::move(free_buffers_.back());
+                free_buffers_.pop_back();
+            }
+        }
+        frame.key_frame = key_frame;
+        // Copy outside the lock, the writer keeps running meanwhile.
+        frame.data.resize(size);
+        std::memcpy(frame.data.data(), data, size);
+
+        const uint64_t     id = frame.id;
+        std::vector<Frame> dropped;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (!Admit(lock, frame, dropped)) {
+                dropped.push_back(std::move(frame));
+            } else {
+                queue_.push_back(std::move(frame));
+                not_empty_.notify_one();
+            }
+        }
+        for (auto& f : dropped) {
+            Complete(f, { -1, "Frame dropped, camera send queue is full" }, true);
+        }
+        return id;
+    }
+
+    /**
+     * @brief Number of frames waiting for the writer.
+     */
+    size_t Depth()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return queue_.size();
+    }
+
+    /**
+     * @brief Stop the writer thread. Frames still queued are reported as
+     *        dropped. Blocks while a frame is being written to the socket.
+     */
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopped_) {
+                return;
+            }
+            stopped_ = true;
+        }
+        not_empty_.notify_all();
+        not_full_.notify_all();
+        writer_thread_.join();
+
+        std::deque<Frame> left;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            left.swap(queue_);
+        }
+        for (auto& f : left) {
+            Complete(f, { -1, "Frame dropped, camera send queue stopped" }, true);
+        }
+    }
+
+private:
+    struct Frame
+    {
+        std::vector<uint8_t> data;
+        bool                 key_frame = false;
+        uint64_t             id        = 0;
+    };
+
+    const size_t                          depth_;
+    const VideoSink::SendDropPolicy       policy_;
+    const VideoSink::SendCompletionCallback on_complete_;
+    Writer                                writer_;
+
+    std::mutex                 mutex_;
+    std::condition_variable    not_empty_;
+    std::condition_variable    not_full_;
+    std::deque<Frame>          queue_;
+    std::vector<std::vector<uint8_t>> free_buffers_;
+    uint64_t                   next_id_          = 0;
+    bool                       waiting_for_key_  = false;
+    bool                       stopped_          = false;
+    std::thread                writer_thread_;
+
+    /**
+     * Applies the drop policy. Returns false when frame itself must be
+     * dropped, otherwise makes room for it, moving evicted frames to dropped.
+     */
+    bool Admit(std::unique_lock<std::mutex>& lock,
+               const Frame&                 frame,
+               std::vector<Frame>&          dropped)
+    {
+        switch (policy_) {
+            case VideoSink::SendDropPolicy::kBlock:
+                not_full_.wait(lock, [this]() {
+                    return stopped_ || queue_.size() < depth_;
+                });
+                return !stopped_;
+
+            case VideoSink::SendDropPolicy::kDropNonKeyFrame:
+                // Frames predicted from a dropped one are useless to the
+                // decoder, so once a frame was dropped, drop the rest of the
+                // GOP until the next key frame.
+                if (!frame.key_frame) {
+                    if (waiting_for_key_ || queue_.size() >= depth_) {
+                        waiting_for_key_ = true;
+                        return false;
+                    }
+                    return !stopped_;
+                }
+                waiting_for_key_ = false;
+                if (queue_.size() >= depth_) {
+                    // A key frame supersedes everything queued before it.
+                    while (!queue_.empty()) {
+                        dropped.push_back(std::move(queue_.front()));
+                        queue_.pop_front();
+                    }
+                }
+                return !stopped_;
+
+            case VideoSink::SendDropPolicy::kDropOldest:
+            default:
+                while (queue_.size() >= depth_) {
+                    dropped.push_back(std::move(queue_.front()));
+                    queue_.pop_front();
+                }
+                return !stopped_;
+        }
+    }
+
+    void Complete(Frame& frame, const IOResult& result, bool dropped)
+    {
+        if (on_complete_) {
+            VideoSink::send_completion_t completion;
+            completion.frame_id  = frame.id;
+            completion.key_frame = frame.key_frame;
+            completion.dropped   = dropped;
+            completion.result    = result;
+            on_complete_(completion);
+        }
+        Recycle(std::move(frame.data));
+    }
+
+    void Recycle(std::vector<uint8_t>&& buffer)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Keep at most one spare buffer per slot plus the one in flight.
+        if (free_buffers_.size() <= depth_) {
+            free_buffers_.push_back(std::move(buffer));
+        }
+    }
+
+    void WriterThreadProc()
+    {
+        while (true) {
+            Frame frame;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                not_empty_.wait(lock,
+                                [this]() { return stopped_ || !queue_.empty(); });
+                if (stopped_) {
+                    return;
+                }
+                frame = std::move(queue_.front());
+                queue_.pop_front();
+            }
+            not_full_.notify_one();
+            IOResult result = writer_(frame.data.data(), frame.data.size());
+            Complete(frame, result, false);
+        }
+    }
+};
+
+} // namespace client
+} // namespace vhal
+
+#endif /* FRAME_SEND_QUEUE_H */
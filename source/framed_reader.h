@@ -0,0 +1,286 @@
+/**
+ * @file framed_reader.h
+ * @brief Buffered reader for fixed-size VHAL control messages
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef FRAMED_READER_H
+#define FRAMED_READER_H
+
+#include "istream_socket_client.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <system_error>
+#include <vector>
+extern "C"
+{
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+}
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief Reads control messages through a local buffer, so that a burst of
+ * small messages costs one recv() instead of one per message.
+ *
+ * Each fill asks the socket for whatever is available, up to the free space in
+ * the buffer, and only waits when nothing at all has arrived. Messages left in
+ * the buffer after a fill must be consumed before going back to poll(), since
+ * the socket will not report them as readable again; see Buffered().
+ *
+ * With @p receive_fds, fills go through recvmsg() on the native socket and
+ * collect SCM_RIGHTS descriptors in arrival order, for ReadFds() to hand out.
+ *
+ * Not thread safe. Meant to be used from the talker thread only.
+ */
+class FramedReader
+{
+public:
+    static constexpr size_t kDefaultCapacity = 64 * 1024;
+    static constexpr int    kMaxFdsPerRecv   = 16;
+
+    FramedReader(IStreamSocketClient* client,
+                 size_t               capacity    = kDefaultCapacity,
+                 bool                 receive_fds = false)
+      : client_{ client },
+        buffer_(capacity),
+        receive_fds_{ receive_fds }
+    {}
+
+    ~FramedReader() { Reset(); }
+
+    FramedReader(const FramedReader&) = delete;
+    FramedReader& operator=(const FramedReader&) = delete;
+
+    /**
+     * @brief Number of bytes already received and not consumed yet.
+     */
+    size_t Buffered() const { return end_ - start_; }
+
+    /**
+     * @brief Drop buffered bytes and close queued fds. Call whenever the
+     *        socket (re)connects, since leftovers belong to the old stream.
+     */
+    void Reset()
+    {
+        start_ = end_ = 0;
+        DropFds();
+    }
+
+    /**
+     * @brief Close the queued fds, e.g. those that came with a message the
+     *        caller rejected and will not ReadFds() for.
+     */
+    void DropFds()
+    {
+        for (int fd : fds_) {
+            close(fd);
+        }
+        fds_.clear();
+    }
+
+    /**
+     * @brief Read exactly @p size bytes into @p out.
+     *
+     * @return IOResult {size, ""} on success, {0, ""} if the peer closed the
+     *         connection first, {-1, error} otherwise.
+     */
+    IOResult Read(void* out, size_t size)
+    {
+        auto   dst  = static_cast<uint8_t*>(out);
+        size_t done = 0;
+        while (done < size) {
+            if (Buffered() == 0) {
+                if (auto res = Fill(size - done); std::get<0>(res) <= 0) {
+                    return res;
+                }
+            }
+            size_t chunk = std::min(size - done, Buffered());
+            std::memcpy(dst + done, buffer_.data() + start_, chunk);
+            Consume(chunk);
+            done += chunk;
+        }
+        return { static_cast<ssize_t>(size), "" };
+    }
+
+    /**
+     * @brief Like Read(), without the copy: waits until @p size bytes are
+     *        buffered and consumes them in place. @p data stays valid until
+     *        the next call on the reader.
+     */
+    IOResult Pull(size_t size, const uint8_t** data)
+    {
+        while (Buffered() < size) {
+            if (auto res = Fill(size - Buffered()); std::get<0>(res) <= 0) {
+                return res;
+            }
+        }
+        *data = buffer_.data() + start_;
+        Consume(size);
+        return { static_cast<ssize_t>(size), "" };
+    }
+
+    /**
+     * @brief Consume @p size bytes without looking at them, for payloads
+     *        that may be larger than the buffer.
+     */
+    IOResult Skip(size_t size)
+    {
+        size_t done = 0;
+        while (done < size) {
+            if (Buffered() == 0) {
+                if (auto res = Fill(size - done); std::get<0>(res) <= 0) {
+                    return res;
+                }
+            }
+            size_t chunk = std::min(size - done, Buffered());
+            Consume(chunk);
+            done += chunk;
+        }
+        return { static_cast<ssize_t>(size), "" };
+    }
+
+    /**
+     * @brief Take @p count descriptors received alongside the stream, waiting
+     *        for more data if they have not arrived yet. Ownership of the fds
+     *        moves to the caller.
+     */
+    IOResult ReadFds(int* fds, size_t count)
+    {
+        while (fds_.size() < count) {
+            if (!receive_fds_) {
+                return { -1, std::strerror(EINVAL) };
+            }
+            if (auto res = Fill(1); std::get<0>(res) <= 0) {
+                return res;
+            }
+        }
+        for (size_t i = 0; i < count; ++i) {
+            fds[i] = fds_.front();
+            fds_.pop_front();
+        }
+        return { static_cast<ssize_t>(count), "" };
+    }
+
+private:
+    // Upper bound on waiting for the rest of a message that has started.
+    static constexpr int kWaitSliceMs = 100;
+    static constexpr int kWaitSlices  = 20;
+
+    IStreamSocketClient* client_;
+    std::vector<uint8_t> buffer_;
+    size_t               start_ = 0;
+    size_t               end_   = 0;
+    bool                 receive_fds_;
+    std::deque<int>      fds_;
+
+    void Consume(size_t size)
+    {
+        start_ += size;
+        if (start_ == end_) {
+            start_ = end_ = 0;
+        }
+    }
+
+    IOStatus RecvSome(uint8_t* data, size_t size)
+    {
+        if (!receive_fds_) {
+            return client_->RecvNoAlloc(data, size, MSG_DONTWAIT);
+        }
+
+        struct iovec iov = { data, size };
+        char control[CMSG_SPACE(sizeof(int) * kMaxFdsPerRecv)];
+        struct msghdr msg = {};
+        msg.msg_iov        = &iov;
+        msg.msg_iovlen     = 1;
+        msg.msg_control    = control;
+        msg.msg_controllen = sizeof(control);
+
+        ssize_t received = ::recvmsg(client_->GetNativeSocketFd(), &msg,
+                                     MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+        if (received == -1) {
+            return IOStatus::FromErrno();
+        }
+        for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+                continue;
+            }
+            size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            int    fd;
+            for (size_t i = 0; i < n; ++i) {
+                std::memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(fd));
+                fds_.push_back(fd);
+            }
+        }
+        if (msg.msg_flags & MSG_CTRUNC) {
+            return { -1, std::make_error_code(std::errc::message_size) };
+        }
+        return { received, {} };
+    }
+
+    /**
+     * @brief Receive at least one byte, making room for @p want bytes first.
+     */
+    IOResult Fill(size_t want)
+    {
+        if (buffer_.size() - end_ < want && start_ > 0) {
+            std::memmove(buffer_.data(), buffer_.data() + start_, Buffered());
+            end_ -= start_;
+            start_ = 0;
+        }
+        if (end_ == buffer_.size()) {
+            buffer_.resize(buffer_.size() * 2);
+        }
+
+        for (int slice = 0; slice <= kWaitSlices; ++slice) {
+            IOStatus status =
+              RecvSome(buffer_.data() + end_, buffer_.size() - end_);
+            if (status.size > 0) {
+                end_ += status.size;
+                return { status.size, "" };
+            }
+            if (status.size == 0) {
+                return { 0, "" };
+            }
+            if (status.error == std::errc::interrupted) {
+                continue;
+            }
+            if (status.error != std::errc::resource_unavailable_try_again) {
+                return ToIOResult(status);
+            }
+            struct pollfd pfd = { client_->GetNativeSocketFd(), POLLIN, 0 };
+            if (poll(&pfd, 1, kWaitSliceMs) < 0 && errno != EINTR) {
+                return { -1, std::strerror(errno) };
+            }
+        }
+        return { -1, std::strerror(ETIMEDOUT) };
+    }
+};
+
+} // namespace client
+} // namespace vhal
+
+#endif /* FRAMED_READER_H */
@@ -0,0 +1,133 @@
+/**
+ * @file framed_writer.h
+ * @brief Socket writer with a priority control lane and a bulk data lane
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef FRAMED_WRITER_H
+#define FRAMED_WRITER_H
+
+#include "istream_socket_client.h"
+#include "libvhal_common.h"
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+extern "C"
+{
+#include <sys/uio.h>
+}
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief Serializes framed messages from many threads onto one socket.
+ *
+ * A message, header and payload, is written by one holder of the socket at
+ * a time, so that messages from different threads never interleave. Writers
+ * wait their turn in one of two FIFO lanes: kControl messages (capability
+ * requests, camera info, user id, buffer pool registration) always go
+ * before kBulk ones (frames), so control latency is bounded by the one
+ * frame already on the wire rather than by every frame queued behind it.
+ *
+ * Writes are synchronous; the caller gets the result of its own message.
+ */
+class FramedWriter
+{
+public:
+    enum class Lane { kControl, kBulk };
+
+    explicit FramedWriter(IStreamSocketClient& socket) : socket_{ socket } {}
+
+    /**
+     * @brief Runs @p write with the socket to itself, for messages that need
+     *        more than a plain send (ancillary data, MSG_ZEROCOPY).
+     */
+    template <typename Fn>
+    auto Exclusive(Lane lane, Fn&& write)
+    {
+        Turn turn(*this, lane);
+        return write();
+    }
+
+    IOStatus Write(Lane lane, const struct iovec* iov, int iovcnt)
+    {
+        return Exclusive(lane, [&]() { return socket_.SendVNoAlloc(iov, iovcnt); });
+    }
+
+    IOStatus Write(Lane lane, const uint8_t* data, size_t size)
+    {
+        return Exclusive(lane, [&]() { return socket_.SendNoAlloc(data, size); });
+    }
+
+private:
+    // Holds the socket for its lifetime, taking turns in lane order.
+    class Turn
+    {
+    public:
+        Turn(FramedWriter& writer, Lane lane) : writer_{ writer }
+        {
+            std::unique_lock<std::mutex> lock(writer_.mutex_);
+            auto& queue  = writer_.lanes_[static_cast<int>(lane)];
+            auto  ticket = queue.next++;
+            writer_.cv_.wait(lock, [&]() {
+                if (writer_.busy_ || queue.serving != ticket) {
+                    return false;
+                }
+                auto& control = writer_.lanes_[static_cast<int>(Lane::kControl)];
+                return lane == Lane::kControl || control.serving == control.next;
+            });
+            ++queue.serving;
+            writer_.busy_ = true;
+        }
+
+        ~Turn()
+        {
+            {
+                std::lock_guard<std::mutex> lock(writer_.mutex_);
+                writer_.busy_ = false;
+            }
+            writer_.cv_.notify_all();
+        }
+
+        Turn(const Turn&) = delete;
+        Turn& operator=(const Turn&) = delete;
+
+    private:
+        FramedWriter& writer_;
+    };
+
+    // Ticket dispenser; serving == next means nobody waits in the lane.
+    struct lane_t {
+        uint64_t next    = 0;
+        uint64_t serving = 0;
+    };
+
+    IStreamSocketClient&    socket_;
+    std::mutex              mutex_;
+    std::condition_variable cv_;
+    bool                    busy_ = false;
+    lane_t                  lanes_[2];
+};
+
+} // namespace client
+} // namespace vhal
+
+#endif /* FRAMED_WRITER_H */
@@ -0,0 +1,135 @@
+/**
+ * @file hdr_histogram.h
+ * @brief Lock-free log-linear histogram
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef HDR_HISTOGRAM_H
+#define HDR_HISTOGRAM_H
+
+#include "video_sink.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief Histogram of 64 bit values with a bounded relative error, after
+ *        HdrHistogram: each power of two range is split into kSubBuckets
+ *        linear buckets. Values below kSubBuckets are exact.
+ *
+ * Record() is a handful of relaxed atomic increments, safe from any number
+ * of threads. Summary() may run concurrently; it sees each bucket at some
+ * point during the call, which is good enough for monitoring.
+ */
+class HdrHistogram
+{
+public:
+    static constexpr int kSubBits    = 4;
+    static constexpr int kSubBuckets = 1 << kSubBits;
+    static constexpr int kBuckets    = (64 - kSubBits + 1) * kSubBuckets;
+
+    void Record(uint64_t value)
+    {
+        counts_[Index(value)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+        uint64_t min = min_.load(std::memory_order_relaxed);
+        while (value < min
+               && !min_.compare_exchange_weak(min, value, std::memory_order_relaxed)) {
+        }
+        uint64_t max = max_.load(std::memory_order_relaxed);
+        while (value > max
+               && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    VideoSink::histogram_summary_t Summary() const
+    {
+        VideoSink::histogram_summary_t summary;
+        std::array<uint64_t, kBuckets> counts;
+        uint64_t                       total = 0;
+        for (int i = 0; i < kBuckets; ++i) {
+            counts[i] = counts_[i].load(std::memory_order_relaxed);
+            total += counts[i];
+        }
+        if (total == 0) {
+            return summary;
+        }
+        summary.count = total;
+        summary.min   = min_.load(std::memory_order_relaxed);
+        summary.max   = max_.load(std::memory_order_relaxed);
+        summary.mean  = double(sum_.load(std::memory_order_relaxed))
+                       / count_.load(std::memory_order_relaxed);
+
+        struct
+        {
+            double    quantile;
+            uint64_t* value;
+        } const wanted[] = { { 0.5, &summary.p50 },
+                             { 0.9, &summary.p90 },
+                             { 0.99, &summary.p99 },
+                             { 0.999, &summary.p999 } };
+        uint64_t seen = 0;
+        size_t   next = 0;
+        for (int i = 0; i < kBuckets && next < std::size(wanted); ++i) {
+            seen += counts[i];
+            while (next < std::size(wanted) && seen >= wanted[next].quantile * total) {
+                *wanted[next].value = std::min(HighestEquivalent(i), summary.max);
+                ++next;
+            }
+        }
+        return summary;
+    }
+
+    static int Index(uint64_t value)
+    {
+        if (value < kSubBuckets) {
+            return static_cast<int>(value);
+        }
+        const int shift = 63 - __builtin_clzll(value) - kSubBits;
+        return (shift + 1) * kSubBuckets
+               + static_cast<int>((value >> shift) & (kSubBuckets - 1));
+    }
+
+    static uint64_t HighestEquivalent(int index)
+    {
+        if (index < kSubBuckets) {
+            return index;
+        }
+        const int shift = index / kSubBuckets - 1;
+        const uint64_t lowest = uint64_t(kSubBuckets + index % kSubBuckets) << shift;
+        return lowest + ((uint64_t(1) << shift) - 1);
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, kBuckets> counts_{};
+    std::atomic<uint64_t>                       count_ = 0;
+    std::atomic<uint64_t>                       sum_   = 0;
+    std::atomic<uint64_t> min_ = std::numeric_limits<uint64_t>::max();
+    std::atomic<uint64_t> max_ = 0;
+};
+
+} // namespace client
+} // namespace vhal
+
+#endif /* HDR_HISTOGRAM_H */
@@ -0,0 +1,241 @@
+/**
+ * @file hwc_handle_table.h
+ * @brief Slot table of remote HWC buffer handles backed by a handle pool
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef HWC_HANDLE_TABLE_H
+#define HWC_HANDLE_TABLE_H
+
+#include "display-protocol.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief Preallocated cros_gralloc_handle storage. Grows by whole chunks when
+ *        more buffers are alive than ever before, and never shrinks, so
+ *        buffers recreated on a resolution change reuse the same memory.
+ *
+ * Thread safe: handles are taken on the socket thread and may be given back
+ * from the consumer thread.
+ */
+class HwcHandlePool
+{
+public:
+    static constexpr size_t kChunkHandles = 32;
+
+    HwcHandlePool() { Grow(); }
+
+    HwcHandlePool(const HwcHandlePool&) = delete;
+    HwcHandlePool& operator=(const HwcHandlePool&) = delete;
+
+    /**
+     * @brief Returns a zeroed handle.
+     */
+    cros_gralloc_handle_t Acquire()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_.empty()) {
+            Grow();
+        }
+        auto handle = free_.back();
+        free_.pop_back();
+        memset(handle, 0, sizeof(*handle));
+        return handle;
+    }
+
+    void Release(cros_gralloc_handle_t handle)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.push_back(handle);
+    }
+
+private:
+    // Called with mutex_ held, or from the constructor.
+    void Grow()
+    {
+        chunks_.push_back(std::make_unique<cros_gralloc_handle[]>(kChunkHandles));
+        free_.reserve(chunks_.size() * kChunkHandles);
+        for (size_t i = kChunkHandles; i-- > 0;) {
+            free_.push_back(&chunks_.back()[i]);
+        }
+    }
+
+    std::mutex                                          mutex_;
+    std::vector<std::unique_ptr<cros_gralloc_handle[]>> chunks_;
+    std::vector<cros_gralloc_handle_t>                  free_;
+};
+
+/**
+ * @brief Maps the remote (guest) buffer handles to the local ones, with
+ *        open addressing and linear probing in a power of two table kept at
+ *        most half full. Lookups never allocate nor throw; erasing shifts
+ *        the following entries back, so there are no tombstones to skip.
+ *
+ * Not thread safe. Meant to be used from the socket thread, and from stop()
+ * once that thread is gone.
+ */
+class HwcHandleTable
+{
+public:
+    explicit HwcHandleTable(size_t capacity = 2 * HwcHandlePool::kChunkHandles)
+    {
+        size_t slots = 2;
+        while (slots < capacity) {
+            slots <<= 1;
+        }
+        slots_.resize(slots);
+    }
+
+    size_t Size() const { return size_; }
+
+    /**
+     * @return The local handle of @p remote, nullptr if unknown.
+     */
+    cros_gralloc_handle_t Find(uint64_t remote) const
+    {
+        for (size_t i = Home(remote);; i = Next(i)) {
+            const auto& slot = slots_[i];
+            if (!slot.local) {
+                return nullptr;
+            }
+            if (slot.remote == remote) {
+                return slot.local;
+            }
+        }
+    }
+
+    /**
+     * @brief Maps @p remote to @p local.
+     *
+     * @return The handle @p remote was mapped to before, nullptr if none.
+     */
+    cros_gralloc_handle_t Insert(uint64_t remote, cros_gralloc_handle_t local)
+    {
+        if (2 * (size_ + 1) > slots_.size()) {
+            Rehash(2 * slots_.size());
+        }
+        for (size_t i = Home(remote);; i = Next(i)) {
+            auto& slot = slots_[i];
+            if (!slot.local) {
+                slot = { remote, local };
+                ++size_;
+                return nullptr;
+            }
+            if (slot.remote == remote) {
+                auto old   = slot.local;
+                slot.local = local;
+                return old;
+            }
+        }
+    }
+
+    /**
+     * @return The local handle @p remote was mapped to, nullptr if none.
+     */
+    cros_gralloc_handle_t Erase(uint64_t remote)
+    {
+        size_t i = Home(remote);
+        for (;; i = Next(i)) {
+            if (!slots_[i].local) {
+                return nullptr;
+            }
+            if (slots_[i].remote == remote) {
+                break;
+            }
+        }
+        auto local = slots_[i].local;
+        // Backward shift: move up every later entry of the cluster that
+        // would otherwise become unreachable from its home slot.
+        for (size_t j = Next(i);; j = Next(j)) {
+            if (!slots_[j].local) {
+                break;
+            }
+            size_t home = Home(slots_[j].remote);
+            if (((j - home) & Mask()) >= ((j - i) & Mask())) {
+                slots_[i] = slots_[j];
+                i         = j;
+            }
+        }
+        slots_[i] = {};
+        --size_;
+        return local;
+    }
+
+    template <typename Fn>
+    void ForEach(Fn&& fn) const
+    {
+        for (const auto& slot : slots_) {
+            if (slot.local) {
+                fn(slot.remote, slot.local);
+            }
+        }
+    }
+
+    void Clear()
+    {
+        std::fill(slots_.begin(), slots_.end(), slot_t{});
+        size_ = 0;
+    }
+
+private:
+    struct slot_t {
+        uint64_t              remote = 0;
+        cros_gralloc_handle_t local  = nullptr; // nullptr: empty slot
+    };
+
+    size_t Mask() const { return slots_.size() - 1; }
+    size_t Next(size_t i) const { return (i + 1) & Mask(); }
+
+    // Remote handles are guest pointers or ids, mostly differing in the
+    // middle bits; Fibonacci hashing spreads them over the table.
+    size_t Home(uint64_t remote) const
+    {
+        return (remote * 0x9E3779B97F4A7C15ull) >> (64 - Bits());
+    }
+
+    unsigned Bits() const { return __builtin_ctzll(slots_.size()); }
+
+    void Rehash(size_t slots)
+    {
+        std::vector<slot_t> old(slots);
+        old.swap(slots_);
+        size_ = 0;
+        for (const auto& slot : old) {
+            if (slot.local) {
+                Insert(slot.remote, slot.local);
+            }
+        }
+    }
+
+    std::vector<slot_t> slots_;
+    size_t              size_ = 0;
+};
+
+} // namespace client
+} // namespace vhal
+
+#endif /* HWC_HANDLE_TABLE_H */
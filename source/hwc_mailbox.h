@@ -0,0 +1,229 @@
+/**
+ * @file hwc_mailbox.h
+ * @brief Latest frame wins delivery of HWC frames to a consumer thread
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef HWC_MAILBOX_H
+#define HWC_MAILBOX_H
+
+#include "hwc_vhal.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief Hands HWC frames to the handler on a consumer thread of its own, so
+ *        that a slow consumer never holds up the VHal.
+ *
+ * FRAME_CREATE and FRAME_REMOVE are all delivered, in order. Only the newest
+ * FRAME_DISPLAY waits in the mailbox: a frame superseded before the consumer
+ * took it is released at once, which sends its DISPLAY_ACK, and counted as
+ * dropped. The handler is never called from two threads at a time.
+ */
+class HwcMailbox
+{
+public:
+    explicit HwcMailbox(AsyncHwcHandler handler) : handler_{ std::move(handler) } {}
+
+    ~HwcMailbox() { Stop(); }
+
+    void Start()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (consumer_.joinable()) {
+            return;
+        }
+        stop_     = false;
+        consumer_ = std::thread([this]() { Run(); });
+    }
+
+    /**
+     * @brief Stops the consumer. Pending FRAME_CREATE/FRAME_REMOVE are
+     *        delivered on the calling thread, a pending frame is dropped.
+     */
+    void Stop()
+    {
+        std::optional<display_t> display;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+            display.swap(display_);
+        }
+        cv_.notify_all();
+        if (consumer_.joinable()) {
+            consumer_.join();
+        }
+        if (display) {
+            ++dropped_;
+            display.reset(); // its ACK, ahead of the commands
+        }
+        std::deque<command_t> commands;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            commands.swap(commands_);
+        }
+        for (auto& command : commands) {
+            Deliver(command);
+        }
+    }
+
+    void Create(cros_gralloc_handle_t handle, const frame_mapping_t* mapping)
+    {
+        Push({ FRAME_CREATE, handle, mapping, nullptr });
+    }
+
+    /**
+     * @brief @p done runs after the handler saw FRAME_REMOVE, to free the
+     *        handle. A pending frame of the buffer is dropped.
+     */
+    void Remove(cros_gralloc_handle_t  handle,
+                const frame_mapping_t* mapping,
+                std::function<void()>  done)
+    {
+        std::optional<display_t> superseded;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (display_ && display_->handle == handle) {
+                superseded.swap(display_);
+                ++dropped_;
+            }
+        }
+        Push({ FRAME_REMOVE, handle, mapping, std::move(done) });
+    }
+
+    void Display(const frame_info_t& frame, DisplayReleaseToken token)
+    {
+        std::optional<display_t> superseded;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (display_) {
+                superseded.swap(display_);
+                ++dropped_;
+            }
+            display_.emplace();
+            display_->handle  = frame.handle;
+            display_->mapping = frame.mapping;
+            display_->token  = std::move(token);
+            if (frame.ctrl) {
+                display_->ctrl = *frame.ctrl;
+            }
+            display_->sequence = next_sequence_++;
+        }
+        cv_.notify_one();
+        // superseded goes out of scope here, outside the lock: its ACK.
+    }
+
+    VirtualHwcReceiver::DisplayStats Stats() const
+    {
+        return { delivered_.load(), dropped_.load() };
+    }
+
+private:
+    struct command_t {
+        CommandType            cmd;
+        cros_gralloc_handle_t  handle;
+        const frame_mapping_t* mapping;
+        std::function<void()>  done;
+        uint64_t               sequence = 0;
+    };
+
+    struct display_t {
+        cros_gralloc_handle_t            handle  = nullptr;
+        const frame_mapping_t*           mapping = nullptr;
+        std::optional<display_control_t> ctrl;
+        DisplayReleaseToken              token;
+        uint64_t                         sequence = 0;
+    };
+
+    void Push(command_t command)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            command.sequence = next_sequence_++;
+            commands_.push_back(std::move(command));
+        }
+        cv_.notify_one();
+    }
+
+    void Run()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            cv_.wait(lock, [this]() { return stop_ || display_ || !commands_.empty(); });
+            if (stop_) {
+                return;
+            }
+            // Commands that came before the frame go first, so that its
+            // buffer has been created by the time it is shown.
+            if (!commands_.empty()
+                && (!display_ || commands_.front().sequence < display_->sequence)) {
+                auto command = std::move(commands_.front());
+                commands_.pop_front();
+                lock.unlock();
+                Deliver(command);
+            } else {
+                auto display = std::move(*display_);
+                display_.reset();
+                lock.unlock();
+                frame_info_t frame = { display.handle,
+                                       display.ctrl ? &*display.ctrl : nullptr,
+                                       display.mapping };
+                handler_(FRAME_DISPLAY, &frame, std::move(display.token));
+                ++delivered_;
+            }
+            lock.lock();
+        }
+    }
+
+    void Deliver(command_t& command)
+    {
+        frame_info_t frame = { command.handle, nullptr, command.mapping };
+        handler_(command.cmd, &frame, {});
+        if (command.done) {
+            command.done();
+        }
+    }
+
+    const AsyncHwcHandler handler_;
+
+    std::mutex               mutex_;
+    std::condition_variable  cv_;
+    std::deque<command_t>    commands_;
+    std::optional<display_t> display_;
+    uint64_t                 next_sequence_ = 0;
+    bool                     stop_          = false;
+    std::thread              consumer_;
+
+    std::atomic<uint64_t> delivered_{ 0 };
+    std::atomic<uint64_t> dropped_{ 0 };
+};
+
+} // namespace client
+} // namespace vhal
+
+#endif /* HWC_MAILBOX_H */
@@ -0,0 +1,181 @@
+/**
+ * @file hwc_plane_mapping.h
+ * @brief Persistent CPU mapping of the planes of an HWC buffer
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef HWC_PLANE_MAPPING_H
+#define HWC_PLANE_MAPPING_H
+
+#include "display-protocol.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <string>
+extern "C"
+{
+#include <fcntl.h>
+#include <linux/dma-buf.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+}
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief Maps the planes of a buffer once, for as long as the buffer lives,
+ *        instead of every consumer mapping them for every frame.
+ *
+ * The plane fds are duplicated, so the mapping can outlive the handle, e.g.
+ * while a frame of a removed buffer is still being encoded. Planes without
+ * an fd of their own share the first one. Buffers that are not dma-bufs,
+ * such as memfds, are mapped the same way and just skip the sync ioctls.
+ */
+class HwcPlaneMapping
+{
+public:
+    /**
+     * @return nullptr on failure, with error set.
+     */
+    static std::shared_ptr<HwcPlaneMapping>
+    Create(const cros_gralloc_handle& handle, std::string& error)
+    {
+        const int numFds = handle.base.numFds;
+        if (numFds <= 0 || numFds > DRV_MAX_PLANES) {
+            error = "invalid plane fd count";
+            return nullptr;
+        }
+        std::shared_ptr<HwcPlaneMapping> mapping(new HwcPlaneMapping());
+
+        // Each region covers the planes that live in its fd.
+        size_t lengths[DRV_MAX_PLANES] = {};
+        int    planes                  = 0;
+        for (; planes < DRV_MAX_PLANES && handle.sizes[planes] != 0; planes++) {
+            int    region = planes < numFds ? planes : 0;
+            size_t end    = size_t(handle.offsets[planes]) + handle.sizes[planes];
+            lengths[region] = std::max(lengths[region], end);
+        }
+        if (planes == 0) {
+            error = "buffer has no plane sizes";
+            return nullptr;
+        }
+        for (int i = 0; i < numFds; i++) {
+            if (lengths[i] == 0) {
+                continue;
+            }
+            auto& region = mapping->regions_[i];
+            region.fd    = fcntl(handle.fds[i], F_DUPFD_CLOEXEC, 0);
+            if (region.fd < 0) {
+                error = std::strerror(errno);
+                return nullptr;
+            }
+            void* base = mmap(nullptr, lengths[i], PROT_READ, MAP_SHARED, region.fd, 0);
+            if (base == MAP_FAILED) {
+                error = std::strerror(errno);
+                return nullptr;
+            }
+            region.base   = static_cast<uint8_t*>(base);
+            region.length = lengths[i];
+        }
+
+        auto& view      = mapping->view_;
+        view.num_planes = planes;
+        for (int i = 0; i < planes; i++) {
+            const auto& region = mapping->regions_[i < numFds ? i : 0];
+            view.planes[i]     = { region.base + handle.offsets[i], handle.strides[i],
+                                   handle.sizes[i] };
+        }
+
+        // Only dma-bufs know DMA_BUF_IOCTL_SYNC.
+        struct dma_buf_sync sync = { DMA_BUF_SYNC_START | DMA_BUF_SYNC_READ };
+        mapping->dma_buf_        = ioctl(mapping->regions_[0].fd, DMA_BUF_IOCTL_SYNC, &sync) == 0;
+        if (mapping->dma_buf_) {
+            sync.flags = DMA_BUF_SYNC_END | DMA_BUF_SYNC_READ;
+            ioctl(mapping->regions_[0].fd, DMA_BUF_IOCTL_SYNC, &sync);
+        }
+        return mapping;
+    }
+
+    ~HwcPlaneMapping()
+    {
+        for (auto& region : regions_) {
+            if (region.base) {
+                munmap(region.base, region.length);
+            }
+            if (region.fd >= 0) {
+                close(region.fd);
+            }
+        }
+    }
+
+    HwcPlaneMapping(const HwcPlaneMapping&) = delete;
+    HwcPlaneMapping& operator=(const HwcPlaneMapping&) = delete;
+
+    const frame_mapping_t* View() const { return &view_; }
+
+    bool IsDmaBuf() const { return dma_buf_; }
+
+    /**
+     * @brief Before the CPU reads a frame: waits for the GPU to be done with
+     *        the buffer and makes its writes visible.
+     */
+    void BeginAccess() { Sync(DMA_BUF_SYNC_START | DMA_BUF_SYNC_READ); }
+
+    /**
+     * @brief After the CPU is done reading the frame.
+     */
+    void EndAccess() { Sync(DMA_BUF_SYNC_END | DMA_BUF_SYNC_READ); }
+
+private:
+    HwcPlaneMapping() = default;
+
+    void Sync(uint64_t flags)
+    {
+        if (!dma_buf_) {
+            return;
+        }
+        struct dma_buf_sync sync = { flags };
+        for (auto& region : regions_) {
+            if (region.fd < 0) {
+                continue;
+            }
+            while (ioctl(region.fd, DMA_BUF_IOCTL_SYNC, &sync) == -1
+                   && (errno == EINTR || errno == EAGAIN)) {
+            }
+        }
+    }
+
+    struct region_t {
+        int      fd     = -1;
+        uint8_t* base   = nullptr;
+        size_t   length = 0;
+    };
+
+    region_t        regions_[DRV_MAX_PLANES];
+    frame_mapping_t view_{};
+    bool            dma_buf_ = false;
+};
+
+} // namespace client
+} // namespace vhal
+
+#endif /* HWC_PLANE_MAPPING_H */
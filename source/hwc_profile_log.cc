@@ -18,6 +18,7 @@
  */
 
 #include "hwc_profile_log.h"
+#include "receiver_log.h"
 #include <chrono>
 #include <cassert>
 
@@ -102,7 +103,7 @@ log_err_t ProfileLogger::Initialize(int width, int height)
 
     if (env_string != nullptr && atoi(env_string) == 1)
     {
-        printf("YML Log of events is enabled\n");
+        AIC_LOG(LIBVHAL_INFO, "YML Log of events is enabled");
         m_enabled = true;
     }
 
@@ -115,12 +116,12 @@ log_err_t ProfileLogger::Initialize(int width, int height)
 
     m_logFilePtr = fopen(m_logFilePath.c_str(), "w");
     if (! m_logFilePtr) {
-        printf("Cannot open file to write: %s\n", m_logFilePath.c_str());
+        AIC_LOG(LIBVHAL_ERROR, "Cannot open file to write: %s", m_logFilePath.c_str());
         m_enabled = false;
         return ERR_UNWRITABLE_LOGFILE;
     }
     else
-        printf("YML Log file opened at %s\n", m_logFilePath.c_str());
+        AIC_LOG(LIBVHAL_INFO, "YML Log file opened at %s", m_logFilePath.c_str());
 
     SetResolution(width, height);
     m_initialized = true;
@@ -143,8 +144,8 @@ log_err_t ProfileLogger::AcquireMutex()
         m_log_mutex.lock();
     }
     catch (std::system_error& e) {
-        std::cout << "Exception attempting to acquire log mutex: " << e.code()
-                  << " (" << e.what() << ")" << std::endl;
+        AIC_LOG(LIBVHAL_ERROR, "Exception attempting to acquire log mutex: %d (%s)",
+                e.code().value(), e.what());
         return ERR_LOCKING;
     }
 
@@ -160,8 +161,8 @@ log_err_t ProfileLogger::ReleaseMutex()
         m_log_mutex.unlock();
     }
     catch (std::system_error& e) {
-        std::cout << "Exception attempting to release log mutex: " << e.code()
-                  << " (" << e.what() << ")" << std::endl;
+        AIC_LOG(LIBVHAL_ERROR, "Exception attempting to release log mutex: %d (%s)",
+                e.code().value(), e.what());
         return ERR_LOCKING;
     }
 
@@ -33,7 +33,21 @@
 namespace vhal {
 namespace client {
 
-VirtualHwcReceiver::VirtualHwcReceiver(struct ConfigInfo info, HwcHandler handler)
+VirtualHwcReceiver::VirtualHwcReceiver(struct ConfigInfo info, HwcHandler handler,
+                                       std::shared_ptr<Reactor> reactor)
+  : VirtualHwcReceiver(std::move(info),
+                       // The token dies on return, so the ACK follows the handler.
+                       handler ? AsyncHwcHandler([handler](CommandType cmd,
+                                                           const frame_info_t* frame,
+                                                           DisplayReleaseToken) {
+                           handler(cmd, frame);
+                       })
+                               : nullptr,
+                       std::move(reactor))
+{}
+
+VirtualHwcReceiver::VirtualHwcReceiver(struct ConfigInfo info, AsyncHwcHandler handler,
+                                       std::shared_ptr<Reactor> reactor)
 {
     auto sockPath = info.unix_conn_info.socket_dir;
     if (sockPath.length() == 0) {
@@ -48,7 +62,8 @@ VirtualHwcReceiver::VirtualHwcReceiver(struct ConfigInfo info, HwcHandler handle
     //Creating interface to communicate to VHAL via libvhal
     auto unix_sock_client =
       std::make_unique<UnixStreamSocketClient>(std::move(sockPath));
-    impl_ = std::make_unique<Impl>(std::move(unix_sock_client), std::move(info), std::move(handler));
+    impl_ = std::make_unique<Impl>(std::move(unix_sock_client), std::move(info), std::move(handler),
+                                   std::move(reactor));
     if (!impl_->init()) {
         throw std::logic_error("failed to create hwc");
     }
@@ -76,5 +91,18 @@ IOResult VirtualHwcReceiver::setVideoAlpha(uint32_t action)
     return impl_->setVideoAlpha(action);
 }
 
+VirtualHwcReceiver::DisplayStats VirtualHwcReceiver::getDisplayStats()
+{
+    return impl_->getDisplayStats();
+}
+
+void DisplayReleaseToken::Release()
+{
+    if (pending_) {
+        pending_->Release();
+        pending_.reset();
+    }
+}
+
 }
 }
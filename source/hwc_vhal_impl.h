@@ -24,11 +24,19 @@
 #include <functional>
 #include <memory>
 #include <map>
+#include <mutex>
+#include <unordered_map>
 #include <iostream>
 #include <thread>
 #include "libvhal_common.h"
 #include "hwc_vhal.h"
+#include "framed_reader.h"
+#include "hwc_handle_table.h"
+#include "hwc_mailbox.h"
+#include "hwc_plane_mapping.h"
 #include "istream_socket_client.h"
+#include "receiver_log.h"
+#include "stream_talker.h"
 
 #include "display-protocol.h"
 #include "hwc_profile_log.h"
@@ -42,10 +50,138 @@ using namespace std;
 namespace vhal {
 namespace client {
 
+/**
+ * Writes events to the HWC VHal, one whole event at a time, for the talker
+ * thread, setMode()/setVideoAlpha() callers and frame releases from any
+ * thread. Shared with the pending releases, which may outlive the receiver.
+ */
+class HwcEventChannel
+{
+public:
+    HwcEventChannel(IStreamSocketClient* socket, shared_ptr<ProfileLogger> log)
+      : socket_{socket}, log_{move(log)}
+    {}
+
+    ssize_t Send(const void* ev, size_t size)
+    {
+        lock_guard<mutex> lock(mutex_);
+        return SendLocked(ev, size);
+    }
+
+    // New VHal session, or stop(): ACKs owed to the old one are dropped.
+    void NewSession()
+    {
+        lock_guard<mutex> lock(mutex_);
+        ++generation_;
+        in_flight_ = 0;
+    }
+
+    uint64_t BeginDisplay(int depth)
+    {
+        lock_guard<mutex> lock(mutex_);
+        if (++in_flight_ > depth) {
+            AIC_LOG(LIBVHAL_WARNING, "%d frames displayed without ACK, more than the %d buffers",
+                    in_flight_, depth);
+        }
+        return generation_;
+    }
+
+    void Ack(buffer_info_event_t ev, uint64_t generation)
+    {
+        ev.event.type = VHAL_DD_EVENT_DISPLAY_ACK;
+        ev.event.size = sizeof(ev);
+        {
+            lock_guard<mutex> lock(mutex_);
+            if (generation != generation_) {
+                return;
+            }
+            --in_flight_;
+            if (SendLocked(&ev, sizeof(ev)) <= 0) {
+                AIC_LOG(LIBVHAL_ERROR, "send() failed: %s\n", strerror(errno));
+                return;
+            }
+        }
+        // The talker holds the log mutex while it handles an event.
+        const bool dispatching = dispatch_thread_ == this_thread::get_id();
+        if (!dispatching) {
+            log_->AcquireMutex();
+        }
+        log_->LogGenericEventInfo(EVENT_DISPLAY_REQ_ACK);
+        log_->AddBufferInfoEventStruct(&ev);
+        if (!dispatching) {
+            log_->ReleaseMutex();
+        }
+    }
+
+    void SetDispatching(bool dispatching)
+    {
+        dispatch_thread_ = dispatching ? this_thread::get_id() : thread::id();
+    }
+
+    // The socket is going away; later sends fail and releases are dropped.
+    void Detach()
+    {
+        lock_guard<mutex> lock(mutex_);
+        socket_ = nullptr;
+        ++generation_;
+    }
+
+private:
+    ssize_t SendLocked(const void* ev, size_t size)
+    {
+        if (!socket_) {
+            errno = ENOTCONN;
+            return -1;
+        }
+        // Releases may come after the VHal is gone, don't die of SIGPIPE.
+        return send(socket_->GetNativeSocketFd(), ev, size, MSG_NOSIGNAL);
+    }
+
+    mutex                     mutex_;
+    IStreamSocketClient*      socket_;
+    shared_ptr<ProfileLogger> log_;
+    uint64_t                  generation_ = 0;
+    int                       in_flight_  = 0;
+    atomic<thread::id>        dispatch_thread_{};
+};
+
+class DisplayReleaseToken::Pending
+{
+public:
+    Pending(shared_ptr<HwcEventChannel> channel, uint64_t generation,
+            const buffer_info_event_t& ev, shared_ptr<HwcPlaneMapping> mapping)
+      : channel_{move(channel)}, generation_{generation}, ev_(ev), mapping_{move(mapping)}
+    {}
+
+    ~Pending() { Release(); }
+
+    void Release()
+    {
+        if (!released_.exchange(true)) {
+            // CPU access ends before the GPU may render into it again.
+            if (mapping_) {
+                mapping_->EndAccess();
+            }
+            channel_->Ack(ev_, generation_);
+        }
+    }
+
+private:
+    shared_ptr<HwcEventChannel> channel_;
+    uint64_t                    generation_;
+    buffer_info_event_t         ev_;
+    shared_ptr<HwcPlaneMapping> mapping_;
+    atomic<bool>                released_ = false;
+};
+
 class VirtualHwcReceiver::Impl
 {
 public:
-    Impl(unique_ptr<IStreamSocketClient> unix_sock_client, ConfigInfo info, HwcHandler handler): socket_client_{move(unix_sock_client)}, mInfo{move(info)}, mHwcHandler{move(handler)}
+    Impl(unique_ptr<IStreamSocketClient> unix_sock_client, ConfigInfo info,
+         AsyncHwcHandler handler, shared_ptr<Reactor> reactor = nullptr)
+      : socket_client_{move(unix_sock_client)}, mInfo{move(info)}, mHwcHandler{move(handler)},
+        mReactor{move(reactor)},
+        mReader{socket_client_.get(), FramedReader::kDefaultCapacity, true}
     {
         AIC_LOG(mDebug, "info.video_res_width: %d", mInfo.video_res_width);
         AIC_LOG(mDebug, "info.video_res_height: %d", mInfo.video_res_height);
@@ -54,8 +190,12 @@ public:
         AIC_LOG(mDebug, "info.unix_conn_info.socket_dir: %s", mInfo.unix_conn_info.socket_dir.c_str());
         AIC_LOG(mDebug, "info.unix_conn_info.android_instance_id: %d", mInfo.unix_conn_info.android_instance_id);
 
-        m_pLog = std::make_unique<ProfileLogger>();
+        m_pLog = std::make_shared<ProfileLogger>();
         m_pLog->Initialize(mInfo.video_res_width, mInfo.video_res_height);
+        mEvents = std::make_shared<HwcEventChannel>(socket_client_.get(), m_pLog);
+        if (mInfo.delivery == DisplayDelivery::kMailbox) {
+            mMailbox = std::make_unique<HwcMailbox>(mHwcHandler);
+        }
     }
 
     ~Impl()
@@ -63,71 +203,16 @@ public:
         if (should_continue_) {
             stop();
         }
+        mEvents->Detach();
     }
 
     cros_gralloc_handle_t get_handle(uint64_t h)
     {
-        try {
-	    cros_gralloc_handle_t handle = mHandles.at(h);
-	    if (!handle) {
-	        AIC_LOG(mDebug, "broken handle: %ld\n", h);
-	    }
-	    return handle;
-	} catch(...) {
-	    AIC_LOG(mDebug, "remote handle not found: %ld\n", h);
-	    return nullptr;
-        }
-    }
-
-    int recvFds(int fd, int* pfd, size_t fdlen)
-    {
-        int ret = 0;
-        int count = 0;
-        int i = 0;
-        struct msghdr msg;
-        int rdata[4] = {0};
-        struct iovec vec;
-        char cmsgbuf[CMSG_SPACE(fdlen * sizeof(int))];
-        struct cmsghdr* p_cmsg;
-        int* p_fds;
-
-	if (pfd == NULL) {
-	    return -1;
-	}
-
-	if ((fdlen == 0) || (fdlen > DRV_MAX_PLANES)) {
-	    AIC_LOG(mDebug, "wrong fdlen(%zd), it should be less than the DRV_MAX_PLANES\n", fdlen);
-	    return -1;
-	}
-
-        vec.iov_base = rdata;
-        vec.iov_len = 16;
-        msg.msg_name = NULL;
-        msg.msg_namelen = 0;
-        msg.msg_iov = &vec;
-        msg.msg_iovlen = 1;
-        msg.msg_control = cmsgbuf;
-        msg.msg_controllen = sizeof(cmsgbuf);
-        msg.msg_flags = 0;
-
-        p_fds = (int*)CMSG_DATA(CMSG_FIRSTHDR(&msg));
-        count = recvmsg(fd, &msg, MSG_WAITALL);
-        if (count < 0) {
-            printf("Failed to recv fd from remote\n");
-            ret = -1;
-        } else {
-            p_cmsg = CMSG_FIRSTHDR(&msg);
-            if (p_cmsg == NULL) {
-                printf("No msg hdr\n");
-                ret = -1;
-            } else {
-                p_fds = (int*)CMSG_DATA(p_cmsg);
-                for (i = 0; i < (int)fdlen; i++) {
-                    pfd[i] = p_fds[i];
-               }
-            }
+        cros_gralloc_handle_t handle = mHandles.Find(h);
+        if (!handle) {
+            AIC_LOG(mDebug, "remote handle not found: %ld\n", h);
         }
-        return ret;
+        return handle;
     }
 
     bool init()
@@ -162,7 +247,20 @@ public:
         }
 
         should_continue_ = true;
-        mWorkThread = std::unique_ptr<std::thread>(new std::thread(&Impl::workThreadProc, this));
+        if (mMailbox) {
+            mMailbox->Start();
+        }
+        mTalker = std::make_unique<StreamTalker>(
+          socket_client_.get(),
+          "VirtualHwcReceiver",
+          mReactor,
+          [this]() {
+              AIC_LOG(LIBVHAL_INFO, "Connected to HWC VHal!");
+              mReader.Reset();
+              mEvents->NewSession();
+          },
+          [this]() { return OnMessage(); });
+        mTalker->Start();
         AIC_LOG(mDebug, "start is: %s", "successful!");
         return {0, error_msg};
     }
@@ -175,18 +273,24 @@ public:
         }
 
         should_continue_ = false;
-        mWorkThread->join();
+        mTalker.reset();
+        mEvents->NewSession();
         socket_client_->Close();
+        if (mMailbox) {
+            mMailbox->Stop();
+        }
         // Free the buffer handles
-        for (auto const& [rh, lh] : mHandles) {
+        mHandles.ForEach([this](uint64_t, cros_gralloc_handle_t lh) {
+            auto mapping = TakeMapping(lh);
             if (mHwcHandler) {
-                frame_info_t frame = {.handle = lh, .ctrl = nullptr};
-                mHwcHandler(FRAME_REMOVE, &frame);
+                frame_info_t frame = {.handle = lh, .ctrl = nullptr,
+                                      .mapping = mapping ? mapping->View() : nullptr};
+                mHwcHandler(FRAME_REMOVE, &frame, {});
             }
-            close(lh->fds[0]);
-            free(lh);
-        }
-        mHandles.clear();
+            CloseBufferFds(lh);
+            mHandlePool.Release(lh);
+        });
+        mHandles.Clear();
 
         AIC_LOG(mDebug, "stop is: %s", "successful!");
         return {0, error_msg};
@@ -208,7 +312,7 @@ public:
         ev.info.width = width;
         ev.info.height = height;
         ssize_t len = 0;
-        len = send(socket_client_->GetNativeSocketFd(), &ev, sizeof(ev), 0);
+        len = mEvents->Send(&ev, sizeof(ev));
         if (len <= 0) {
             error_msg = std::strerror(errno);
             return {-1, error_msg};
@@ -233,7 +337,7 @@ public:
 
         ev.alpha.enable = action;
         ssize_t len = 0;
-        len = send(socket_client_->GetNativeSocketFd(), &ev, sizeof(ev), 0);
+        len = mEvents->Send(&ev, sizeof(ev));
         if (len <= 0) {
             error_msg = std::strerror(errno);
             return {-1, error_msg};
@@ -243,93 +347,91 @@ public:
         return {0, error_msg};
     }
 
-    void workThreadProc()
+    DisplayStats getDisplayStats()
     {
-        while (should_continue_) {
-            while ((not socket_client_->Connected()) && (should_continue_)) {
-                if (auto [connected, error_msg] = socket_client_->Connect();
-                    !connected) {
-                    cout << "Failed to connect to VHal: "
-                         << error_msg
-                         << ". Retry after 1s...\n";
-                    this_thread::sleep_for(1s);
-                    continue;
-                }
-                cout << "Connected to HWC VHal!\n";
-            }
-
-            struct pollfd fds[1];
-            const int     timeout_ms = 1 * 1000; // 1 sec timeout
-            int           ret;
-
-            // watch socket for input
-            fds[0].fd     = socket_client_->GetNativeSocketFd();
-            fds[0].events = POLLIN;
-            // connected ...
-
-	    ret = poll(fds, std::size(fds), timeout_ms);
-	    if (ret < 0) {
-	        socket_client_->Close();
-		continue; //this will goto Connect();
-	    } else if (ret == 0) {
-	        continue;
-	    } else {
-                display_event_t ev{};
-                ssize_t len = read(socket_client_->GetNativeSocketFd(), &ev, sizeof(ev));
-                if (len < 0) {
-                    AIC_LOG(mDebug, "can't receive data: %s\n", strerror(errno));
-                    break;
-                } else if (len == 0) {
-                    AIC_LOG(mDebug, "client disconnected: %s\n", strerror(errno));
-                    break;
-                } else {
-                    log_event_t eventType = m_pLog->TranslateEvType(ev.type);
-                    m_pLog->UpdateEventCount(eventType);
-
-                    m_pLog->AcquireMutex();
-                    m_pLog->LogGenericEventInfo(eventType, &ev);
-
-                    switch (ev.type) {
-                        case VHAL_DD_EVENT_DISPINFO_REQ:
-                            if (checkDispConfig(ev.id, ev.renderNode) == -1) {
-                                m_pLog->ReleaseMutex();
-                                goto error;
-                            }
-                            AIC_LOG(mDebug, "VHAL_DD_EVENT_DISPINFO_REQ\n");
-                            UpdateDispConfig(socket_client_->GetNativeSocketFd());
-                            break;
-                        case VHAL_DD_EVENT_DISPPORT_REQ:
-                            AIC_LOG(mDebug, "VHAL_DD_EVENT_DISPPORT_REQ\n");
-                            UpdateDispPort(socket_client_->GetNativeSocketFd());
-                            break;
-                        case VHAL_DD_EVENT_CREATE_BUFFER:
-                            AIC_LOG(mDebug, "VHAL_DD_EVENT_CREATE_BUFFER\n");
-                            if (ev.size == sizeof(buffer_info_event_t) + sizeof(cros_gralloc_handle)) {
-                                CreateBuffer(socket_client_->GetNativeSocketFd());
-                            }
-                            break;
-                        case VHAL_DD_EVENT_REMOVE_BUFFER:
-                            AIC_LOG(mDebug, "VHAL_DD_EVENT_REMOVE_BUFFER\n");
-                            RemoveBuffer(socket_client_->GetNativeSocketFd());
-                            break;
-                        case VHAL_DD_EVENT_DISPLAY_REQ:
-                            //AIC_LOG(mDebug, "VHAL_DD_EVENT_DISPLAY_REQ\n");
-                            DisplayRequest(socket_client_->GetNativeSocketFd(), ev.size - sizeof(ev));
-                            break;
-                        default:
-                            AIC_LOG(mDebug, "VHAL_DD_EVENT_<unknown>: ev.type=%d\n", ev.type);
-                    } // end of switch
+        if (mMailbox) {
+            return mMailbox->Stats();
+        }
+        return {mDelivered.load(), 0};
+    }
 
-                    m_pLog->ReleaseMutex();
-                } //end of else
-            }
-        } // end of while
+    StreamTalker::Status OnMessage()
+    {
+        // Drain every event the last fill brought in; poll() won't report
+        // them again.
+        StreamTalker::Status status;
+        do {
+            status = HandleMessage();
+        } while (status == StreamTalker::Status::kContinue &&
+                 mReader.Buffered() >= sizeof(display_event_t));
+        return status;
+    }
 
-        error:
-            socket_client_->Close();
+    StreamTalker::Status HandleMessage()
+    {
+        display_event_t ev{};
+        auto [len, error_msg] = mReader.Read(&ev, sizeof(ev));
+        if (len < 0) {
+            AIC_LOG(mDebug, "can't receive data: %s\n", error_msg.c_str());
+            AIC_LOG(mDebug, "working thread stopped, please re-start() !!!");
+            return StreamTalker::Status::kStop;
+        } else if (len == 0) {
+            AIC_LOG(mDebug, "%s", "client disconnected\n");
             AIC_LOG(mDebug, "working thread stopped, please re-start() !!!");
+            return StreamTalker::Status::kStop;
+        }
+
+        log_event_t eventType = m_pLog->TranslateEvType(ev.type);
+        m_pLog->UpdateEventCount(eventType);
 
-        return;
+        m_pLog->AcquireMutex();
+        mEvents->SetDispatching(true);
+        m_pLog->LogGenericEventInfo(eventType, &ev);
+
+        switch (ev.type) {
+            case VHAL_DD_EVENT_DISPINFO_REQ:
+                if (checkDispConfig(ev.id, ev.renderNode) == -1) {
+                    mEvents->SetDispatching(false);
+                    m_pLog->ReleaseMutex();
+                    AIC_LOG(mDebug, "working thread stopped, please re-start() !!!");
+                    return StreamTalker::Status::kStop;
+                }
+                AIC_LOG(mDebug, "VHAL_DD_EVENT_DISPINFO_REQ\n");
+                UpdateDispConfig(socket_client_->GetNativeSocketFd());
+                break;
+            case VHAL_DD_EVENT_DISPPORT_REQ:
+                AIC_LOG(mDebug, "VHAL_DD_EVENT_DISPPORT_REQ\n");
+                UpdateDispPort(socket_client_->GetNativeSocketFd());
+                break;
+            case VHAL_DD_EVENT_CREATE_BUFFER:
+                AIC_LOG(mDebug, "VHAL_DD_EVENT_CREATE_BUFFER\n");
+                if (ev.size == sizeof(buffer_info_event_t) + sizeof(cros_gralloc_handle)) {
+                    CreateBuffer();
+                } else {
+                    SkipEvent(ev);
+                }
+                break;
+            case VHAL_DD_EVENT_REMOVE_BUFFER:
+                AIC_LOG(mDebug, "VHAL_DD_EVENT_REMOVE_BUFFER\n");
+                RemoveBuffer();
+                break;
+            case VHAL_DD_EVENT_DISPLAY_REQ:
+                //AIC_LOG(mDebug, "VHAL_DD_EVENT_DISPLAY_REQ\n");
+                if (ev.size >= sizeof(buffer_info_event_t)
+                    && ev.size - sizeof(ev) <= size_t(kMaxDisplayBody)) {
+                    DisplayRequest(socket_client_->GetNativeSocketFd(), ev.size - sizeof(ev));
+                } else {
+                    AIC_LOG(mDebug, "Wrong data size in displayBuffer message\n");
+                    SkipEvent(ev);
+                }
+                break;
+            default:
+                AIC_LOG(mDebug, "VHAL_DD_EVENT_<unknown>: ev.type=%d\n", ev.type);
+        } // end of switch
+
+        mEvents->SetDispatching(false);
+        m_pLog->ReleaseMutex();
+        return StreamTalker::Status::kContinue;
     }
 
     int checkDispConfig(int aicSession, int aicRenderNodeMinus128) {
@@ -369,10 +471,10 @@ public:
         ev.info.fps = 60;
         ev.info.minSwapInterval = 1;
         ev.info.maxSwapInterval = 1;
-        ev.info.numFramebuffers = 2;
+        ev.info.numFramebuffers = mInfo.num_framebuffers;
 
         ssize_t len = 0;
-        len = send(fd, &ev, sizeof(ev), 0);
+        len = mEvents->Send(&ev, sizeof(ev));
         if (len <= 0) {
             AIC_LOG(mDebug, "send() failed: %s\n", strerror(errno));
         }
@@ -389,7 +491,7 @@ public:
       ev.dispPort.port = mInfo.user_id;
 
       ssize_t len = 0;
-      len = send(fd, &ev, sizeof(ev), 0);
+      len = mEvents->Send(&ev, sizeof(ev));
       if (len <= 0) {
           AIC_LOG(mDebug, "send() failed: %s\n", strerror(errno));
       }
@@ -405,38 +507,37 @@ public:
      * 2) display_event_t::size, total size
      * 3) buffer_info_t::remote_handle, buffer handle
      *
-     * body: cros_gralloc_handle_t
+     * body: cros_gralloc_handle_t, then 16 bytes carrying the plane fds
      */
-    int CreateBuffer(int fd)
+    int CreateBuffer()
     {
-        buffer_info_event_t ev{};
-        ssize_t len = 0;
-        int ret = -1;
-
-        auto handle = (cros_gralloc_handle_t)malloc(sizeof(cros_gralloc_handle));
-        if (handle == nullptr) {
-            AIC_LOG(mDebug, "Failed to allocate local buffer handle: %s\n", strerror(errno));
-            ret = -errno;
-            return ret;
-        }
-
-        len = recv(fd, &ev.info, sizeof(ev.info), 0);
-        if (len <= 0) {
-            free(handle);
-            AIC_LOG(mDebug, "Failed to read buffer info: %s\n", strerror(errno));
+        // The whole event in one go, straight out of the receive buffer.
+        const uint8_t* body = nullptr;
+        if (auto [len, error_msg] = mReader.Pull(kCreateBufferBody, &body); len <= 0) {
+            AIC_LOG(mDebug, "Failed to read buffer info: %s\n", error_msg.c_str());
             return -1;
         }
+        buffer_info_event_t ev{};
+        memcpy(&ev.info, body, sizeof(ev.info));
         m_pLog->AddBufferInfoStruct(&ev.info, 2);
 
-        len = recv(fd, handle, sizeof(cros_gralloc_handle), 0);
-        if (len <= 0) {
-            free(handle);
-            AIC_LOG(mDebug, "Failed to read buffer info: %s\n", strerror(errno));
+        auto handle = mHandlePool.Acquire();
+        memcpy(handle, body + sizeof(ev.info), sizeof(cros_gralloc_handle));
+        // The fd carrier that follows only holds the remote fd numbers.
+
+        size_t numFds = handle->base.numFds;
+        if ((numFds == 0) || (numFds > DRV_MAX_PLANES)) {
+            mHandlePool.Release(handle);
+            // The plane fds came with the event, nobody will take them now.
+            mReader.DropFds();
+            AIC_LOG(mDebug, "wrong fdlen(%zd), it should be less than the DRV_MAX_PLANES\n", numFds);
             return -1;
         }
-
-        if (recvFds(fd, handle->fds, handle->base.numFds) == -1) {
-            free(handle);
+        if (auto [len, error_msg] = mReader.ReadFds(handle->fds, numFds); len <= 0) {
+            mHandlePool.Release(handle);
+            // Some of the plane fds may have made it.
+            mReader.DropFds();
+            AIC_LOG(mDebug, "Failed to recv fd from remote: %s\n", error_msg.c_str());
             return -1;
         }
         // Unified NV12 format
@@ -448,21 +549,36 @@ public:
         m_pLog->AddGrallocHandleStruct(handle, 2);
 
         AIC_LOG(mDebug, "createBuffer width(%d)height(%d)\n", handle->width, handle->height);
-        mHandles.insert(std::make_pair(ev.info.remote_handle, handle));
-        frame_info_t frame = {.handle = handle, .ctrl = nullptr};
-        mHwcHandler(FRAME_CREATE, &frame);
+        if (auto old = mHandles.Insert(ev.info.remote_handle, handle)) {
+            AIC_LOG(mDebug, "remote handle %ld created twice\n", ev.info.remote_handle);
+            DropBuffer(old);
+        }
+        const frame_mapping_t* view = nullptr;
+        if (mInfo.map_planes) {
+            std::string error;
+            if (auto mapping = HwcPlaneMapping::Create(*handle, error)) {
+                view = mapping->View();
+                mMappings.emplace(handle, move(mapping));
+            } else {
+                AIC_LOG(LIBVHAL_WARNING, "Failed to map buffer planes: %s", error.c_str());
+            }
+        }
+        if (mMailbox) {
+            mMailbox->Create(handle, view);
+        } else {
+            frame_info_t frame = {.handle = handle, .ctrl = nullptr, .mapping = view};
+            mHwcHandler(FRAME_CREATE, &frame, {});
+        }
 
         return 0;
     }
 
-    int RemoveBuffer(int fd)
+    int RemoveBuffer()
     {
         buffer_info_event_t ev{};
-        ssize_t len = 0;
 
-        len = recv(fd, &ev.info, sizeof(ev.info), 0);
-        if (len <= 0) {
-            AIC_LOG(mDebug, "Failed to read buffer info: %s\n", strerror(errno));
+        if (auto [len, error_msg] = mReader.Read(&ev.info, sizeof(ev.info)); len <= 0) {
+            AIC_LOG(mDebug, "Failed to read buffer info: %s\n", error_msg.c_str());
             return -1;
         }
         m_pLog->AddBufferInfoStruct(&ev.info, 2);
@@ -471,39 +587,90 @@ public:
         if (!handle) {
             return -1;
         }
-        frame_info_t frame = {.handle = handle, .ctrl = nullptr};
-        mHwcHandler(FRAME_REMOVE, &frame);
+        mHandles.Erase(ev.info.remote_handle);
+        DropBuffer(handle);
 
-        close(handle->fds[0]);
-        free(handle);
+        return 0;
+    }
 
-        mHandles.erase(ev.info.remote_handle);
+    void DropBuffer(cros_gralloc_handle_t handle)
+    {
+        // Unmapped once the last frame of the buffer is released.
+        auto                   mapping = TakeMapping(handle);
+        const frame_mapping_t* view    = mapping ? mapping->View() : nullptr;
+        if (mMailbox) {
+            // Freed once the consumer is done with the buffer.
+            mMailbox->Remove(handle, view, [this, handle, mapping]() {
+                CloseBufferFds(handle);
+                mHandlePool.Release(handle);
+            });
+            return;
+        }
+        frame_info_t frame = {.handle = handle, .ctrl = nullptr, .mapping = view};
+        mHwcHandler(FRAME_REMOVE, &frame, {});
+
+        CloseBufferFds(handle);
+        mHandlePool.Release(handle);
+    }
+
+    shared_ptr<HwcPlaneMapping> FindMapping(cros_gralloc_handle_t handle)
+    {
+        if (mMappings.empty()) {
+            return nullptr;
+        }
+        auto it = mMappings.find(handle);
+        return it == mMappings.end() ? nullptr : it->second;
+    }
+
+    shared_ptr<HwcPlaneMapping> TakeMapping(cros_gralloc_handle_t handle)
+    {
+        auto mapping = FindMapping(handle);
+        if (mapping) {
+            mMappings.erase(handle);
+        }
+        return mapping;
+    }
 
+    // Every plane came with an fd of its own, even planes of one BO.
+    static void CloseBufferFds(cros_gralloc_handle_t handle)
+    {
+        for (int i = 0; i < handle->base.numFds && i < DRV_MAX_PLANES; i++) {
+            close(handle->fds[i]);
+        }
+    }
+
+    // Keeps the stream in sync past an event we don't handle, and closes
+    // whatever fds it carried.
+    int SkipEvent(const display_event_t& ev)
+    {
+        AIC_LOG(mDebug, "Skipping event type=%d with unexpected size %u\n", ev.type, ev.size);
+        if (ev.size < sizeof(ev)) {
+            return -1;
+        }
+        if (auto [len, error_msg] = mReader.Skip(ev.size - sizeof(ev)); len < 0) {
+            AIC_LOG(mDebug, "Failed to skip event: %s\n", error_msg.c_str());
+            return -1;
+        }
+        mReader.DropFds();
         return 0;
     }
 
     int DisplayRequest(int fd, int size) {
         buffer_info_event_t ev{};
-        ssize_t len = 0;
-        if (size < (int)sizeof(ev.info)) {
-            AIC_LOG(mDebug, "Wrong data size in displayBuffer message\n");
-            return -1;
-        }
-        len = recv(fd, &ev.info, sizeof(ev.info), 0);
-        if (len <= 0) {
-            AIC_LOG(mDebug, "Failed to read buffer info: %s\n", strerror(errno));
+        // Pull all of it, so that a payload we don't know keeps the stream
+        // in sync rather than being parsed as the next event.
+        const uint8_t* body = nullptr;
+        if (auto [len, error_msg] = mReader.Pull(size, &body); len <= 0) {
+            AIC_LOG(mDebug, "Failed to read buffer info: %s\n", error_msg.c_str());
             return -1;
         }
+        memcpy(&ev.info, body, sizeof(ev.info));
         m_pLog->AddBufferInfoStruct(&ev.info, 2);
 
         display_control_t ctrl{};
         bool hasCtrl = (size == (sizeof(ev.info) + sizeof(display_control_t)));
         if (hasCtrl) {
-            len = recv(fd, &ctrl, sizeof(display_control_t), 0);
-            if (len <= 0) {
-                AIC_LOG(mDebug, "Failed to read display control info: %s\n", strerror(errno));
-                return -1;
-            }
+            memcpy(&ctrl, body + sizeof(ev.info), sizeof(ctrl));
             m_pLog->AddDisplayControlStruct(&ctrl, 2);
         }
 
@@ -512,33 +679,50 @@ public:
             return -1;
         }
 
-        frame_info_t frame = {.handle = handle, .ctrl = hasCtrl ? &ctrl : nullptr};
-        mHwcHandler(FRAME_DISPLAY, &frame);
-
-        ev.event.type = VHAL_DD_EVENT_DISPLAY_ACK;
-        ev.event.size = sizeof(ev);
-        len = send(fd, &ev, sizeof(ev), 0);
-        if (len <= 0) {
-            AIC_LOG(mDebug, "send() failed: %s\n", strerror(errno));
-            return -1;
+        // The ACK lets Android render into the buffer again: it goes out
+        // when the handler releases the token, right away for a HwcHandler.
+        auto mapping = FindMapping(handle);
+        if (mapping) {
+            mapping->BeginAccess();
+        }
+        auto generation = mEvents->BeginDisplay(mInfo.num_framebuffers);
+        frame_info_t frame = {.handle = handle, .ctrl = hasCtrl ? &ctrl : nullptr,
+                              .mapping = mapping ? mapping->View() : nullptr};
+        DisplayReleaseToken token(make_shared<DisplayReleaseToken::Pending>(
+          mEvents, generation, ev, move(mapping)));
+        if (mMailbox) {
+            mMailbox->Display(frame, move(token));
+        } else {
+            mHwcHandler(FRAME_DISPLAY, &frame, move(token));
+            ++mDelivered;
         }
-        m_pLog->LogGenericEventInfo(EVENT_DISPLAY_REQ_ACK);
-        m_pLog->AddBufferInfoEventStruct(&ev);
 
         return 0;
     }
 
     private:
+        // buffer_info_t, cros_gralloc_handle, then the 16 byte fd carrier.
+        static constexpr size_t kCreateBufferBody =
+          sizeof(buffer_info_t) + sizeof(cros_gralloc_handle) + 4 * sizeof(int);
+        static constexpr int kMaxDisplayBody = 4096;
+
         unique_ptr<IStreamSocketClient> socket_client_;
         struct ConfigInfo mInfo;
-        HwcHandler  mHwcHandler = nullptr;
+        AsyncHwcHandler mHwcHandler = nullptr;
         atomic<bool> should_continue_ = false;
         int renderNode = -1;
-        std::unique_ptr<std::thread> mWorkThread;
+        std::shared_ptr<Reactor> mReactor;
+        FramedReader mReader;
+        std::unique_ptr<StreamTalker> mTalker;
         int sockClientFd = -1;
         int mDebug = 2;
-        std::map<uint64_t, cros_gralloc_handle_t> mHandles;
-        std::unique_ptr<ProfileLogger> m_pLog;
+        HwcHandlePool mHandlePool;
+        HwcHandleTable mHandles;
+        std::unordered_map<cros_gralloc_handle_t, shared_ptr<HwcPlaneMapping>> mMappings;
+        std::shared_ptr<ProfileLogger> m_pLog;
+        std::shared_ptr<HwcEventChannel> mEvents;
+        std::unique_ptr<HwcMailbox> mMailbox;
+        std::atomic<uint64_t> mDelivered = 0;
 
 };
 }
@@ -0,0 +1,54 @@
+/**
+ * @file io_uring_queue.cc
+ * @brief
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "io_uring_queue.h"
+#include "io_uring_queue_impl.h"
+
+namespace vhal {
+namespace client {
+
+IoUringQueue::IoUringQueue(unsigned entries, unsigned max_files)
+  : impl_{ std::make_unique<Impl>(entries, max_files) }
+{}
+
+IoUringQueue::~IoUringQueue() = default;
+
+bool
+IoUringQueue::Available() const
+{
+    return impl_->Available();
+}
+
+bool
+IoUringQueue::RegisterBuffers(const struct iovec* iov, int count)
+{
+    return impl_->RegisterBuffers(iov, count);
+}
+
+void
+IoUringQueue::UnregisterBuffers()
+{
+    impl_->UnregisterBuffers();
+}
+
+} // namespace client
+} // namespace vhal
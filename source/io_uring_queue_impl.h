@@ -0,0 +1,423 @@
+/**
+ * @file io_uring_queue_impl.h
+ * @brief
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef IO_URING_QUEUE_IMPL_H
+#define IO_URING_QUEUE_IMPL_H
+
+#include "io_uring_queue.h"
+#include "receiver_log.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <vector>
+extern "C"
+{
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+}
+
+namespace vhal {
+namespace client {
+
+class IoUringQueue::Impl
+{
+public:
+    Impl(unsigned entries, unsigned max_files)
+    {
+        struct io_uring_params params = {};
+        ring_fd_ = syscall(__NR_io_uring_setup, entries, &params);
+        if (ring_fd_ < 0) {
+            AIC_LOG(LIBVHAL_WARNING, "io_uring unavailable, using plain sockets: %s",
+                    std::strerror(errno));
+            return;
+        }
+        if (!MapRings(params) || !ProbeOps()) {
+            AIC_LOG(LIBVHAL_WARNING, "io_uring setup incomplete, using plain sockets");
+            Release();
+            return;
+        }
+        // Sparse fixed file table, filled in as clients connect.
+        files_.assign(max_files, -1);
+        if (Register(IORING_REGISTER_FILES, files_.data(), files_.size()) != 0) {
+            files_.clear();
+        }
+    }
+
+    ~Impl() { Release(); }
+
+    Impl(const Impl&) = delete;
+    Impl& operator=(const Impl&) = delete;
+
+    bool Available() const { return ring_fd_ >= 0; }
+
+    bool FixedBuffersSupported() const { return fixed_buffers_; }
+
+    /**
+     * Returns the fixed file slot for fd, -1 if none is free.
+     */
+    int RegisterFile(int fd)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t slot = 0; slot < files_.size(); slot++) {
+            if (files_[slot] == -1 && UpdateFile(slot, fd)) {
+                files_[slot] = fd;
+                return slot;
+            }
+        }
+        return -1;
+    }
+
+    void UnregisterFile(int slot)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (slot >= 0 && (size_t)slot < files_.size()) {
+            UpdateFile(slot, -1);
+            files_[slot] = -1;
+        }
+    }
+
+    bool RegisterBuffers(const struct iovec* iov, int count)
+    {
+        if (!Available() || !fixed_buffers_) {
+            return false;
+        }
+        UnregisterBuffers();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (Register(IORING_REGISTER_BUFFERS, iov, count) != 0) {
+            AIC_LOG(LIBVHAL_ERROR, "io_uring buffer registration failed: %s", std::strerror(errno));
+            return false;
+        }
+        buffers_.assign(iov, iov + count);
+        return true;
+    }
+
+    void UnregisterBuffers()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!buffers_.empty()) {
+            Register(IORING_UNREGISTER_BUFFERS, nullptr, 0);
+            buffers_.clear();
+        }
+    }
+
+    /**
+     * Index of the registered buffer holding [data, data + size), -1 if none.
+     */
+    int FindBuffer(const void* data, size_t size) const
+    {
+        if (!fixed_send_) {
+            return -1;
+        }
+        auto p = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < buffers_.size(); i++) {
+            auto base = static_cast<const uint8_t*>(buffers_[i].iov_base);
+            if (p >= base && p + size <= base + buffers_[i].iov_len) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    // The kernel refused a fixed buffer send, stop asking.
+    void DisableFixedSend()
+    {
+        if (fixed_send_.exchange(false)) {
+            AIC_LOG(LIBVHAL_WARNING, "io_uring fixed buffer sends unsupported, copying instead");
+        }
+    }
+
+    /**
+     * Queues the SQE prepared by fill, submits it and waits for its
+     * completion.
+     *
+     * @return cqe res: the syscall result, -errno on failure.
+     */
+    template<typename Fill>
+    int32_t Execute(Fill fill)
+    {
+        Op                           op;
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (failed_) {
+            return -failed_;
+        }
+
+        struct io_uring_sqe* sqe;
+        while ((sqe = NextSqe()) == nullptr) {
+            // Submission queue full, push it to the kernel.
+            if (Enter(SqPending(), 0, 0) < 0 && errno != EAGAIN) {
+                return -errno;
+            }
+        }
+        memset(sqe, 0, sizeof(*sqe));
+        fill(sqe);
+        sqe->user_data = reinterpret_cast<uint64_t>(&op);
+        __atomic_store_n(sq_.tail, sq_tail_, __ATOMIC_RELEASE);
+
+        // From here on the ring points at op: don't leave before it is done
+        // or the ring failed, whatever the submission returns.
+        while (!op.done && !failed_) {
+            if (reaping_ && !submitting_ && SqPending() > 0) {
+                // Someone waits in the kernel and reaps for us, but only
+                // submits on its next round: submit for everyone queued by
+                // now, and for those queueing while we are at it, next time.
+                submitting_     = true;
+                unsigned submit = SqPending();
+                lock.unlock();
+                int err = 0;
+                if (Enter(submit, 0, 0) < 0 && errno != EINTR && errno != EAGAIN
+                    && errno != EBUSY) {
+                    err = errno;
+                }
+                lock.lock();
+                submitting_ = false;
+                if (err) {
+                    Fail(err);
+                }
+                reaped_.notify_all();
+                continue;
+            }
+            if (reaping_ || submitting_) {
+                reaped_.wait(lock);
+                continue;
+            }
+            // Become the reaper: submit what is pending and wait for any
+            // completion in the same syscall.
+            reaping_        = true;
+            unsigned submit = SqPending();
+            lock.unlock();
+            int err = 0;
+            if (Enter(submit, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR
+                && errno != EAGAIN && errno != EBUSY) {
+                err = errno;
+            }
+            lock.lock();
+            reaping_ = false;
+            if (err) {
+                Fail(err);
+            } else if (!failed_) {
+                ReapCompletions();
+            }
+            reaped_.notify_all();
+        }
+        return op.done ? op.res : -failed_;
+    }
+
+private:
+    struct Op
+    {
+        int32_t res  = 0;
+        bool    done = false;
+    };
+
+    struct SqRing
+    {
+        unsigned* head;
+        unsigned* tail;
+        unsigned* mask;
+        unsigned* array;
+    };
+
+    struct CqRing
+    {
+        unsigned*             head;
+        unsigned*             tail;
+        unsigned*             mask;
+        struct io_uring_cqe*  cqes;
+    };
+
+    int                   ring_fd_       = -1;
+    void*                 sq_map_        = MAP_FAILED;
+    size_t                sq_map_size_   = 0;
+    void*                 cq_map_        = MAP_FAILED;
+    size_t                cq_map_size_   = 0;
+    struct io_uring_sqe*  sqes_          = nullptr;
+    size_t                sqes_size_     = 0;
+    unsigned              sq_entries_    = 0;
+    unsigned              sq_tail_       = 0;
+    SqRing                sq_            = {};
+    CqRing                cq_            = {};
+    bool                  fixed_buffers_ = false;
+
+    std::mutex              mutex_;
+    std::condition_variable reaped_;
+    bool                    reaping_    = false;
+    bool                    submitting_ = false;
+    int                     failed_     = 0;
+    std::atomic<bool>       fixed_send_{ true };
+    std::vector<int>        files_;
+    std::vector<iovec>      buffers_;
+
+    bool MapRings(const struct io_uring_params& p)
+    {
+        sq_map_size_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_map_size_ = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+        bool single  = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) {
+            sq_map_size_ = std::max(sq_map_size_, cq_map_size_);
+        }
+        sq_map_ = mmap(nullptr, sq_map_size_, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+        if (sq_map_ == MAP_FAILED) {
+            return false;
+        }
+        if (single) {
+            cq_map_ = sq_map_;
+        } else {
+            cq_map_ = mmap(nullptr, cq_map_size_, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+            if (cq_map_ == MAP_FAILED) {
+                return false;
+            }
+        }
+        sqes_size_ = p.sq_entries * sizeof(struct io_uring_sqe);
+        void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            return false;
+        }
+        sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+        auto sq     = static_cast<uint8_t*>(sq_map_);
+        sq_.head    = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+        sq_.tail    = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sq_.mask    = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sq_.array   = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        sq_entries_ = p.sq_entries;
+        sq_tail_    = *sq_.tail;
+        // SQE i always sits in slot i of the index array.
+        for (unsigned i = 0; i < sq_entries_; i++) {
+            sq_.array[i] = i;
+        }
+
+        auto cq  = static_cast<uint8_t*>(cq_map_);
+        cq_.head = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cq_.tail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cq_.mask = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cq_.cqes = reinterpret_cast<struct io_uring_cqe*>(cq + p.cq_off.cqes);
+        return true;
+    }
+
+    bool ProbeOps()
+    {
+        const size_t len = sizeof(struct io_uring_probe)
+                           + 256 * sizeof(struct io_uring_probe_op);
+        std::vector<uint8_t> buf(len, 0);
+        auto probe = reinterpret_cast<struct io_uring_probe*>(buf.data());
+        if (Register(IORING_REGISTER_PROBE, probe, 256) != 0) {
+            return false;
+        }
+        auto supported = [probe](uint8_t op) {
+            return op <= probe->last_op
+                   && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+        };
+        fixed_buffers_ = supported(IORING_OP_READ_FIXED)
+                         && supported(IORING_OP_WRITE_FIXED);
+        return supported(IORING_OP_SEND) && supported(IORING_OP_RECV)
+               && supported(IORING_OP_SENDMSG);
+    }
+
+    // The ring is unusable: fail every op waiting on it, now and later.
+    // Nothing reaps it again, so late completions never touch the ops that
+    // are gone.
+    void Fail(int err)
+    {
+        AIC_LOG(LIBVHAL_ERROR, "io_uring_enter failed: %s", std::strerror(err));
+        failed_ = err;
+    }
+
+    struct io_uring_sqe* NextSqe()
+    {
+        unsigned head = __atomic_load_n(sq_.head, __ATOMIC_ACQUIRE);
+        if (sq_tail_ - head >= sq_entries_) {
+            return nullptr;
+        }
+        return &sqes_[sq_tail_++ & *sq_.mask];
+    }
+
+    unsigned SqPending() const
+    {
+        return sq_tail_ - __atomic_load_n(sq_.head, __ATOMIC_ACQUIRE);
+    }
+
+    void ReapCompletions()
+    {
+        unsigned head = *cq_.head;
+        unsigned tail = __atomic_load_n(cq_.tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            auto& cqe = cq_.cqes[head & *cq_.mask];
+            auto  op  = reinterpret_cast<Op*>(cqe.user_data);
+            op->res   = cqe.res;
+            op->done  = true;
+        }
+        __atomic_store_n(cq_.head, head, __ATOMIC_RELEASE);
+    }
+
+    int Enter(unsigned to_submit, unsigned min_complete, unsigned flags)
+    {
+        return syscall(__NR_io_uring_enter, ring_fd_, to_submit, min_complete,
+                       flags, nullptr, 0);
+    }
+
+    int Register(unsigned opcode, const void* arg, unsigned nr_args)
+    {
+        return syscall(__NR_io_uring_register, ring_fd_, opcode, arg, nr_args);
+    }
+
+    bool UpdateFile(unsigned slot, int fd)
+    {
+        struct io_uring_files_update update = {};
+        update.offset                       = slot;
+        update.fds                          = reinterpret_cast<uint64_t>(&fd);
+        return Register(IORING_REGISTER_FILES_UPDATE, &update, 1) == 1;
+    }
+
+    void Release()
+    {
+        if (sqes_) {
+            munmap(sqes_, sqes_size_);
+            sqes_ = nullptr;
+        }
+        if (cq_map_ != MAP_FAILED && cq_map_ != sq_map_) {
+            munmap(cq_map_, cq_map_size_);
+        }
+        cq_map_ = MAP_FAILED;
+        if (sq_map_ != MAP_FAILED) {
+            munmap(sq_map_, sq_map_size_);
+            sq_map_ = MAP_FAILED;
+        }
+        if (ring_fd_ >= 0) {
+            close(ring_fd_);
+            ring_fd_ = -1;
+        }
+    }
+};
+
+} // namespace client
+} // namespace vhal
+
+#endif /* IO_URING_QUEUE_IMPL_H */
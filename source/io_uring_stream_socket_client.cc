@@ -0,0 +1,105 @@
+/**
+ * @file io_uring_stream_socket_client.cc
+ * @brief
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "io_uring_stream_socket_client.h"
+#include "io_uring_stream_socket_client_impl.h"
+
+namespace vhal {
+namespace client {
+IoUringStreamSocketClient::IoUringStreamSocketClient(
+  std::unique_ptr<IStreamSocketClient> transport,
+  std::shared_ptr<IoUringQueue>        queue)
+{
+    auto ring = queue->impl_.get();
+    impl_ = std::make_unique<Impl>(std::move(transport), std::move(queue), ring);
+}
+
+IoUringStreamSocketClient::~IoUringStreamSocketClient() = default;
+
+ConnectionResult
+IoUringStreamSocketClient::Connect()
+{
+    return impl_->Connect();
+}
+
+bool
+IoUringStreamSocketClient::Connected() const
+{
+    return impl_->Connected();
+}
+
+int
+IoUringStreamSocketClient::GetNativeSocketFd() const
+{
+    return impl_->GetNativeSocketFd();
+}
+
+std::string
+IoUringStreamSocketClient::GetRemotePath() const
+{
+    return impl_->GetRemotePath();
+}
+
+IOResult
+IoUringStreamSocketClient::Send(const uint8_t* data, size_t size)
+{
+    return ToIOResult(SendNoAlloc(data, size));
+}
+
+IOResult
+IoUringStreamSocketClient::SendV(const struct iovec* iov, int iovcnt)
+{
+    return ToIOResult(SendVNoAlloc(iov, iovcnt));
+}
+
+IOResult
+IoUringStreamSocketClient::Recv(uint8_t* data, size_t size, uint8_t flag)
+{
+    return ToIOResult(RecvNoAlloc(data, size, flag));
+}
+
+IOStatus
+IoUringStreamSocketClient::SendNoAlloc(const uint8_t* data, size_t size)
+{
+    return impl_->Send(data, size);
+}
+
+IOStatus
+IoUringStreamSocketClient::SendVNoAlloc(const struct iovec* iov, int iovcnt)
+{
+    return impl_->SendV(iov, iovcnt);
+}
+
+IOStatus
+IoUringStreamSocketClient::RecvNoAlloc(uint8_t* data, size_t size, uint8_t flag)
+{
+    return impl_->Recv(data, size, flag);
+}
+
+void
+IoUringStreamSocketClient::Close()
+{
+    impl_->Close();
+}
+
+} // namespace client
+} // namespace vhal
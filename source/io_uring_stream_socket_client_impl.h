@@ -0,0 +1,194 @@
+/**
+ * @file io_uring_stream_socket_client_impl.h
+ * @brief
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef IO_URING_STREAM_SOCKET_CLIENT_IMPL_H
+#define IO_URING_STREAM_SOCKET_CLIENT_IMPL_H
+
+#include "io_uring_queue_impl.h"
+#include "io_uring_stream_socket_client.h"
+#include "receiver_log.h"
+#include "sendv_util.h"
+#include <atomic>
+#include <cstring>
+#include <vector>
+extern "C"
+{
+#include <linux/io_uring.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+}
+
+namespace vhal {
+namespace client {
+
+class IoUringStreamSocketClient::Impl
+{
+public:
+    Impl(std::unique_ptr<IStreamSocketClient> transport,
+         std::shared_ptr<IoUringQueue>        queue,
+         IoUringQueue::Impl*                  ring)
+      : transport_{ std::move(transport) },
+        queue_{ std::move(queue) },
+        ring_{ ring->Available() ? ring : nullptr }
+    {}
+    ~Impl() { Close(); }
+    Impl(Impl &) = delete;
+    Impl& operator = (Impl &) = delete;
+
+    ConnectionResult Connect()
+    {
+        ReleaseSlot();
+        auto result = transport_->Connect();
+        if (std::get<0>(result) && ring_) {
+            fd_   = transport_->GetNativeSocketFd();
+            slot_ = ring_->RegisterFile(fd_);
+        }
+        return result;
+    }
+
+    bool Connected() const { return transport_->Connected(); }
+
+    int GetNativeSocketFd() const { return transport_->GetNativeSocketFd(); }
+
+    std::string GetRemotePath() const { return transport_->GetRemotePath(); }
+
+    IOStatus Send(const uint8_t* data, size_t size)
+    {
+        if (!ring_) {
+            return transport_->SendNoAlloc(data, size);
+        }
+        // A socket op either way, so that a hang up is EPIPE, not SIGPIPE.
+        auto send = [&](int index) {
+            return ring_->Execute([&](struct io_uring_sqe* sqe) {
+                SetFile(sqe);
+                sqe->opcode    = IORING_OP_SEND;
+                sqe->addr      = reinterpret_cast<uint64_t>(data);
+                sqe->len       = size;
+                sqe->msg_flags = MSG_NOSIGNAL;
+                if (index >= 0) {
+                    sqe->ioprio    = IORING_RECVSEND_FIXED_BUF;
+                    sqe->buf_index = index;
+                }
+            });
+        };
+        int     index = ring_->FindBuffer(data, size);
+        int32_t res   = send(index);
+        if (res == -EINVAL && index >= 0) {
+            // The kernel predates fixed buffer sends.
+            ring_->DisableFixedSend();
+            res = send(-1);
+        }
+        return ToIOStatus("Send", res);
+    }
+
+    IOStatus SendV(const struct iovec* iov, int iovcnt)
+    {
+        if (!ring_) {
+            return transport_->SendVNoAlloc(iov, iovcnt);
+        }
+
+        // Same short write handling as the plain socket clients.
+        SendVProgress progress = SendMsgAll(iov, iovcnt, [this](struct msghdr* msg) -> ssize_t {
+            return ring_->Execute([&](struct io_uring_sqe* sqe) {
+                SetFile(sqe);
+                sqe->opcode    = IORING_OP_SENDMSG;
+                sqe->addr      = reinterpret_cast<uint64_t>(msg);
+                sqe->len       = 1;
+                sqe->msg_flags = MSG_NOSIGNAL;
+            });
+        });
+        if (progress.error) {
+            return ToIOStatus("SendV", -progress.error);
+        }
+        return { static_cast<ssize_t>(progress.sent), {} };
+    }
+
+    IOStatus Recv(uint8_t* data, size_t size, uint8_t flag)
+    {
+        if (!ring_) {
+            return transport_->RecvNoAlloc(data, size, flag);
+        }
+        // Plain RECV even into registered buffers: there is no fixed buffer
+        // receive that honours the recv() flags.
+        int32_t res = ring_->Execute([&](struct io_uring_sqe* sqe) {
+            SetFile(sqe);
+            sqe->opcode    = IORING_OP_RECV;
+            sqe->addr      = reinterpret_cast<uint64_t>(data);
+            sqe->len       = size;
+            sqe->msg_flags = flag;
+        });
+        return ToIOStatus("Recv", res);
+    }
+
+    void Close()
+    {
+        ReleaseSlot();
+        transport_->Close();
+    }
+
+private:
+    std::unique_ptr<IStreamSocketClient> transport_;
+    // Keeps ring_ alive.
+    std::shared_ptr<IoUringQueue>        queue_;
+    IoUringQueue::Impl*                  ring_;
+    std::atomic<int>                     fd_{ -1 };
+    std::atomic<int>                     slot_{ -1 };
+
+    void SetFile(struct io_uring_sqe* sqe) const
+    {
+        int slot = slot_;
+        if (slot >= 0) {
+            sqe->fd = slot;
+            sqe->flags |= IOSQE_FIXED_FILE;
+        } else {
+            sqe->fd = transport_->GetNativeSocketFd();
+        }
+    }
+
+    void ReleaseSlot()
+    {
+        int slot = slot_.exchange(-1);
+        if (slot >= 0) {
+            ring_->UnregisterFile(slot);
+        }
+        fd_ = -1;
+    }
+
+    IOStatus ToIOStatus(const char* op, int32_t res) const
+    {
+        if (res < 0) {
+            if (res != -EAGAIN) {
+                AIC_LOG(LIBVHAL_ERROR, "%s() args: fd: %d, io_uring error: %s", op, fd_.load(),
+                        std::strerror(-res));
+            }
+            // Callers tell EAGAIN apart like after a plain recv().
+            errno = -res;
+            return { -1, std::error_code(-res, std::system_category()) };
+        }
+        return { res, {} };
+    }
+};
+
+} // namespace client
+} // namespace vhal
+
+#endif /* IO_URING_STREAM_SOCKET_CLIENT_IMPL_H */
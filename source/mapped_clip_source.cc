@@ -0,0 +1,60 @@
+/**
+ * @file mapped_clip_source.cc
+ * @brief Loops an H.264/H.265 clip from a shared memory mapping
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "mapped_clip_source.h"
+#include "mapped_clip_source_impl.h"
+
+namespace vhal {
+namespace client {
+
+MappedClipSource::MappedClipSource(const std::string& path, AnnexBPacketizer::Codec codec)
+  : impl_{ std::make_unique<Impl>(path, codec) }
+{}
+
+MappedClipSource::~MappedClipSource() = default;
+
+AnnexBPacketizer::access_unit_t
+MappedClipSource::Next()
+{
+    return impl_->Next();
+}
+
+void
+MappedClipSource::SeekToKeyFrame(size_t frame)
+{
+    impl_->SeekToKeyFrame(frame);
+}
+
+size_t
+MappedClipSource::FrameCount() const
+{
+    return impl_->FrameCount();
+}
+
+uint64_t
+MappedClipSource::Loops() const
+{
+    return impl_->Loops();
+}
+
+} // namespace client
+} // namespace vhal
@@ -0,0 +1,217 @@
+/**
+ * @file mapped_clip_source_impl.h
+ * @brief Loops an H.264/H.265 clip from a shared memory mapping
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MAPPED_CLIP_SOURCE_IMPL_H
+#define MAPPED_CLIP_SOURCE_IMPL_H
+
+#include "annexb_packetizer_impl.h"
+#include "mapped_clip_source.h"
+#include <algorithm>
+#include <cerrno>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+#include <tuple>
+#include <vector>
+extern "C"
+{
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+}
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief A clip mapped in memory and its access unit index. Shared by all
+ * the sources playing the same file, read-only once built.
+ */
+class MappedClip
+{
+public:
+    using Range = AccessUnitSplitter::Range;
+
+    ~MappedClip()
+    {
+        if (data_) {
+            munmap(const_cast<uint8_t*>(data_), size_);
+        }
+    }
+
+    /**
+     * @brief Returns the mapping of path, creating it if no source holds it.
+     */
+    static std::shared_ptr<MappedClip> Open(const std::string&      path,
+                                            AnnexBPacketizer::Codec codec)
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::system_error(errno, std::system_category(), "open " + path);
+        }
+        struct stat st;
+        if (fstat(fd, &st) < 0) {
+            int error = errno;
+            close(fd);
+            throw std::system_error(error, std::system_category(), "stat " + path);
+        }
+
+        // The same file, unless it was rewritten in the meantime.
+        Key key{ st.st_dev, st.st_ino, st.st_size, st.st_mtim.tv_sec,
+                 st.st_mtim.tv_nsec, codec };
+        std::lock_guard<std::mutex> lock(RegistryMutex());
+        auto&                       registry = Registry();
+        if (auto it = registry.find(key); it != registry.end()) {
+            if (auto clip = it->second.lock()) {
+                close(fd);
+                return clip;
+            }
+        }
+
+        auto clip = std::shared_ptr<MappedClip>(new MappedClip());
+        clip->Map(fd, st.st_size, path);
+        close(fd);
+        clip->BuildIndex(codec, path);
+        registry[key] = clip;
+        // Forget clips nobody plays any more.
+        for (auto it = registry.begin(); it != registry.end();) {
+            it = it->second.expired() ? registry.erase(it) : std::next(it);
+        }
+        return clip;
+    }
+
+    const uint8_t* Data() const { return data_; }
+
+    const std::vector<Range>& Index() const { return index_; }
+
+    const std::vector<size_t>& KeyFrames() const { return key_frames_; }
+
+private:
+    using Key = std::tuple<dev_t, ino_t, off_t, time_t, long, AnnexBPacketizer::Codec>;
+
+    const uint8_t*      data_ = nullptr;
+    size_t              size_ = 0;
+    std::vector<Range>  index_;
+    std::vector<size_t> key_frames_;
+
+    MappedClip() = default;
+
+    static std::mutex& RegistryMutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    static std::map<Key, std::weak_ptr<MappedClip>>& Registry()
+    {
+        static std::map<Key, std::weak_ptr<MappedClip>> registry;
+        return registry;
+    }
+
+    void Map(int fd, off_t size, const std::string& path)
+    {
+        if (size <= 0) {
+            close(fd);
+            throw std::invalid_argument("Empty clip: " + path);
+        }
+        void* addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            int error = errno;
+            close(fd);
+            throw std::system_error(error, std::system_category(), "mmap " + path);
+        }
+        data_ = static_cast<const uint8_t*>(addr);
+        size_ = size;
+        // Clips are small and played over and over, read them in once.
+        madvise(addr, size_, MADV_WILLNEED);
+    }
+
+    void BuildIndex(AnnexBPacketizer::Codec codec, const std::string& path)
+    {
+        AccessUnitSplitter splitter(codec);
+        splitter.Finish(data_, size_);
+        auto& ready = splitter.Ready();
+        index_.assign(ready.begin(), ready.end());
+        if (index_.empty()) {
+            throw std::invalid_argument("No access unit found in " + path);
+        }
+        for (size_t i = 0; i < index_.size(); i++) {
+            if (index_[i].key_frame) {
+                key_frames_.push_back(i);
+            }
+        }
+    }
+};
+
+class MappedClipSource::Impl
+{
+public:
+    Impl(const std::string& path, AnnexBPacketizer::Codec codec)
+      : clip_{ MappedClip::Open(path, codec) }
+    {
+        SeekToKeyFrame(0);
+    }
+
+    AnnexBPacketizer::access_unit_t Next()
+    {
+        const auto& index = clip_->Index();
+        if (next_ >= index.size()) {
+            // Frames before the first key frame cannot be decoded on their
+            // own, only play them once.
+            next_ = FirstKeyFrame();
+            loops_++;
+        }
+        const auto& range = index[next_++];
+        return { clip_->Data() + range.offset, range.size, range.key_frame,
+                 range.parameter_sets };
+    }
+
+    void SeekToKeyFrame(size_t frame)
+    {
+        frame            = frame % clip_->Index().size();
+        const auto& keys = clip_->KeyFrames();
+        auto        it   = std::upper_bound(keys.begin(), keys.end(), frame);
+        next_            = it == keys.begin() ? (frame == 0 ? 0 : FirstKeyFrame()) : *(it - 1);
+    }
+
+    size_t FrameCount() const { return clip_->Index().size(); }
+
+    uint64_t Loops() const { return loops_; }
+
+private:
+    std::shared_ptr<MappedClip> clip_;
+    size_t                      next_  = 0;
+    uint64_t                    loops_ = 0;
+
+    size_t FirstKeyFrame() const
+    {
+        const auto& keys = clip_->KeyFrames();
+        return keys.empty() ? 0 : keys.front();
+    }
+};
+
+} // namespace client
+} // namespace vhal
+
+#endif /* MAPPED_CLIP_SOURCE_IMPL_H */
@@ -0,0 +1,245 @@
+/**
+ * @file pixel_convert.cc
+ * @brief Conversion of raw camera images to I420
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "pixel_convert.h"
+#include "pixel_convert_kernels.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+namespace vhal {
+namespace client {
+
+namespace {
+
+struct Kernels
+{
+    void (*split_uv)(const uint8_t*, uint8_t*, uint8_t*, size_t);
+    void (*packed_to_y)(const uint8_t*, uint8_t*, size_t, int);
+    void (*packed_to_uv)(const uint8_t*, const uint8_t*, uint8_t*, uint8_t*, size_t, int);
+    void (*rgba_to_y)(const uint8_t*, uint8_t*, size_t);
+    void (*rgba_to_uv)(const uint8_t*, const uint8_t*, uint8_t*, uint8_t*, size_t);
+    void (*rgb24_to_rgba)(const uint8_t*, uint8_t*, size_t);
+    void (*halve_rows)(const uint8_t*, const uint8_t*, uint8_t*, size_t);
+};
+
+constexpr Kernels kScalarKernels = {
+    kernels::SplitUVScalar,    kernels::PackedToYScalar,   kernels::PackedToUVScalar,
+    kernels::RgbaToYScalar,    kernels::RgbaToUVScalar,    kernels::Rgb24ToRgbaScalar,
+    kernels::HalveRowsScalar,
+};
+
+#ifdef LIBVHAL_X86_SIMD
+constexpr Kernels kSse41Kernels = {
+    kernels::SplitUVSse41,     kernels::PackedToYSse41,    kernels::PackedToUVSse41,
+    kernels::RgbaToYSse41,     kernels::RgbaToUVSse41,     kernels::Rgb24ToRgbaSse41,
+    kernels::HalveRowsSse41,
+};
+
+// RGB24 expansion gains nothing from wider registers.
+constexpr Kernels kAvx2Kernels = {
+    kernels::SplitUVAvx2,      kernels::PackedToYAvx2,     kernels::PackedToUVAvx2,
+    kernels::RgbaToYAvx2,      kernels::RgbaToUVAvx2,      kernels::Rgb24ToRgbaSse41,
+    kernels::HalveRowsAvx2,
+};
+#endif
+
+SimdLevel
+SupportedSimdLevel()
+{
+#ifdef LIBVHAL_X86_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdLevel::kAvx2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return SimdLevel::kSse41;
+    }
+#endif
+    return SimdLevel::kScalar;
+}
+
+const Kernels*
+KernelsFor(SimdLevel level)
+{
+#ifdef LIBVHAL_X86_SIMD
+    switch (level) {
+        case SimdLevel::kAvx2:
+            return &kAvx2Kernels;
+        case SimdLevel::kSse41:
+            return &kSse41Kernels;
+        case SimdLevel::kScalar:
+            break;
+    }
+#endif
+    return &kScalarKernels;
+}
+
+// Switched by SetPixelConvertSimdLevel() while other threads convert.
+std::atomic<const Kernels*> active_kernels{ KernelsFor(SupportedSimdLevel()) };
+
+size_t
+BytesPerPixel(PixelFormat format)
+{
+    switch (format) {
+        case PixelFormat::kNV12:
+            return 1;
+        case PixelFormat::kYUYV:
+        case PixelFormat::kUYVY:
+            return 2;
+        case PixelFormat::kRGB24:
+            return 3;
+        case PixelFormat::kRGBA:
+            return 4;
+    }
+    return 0;
+}
+
+/**
+ * Produces full resolution I420 rows of a source image, two luma rows and
+ * the chroma row they share at a time.
+ */
+class RowPairConverter
+{
+public:
+    RowPairConverter(const raw_image_t& image, const Kernels& k)
+      : image_{ image }, k_{ k }, width_{ image.width }
+    {
+        const size_t bpp = BytesPerPixel(image.format);
+        stride_[0] = image.stride[0] ? image.stride[0] : width_ * bpp;
+        stride_[1] = image.stride[1] ? image.stride[1] : width_;
+        if (image.format == PixelFormat::kRGB24) {
+            rgba_[0].resize(width_ * 4);
+            rgba_[1].resize(width_ * 4);
+        }
+    }
+
+    // Luma rows 2 * pair and 2 * pair + 1, chroma row pair.
+    void Convert(uint32_t pair, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v)
+    {
+        const uint8_t* r0 = image_.data[0] + 2 * pair * stride_[0];
+        const uint8_t* r1 = r0 + stride_[0];
+        switch (image_.format) {
+            case PixelFormat::kNV12:
+                std::memcpy(y0, r0, width_);
+                std::memcpy(y1, r1, width_);
+                k_.split_uv(image_.data[1] + pair * stride_[1], u, v, width_ / 2);
+                break;
+            case PixelFormat::kYUYV:
+            case PixelFormat::kUYVY: {
+                const int y_offset = image_.format == PixelFormat::kUYVY;
+                k_.packed_to_y(r0, y0, width_, y_offset);
+                k_.packed_to_y(r1, y1, width_, y_offset);
+                k_.packed_to_uv(r0, r1, u, v, width_, y_offset);
+                break;
+            }
+            case PixelFormat::kRGB24:
+                k_.rgb24_to_rgba(r0, rgba_[0].data(), width_);
+                k_.rgb24_to_rgba(r1, rgba_[1].data(), width_);
+                r0 = rgba_[0].data();
+                r1 = rgba_[1].data();
+                [[fallthrough]];
+            case PixelFormat::kRGBA:
+                k_.rgba_to_y(r0, y0, width_);
+                k_.rgba_to_y(r1, y1, width_);
+                k_.rgba_to_uv(r0, r1, u, v, width_);
+                break;
+        }
+    }
+
+private:
+    const raw_image_t&   image_;
+    const Kernels&       k_;
+    const size_t         width_;
+    size_t               stride_[2];
+    std::vector<uint8_t> rgba_[2];
+};
+
+} // namespace
+
+size_t
+I420FrameSize(uint32_t width, uint32_t height, bool downscale)
+{
+    const uint32_t align = downscale ? 4 : 2;
+    if (width == 0 || height == 0 || width % align || height % align) {
+        return 0;
+    }
+    if (downscale) {
+        width /= 2;
+        height /= 2;
+    }
+    return size_t(width) * height * 3 / 2;
+}
+
+size_t
+ConvertToI420(const raw_image_t& image, uint8_t* dst, size_t dst_size, bool downscale)
+{
+    const size_t size = I420FrameSize(image.width, image.height, downscale);
+    if (size == 0 || size > dst_size || !dst || !image.data[0]
+        || (image.format == PixelFormat::kNV12 && !image.data[1])) {
+        return 0;
+    }
+
+    const Kernels&   k     = *active_kernels.load(std::memory_order_acquire);
+    const uint32_t   scale = downscale ? 2 : 1;
+    const size_t     out_w = image.width / scale;
+    const size_t     out_h = image.height / scale;
+    uint8_t*         y     = dst;
+    uint8_t*         u     = y + out_w * out_h;
+    uint8_t*         v     = u + out_w * out_h / 4;
+    RowPairConverter rows(image, k);
+
+    if (!downscale) {
+        for (uint32_t pair = 0; pair < out_h / 2; ++pair) {
+            rows.Convert(pair, y + 2 * pair * out_w, y + (2 * pair + 1) * out_w,
+                         u + pair * out_w / 2, v + pair * out_w / 2);
+        }
+        return size;
+    }
+
+    // Two full resolution row pairs make one output row pair.
+    const size_t         w = image.width;
+    std::vector<uint8_t> tmp(w * 4 + w * 2);
+    uint8_t*             ty[4] = { &tmp[0], &tmp[w], &tmp[2 * w], &tmp[3 * w] };
+    uint8_t*             tu[2] = { &tmp[4 * w], &tmp[4 * w + w / 2] };
+    uint8_t*             tv[2] = { &tmp[5 * w], &tmp[5 * w + w / 2] };
+    for (uint32_t pair = 0; pair < out_h / 2; ++pair) {
+        rows.Convert(2 * pair, ty[0], ty[1], tu[0], tv[0]);
+        rows.Convert(2 * pair + 1, ty[2], ty[3], tu[1], tv[1]);
+        k.halve_rows(ty[0], ty[1], y + 2 * pair * out_w, out_w);
+        k.halve_rows(ty[2], ty[3], y + (2 * pair + 1) * out_w, out_w);
+        k.halve_rows(tu[0], tu[1], u + pair * out_w / 2, out_w / 2);
+        k.halve_rows(tv[0], tv[1], v + pair * out_w / 2, out_w / 2);
+    }
+    return size;
+}
+
+SimdLevel
+SetPixelConvertSimdLevel(SimdLevel max)
+{
+    SimdLevel level = std::min(max, SupportedSimdLevel());
+    active_kernels.store(KernelsFor(level), std::memory_order_release);
+    return level;
+}
+
+} // namespace client
+} // namespace vhal
@@ -0,0 +1,454 @@
+/**
+ * @file pixel_convert_kernels.h
+ * @brief Row kernels of the I420 conversion
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef PIXEL_CONVERT_KERNELS_H
+#define PIXEL_CONVERT_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define LIBVHAL_X86_SIMD 1
+#endif
+
+namespace vhal {
+namespace client {
+
+/**
+ * Every kernel converts one row, or one pair of rows for chroma. The SIMD
+ * versions run the bulk of the row and leave the tail to the scalar ones,
+ * which they match bit for bit: rounding averages everywhere, and RGB
+ * coefficients small enough for pmaddubsw (7 bit for Y, 8 bit for U/V).
+ */
+namespace kernels {
+
+inline uint8_t
+Avg(uint8_t a, uint8_t b)
+{
+    return (a + b + 1) >> 1;
+}
+
+inline uint8_t
+RgbToY(int r, int g, int b)
+{
+    return ((33 * r + 64 * g + 13 * b + 64) >> 7) + 16;
+}
+
+inline uint8_t
+RgbToU(int r, int g, int b)
+{
+    return ((112 * b - 74 * g - 38 * r + 128) >> 8) + 128;
+}
+
+inline uint8_t
+RgbToV(int r, int g, int b)
+{
+    return ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+}
+
+// NV12 chroma: n interleaved U/V pairs to planar.
+inline void
+SplitUVScalar(const uint8_t* uv, uint8_t* u, uint8_t* v, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        u[i] = uv[2 * i];
+        v[i] = uv[2 * i + 1];
+    }
+}
+
+// YUYV (y_offset 0) or UYVY (y_offset 1) luma of w pixels.
+inline void
+PackedToYScalar(const uint8_t* src, uint8_t* y, size_t w, int y_offset)
+{
+    for (size_t i = 0; i < w; ++i) {
+        y[i] = src[2 * i + y_offset];
+    }
+}
+
+// YUYV/UYVY chroma of two rows of w pixels, averaged vertically.
+inline void
+PackedToUVScalar(const uint8_t* r0, const uint8_t* r1, uint8_t* u, uint8_t* v,
+                 size_t w, int y_offset)
+{
+    const int c = 1 - y_offset;
+    for (size_t i = 0; i < w / 2; ++i) {
+        u[i] = Avg(r0[4 * i + c], r1[4 * i + c]);
+        v[i] = Avg(r0[4 * i + c + 2], r1[4 * i + c + 2]);
+    }
+}
+
+inline void
+RgbaToYScalar(const uint8_t* rgba, uint8_t* y, size_t w)
+{
+    for (size_t i = 0; i < w; ++i) {
+        y[i] = RgbToY(rgba[4 * i], rgba[4 * i + 1], rgba[4 * i + 2]);
+    }
+}
+
+// Chroma of each 2x2 block of two RGBA rows of w pixels.
+inline void
+RgbaToUVScalar(const uint8_t* r0, const uint8_t* r1, uint8_t* u, uint8_t* v, size_t w)
+{
+    for (size_t i = 0; i < w / 2; ++i) {
+        int c[3];
+        for (int ch = 0; ch < 3; ++ch) {
+            c[ch] = Avg(Avg(r0[8 * i + ch], r1[8 * i + ch]),
+                        Avg(r0[8 * i + 4 + ch], r1[8 * i + 4 + ch]));
+        }
+        u[i] = RgbToU(c[0], c[1], c[2]);
+        v[i] = RgbToV(c[0], c[1], c[2]);
+    }
+}
+
+inline void
+Rgb24ToRgbaScalar(const uint8_t* rgb, uint8_t* rgba, size_t w)
+{
+    for (size_t i = 0; i < w; ++i) {
+        rgba[4 * i]     = rgb[3 * i];
+        rgba[4 * i + 1] = rgb[3 * i + 1];
+        rgba[4 * i + 2] = rgb[3 * i + 2];
+        rgba[4 * i + 3] = 0;
+    }
+}
+
+// 2x2 box filter of two rows into out_w samples.
+inline void
+HalveRowsScalar(const uint8_t* r0, const uint8_t* r1, uint8_t* out, size_t out_w)
+{
+    for (size_t i = 0; i < out_w; ++i) {
+        out[i] = Avg(Avg(r0[2 * i], r1[2 * i]), Avg(r0[2 * i + 1], r1[2 * i + 1]));
+    }
+}
+
+#ifdef LIBVHAL_X86_SIMD
+#define LIBVHAL_SSE41 __attribute__((target("sse4.1")))
+#define LIBVHAL_AVX2 __attribute__((target("avx2")))
+
+LIBVHAL_SSE41 inline __m128i
+Load128(const uint8_t* p)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+LIBVHAL_SSE41 inline void
+Store128(uint8_t* p, __m128i v)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+}
+
+// Even (odd = false) or odd bytes of each 16 bit word, zero extended.
+LIBVHAL_SSE41 inline __m128i
+Bytes128(__m128i v, bool odd)
+{
+    return odd ? _mm_srli_epi16(v, 8) : _mm_and_si128(v, _mm_set1_epi16(0x00ff));
+}
+
+LIBVHAL_SSE41 inline __m128i
+ShufflePs128(__m128i a, __m128i b, bool odd)
+{
+    return _mm_castps_si128(
+      odd ? _mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), 0xdd)
+          : _mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), 0x88));
+}
+
+// ((sum + round) >> shift) + offset for 8 signed 16 bit sums.
+LIBVHAL_SSE41 inline __m128i
+Scale128(__m128i sum, int round, int shift, int offset)
+{
+    sum = _mm_srai_epi16(_mm_add_epi16(sum, _mm_set1_epi16(round)), shift);
+    return _mm_add_epi16(sum, _mm_set1_epi16(offset));
+}
+
+LIBVHAL_SSE41 inline void
+SplitUVSse41(const uint8_t* uv, uint8_t* u, uint8_t* v, size_t n)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = Load128(uv + 2 * i);
+        __m128i b = Load128(uv + 2 * i + 16);
+        Store128(u + i, _mm_packus_epi16(Bytes128(a, false), Bytes128(b, false)));
+        Store128(v + i, _mm_packus_epi16(Bytes128(a, true), Bytes128(b, true)));
+    }
+    SplitUVScalar(uv + 2 * i, u + i, v + i, n - i);
+}
+
+LIBVHAL_SSE41 inline void
+PackedToYSse41(const uint8_t* src, uint8_t* y, size_t w, int y_offset)
+{
+    size_t i = 0;
+    for (; i + 16 <= w; i += 16) {
+        __m128i a = Load128(src + 2 * i);
+        __m128i b = Load128(src + 2 * i + 16);
+        Store128(y + i, _mm_packus_epi16(Bytes128(a, y_offset), Bytes128(b, y_offset)));
+    }
+    PackedToYScalar(src + 2 * i, y + i, w - i, y_offset);
+}
+
+LIBVHAL_SSE41 inline void
+PackedToUVSse41(const uint8_t* r0, const uint8_t* r1, uint8_t* u, uint8_t* v,
+                size_t w, int y_offset)
+{
+    const bool c_odd = y_offset == 0;
+    size_t     i     = 0;
+    for (; i + 32 <= w; i += 32) {
+        __m128i a[4];
+        for (int k = 0; k < 4; ++k) {
+            a[k] = Bytes128(_mm_avg_epu8(Load128(r0 + 2 * i + 16 * k),
+                                         Load128(r1 + 2 * i + 16 * k)),
+                            c_odd);
+        }
+        __m128i c0 = _mm_packus_epi16(a[0], a[1]);
+        __m128i c1 = _mm_packus_epi16(a[2], a[3]);
+        Store128(u + i / 2, _mm_packus_epi16(Bytes128(c0, false), Bytes128(c1, false)));
+        Store128(v + i / 2, _mm_packus_epi16(Bytes128(c0, true), Bytes128(c1, true)));
+    }
+    PackedToUVScalar(r0 + 2 * i, r1 + 2 * i, u + i / 2, v + i / 2, w - i, y_offset);
+}
+
+LIBVHAL_SSE41 inline void
+RgbaToYSse41(const uint8_t* rgba, uint8_t* y, size_t w)
+{
+    const __m128i coef = _mm_set1_epi32(0x000d4021); // 33, 64, 13, 0
+    size_t        i    = 0;
+    for (; i + 16 <= w; i += 16) {
+        __m128i m[4];
+        for (int k = 0; k < 4; ++k) {
+            m[k] = _mm_maddubs_epi16(Load128(rgba + 4 * i + 16 * k), coef);
+        }
+        __m128i y0 = Scale128(_mm_hadd_epi16(m[0], m[1]), 64, 7, 16);
+        __m128i y1 = Scale128(_mm_hadd_epi16(m[2], m[3]), 64, 7, 16);
+        Store128(y + i, _mm_packus_epi16(y0, y1));
+    }
+    RgbaToYScalar(rgba + 4 * i, y + i, w - i);
+}
+
+LIBVHAL_SSE41 inline void
+RgbaToUVSse41(const uint8_t* r0, const uint8_t* r1, uint8_t* u, uint8_t* v, size_t w)
+{
+    const __m128i coef_u = _mm_set1_epi32(0x0070b6da); // -38, -74, 112, 0
+    const __m128i coef_v = _mm_set1_epi32(0x00eea270); // 112, -94, -18, 0
+    size_t        i      = 0;
+    for (; i + 16 <= w; i += 16) {
+        __m128i r[4];
+        for (int k = 0; k < 4; ++k) {
+            r[k] = _mm_avg_epu8(Load128(r0 + 4 * i + 16 * k), Load128(r1 + 4 * i + 16 * k));
+        }
+        __m128i p0 = _mm_avg_epu8(ShufflePs128(r[0], r[1], false), ShufflePs128(r[0], r[1], true));
+        __m128i p1 = _mm_avg_epu8(ShufflePs128(r[2], r[3], false), ShufflePs128(r[2], r[3], true));
+        __m128i su = Scale128(_mm_hadd_epi16(_mm_maddubs_epi16(p0, coef_u),
+                                             _mm_maddubs_epi16(p1, coef_u)),
+                              128, 8, 128);
+        __m128i sv = Scale128(_mm_hadd_epi16(_mm_maddubs_epi16(p0, coef_v),
+                                             _mm_maddubs_epi16(p1, coef_v)),
+                              128, 8, 128);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(u + i / 2), _mm_packus_epi16(su, su));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(v + i / 2), _mm_packus_epi16(sv, sv));
+    }
+    RgbaToUVScalar(r0 + 4 * i, r1 + 4 * i, u + i / 2, v + i / 2, w - i);
+}
+
+LIBVHAL_SSE41 inline void
+Rgb24ToRgbaSse41(const uint8_t* rgb, uint8_t* rgba, size_t w)
+{
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    size_t        i       = 0;
+    // Each load reads 4 bytes past the 4 pixels it expands.
+    for (; 3 * i + 16 <= 3 * w; i += 4) {
+        Store128(rgba + 4 * i, _mm_shuffle_epi8(Load128(rgb + 3 * i), shuffle));
+    }
+    Rgb24ToRgbaScalar(rgb + 3 * i, rgba + 4 * i, w - i);
+}
+
+LIBVHAL_SSE41 inline void
+HalveRowsSse41(const uint8_t* r0, const uint8_t* r1, uint8_t* out, size_t out_w)
+{
+    size_t i = 0;
+    for (; i + 16 <= out_w; i += 16) {
+        __m128i a = _mm_avg_epu8(Load128(r0 + 2 * i), Load128(r1 + 2 * i));
+        __m128i b = _mm_avg_epu8(Load128(r0 + 2 * i + 16), Load128(r1 + 2 * i + 16));
+        a         = _mm_avg_epu16(Bytes128(a, false), Bytes128(a, true));
+        b         = _mm_avg_epu16(Bytes128(b, false), Bytes128(b, true));
+        Store128(out + i, _mm_packus_epi16(a, b));
+    }
+    HalveRowsScalar(r0 + 2 * i, r1 + 2 * i, out + i, out_w - i);
+}
+
+LIBVHAL_AVX2 inline __m256i
+Load256(const uint8_t* p)
+{
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+}
+
+LIBVHAL_AVX2 inline void
+Store256(uint8_t* p, __m256i v)
+{
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+}
+
+LIBVHAL_AVX2 inline __m256i
+Bytes256(__m256i v, bool odd)
+{
+    return odd ? _mm256_srli_epi16(v, 8) : _mm256_and_si256(v, _mm256_set1_epi16(0x00ff));
+}
+
+// packus works within 128 bit lanes, put the 64 bit halves back in order.
+LIBVHAL_AVX2 inline __m256i
+Pack256(__m256i a, __m256i b)
+{
+    return _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xd8);
+}
+
+LIBVHAL_AVX2 inline __m256i
+ShufflePs256(__m256i a, __m256i b, bool odd)
+{
+    return _mm256_castps_si256(
+      odd ? _mm256_shuffle_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), 0xdd)
+          : _mm256_shuffle_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), 0x88));
+}
+
+LIBVHAL_AVX2 inline __m256i
+Scale256(__m256i sum, int round, int shift, int offset)
+{
+    sum = _mm256_srai_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(round)), shift);
+    return _mm256_add_epi16(sum, _mm256_set1_epi16(offset));
+}
+
+// hadd works within 128 bit lanes, restores pixel order of 32 bit groups.
+LIBVHAL_AVX2 inline __m256i
+Unlane256(__m256i v)
+{
+    return _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+}
+
+LIBVHAL_AVX2 inline void
+SplitUVAvx2(const uint8_t* uv, uint8_t* u, uint8_t* v, size_t n)
+{
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i a = Load256(uv + 2 * i);
+        __m256i b = Load256(uv + 2 * i + 32);
+        Store256(u + i, Pack256(Bytes256(a, false), Bytes256(b, false)));
+        Store256(v + i, Pack256(Bytes256(a, true), Bytes256(b, true)));
+    }
+    SplitUVSse41(uv + 2 * i, u + i, v + i, n - i);
+}
+
+LIBVHAL_AVX2 inline void
+PackedToYAvx2(const uint8_t* src, uint8_t* y, size_t w, int y_offset)
+{
+    size_t i = 0;
+    for (; i + 32 <= w; i += 32) {
+        __m256i a = Load256(src + 2 * i);
+        __m256i b = Load256(src + 2 * i + 32);
+        Store256(y + i, Pack256(Bytes256(a, y_offset), Bytes256(b, y_offset)));
+    }
+    PackedToYSse41(src + 2 * i, y + i, w - i, y_offset);
+}
+
+LIBVHAL_AVX2 inline void
+PackedToUVAvx2(const uint8_t* r0, const uint8_t* r1, uint8_t* u, uint8_t* v,
+               size_t w, int y_offset)
+{
+    const bool c_odd = y_offset == 0;
+    size_t     i     = 0;
+    for (; i + 64 <= w; i += 64) {
+        __m256i a[4];
+        for (int k = 0; k < 4; ++k) {
+            a[k] = Bytes256(_mm256_avg_epu8(Load256(r0 + 2 * i + 32 * k),
+                                            Load256(r1 + 2 * i + 32 * k)),
+                            c_odd);
+        }
+        __m256i c0 = Pack256(a[0], a[1]);
+        __m256i c1 = Pack256(a[2], a[3]);
+        Store256(u + i / 2, Pack256(Bytes256(c0, false), Bytes256(c1, false)));
+        Store256(v + i / 2, Pack256(Bytes256(c0, true), Bytes256(c1, true)));
+    }
+    PackedToUVSse41(r0 + 2 * i, r1 + 2 * i, u + i / 2, v + i / 2, w - i, y_offset);
+}
+
+LIBVHAL_AVX2 inline void
+RgbaToYAvx2(const uint8_t* rgba, uint8_t* y, size_t w)
+{
+    const __m256i coef = _mm256_set1_epi32(0x000d4021);
+    size_t        i    = 0;
+    for (; i + 32 <= w; i += 32) {
+        __m256i m[4];
+        for (int k = 0; k < 4; ++k) {
+            m[k] = _mm256_maddubs_epi16(Load256(rgba + 4 * i + 32 * k), coef);
+        }
+        __m256i y0 = Scale256(_mm256_hadd_epi16(m[0], m[1]), 64, 7, 16);
+        __m256i y1 = Scale256(_mm256_hadd_epi16(m[2], m[3]), 64, 7, 16);
+        Store256(y + i, Unlane256(_mm256_packus_epi16(y0, y1)));
+    }
+    RgbaToYSse41(rgba + 4 * i, y + i, w - i);
+}
+
+LIBVHAL_AVX2 inline void
+RgbaToUVAvx2(const uint8_t* r0, const uint8_t* r1, uint8_t* u, uint8_t* v, size_t w)
+{
+    const __m256i coef_u = _mm256_set1_epi32(0x0070b6da);
+    const __m256i coef_v = _mm256_set1_epi32(0x00eea270);
+    size_t        i      = 0;
+    for (; i + 32 <= w; i += 32) {
+        __m256i r[4];
+        for (int k = 0; k < 4; ++k) {
+            r[k] = _mm256_avg_epu8(Load256(r0 + 4 * i + 32 * k), Load256(r1 + 4 * i + 32 * k));
+        }
+        __m256i p0 = _mm256_avg_epu8(ShufflePs256(r[0], r[1], false), ShufflePs256(r[0], r[1], true));
+        __m256i p1 = _mm256_avg_epu8(ShufflePs256(r[2], r[3], false), ShufflePs256(r[2], r[3], true));
+        __m256i su = Scale256(Unlane256(_mm256_hadd_epi16(_mm256_maddubs_epi16(p0, coef_u),
+                                                          _mm256_maddubs_epi16(p1, coef_u))),
+                              128, 8, 128);
+        __m256i sv = Scale256(Unlane256(_mm256_hadd_epi16(_mm256_maddubs_epi16(p0, coef_v),
+                                                          _mm256_maddubs_epi16(p1, coef_v))),
+                              128, 8, 128);
+        Store128(u + i / 2, _mm256_castsi256_si128(
+                              _mm256_permute4x64_epi64(_mm256_packus_epi16(su, su), 0x08)));
+        Store128(v + i / 2, _mm256_castsi256_si128(
+                              _mm256_permute4x64_epi64(_mm256_packus_epi16(sv, sv), 0x08)));
+    }
+    RgbaToUVSse41(r0 + 4 * i, r1 + 4 * i, u + i / 2, v + i / 2, w - i);
+}
+
+LIBVHAL_AVX2 inline void
+HalveRowsAvx2(const uint8_t* r0, const uint8_t* r1, uint8_t* out, size_t out_w)
+{
+    size_t i = 0;
+    for (; i + 32 <= out_w; i += 32) {
+        __m256i a = _mm256_avg_epu8(Load256(r0 + 2 * i), Load256(r1 + 2 * i));
+        __m256i b = _mm256_avg_epu8(Load256(r0 + 2 * i + 32), Load256(r1 + 2 * i + 32));
+        a         = _mm256_avg_epu16(Bytes256(a, false), Bytes256(a, true));
+        b         = _mm256_avg_epu16(Bytes256(b, false), Bytes256(b, true));
+        Store256(out + i, Pack256(a, b));
+    }
+    HalveRowsSse41(r0 + 2 * i, r1 + 2 * i, out + i, out_w - i);
+}
+
+#undef LIBVHAL_SSE41
+#undef LIBVHAL_AVX2
+#endif
+
+} // namespace kernels
+} // namespace client
+} // namespace vhal
+
+#endif /* PIXEL_CONVERT_KERNELS_H */
@@ -0,0 +1,78 @@
+/**
+ * @file reactor.cc
+ * @brief Shared epoll event loop for VHAL talkers
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "reactor.h"
+#include "reactor_impl.h"
+
+namespace vhal {
+namespace client {
+
+Reactor::Reactor()
+  : impl_{ std::make_unique<Impl>() }
+{}
+
+Reactor::~Reactor() = default;
+
+bool
+Reactor::AddFd(int fd, uint32_t events, FdHandler handler)
+{
+    return impl_->AddFd(fd, events, std::move(handler));
+}
+
+void
+Reactor::RemoveFd(int fd)
+{
+    impl_->RemoveFd(fd);
+}
+
+Reactor::TimerId
+Reactor::RunAfter(std::chrono::milliseconds delay, Task task)
+{
+    return impl_->RunAfter(delay, std::move(task));
+}
+
+void
+Reactor::CancelTimer(TimerId id)
+{
+    impl_->CancelTimer(id);
+}
+
+void
+Reactor::Post(Task task)
+{
+    impl_->Post(std::move(task));
+}
+
+bool
+Reactor::InLoopThread() const
+{
+    return impl_->InLoopThread();
+}
+
+bool
+Reactor::Failed() const
+{
+    return impl_->Failed();
+}
+
+} // namespace client
+} // namespace vhal
@@ -0,0 +1,367 @@
+/**
+ * @file reactor_impl.h
+ * @brief epoll + eventfd implementation of vhal::client::Reactor
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef REACTOR_IMPL_H
+#define REACTOR_IMPL_H
+
+#include "reactor.h"
+#include "receiver_log.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+extern "C"
+{
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+}
+
+namespace vhal {
+namespace client {
+
+class Reactor::Impl
+{
+public:
+    Impl()
+    {
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd_ < 0) {
+            throw std::system_error(errno, std::system_category());
+        }
+        wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wake_fd_ < 0) {
+            int err = errno;
+            close(epoll_fd_);
+            throw std::system_error(err, std::system_category());
+        }
+        struct epoll_event ev = {};
+        ev.events             = EPOLLIN;
+        ev.data.u64           = kWakeKey;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+
+        loop_thread_ = std::thread(&Impl::Run, this);
+    }
+
+    ~Impl()
+    {
+        should_continue_ = false;
+        Wake();
+        loop_thread_.join();
+        close(wake_fd_);
+        close(epoll_fd_);
+    }
+
+    Impl(const Impl&) = delete;
+    Impl& operator=(const Impl&) = delete;
+
+    bool AddFd(int fd, uint32_t events, FdHandler handler)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (failed_ || fd < 0 || fds_.count(fd)) {
+            return false;
+        }
+        auto entry        = std::make_shared<FdEntry>();
+        entry->handler    = std::move(handler);
+        entry->generation = NextGeneration();
+
+        // The generation tag lets the loop ignore events that were already
+        // fetched for an fd which got removed (and maybe reused) since.
+        struct epoll_event ev = {};
+        ev.events             = events;
+        ev.data.u64 =
+          (static_cast<uint64_t>(entry->generation) << 32) | uint32_t(fd);
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) == -1) {
+            return false;
+        }
+        fds_[fd] = std::move(entry);
+        return true;
+    }
+
+    void RemoveFd(int fd)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto                         it = fds_.find(fd);
+        if (it == fds_.end()) {
+            return;
+        }
+        auto entry = std::move(it->second);
+        fds_.erase(it);
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+        if (!InLoopThread()) {
+            idle_.wait(lock, [&] { return running_fd_ != entry.get(); });
+        }
+    }
+
+    TimerId RunAfter(std::chrono::milliseconds delay, Task task)
+    {
+        TimerId id;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            id            = ++last_timer_id_;
+            auto deadline = Clock::now() + delay;
+            timers_.emplace(std::make_pair(deadline, id), std::move(task));
+            timer_deadlines_[id] = deadline;
+        }
+        if (!InLoopThread()) {
+            Wake();
+        }
+        return id;
+    }
+
+    void CancelTimer(TimerId id)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto                         it = timer_deadlines_.find(id);
+        if (it != timer_deadlines_.end()) {
+            timers_.erase(std::make_pair(it->second, id));
+            timer_deadlines_.erase(it);
+        }
+        if (!InLoopThread()) {
+            idle_.wait(lock, [&] { return running_timer_ != id; });
+        }
+    }
+
+    void Post(Task task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            posted_.push_back(std::move(task));
+        }
+        if (!InLoopThread()) {
+            Wake();
+        }
+    }
+
+    bool InLoopThread() const
+    {
+        return std::this_thread::get_id() == loop_thread_id_.load();
+    }
+
+    bool Failed() const { return failed_; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct FdEntry
+    {
+        FdHandler handler;
+        uint32_t  generation = 0;
+    };
+
+    static constexpr uint64_t kWakeKey   = ~0ULL;
+    static constexpr int      kMaxEvents = 64;
+    // Pace of the loop if even poll() on the wake fd fails.
+    static constexpr int      kFailedPollMs = 10;
+
+    int                          epoll_fd_ = -1;
+    int                          wake_fd_  = -1;
+    std::thread                  loop_thread_;
+    std::atomic<std::thread::id> loop_thread_id_;
+    std::atomic<bool>            should_continue_ = true;
+    std::atomic<bool>            failed_          = false;
+    std::mutex                   mutex_;
+    std::condition_variable      idle_;
+    const FdEntry*               running_fd_    = nullptr;
+    TimerId                      running_timer_ = 0;
+    uint32_t                     generation_    = 0;
+    TimerId                      last_timer_id_ = 0;
+    std::unordered_map<int, std::shared_ptr<FdEntry>>   fds_;
+    std::map<std::pair<Clock::time_point, TimerId>, Task> timers_;
+    std::unordered_map<TimerId, Clock::time_point>      timer_deadlines_;
+    std::vector<Task>                                   posted_;
+
+    uint32_t NextGeneration()
+    {
+        if (++generation_ == (kWakeKey >> 32)) {
+            generation_ = 1;
+        }
+        return generation_;
+    }
+
+    void Wake()
+    {
+        uint64_t one = 1;
+        if (write(wake_fd_, &one, sizeof(one)) < 0) {
+            // Counter saturated: the loop is going to wake up anyway.
+        }
+    }
+
+    int NextTimeoutMs()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!posted_.empty()) {
+            return 0;
+        }
+        if (timers_.empty()) {
+            return -1;
+        }
+        auto wait = timers_.begin()->first.first - Clock::now();
+        if (wait <= Clock::duration::zero()) {
+            return 0;
+        }
+        // Round up, so that we never wake up just before the deadline.
+        return std::chrono::ceil<std::chrono::milliseconds>(wait).count();
+    }
+
+    void DispatchFd(uint64_t key, uint32_t events)
+    {
+        const int      fd         = static_cast<int>(key & 0xffffffff);
+        const uint32_t generation = static_cast<uint32_t>(key >> 32);
+
+        std::shared_ptr<FdEntry> entry;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto                        it = fds_.find(fd);
+            if (it == fds_.end() || it->second->generation != generation) {
+                return;
+            }
+            entry       = it->second;
+            running_fd_ = entry.get();
+        }
+        entry->handler(events);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_fd_ = nullptr;
+        }
+        idle_.notify_all();
+    }
+
+    /**
+     * epoll is gone: tell every fd handler through its error path, once, and
+     * forget the fds. Timers and tasks keep running, so that owners can still
+     * clean up through the reactor.
+     */
+    void Fail(int err)
+    {
+        AIC_LOG(LIBVHAL_ERROR, "epoll_wait() failed: %s, no more fd events", std::strerror(err));
+        std::vector<uint64_t> keys;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            failed_ = true;
+            for (auto& [fd, entry] : fds_) {
+                keys.push_back((static_cast<uint64_t>(entry->generation) << 32) | uint32_t(fd));
+            }
+        }
+        // Handlers may remove each other, DispatchFd() skips those.
+        for (auto key : keys) {
+            DispatchFd(key, EPOLLERR);
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        fds_.clear();
+    }
+
+    // Stands in for epoll_wait() once it failed, woken by Wake() only.
+    void WaitForWake(int timeout_ms)
+    {
+        struct pollfd pfd = { wake_fd_, POLLIN, 0 };
+        if (poll(&pfd, 1, timeout_ms) == -1 && errno != EINTR) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(kFailedPollMs));
+        }
+        uint64_t count;
+        while (read(wake_fd_, &count, sizeof(count)) > 0) {
+        }
+    }
+
+    void RunExpiredTimers()
+    {
+        while (true) {
+            Task task;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (timers_.empty() ||
+                    timers_.begin()->first.first > Clock::now()) {
+                    return;
+                }
+                auto node      = timers_.extract(timers_.begin());
+                running_timer_ = node.key().second;
+                timer_deadlines_.erase(running_timer_);
+                task = std::move(node.mapped());
+            }
+            task();
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                running_timer_ = 0;
+            }
+            idle_.notify_all();
+        }
+    }
+
+    void RunPostedTasks()
+    {
+        std::vector<Task> tasks;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks.swap(posted_);
+        }
+        for (auto& task : tasks) {
+            task();
+        }
+    }
+
+    void Run()
+    {
+        struct epoll_event events[kMaxEvents];
+
+        loop_thread_id_ = std::this_thread::get_id();
+        while (should_continue_) {
+            int n = 0;
+            if (failed_) {
+                WaitForWake(NextTimeoutMs());
+            } else {
+                n = epoll_wait(epoll_fd_, events, kMaxEvents, NextTimeoutMs());
+            }
+            if (n == -1) {
+                if (errno != EINTR) {
+                    Fail(errno);
+                }
+                continue;
+            }
+            for (int i = 0; i < n && should_continue_; i++) {
+                if (events[i].data.u64 == kWakeKey) {
+                    uint64_t count;
+                    while (read(wake_fd_, &count, sizeof(count)) > 0) {
+                    }
+                    continue;
+                }
+                DispatchFd(events[i].data.u64, events[i].events);
+            }
+            if (should_continue_) {
+                RunExpiredTimers();
+                RunPostedTasks();
+            }
+        }
+    }
+};
+
+} // namespace client
+} // namespace vhal
+
+#endif /* REACTOR_IMPL_H */
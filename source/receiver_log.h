@@ -19,6 +19,7 @@
 #ifndef _RECEIVER_LOG_H
 #define _RECEIVER_LOG_H
 
+#include "async_logger.h"
 #include <cstring>
 #include <pthread.h>
 #include <stdio.h>
@@ -30,50 +31,38 @@
 namespace vhal {
 namespace client {
 
-#ifdef __android__
-#include <android/log.h>
-#endif
-
-#define LIBVHAL_INFO 1
-#define LIBVHAL_DEBUG 2
-#define LIBVHAL_WARNING 3
-#define LIBVHAL_ERROR 4
-
-#ifndef __android__
+/**
+ * Messages are formatted on the calling thread and written out by the
+ * logging thread, see AsyncLogger. Levels are defined in vhal_log.h.
+ */
 #define AIC_LOG(level, fmt, ...)                                               \
     do {                                                                       \
-        if (level >= LIBVHAL_INFO) {                                            \
-            printf("%s %ld %s(%d): " fmt "\n",                                 \
-                   (level == 4)                                                \
-                     ? "ERR"                                                   \
-                     : ((level == 3)                                           \
-                          ? "WRN"                                              \
-                          : ((level == 2) ? "DBG" : "LIBVHAL_INFO")),          \
-                   syscall(__NR_gettid),                                       \
-                   __FUNCTION__,                                               \
-                   __LINE__,                                                   \
-                   ##__VA_ARGS__);                                             \
-            fflush(stdout);                                                    \
+        if (LIBVHAL_LOG_RANK(level) >= LIBVHAL_LOG_RANK(LIBVHAL_LOG_MIN_LEVEL) \
+            && ::vhal::client::AsyncLogger::Enabled(level)) {                  \
+            ::vhal::client::AsyncLogger::Instance().Log(                       \
+              (level), __FUNCTION__, __LINE__, fmt, ##__VA_ARGS__);            \
         }                                                                      \
     } while (0)
-#else
-#define AIC_LOG(level, fmt, ...)                                               \
+
+/**
+ * Same as AIC_LOG, at most once per interval of limiter (a LogRateLimiter).
+ * The first message after a quiet period tells how many were skipped.
+ */
+#define AIC_LOG_RATE_LIMITED(limiter, level, fmt, ...)                         \
     do {                                                                       \
-        if (level >= LIBVHAL_INFO) {                                            \
-            __android_log_print(                                               \
-              (level == 4)                                                     \
-                ? ANDROID_LOG_ERROR                                            \
-                : ((level == 3)                                                \
-                     ? ANDROID_LOG_WARN                                        \
-                     : ((level == 2) ? ANDROID_LOG_DEBUG : ANDROID_LOG_INFO)), \
-              LOG_TAG,                                                         \
-              "%s(%d): " fmt,                                                  \
-              __FUNCTION__,                                                    \
-              __LINE__,                                                        \
-              ##__VA_ARGS__);                                                  \
+        uint64_t aic_log_suppressed = 0;                                       \
+        if (LIBVHAL_LOG_RANK(level) >= LIBVHAL_LOG_RANK(LIBVHAL_LOG_MIN_LEVEL) \
+            && ::vhal::client::AsyncLogger::Enabled(level)                     \
+            && (limiter).Allow(aic_log_suppressed)) {                          \
+            if (aic_log_suppressed) {                                          \
+                AIC_LOG(level, fmt " (%llu similar messages suppressed)",      \
+                        ##__VA_ARGS__,                                         \
+                        static_cast<unsigned long long>(aic_log_suppressed));  \
+            } else {                                                           \
+                AIC_LOG(level, fmt, ##__VA_ARGS__);                            \
+            }                                                                  \
         }                                                                      \
     } while (0)
-#endif
 
 } // namespace client
 } // namespace vhal
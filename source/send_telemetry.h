@@ -0,0 +1,160 @@
+/**
+ * @file send_telemetry.h
+ * @brief Lock-free send statistics of the camera data path
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef SEND_TELEMETRY_H
+#define SEND_TELEMETRY_H
+
+#include "hdr_histogram.h"
+#include "video_sink.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief Counters behind VideoSink::camera_telemetry_t. Recording and
+ *        Snapshot() only use relaxed atomics, no locks.
+ *
+ * Per second rates come from a small ring of counters, one per second,
+ * each tagged with the second it counts so that a stale slot reads as 0.
+ */
+class SendTelemetry
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void RecordSend(size_t bytes, Clock::time_point start)
+    {
+        const auto now = Clock::now();
+        latency_.Record(Nanos(now - start));
+        frames_.fetch_add(1, std::memory_order_relaxed);
+        bytes_.fetch_add(bytes, std::memory_order_relaxed);
+
+        int64_t none = 0;
+        first_send_.compare_exchange_strong(none, Nanos(now.time_since_epoch()),
+                                            std::memory_order_relaxed);
+        const uint64_t second = Seconds(now);
+        AddToSlot(frame_slots_, second, 1);
+        AddToSlot(byte_slots_, second, bytes);
+    }
+
+    void RecordError(Clock::time_point start)
+    {
+        latency_.Record(Nanos(Clock::now() - start));
+        errors_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void RecordDrop() { dropped_.fetch_add(1, std::memory_order_relaxed); }
+
+    void RecordQueueDepth(size_t depth) { queue_depth_.Record(depth); }
+
+    void RecordConnected() { connections_.fetch_add(1, std::memory_order_relaxed); }
+
+    /**
+     * @brief Everything but socket_backlog, which belongs to the socket.
+     */
+    VideoSink::camera_telemetry_t Snapshot() const
+    {
+        VideoSink::camera_telemetry_t t;
+        t.frames_sent    = frames_.load(std::memory_order_relaxed);
+        t.bytes_sent     = bytes_.load(std::memory_order_relaxed);
+        t.send_errors    = errors_.load(std::memory_order_relaxed);
+        t.frames_dropped = dropped_.load(std::memory_order_relaxed);
+        t.connections    = connections_.load(std::memory_order_relaxed);
+        t.reconnects     = t.connections ? t.connections - 1 : 0;
+        t.send_latency   = latency_.Summary();
+        t.queue_depth    = queue_depth_.Summary();
+
+        const auto     now  = Clock::now();
+        const uint64_t last = Seconds(now) - 1;
+        t.fps               = ReadSlot(frame_slots_, last);
+        t.bitrate           = 8.0 * ReadSlot(byte_slots_, last);
+
+        const int64_t first = first_send_.load(std::memory_order_relaxed);
+        if (first) {
+            double elapsed = (Nanos(now.time_since_epoch()) - first) / 1e9;
+            if (elapsed > 0) {
+                t.average_fps     = t.frames_sent / elapsed;
+                t.average_bitrate = 8.0 * t.bytes_sent / elapsed;
+            }
+        }
+        return t;
+    }
+
+private:
+    static constexpr int      kSlots    = 4;
+    static constexpr int      kTagBits  = 24;
+    static constexpr int      kValueBits = 64 - kTagBits;
+    static constexpr uint64_t kValueMask = (uint64_t(1) << kValueBits) - 1;
+
+    using Slots = std::atomic<uint64_t>[kSlots];
+
+    std::atomic<uint64_t> frames_      = 0;
+    std::atomic<uint64_t> bytes_       = 0;
+    std::atomic<uint64_t> errors_      = 0;
+    std::atomic<uint64_t> dropped_     = 0;
+    std::atomic<uint32_t> connections_ = 0;
+    std::atomic<int64_t>  first_send_  = 0; // steady clock ns, 0 before
+    Slots                 frame_slots_ = {};
+    Slots                 byte_slots_  = {};
+    HdrHistogram          latency_;
+    HdrHistogram          queue_depth_;
+
+    template<typename Duration>
+    static int64_t Nanos(Duration d)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+    }
+
+    static uint64_t Seconds(Clock::time_point t)
+    {
+        return std::chrono::duration_cast<std::chrono::seconds>(t.time_since_epoch())
+          .count();
+    }
+
+    static uint64_t Tag(uint64_t second) { return second << kValueBits; }
+
+    static void AddToSlot(Slots& slots, uint64_t second, uint64_t delta)
+    {
+        auto&    slot = slots[second % kSlots];
+        uint64_t old  = slot.load(std::memory_order_relaxed);
+        uint64_t next;
+        do {
+            // A slot still tagged with an older second starts over.
+            next = (old & ~kValueMask) == Tag(second) ? old + delta
+                                                      : Tag(second) | delta;
+        } while (!slot.compare_exchange_weak(old, next, std::memory_order_relaxed));
+    }
+
+    static uint64_t ReadSlot(const Slots& slots, uint64_t second)
+    {
+        uint64_t v = slots[second % kSlots].load(std::memory_order_relaxed);
+        return (v & ~kValueMask) == Tag(second) ? v & kValueMask : 0;
+    }
+};
+
+} // namespace client
+} // namespace vhal
+
+#endif /* SEND_TELEMETRY_H */
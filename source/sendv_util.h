@@ -0,0 +1,110 @@
+/**
+ * @file sendv_util.h
+ * @brief Short write handling shared by the SendV() implementations
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef SENDV_UTIL_H
+#define SENDV_UTIL_H
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+extern "C"
+{
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+}
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief Outcome of SendMsgAll(): bytes sent out of total, and the errno
+ *        that stopped it, 0 when every byte left.
+ */
+struct SendVProgress
+{
+    size_t sent  = 0;
+    size_t total = 0;
+    int    error = 0;
+};
+
+/**
+ * @brief Sends every byte of @p iov through @p send_msg.
+ *
+ * Fast path: the whole message leaves in one call. On a short write, resume
+ * from a private copy of the remaining iovecs, so the caller's array is left
+ * untouched. EINTR is retried.
+ *
+ * @param send_msg Callable taking a struct msghdr*, returning the number of
+ *                 bytes sent or -errno, like one sendmsg() call.
+ */
+template <typename SendMsg>
+SendVProgress SendMsgAll(const struct iovec* iov, int iovcnt, SendMsg&& send_msg)
+{
+    struct msghdr msg = {};
+    msg.msg_iov       = const_cast<struct iovec*>(iov);
+    msg.msg_iovlen    = iovcnt;
+
+    SendVProgress progress;
+    for (int i = 0; i < iovcnt; i++) {
+        progress.total += iov[i].iov_len;
+    }
+
+    std::vector<struct iovec> rest;
+    while (progress.sent < progress.total) {
+        ssize_t n = send_msg(&msg);
+        if (n < 0) {
+            if (n == -EINTR) {
+                continue;
+            }
+            progress.error = static_cast<int>(-n);
+            break;
+        }
+        progress.sent += n;
+        if (progress.sent == progress.total) {
+            break;
+        }
+        if (rest.empty()) {
+            rest.assign(iov, iov + iovcnt);
+            msg.msg_iov = rest.data();
+        }
+        while (n > 0 && msg.msg_iovlen > 0) {
+            auto& v = msg.msg_iov[0];
+            if ((size_t)n < v.iov_len) {
+                v.iov_base = static_cast<uint8_t*>(v.iov_base) + n;
+                v.iov_len -= n;
+                n = 0;
+            } else {
+                n -= v.iov_len;
+                msg.msg_iov++;
+                msg.msg_iovlen--;
+            }
+        }
+    }
+    return progress;
+}
+
+} // namespace client
+} // namespace vhal
+
+#endif /* SENDV_UTIL_H */
@@ -24,6 +24,7 @@
 
 #include "sensor_interface.h"
 #include "sensor_interface_impl.h"
+#include "io_uring_stream_socket_client.h"
 #include "unix_stream_socket_client.h"
 #include <functional>
 #include <memory>
@@ -37,7 +38,8 @@ namespace vhal {
 namespace client {
 
 SensorInterface::SensorInterface(UnixConnectionInfo unix_conn_info, SensorCallback callback,
-                                                                const int32_t user_id = -1)
+                                                                const int32_t user_id = -1,
+                                 std::shared_ptr<Reactor> reactor)
 {
     auto sockPath = unix_conn_info.socket_dir;
     if (sockPath.length() == 0) {
@@ -50,9 +52,14 @@ SensorInterface::SensorInterface(UnixConnectionInfo unix_conn_info, SensorCallba
     }
 
     //Creating interface to communicate to VHAL via libvhal
-    auto unix_sock_client =
+    unique_ptr<IStreamSocketClient> unix_sock_client =
       make_unique<UnixStreamSocketClient>(move(sockPath));
-    impl_ = std::make_unique<Impl>(std::move(unix_sock_client), callback, user_id);
+    if (unix_conn_info.io_uring) {
+        unix_sock_client = make_unique<IoUringStreamSocketClient>(
+          move(unix_sock_client), unix_conn_info.io_uring);
+    }
+    impl_ = std::make_unique<Impl>(std::move(unix_sock_client), callback, user_id,
+                                   std::move(reactor));
 }
 
 SensorInterface::~SensorInterface() {}
@@ -62,6 +69,11 @@ IOResult SensorInterface::SendDataPacket(const SensorDataPacket *event)
     return impl_->SendDataPacket(event);
 }
 
+IOStatus SensorInterface::SendDataPacketNoAlloc(const SensorDataPacket *event)
+{
+    return impl_->SendDataPacketNoAlloc(event);
+}
+
 uint64_t SensorInterface::GetSupportedSensorList()
 {
     return impl_->GetSupportedSensorList();
@@ -25,7 +25,10 @@
 #ifndef SENSOR_INTERFACE_IMPL_H
 #define SENSOR_INTERFACE_IMPL_H
 
+#include "framed_reader.h"
 #include "istream_socket_client.h"
+#include "receiver_log.h"
+#include "stream_talker.h"
 #include "sensor_interface.h"
 #include <atomic>
 #include <chrono>
@@ -39,6 +42,7 @@ extern "C"
 {
 #include <sys/poll.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 }
 #include <thread>
@@ -53,92 +57,49 @@ namespace client {
 class SensorInterface::Impl
 {
 public:
-    Impl(unique_ptr<IStreamSocketClient> socket_client, SensorCallback callback,
-                                                        const int32_t user_id)
-      : socket_client_{ move(socket_client) },
-        callback_{ move(callback) }
+    Impl(unique_ptr<IStreamSocketClient> socket_client,
+         SensorCallback                  callback,
+         const int32_t                   user_id,
+         shared_ptr<Reactor>             reactor = nullptr)
+      : callback_{ move(callback) },
+        socket_client_{ move(socket_client) },
+        user_id_{ user_id },
+        reader_{ socket_client_.get() },
+        talker_{ socket_client_.get(),
+                 "SensorInterface",
+                 move(reactor),
+                 [this]() {
+                     AIC_LOG(LIBVHAL_INFO, "Connected to Sensor VHal!");
+                     reader_.Reset();
+                     sendStreamerUserId(user_id_);
+                 },
+                 [this]() { return OnMessage(); } }
     {
-        vhal_talker_thread_ = thread([this, user_id]() {
-            while (should_continue_) {
-                if (not socket_client_->Connected()) {
-                    if (auto [connected, error_msg] = socket_client_->Connect();
-                        !connected) {
-                        cout << "SensorInterface Failed to connect to VHal: "
-                             << error_msg
-                             << ". Retry after 1s...\n";
-                        this_thread::sleep_for(1s);
-                        continue;
-                    }
-                }
-                // connected ...
-                cout << "Connected to Sensor VHal!\n";
-                sendStreamerUserId(user_id);
-
-                struct pollfd fds[1];
-                const int     timeout_ms = 1 * 1000; // 1 sec timeout
-                int           ret;
-
-                // watch socket for input
-                fds[0].fd     = socket_client_->GetNativeSocketFd();
-                fds[0].events = POLLIN;
-
-                do {
-                    ret = poll(fds, std::size(fds), timeout_ms);
-                    if (ret == -1) {
-                        throw system_error(errno, system_category());
-                    }
-                    if (!ret) {
-                        continue;
-                    }
-                    if (fds[0].revents & POLLIN) {
-                        cout << "Sensor VHal has some message for us!\n";
-
-                        SensorInterface::CtrlPacket ctrl_msg;
-
-                        if (auto [received, recv_err_msg] =
-                              socket_client_->Recv(
-                                reinterpret_cast<uint8_t*>(&ctrl_msg),
-                                sizeof(ctrl_msg));
-                            received != sizeof(SensorInterface::CtrlPacket)) {
-                            cout << "Failed to read message from SensorInterface: "
-                                 << recv_err_msg
-                                 << ", going to disconnect and reconnect.\n";
-                            socket_client_->Close();
-                            break;
-                        }
-
-                        if (IsValidCtrlPacket(ctrl_msg.type)) {
-                            // success, invoke client callback
-                            callback_(cref(ctrl_msg));
-                        }
-                    } else {
-                        if (fds[0].revents & (POLLERR|POLLHUP)) {
-                            cout << "SensorInterface Poll Fail event: "
-                                << fds[0].revents
-                                << ", reconnect\n";
-                            socket_client_->Close();
-                            break;
-                        }
-                        cout << "SensorInterface : Poll revents " << fds[0].revents << "\n";
-                    }
-                } while (should_continue_);
-            }
-        });
+        talker_.Start();
     }
 
     ~Impl()
     {
-        should_continue_ = false;
-        vhal_talker_thread_.join();
+        talker_.Stop();
     }
 
     IOResult SendDataPacket(const SensorDataPacket *event)
+    {
+        auto status = SendDataPacketNoAlloc(event);
+        if (status.error == std::errc::not_connected && status.size == 0)
+            return {0, "VHAL Not connected"};
+        if (status.error == std::errc::not_supported)
+            return {-1, "Sensor Type not supported"};
+        return ToIOResult(status);
+    }
+
+    IOStatus SendDataPacketNoAlloc(const SensorDataPacket *event)
     {
         vhal_sensor_event_t sensor_event;
         int dataCount = 0;
 
         if (not socket_client_->Connected())
-            return {0, "VHAL Not connected"};
+            return {0, std::make_error_code(std::errc::not_connected)};
 
         switch (event->type) {
             case SENSOR_TYPE_ACCELEROMETER:
@@ -160,9 +121,9 @@ public:
                 break;
 
             default:
-                cout << "LibVHAL[Sensor]: Sensor type %d not supported."
-                        "Dropping data event." << event->type << endl;
-                return {-1, "Sensor Type not supported"};
+                AIC_LOG(LIBVHAL_WARNING, "Sensor type %d not supported. Dropping data event.",
+                        static_cast<int>(event->type));
+                return {-1, std::make_error_code(std::errc::not_supported)};
         }
 
         const size_t dataHeaderLen = sizeof(vhal_sensor_event_t) - sizeof(sensor_event.fdata);
@@ -172,16 +133,17 @@ public:
         sensor_event.fdataCount = dataCount;
         sensor_event.timestamp_ns = event->timestamp_ns;
         sensor_event.fdata = nullptr;
-        uint8_t dataPtr[totalPayloadLen];
-        std::memmove(dataPtr, &sensor_event, dataHeaderLen);
-        std::memmove((dataPtr + dataHeaderLen), event->fdata, dataPayLoadLen);
-        if (auto [sent, error_msg] =
-                socket_client_->Send(dataPtr, totalPayloadLen); sent == -1) {
-            return { sent, error_msg };
+        struct iovec iov[2] = {
+            { &sensor_event, dataHeaderLen },
+            { const_cast<float*>(event->fdata), dataPayLoadLen }
+        };
+        if (auto status = socket_client_->SendVNoAlloc(iov, std::size(iov));
+            status.size == -1) {
+            return status;
         }
 
         // success
-        return { totalPayloadLen, "" };
+        return { static_cast<ssize_t>(totalPayloadLen), {} };
     }
 
     bool IsValidCtrlPacket(int32_t SensorType)
@@ -214,11 +176,37 @@ public:
                 SENSOR_TYPE_MASK(SENSOR_TYPE_MAGNETIC_FIELD_UNCALIBRATED) |
                 SENSOR_TYPE_MASK(SENSOR_TYPE_GYROSCOPE_UNCALIBRATED);
     }
+    StreamTalker::Status OnMessage()
+    {
+        AIC_LOG(LIBVHAL_DEBUG, "Sensor VHal has some message for us!");
+
+        // Drain every message the last fill brought in; poll() won't report
+        // them again.
+        do {
+            SensorInterface::CtrlPacket ctrl_msg;
+
+            if (auto [received, recv_err_msg] =
+                  reader_.Read(&ctrl_msg, sizeof(ctrl_msg));
+                received != sizeof(SensorInterface::CtrlPacket)) {
+                AIC_LOG(LIBVHAL_ERROR,
+                        "Failed to read message from SensorInterface: %s, going to disconnect and reconnect.",
+                        recv_err_msg.c_str());
+                return StreamTalker::Status::kReconnect;
+            }
+
+            if (IsValidCtrlPacket(ctrl_msg.type)) {
+                // success, invoke client callback
+                callback_(cref(ctrl_msg));
+            }
+        } while (reader_.Buffered() >= sizeof(SensorInterface::CtrlPacket));
+        return StreamTalker::Status::kContinue;
+    }
+
 private:
     SensorCallback                  callback_ = nullptr;
     unique_ptr<IStreamSocketClient> socket_client_;
-    thread                          vhal_talker_thread_;
-    atomic<bool>                    should_continue_ = true;
+    int32_t                         user_id_ = -1;
+    FramedReader                    reader_;
 
     void sendStreamerUserId(int32_t user_id) {
         if (not socket_client_->Connected())
@@ -234,6 +222,9 @@ private:
             socket_client_->Send(dataPtr, dataLen);
         }
     }
+
+    // Declared last: stopped before the state its handlers use goes away.
+    StreamTalker talker_;
 };
 
 } // namespace client
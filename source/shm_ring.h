@@ -0,0 +1,375 @@
+/**
+ * @file shm_ring.h
+ * @brief Shared-memory byte ring with eventfd doorbells
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+extern "C"
+{
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+}
+
+namespace vhal {
+namespace client {
+
+/**
+ * Handshake of the shared-memory ring transport.
+ *
+ * The client connects to the VHAL Unix socket and sends a shm_ring_hello_t
+ * together with kShmRingNumFds descriptors (SCM_RIGHTS), ordered as
+ * ShmRingFd. The memfd holds a shm_ring_layout_t followed by the two data
+ * areas, client->server first. The server answers with a shm_ring_ack_t.
+ * From then on the socket only carries the connection lifetime: each side
+ * closes it to hang up, all data goes through the rings.
+ */
+constexpr uint32_t kShmRingMagic   = 0x474e5253; // "SRNG"
+constexpr uint32_t kShmRingVersion = 1;
+
+struct shm_ring_hello_t
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t ring_size; // bytes per direction, power of two
+};
+
+struct shm_ring_ack_t
+{
+    uint32_t magic;
+    int32_t  status; // 0 on success, errno otherwise
+};
+
+// Descriptor order in the hello message, named from the client side.
+enum ShmRingFd {
+    kShmRingMemFd = 0,
+    kShmRingTxDataFd,  // client->server data doorbell
+    kShmRingTxSpaceFd, // client->server space doorbell
+    kShmRingRxDataFd,  // server->client data doorbell
+    kShmRingRxSpaceFd, // server->client space doorbell
+    kShmRingNumFds
+};
+
+/**
+ * Control block of one direction. head and tail are free running byte
+ * counters owned by the producer and the consumer respectively, kept on
+ * separate cache lines. A side that is about to sleep sets its flag so the
+ * other side rings the doorbell; otherwise no syscall is made.
+ */
+struct shm_ring_ctrl_t
+{
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) std::atomic<uint64_t> tail;
+    alignas(64) std::atomic<uint32_t> need_data;  // consumer waits for data
+    alignas(64) std::atomic<uint32_t> need_space; // producer waits for space
+};
+
+struct shm_ring_layout_t
+{
+    shm_ring_ctrl_t ctrl[2]; // client->server, server->client
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "shared-memory ring needs lock free 64 bit atomics");
+
+constexpr size_t
+ShmRingDataOffset()
+{
+    return (sizeof(shm_ring_layout_t) + 4095) & ~size_t(4095);
+}
+
+constexpr size_t
+ShmRingMapSize(uint64_t ring_size)
+{
+    return ShmRingDataOffset() + 2 * ring_size;
+}
+
+/**
+ * @brief One direction of the transport as seen by one endpoint: either the
+ *        producer or the consumer side. peer_fd is the Unix socket, used to
+ *        notice the other side hanging up while waiting on a doorbell.
+ */
+class ShmRing
+{
+public:
+    ShmRing() = default;
+    ShmRing(shm_ring_ctrl_t* ctrl,
+            uint8_t*         data,
+            uint64_t         size,
+            int              data_fd,
+            int              space_fd,
+            int              peer_fd)
+      : ctrl_{ ctrl },
+        data_{ data },
+        size_{ size },
+        data_fd_{ data_fd },
+        space_fd_{ space_fd },
+        peer_fd_{ peer_fd }
+    {}
+
+    // A ring the peer corrupted reads as both readable and writable, so that
+    // Read() and Write() get to fail on it rather than wait.
+    size_t Readable() const
+    {
+        return ctrl_->head.load(std::memory_order_acquire)
+               - ctrl_->tail.load(std::memory_order_relaxed);
+    }
+
+    size_t Writable() const
+    {
+        return size_
+               - (ctrl_->head.load(std::memory_order_relaxed)
+                  - ctrl_->tail.load(std::memory_order_acquire));
+    }
+
+    /**
+     * @brief Producer: copy all buffers, waiting for space when the ring is
+     *        full. Data is published once per ring-full of bytes, so a
+     *        message that fits reaches the consumer in one piece.
+     *
+     * @return bytes written, 0 if the peer hung up, -1 with errno set:
+     *         EPROTO if the peer corrupted the counters.
+     */
+    ssize_t Write(const struct iovec* iov, int iovcnt)
+    {
+        size_t   total = 0;
+        uint64_t head  = ctrl_->head.load(std::memory_order_relaxed);
+        for (int i = 0; i < iovcnt; i++) {
+            auto   src  = static_cast<const uint8_t*>(iov[i].iov_base);
+            size_t left = iov[i].iov_len;
+            while (left > 0) {
+                uint64_t tail = ctrl_->tail.load(std::memory_order_acquire);
+                if (!Valid(head, tail)) {
+                    errno = EPROTO;
+                    return -1;
+                }
+                size_t room = size_ - (head - tail);
+                if (room == 0) {
+                    Publish(head);
+                    int r = WaitSpace();
+                    if (r <= 0) {
+                        return r;
+                    }
+                    continue;
+                }
+                size_t n = std::min(left, room);
+                CopyIn(head, src, n);
+                head += n;
+                src += n;
+                left -= n;
+                total += n;
+            }
+        }
+        Publish(head);
+        return total;
+    }
+
+    /**
+     * @brief Consumer: copy up to size bytes, like recv() on a stream socket.
+     *
+     * @param peek Leave the bytes in the ring (MSG_PEEK).
+     * @param nonblock Fail with EAGAIN instead of waiting (MSG_DONTWAIT).
+     *
+     * @return bytes read, 0 if the peer hung up, -1 with errno set:
+     *         EPROTO if the peer corrupted the counters.
+     */
+    ssize_t Read(uint8_t* buf, size_t size, bool peek, bool nonblock)
+    {
+        if (size == 0) {
+            return 0;
+        }
+        int r = WaitData(nonblock);
+        if (r <= 0) {
+            return r;
+        }
+        uint64_t tail = ctrl_->tail.load(std::memory_order_relaxed);
+        uint64_t head = ctrl_->head.load(std::memory_order_acquire);
+        if (!Valid(head, tail)) {
+            errno = EPROTO;
+            return -1;
+        }
+        size_t n = std::min<size_t>(size, head - tail);
+        CopyOut(tail, buf, n);
+        if (!peek) {
+            ctrl_->tail.store(tail + n, std::memory_order_seq_cst);
+            if (ctrl_->need_space.load(std::memory_order_seq_cst)
+                && ctrl_->need_space.exchange(0)) {
+                Ring(space_fd_);
+            }
+        }
+        return n;
+    }
+
+    /**
+     * @brief Consumer: arm the data doorbell once the ring is drained.
+     *
+     * Keeps the invariant the transport relies on when its data eventfd is
+     * polled from outside: whenever the ring holds bytes, the data eventfd
+     * is readable.
+     *
+     * @return true if data is available.
+     */
+    bool ArmDataDoorbell()
+    {
+        if (Readable()) {
+            return true;
+        }
+        Drain(data_fd_);
+        ctrl_->need_data.store(1, std::memory_order_seq_cst);
+        if (Readable()) {
+            if (ctrl_->need_data.exchange(0)) {
+                Ring(data_fd_);
+            }
+            return true;
+        }
+        return false;
+    }
+
+private:
+    shm_ring_ctrl_t* ctrl_     = nullptr;
+    uint8_t*         data_     = nullptr;
+    uint64_t         size_     = 0;
+    int              data_fd_  = -1;
+    int              space_fd_ = -1;
+    int              peer_fd_  = -1;
+
+    // The counters live in the shared mapping, where the peer may write
+    // anything: more than size_ bytes in flight would take the copies past
+    // the end of data_.
+    bool Valid(uint64_t head, uint64_t tail) const { return head - tail <= size_; }
+
+    void CopyIn(uint64_t pos, const uint8_t* src, size_t n)
+    {
+        size_t off   = pos & (size_ - 1);
+        size_t first = std::min(n, size_ - off);
+        std::memcpy(data_ + off, src, first);
+        std::memcpy(data_, src + first, n - first);
+    }
+
+    void CopyOut(uint64_t pos, uint8_t* dst, size_t n) const
+    {
+        size_t off   = pos & (size_ - 1);
+        size_t first = std::min(n, size_ - off);
+        std::memcpy(dst, data_ + off, first);
+        std::memcpy(dst + first, data_, n - first);
+    }
+
+    void Publish(uint64_t head)
+    {
+        if (head == ctrl_->head.load(std::memory_order_relaxed)) {
+            return;
+        }
+        ctrl_->head.store(head, std::memory_order_seq_cst);
+        if (ctrl_->need_data.load(std::memory_order_seq_cst)
+            && ctrl_->need_data.exchange(0)) {
+            Ring(data_fd_);
+        }
+    }
+
+    int WaitData(bool nonblock)
+    {
+        while (!ArmDataDoorbell()) {
+            int r = WaitDoorbell(data_fd_, nonblock);
+            if (r <= 0) {
+                return r;
+            }
+        }
+        return 1;
+    }
+
+    int WaitSpace()
+    {
+        while (true) {
+            ctrl_->need_space.store(1, std::memory_order_seq_cst);
+            if (Writable()) {
+                ctrl_->need_space.store(0, std::memory_order_relaxed);
+                return 1;
+            }
+            int r = WaitDoorbell(space_fd_, false);
+            if (r <= 0) {
+                return r;
+            }
+            Drain(space_fd_);
+        }
+    }
+
+    // 1 when the doorbell rang, 0 if the peer hung up, -1 on error.
+    int WaitDoorbell(int fd, bool nonblock)
+    {
+        struct pollfd fds[2] = { { fd, POLLIN, 0 }, { peer_fd_, POLLIN, 0 } };
+        while (true) {
+            int r = ::poll(fds, 2, nonblock ? 0 : -1);
+            if (r < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return -1;
+            }
+            if (fds[1].revents) {
+                if (PeerClosed()) {
+                    return 0;
+                }
+                // Nothing but a hang up is expected on the socket.
+                errno = EPROTO;
+                return -1;
+            }
+            if (fds[0].revents & POLLIN) {
+                return 1;
+            }
+            errno = EAGAIN;
+            return -1;
+        }
+    }
+
+    bool PeerClosed() const
+    {
+        uint8_t byte;
+        ssize_t n = ::recv(peer_fd_, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+        return n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR);
+    }
+
+    static void Ring(int fd)
+    {
+        uint64_t one = 1;
+        while (::write(fd, &one, sizeof(one)) < 0 && errno == EINTR) {
+        }
+    }
+
+    static void Drain(int fd)
+    {
+        uint64_t count;
+        while (::read(fd, &count, sizeof(count)) < 0 && errno == EINTR) {
+        }
+    }
+};
+
+} // namespace client
+} // namespace vhal
+
+#endif /* SHM_RING_H */
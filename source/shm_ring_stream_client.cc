@@ -0,0 +1,103 @@
+/**
+ * @file shm_ring_stream_client.cc
+ * @brief
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "shm_ring_stream_client.h"
+#include "shm_ring_stream_client_impl.h"
+
+namespace vhal {
+namespace client {
+ShmRingStreamClient::ShmRingStreamClient(const std::string& remote_server_path,
+                                         size_t             ring_size)
+  : impl_{ std::make_unique<Impl>(remote_server_path, ring_size) }
+{}
+
+ShmRingStreamClient::~ShmRingStreamClient() = default;
+
+ConnectionResult
+ShmRingStreamClient::Connect()
+{
+    return impl_->Connect();
+}
+
+bool
+ShmRingStreamClient::Connected() const
+{
+    return impl_->Connected();
+}
+
+int
+ShmRingStreamClient::GetNativeSocketFd() const
+{
+    return impl_->GetNativeSocketFd();
+}
+
+std::string
+ShmRingStreamClient::GetRemotePath() const
+{
+    return impl_->GetRemotePath();
+}
+
+IOResult
+ShmRingStreamClient::Send(const uint8_t* data, size_t size)
+{
+    return ToIOResult(SendNoAlloc(data, size));
+}
+
+IOResult
+ShmRingStreamClient::SendV(const struct iovec* iov, int iovcnt)
+{
+    return ToIOResult(SendVNoAlloc(iov, iovcnt));
+}
+
+IOResult
+ShmRingStreamClient::Recv(uint8_t* data, size_t size, uint8_t flag)
+{
+    return ToIOResult(RecvNoAlloc(data, size, flag));
+}
+
+IOStatus
+ShmRingStreamClient::SendNoAlloc(const uint8_t* data, size_t size)
+{
+    struct iovec iov = { const_cast<uint8_t*>(data), size };
+    return impl_->SendV(&iov, 1);
+}
+
+IOStatus
+ShmRingStreamClient::SendVNoAlloc(const struct iovec* iov, int iovcnt)
+{
+    return impl_->SendV(iov, iovcnt);
+}
+
+IOStatus
+ShmRingStreamClient::RecvNoAlloc(uint8_t* data, size_t size, uint8_t flag)
+{
+    return impl_->Recv(data, size, flag);
+}
+
+void
+ShmRingStreamClient::Close()
+{
+    impl_->Close();
+}
+
+} // namespace client
+} // namespace vhal
@@ -0,0 +1,308 @@
+/**
+ * @file shm_ring_stream_client_impl.h
+ * @brief
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef SHM_RING_STREAM_CLIENT_IMPL_H
+#define SHM_RING_STREAM_CLIENT_IMPL_H
+
+#include "shm_ring.h"
+#include "shm_ring_stream_client.h"
+#include "receiver_log.h"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <shared_mutex>
+#include <system_error>
+extern "C"
+{
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+}
+
+namespace vhal {
+namespace client {
+
+class ShmRingStreamClient::Impl
+{
+public:
+    Impl(const std::string& remote_server_socket_path, size_t ring_size)
+    {
+        remote_.sun_family = AF_UNIX;
+        strncpy(remote_.sun_path, remote_server_socket_path.c_str(), sizeof(remote_.sun_path) -1);
+        ring_size_ = 4096;
+        while (ring_size_ < ring_size) {
+            ring_size_ <<= 1;
+        }
+    }
+    ~Impl() { Close(); }
+    Impl(Impl &) = delete;
+    Impl& operator = (Impl &) = delete;
+
+    ConnectionResult Connect()
+    {
+        Close();
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+
+        auto len = strlen(remote_.sun_path) + sizeof(remote_.sun_family);
+        sock_fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (sock_fd_ < 0) {
+            throw std::system_error(errno, std::system_category());
+        }
+        if (::connect(sock_fd_, (struct sockaddr*)&remote_, len) != 0) {
+            std::string error_msg = std::strerror(errno);
+            AIC_LOG_RATE_LIMITED(connect_log_limiter_, LIBVHAL_WARNING,
+                                 "Connect() failed args: fd: %d, remote server path: %s, %s",
+                                 sock_fd_.load(), remote_.sun_path, error_msg.c_str());
+            return Fail(error_msg);
+        }
+
+        std::string error_msg = SetupRings();
+        if (error_msg.empty()) {
+            error_msg = Handshake();
+        }
+        if (!error_msg.empty()) {
+            AIC_LOG(LIBVHAL_ERROR, "ShmRing handshake with %s failed: %s", remote_.sun_path,
+                    error_msg.c_str());
+            return Fail(error_msg);
+        }
+        connected_ = true;
+        return { true, "" };
+    }
+
+    bool Connected() const { return connected_; }
+
+    int GetNativeSocketFd() const { return epoll_fd_; }
+
+    // Not a unix socket to its users: no SCM_RIGHTS, no SIOCOUTQ, no raw
+    // send() on the native fd, so don't let them take it for one.
+    std::string GetRemotePath() const { return ""; }
+
+    IOStatus SendV(const struct iovec* iov, int iovcnt)
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        if (!connected_) {
+            return { -1, std::make_error_code(std::errc::not_connected) };
+        }
+        std::lock_guard<std::mutex> tx_lock(tx_mutex_);
+        ssize_t sent = tx_.Write(iov, iovcnt);
+        if (sent <= 0) {
+            IOStatus status = { -1, sent == 0 ? std::make_error_code(std::errc::broken_pipe)
+                                              : std::error_code(errno, std::system_category()) };
+            AIC_LOG(LIBVHAL_ERROR, "SendV() args: fd: %d, sent: %zd, %s", sock_fd_.load(), sent,
+                    status.error.message().c_str());
+            CheckCorrupt(status);
+            return status;
+        }
+        return { sent, {} };
+    }
+
+    IOStatus Recv(uint8_t* data, size_t size, uint8_t flag)
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        if (!connected_) {
+            return { -1, std::make_error_code(std::errc::not_connected) };
+        }
+        std::lock_guard<std::mutex> rx_lock(rx_mutex_);
+        ssize_t received =
+          rx_.Read(data, size, flag & MSG_PEEK, flag & MSG_DONTWAIT);
+        if (received == -1) {
+            IOStatus status = IOStatus::FromErrno();
+            CheckCorrupt(status);
+            return status;
+        }
+        return { received, {} };
+    }
+
+    void Close()
+    {
+        // Wake up a Send() or Recv() blocked on a doorbell before taking the
+        // lock they hold.
+        int sock = sock_fd_;
+        if (sock >= 0) {
+            shutdown(sock, SHUT_RDWR);
+        }
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        connected_ = false;
+        Release();
+    }
+
+private:
+    struct sockaddr_un remote_;
+    size_t             ring_size_;
+    LogRateLimiter     connect_log_limiter_{ std::chrono::seconds(30) };
+
+    // Shared by Send() and Recv(), exclusive for Connect() and Close() which
+    // remap the rings.
+    mutable std::shared_mutex mutex_;
+    // Each ring has a single producer and a single consumer: one sender and
+    // one receiver at a time, so a message is never interleaved with another.
+    std::mutex                tx_mutex_;
+    std::mutex                rx_mutex_;
+    std::atomic<bool>         connected_{ false };
+    std::atomic<int>          sock_fd_{ -1 };
+    int                       epoll_fd_ = -1;
+    int                       fds_[kShmRingNumFds] = { -1, -1, -1, -1, -1 };
+    uint8_t*                  map_                 = nullptr;
+    size_t                    map_size_            = 0;
+    ShmRing                   tx_;
+    ShmRing                   rx_;
+
+    // A ring the server corrupted can't be trusted again: hang up, which
+    // also wakes the other direction, and let the user reconnect.
+    void CheckCorrupt(const IOStatus& status)
+    {
+        if (status.error != std::errc::protocol_error) {
+            return;
+        }
+        AIC_LOG(LIBVHAL_ERROR, "ShmRing with %s corrupted, closing", remote_.sun_path);
+        connected_ = false;
+        shutdown(sock_fd_, SHUT_RDWR);
+    }
+
+    std::string SetupRings()
+    {
+        map_size_             = ShmRingMapSize(ring_size_);
+        fds_[kShmRingMemFd]   = memfd_create("vhal-shm-ring", MFD_CLOEXEC);
+        if (fds_[kShmRingMemFd] < 0
+            || ftruncate(fds_[kShmRingMemFd], map_size_) != 0) {
+            return std::strerror(errno);
+        }
+        for (int i = kShmRingTxDataFd; i < kShmRingNumFds; i++) {
+            fds_[i] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (fds_[i] < 0) {
+                return std::strerror(errno);
+            }
+        }
+        void* map = mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED,
+                         fds_[kShmRingMemFd], 0);
+        if (map == MAP_FAILED) {
+            return std::strerror(errno);
+        }
+        map_        = static_cast<uint8_t*>(map);
+        auto layout = new (map_) shm_ring_layout_t{};
+        uint8_t* data = map_ + ShmRingDataOffset();
+
+        tx_ = ShmRing(&layout->ctrl[0], data, ring_size_,
+                      fds_[kShmRingTxDataFd], fds_[kShmRingTxSpaceFd], sock_fd_);
+        rx_ = ShmRing(&layout->ctrl[1], data + ring_size_, ring_size_,
+                      fds_[kShmRingRxDataFd], fds_[kShmRingRxSpaceFd], sock_fd_);
+
+        // Readable on incoming data or when the server hangs up.
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd_ < 0) {
+            return std::strerror(errno);
+        }
+        struct epoll_event ev = {};
+        ev.events             = EPOLLIN;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fds_[kShmRingRxDataFd], &ev) != 0) {
+            return std::strerror(errno);
+        }
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, sock_fd_, &ev) != 0) {
+            return std::strerror(errno);
+        }
+        return "";
+    }
+
+    std::string Handshake()
+    {
+        shm_ring_hello_t hello = { kShmRingMagic, kShmRingVersion, ring_size_ };
+        struct iovec     iov   = { &hello, sizeof(hello) };
+        char             cmsgbuf[CMSG_SPACE(sizeof(fds_))] = {};
+        struct msghdr    msg   = {};
+        msg.msg_iov            = &iov;
+        msg.msg_iovlen         = 1;
+        msg.msg_control        = cmsgbuf;
+        msg.msg_controllen     = sizeof(cmsgbuf);
+
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level     = SOL_SOCKET;
+        cmsg->cmsg_type      = SCM_RIGHTS;
+        cmsg->cmsg_len       = CMSG_LEN(sizeof(fds_));
+        memcpy(CMSG_DATA(cmsg), fds_, sizeof(fds_));
+
+        if (::sendmsg(sock_fd_, &msg, MSG_NOSIGNAL) != sizeof(hello)) {
+            return std::strerror(errno);
+        }
+
+        // A server that does not know the protocol never answers.
+        struct pollfd pfd = { sock_fd_, POLLIN, 0 };
+        int           r   = ::poll(&pfd, 1, kHandshakeTimeoutMs);
+        if (r <= 0) {
+            return r == 0 ? "no handshake reply" : std::strerror(errno);
+        }
+        shm_ring_ack_t ack = {};
+        if (::recv(sock_fd_, &ack, sizeof(ack), MSG_WAITALL) != sizeof(ack)
+            || ack.magic != kShmRingMagic) {
+            return "invalid handshake reply";
+        }
+        if (ack.status != 0) {
+            return std::strerror(ack.status);
+        }
+        return "";
+    }
+
+    ConnectionResult Fail(std::string error_msg)
+    {
+        Release();
+        return { false, error_msg };
+    }
+
+    void Release()
+    {
+        tx_ = ShmRing();
+        rx_ = ShmRing();
+        if (map_) {
+            munmap(map_, map_size_);
+            map_ = nullptr;
+        }
+        for (auto& fd : fds_) {
+            if (fd >= 0) {
+                close(fd);
+                fd = -1;
+            }
+        }
+        if (epoll_fd_ >= 0) {
+            close(epoll_fd_);
+            epoll_fd_ = -1;
+        }
+        if (sock_fd_ >= 0) {
+            close(sock_fd_);
+            sock_fd_ = -1;
+        }
+    }
+
+    static constexpr int kHandshakeTimeoutMs = 1000;
+};
+
+} // namespace client
+} // namespace vhal
+
+#endif /* SHM_RING_STREAM_CLIENT_IMPL_H */
@@ -0,0 +1,119 @@
+/**
+ * @file start_code_scan.h
+ * @brief Vectorized Annex-B start code search
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef START_CODE_SCAN_H
+#define START_CODE_SCAN_H
+
+#include <cstddef>
+#include <cstdint>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define LIBVHAL_X86_SIMD 1
+#endif
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief Offset of the first 00 00 01 start code in data, or size if there
+ *        is none. Reference implementation, also used for the tails.
+ */
+inline size_t
+FindStartCodeScalar(const uint8_t* data, size_t size)
+{
+    size_t i = 0;
+    while (i + 2 < size) {
+        // A byte above 1 cannot be part of a start code beginning at i, i+1
+        // or i+2, which lets most of the payload be skipped 3 bytes at a time.
+        if (data[i + 2] > 1) {
+            i += 3;
+        } else if (data[i + 2] == 1 && data[i + 1] == 0 && data[i] == 0) {
+            return i;
+        } else {
+            i++;
+        }
+    }
+    return size;
+}
+
+#ifdef LIBVHAL_X86_SIMD
+__attribute__((target("sse2"))) inline size_t
+FindStartCodeSse2(const uint8_t* data, size_t size)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one  = _mm_set1_epi8(1);
+    size_t        i    = 0;
+    // Compares 16 candidate positions at once, reading 2 bytes past them.
+    for (; i + 18 <= size; i += 16) {
+        __m128i b0   = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i b1   = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 1));
+        __m128i b2   = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 2));
+        __m128i hits = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(b0, zero),
+                                                   _mm_cmpeq_epi8(b1, zero)),
+                                     _mm_cmpeq_epi8(b2, one));
+        if (int mask = _mm_movemask_epi8(hits)) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + FindStartCodeScalar(data + i, size - i);
+}
+
+__attribute__((target("avx2"))) inline size_t
+FindStartCodeAvx2(const uint8_t* data, size_t size)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one  = _mm256_set1_epi8(1);
+    size_t        i    = 0;
+    for (; i + 34 <= size; i += 32) {
+        __m256i b0   = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i b1   = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 1));
+        __m256i b2   = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 2));
+        __m256i hits = _mm256_and_si256(_mm256_and_si256(_mm256_cmpeq_epi8(b0, zero),
+                                                         _mm256_cmpeq_epi8(b1, zero)),
+                                        _mm256_cmpeq_epi8(b2, one));
+        if (uint32_t mask = _mm256_movemask_epi8(hits)) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + FindStartCodeSse2(data + i, size - i);
+}
+#endif
+
+/**
+ * @brief Offset of the first 00 00 01 start code in data, or size if there
+ *        is none. Uses AVX2 or SSE2 when the CPU has them.
+ */
+inline size_t
+FindStartCode(const uint8_t* data, size_t size)
+{
+#ifdef LIBVHAL_X86_SIMD
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2 ? FindStartCodeAvx2(data, size) : FindStartCodeSse2(data, size);
+#else
+    return FindStartCodeScalar(data, size);
+#endif
+}
+
+} // namespace client
+} // namespace vhal
+
+#endif /* START_CODE_SCAN_H */
@@ -0,0 +1,462 @@
+/**
+ * @file stream_talker.h
+ * @brief Connect/poll/reconnect loop shared by the VHAL domain objects
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef STREAM_TALKER_H
+#define STREAM_TALKER_H
+
+#include "connection_manager.h"
+#include "istream_socket_client.h"
+#include "izero_copy_socket_client.h"
+#include "reactor.h"
+#include "receiver_log.h"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+extern "C"
+{
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/poll.h>
+#include <unistd.h>
+}
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief Keeps a stream socket connected to its VHAL and dispatches incoming
+ * messages to the owning domain object.
+ *
+ * Without a Reactor the talker runs its own thread, exactly like the domain
+ * objects used to. With a Reactor, connect retries and socket readiness are
+ * driven by the shared reactor thread instead. In both modes Stop() returns
+ * immediately, without waiting for a poll timeout to expire.
+ *
+ * Connect retries are paced by a ConnectionManager: Unix socket VHals are
+ * connected to as soon as their socket shows up, others are retried with a
+ * jittered exponential backoff.
+ */
+class StreamTalker
+{
+public:
+    /**
+     * @brief What to do after a message has been handled.
+     */
+    enum class Status
+    {
+        kContinue,  // keep listening
+        kReconnect, // close the socket and connect again
+        kStop       // close the socket and stop talking
+    };
+
+    using ConnectedHandler = std::function<void()>;
+    using ReadableHandler  = std::function<Status()>;
+
+    StreamTalker(IStreamSocketClient*     socket_client,
+                 std::string              name,
+                 std::shared_ptr<Reactor> reactor,
+                 ConnectedHandler         on_connected,
+                 ReadableHandler          on_readable)
+      : socket_client_{ socket_client },
+        name_{ std::move(name) },
+        reactor_{ std::move(reactor) },
+        on_connected_{ std::move(on_connected) },
+        on_readable_{ std::move(on_readable) },
+        connection_{ socket_client->GetRemotePath() }
+    {}
+
+    ~StreamTalker() { Stop(); }
+
+    StreamTalker(const StreamTalker&) = delete;
+    StreamTalker& operator=(const StreamTalker&) = delete;
+
+    void Start()
+    {
+        if (started_) {
+            return;
+        }
+        started_ = true;
+        BeginWait();
+        if (reactor_) {
+            reactor_->Post([this]() { ReactorConnect(); });
+            return;
+        }
+        wake_fd_ = eventfd(0, EFD_CLOEXEC);
+        if (wake_fd_ < 0) {
+            throw std::system_error(errno, std::system_category());
+        }
+        talker_thread_ = std::thread(&StreamTalker::ThreadProc, this);
+    }
+
+    /**
+     * @brief Stop talking. Once this returns, no handler is running and none
+     *        will be invoked again. Must not be called from a handler.
+     */
+    void Stop()
+    {
+        if (!started_ || stopped_) {
+            return;
+        }
+        if (reactor_) {
+            auto cleanup = [this]() {
+                stopped_ = true;
+                if (retry_timer_) {
+                    reactor_->CancelTimer(retry_timer_);
+                    retry_timer_ = 0;
+                }
+                Unregister();
+                UnwatchEndpoint();
+            };
+            if (reactor_->InLoopThread()) {
+                cleanup();
+            } else {
+                std::promise<void> done;
+                reactor_->Post([&]() {
+                    cleanup();
+                    done.set_value();
+                });
+                done.get_future().wait();
+            }
+            return;
+        }
+        stopped_     = true;
+        uint64_t one = 1;
+        if (write(wake_fd_, &one, sizeof(one)) < 0) {
+            AIC_LOG(LIBVHAL_ERROR, "%s failed to wake talker thread", name_.c_str());
+        }
+        talker_thread_.join();
+        close(wake_fd_);
+        wake_fd_ = -1;
+    }
+
+    /**
+     * @brief Connection timing, time_to_first_frame is only filled in once
+     *        the owner reports it with NoteFirstSend().
+     */
+    ConnectionStats Stats() const
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        return stats_;
+    }
+
+    /**
+     * @brief Called by the owner after each successful send. Only the first
+     *        one on a connection does any work.
+     */
+    void NoteFirstSend()
+    {
+        if (!first_send_pending_.load(std::memory_order_relaxed)
+            || !first_send_pending_.exchange(false)) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.time_to_first_frame = SinceWaitStart();
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // A VHal that is down would otherwise log a failure every second.
+    static constexpr auto kConnectLogInterval = std::chrono::seconds(30);
+
+    IStreamSocketClient*     socket_client_;
+    std::string              name_;
+    std::shared_ptr<Reactor> reactor_;
+    ConnectedHandler         on_connected_;
+    ReadableHandler          on_readable_;
+    std::atomic<bool>        started_ = false;
+    std::atomic<bool>        stopped_ = false;
+    LogRateLimiter           connect_log_limiter_{ kConnectLogInterval };
+    ConnectionManager        connection_;
+
+    mutable std::mutex stats_mutex_;
+    ConnectionStats    stats_;
+    Clock::time_point  wait_start_;
+    bool               waiting_            = false;
+    std::atomic<bool>  first_send_pending_ = false;
+
+    // Own-thread mode
+    std::thread talker_thread_;
+    int         wake_fd_ = -1;
+
+    // Reactor mode, only touched from the reactor thread
+    int              registered_fd_ = -1;
+    int              watched_fd_    = -1;
+    Reactor::TimerId retry_timer_   = 0;
+
+    std::chrono::microseconds SinceWaitStart() const
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now()
+                                                                     - wait_start_);
+    }
+
+    void BeginWait()
+    {
+        first_send_pending_ = false;
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        waiting_                   = true;
+        wait_start_                = Clock::now();
+        stats_.connect_attempts    = 0;
+        stats_.time_to_connect     = std::chrono::microseconds(-1);
+        stats_.time_to_first_frame = std::chrono::microseconds(-1);
+    }
+
+    /**
+     * @return Delay until the next attempt if it failed, zero on success.
+     */
+    std::chrono::milliseconds TryConnect()
+    {
+        if (!waiting_) {
+            // Closed behind our back, e.g. by a failed send.
+            BeginWait();
+        }
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            stats_.connect_attempts++;
+        }
+        if (auto [connected, error_msg] = socket_client_->Connect();
+            !connected) {
+            auto delay = connection_.OnConnectFailed();
+            AIC_LOG_RATE_LIMITED(connect_log_limiter_, LIBVHAL_WARNING,
+                                 "%s Failed to connect to VHal: %s. Retry after %lldms...",
+                                 name_.c_str(), error_msg.c_str(),
+                                 static_cast<long long>(delay.count()));
+            return delay;
+        }
+        connection_.OnConnected();
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            waiting_               = false;
+            stats_.connections++;
+            stats_.time_to_connect = SinceWaitStart();
+        }
+        first_send_pending_ = true;
+        if (on_connected_) {
+            on_connected_();
+        }
+        return std::chrono::milliseconds(0);
+    }
+
+    /**
+     * @brief Sleeps for delay, or until the endpoint shows up or Stop() is
+     *        called.
+     */
+    void WaitForRetry(std::chrono::milliseconds delay)
+    {
+        auto deadline = Clock::now() + delay;
+        while (!stopped_) {
+            auto left =
+              std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now());
+            if (left.count() <= 0) {
+                return;
+            }
+            struct pollfd fds[2] = { { wake_fd_, POLLIN, 0 },
+                                     { connection_.WatchFd(), POLLIN, 0 } };
+            if (poll(fds, std::size(fds), left.count() + 1) > 0 && fds[1].revents
+                && connection_.ConsumeWatchEvents()) {
+                return;
+            }
+        }
+    }
+
+    Status HandleEvents(uint32_t revents)
+    {
+        // Zero-copy completions also raise POLLERR, on a healthy socket.
+        if ((revents & POLLERR) && !(revents & (POLLHUP | POLLNVAL))) {
+            auto zero_copy = dynamic_cast<IZeroCopySocketClient*>(socket_client_);
+            if (zero_copy && zero_copy->ProcessZeroCopyCompletions() >= 0) {
+                revents &= ~POLLERR;
+                if (!revents) {
+                    return Status::kContinue;
+                }
+            }
+        }
+        if (revents & POLLIN) {
+            return on_readable_();
+        }
+        if (revents & (POLLERR | POLLHUP | POLLNVAL)) {
+            AIC_LOG(LIBVHAL_WARNING, "%s Poll Fail event: %u, reconnect", name_.c_str(),
+                    revents);
+            return Status::kReconnect;
+        }
+        AIC_LOG(LIBVHAL_DEBUG, "%s : Poll revents %u", name_.c_str(), revents);
+        return Status::kContinue;
+    }
+
+    void ThreadProc()
+    {
+        while (!stopped_) {
+            if (not socket_client_->Connected()) {
+                if (auto delay = TryConnect(); delay.count()) {
+                    WaitForRetry(delay);
+                    continue;
+                }
+            }
+
+            struct pollfd fds[2];
+            fds[0].fd     = socket_client_->GetNativeSocketFd();
+            fds[0].events = POLLIN;
+            fds[1].fd     = wake_fd_;
+            fds[1].events = POLLIN;
+
+            int ret = poll(fds, std::size(fds), -1);
+            if (ret == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                AIC_LOG(LIBVHAL_ERROR, "%s poll() failed: %s, stop talking", name_.c_str(),
+                        std::strerror(errno));
+                socket_client_->Close();
+                break;
+            }
+            if (fds[1].revents) {
+                break;
+            }
+            Status status = HandleEvents(fds[0].revents);
+            if (status != Status::kContinue) {
+                socket_client_->Close();
+                BeginWait();
+            }
+            if (status == Status::kStop) {
+                break;
+            }
+        }
+    }
+
+    void Unregister()
+    {
+        if (registered_fd_ >= 0) {
+            reactor_->RemoveFd(registered_fd_);
+            registered_fd_ = -1;
+        }
+    }
+
+    void WatchEndpoint()
+    {
+        int fd = connection_.WatchFd();
+        if (fd < 0 || watched_fd_ >= 0) {
+            return;
+        }
+        if (reactor_->AddFd(fd, EPOLLIN, [this](uint32_t) {
+                if (reactor_->Failed()) {
+                    Halt();
+                    return;
+                }
+                if (connection_.ConsumeWatchEvents() && retry_timer_) {
+                    reactor_->CancelTimer(retry_timer_);
+                    ReactorConnect();
+                }
+            })) {
+            watched_fd_ = fd;
+        }
+    }
+
+    void UnwatchEndpoint()
+    {
+        if (watched_fd_ >= 0) {
+            reactor_->RemoveFd(watched_fd_);
+            watched_fd_ = -1;
+        }
+    }
+
+    void ScheduleRetry(std::chrono::milliseconds delay)
+    {
+        retry_timer_ = reactor_->RunAfter(delay, [this]() { ReactorConnect(); });
+        WatchEndpoint();
+    }
+
+    // The reactor can't wait for fd events any more: stop talking, like a
+    // failed poll() does in own-thread mode. Stop() still cleans up.
+    void Halt()
+    {
+        AIC_LOG(LIBVHAL_ERROR, "%s reactor failed, stop talking", name_.c_str());
+        if (retry_timer_) {
+            reactor_->CancelTimer(retry_timer_);
+            retry_timer_ = 0;
+        }
+        Unregister();
+        UnwatchEndpoint();
+        socket_client_->Close();
+    }
+
+    void ReactorConnect()
+    {
+        retry_timer_ = 0;
+        if (stopped_) {
+            return;
+        }
+        if (reactor_->Failed()) {
+            Halt();
+            return;
+        }
+        if (not socket_client_->Connected()) {
+            if (auto delay = TryConnect(); delay.count()) {
+                ScheduleRetry(delay);
+                return;
+            }
+        }
+        UnwatchEndpoint();
+        registered_fd_ = socket_client_->GetNativeSocketFd();
+        if (!reactor_->AddFd(registered_fd_, EPOLLIN, [this](uint32_t events) {
+                OnReactorEvent(events);
+            })) {
+            AIC_LOG(LIBVHAL_ERROR, "%s failed to watch fd %d, reconnect", name_.c_str(),
+                    registered_fd_);
+            registered_fd_ = -1;
+            socket_client_->Close();
+            BeginWait();
+            ScheduleRetry(connection_.OnConnectFailed());
+        }
+    }
+
+    void OnReactorEvent(uint32_t events)
+    {
+        if (reactor_->Failed()) {
+            Halt();
+            return;
+        }
+        Status status = HandleEvents(events);
+        if (status == Status::kContinue) {
+            return;
+        }
+        Unregister();
+        socket_client_->Close();
+        BeginWait();
+        if (status == Status::kReconnect) {
+            // Deferred through a tracked timer, so that Stop() can cancel it.
+            retry_timer_ = reactor_->RunAfter(std::chrono::milliseconds(0),
+                                              [this]() { ReactorConnect(); });
+        }
+    }
+};
+
+} // namespace client
+} // namespace vhal
+
+#endif /* STREAM_TALKER_H */
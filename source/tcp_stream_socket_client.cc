@@ -55,13 +55,37 @@ TcpStreamSocketClient::GetNativeSocketFd() const
 IOResult
 TcpStreamSocketClient::Send(const uint8_t* data, size_t size)
 {
-    return impl_->Send(data, size);
+    return ToIOResult(SendNoAlloc(data, size));
+}
+
+IOResult
+TcpStreamSocketClient::SendV(const struct iovec* iov, int iovcnt)
+{
+    return ToIOResult(SendVNoAlloc(iov, iovcnt));
 }
 
 IOResult
 TcpStreamSocketClient::Recv(uint8_t* data, size_t size, uint8_t flag)
 {
-    return impl_->Recv(data, size);
+    return ToIOResult(RecvNoAlloc(data, size, flag));
+}
+
+IOStatus
+TcpStreamSocketClient::SendNoAlloc(const uint8_t* data, size_t size)
+{
+    return impl_->Send(data, size);
+}
+
+IOStatus
+TcpStreamSocketClient::SendVNoAlloc(const struct iovec* iov, int iovcnt)
+{
+    return impl_->SendV(iov, iovcnt);
+}
+
+IOStatus
+TcpStreamSocketClient::RecvNoAlloc(uint8_t* data, size_t size, uint8_t flag)
+{
+    return impl_->Recv(data, size, flag);
 }
 
 void
@@ -70,5 +94,29 @@ TcpStreamSocketClient::Close()
     impl_->Close();
 }
 
+void
+TcpStreamSocketClient::SetZeroCopy(bool enable, ReleaseCallback on_release)
+{
+    impl_->SetZeroCopy(enable, std::move(on_release));
+}
+
+bool
+TcpStreamSocketClient::ZeroCopyActive() const
+{
+    return impl_->ZeroCopyActive();
+}
+
+IOResult
+TcpStreamSocketClient::SendVZeroCopy(const struct iovec* iov, int iovcnt, uint64_t cookie)
+{
+    return impl_->SendVZeroCopy(iov, iovcnt, cookie);
+}
+
+int
+TcpStreamSocketClient::ProcessZeroCopyCompletions()
+{
+    return impl_->ProcessZeroCopyCompletions();
+}
+
 } // namespace client
 } // namespace vhal
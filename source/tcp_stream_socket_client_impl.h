@@ -20,13 +20,18 @@
 #define TCP_STREAM_SOCKET_CLIENT_IMPL_H
 
 #include "tcp_stream_socket_client.h"
+#include "receiver_log.h"
+#include "sendv_util.h"
+#include "zero_copy_sender.h"
 #include <cerrno>
 #include <cstdlib>
 #include <cstring>
 #include <system_error>
+#include <vector>
 extern "C"
 {
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/types.h>
 #include <sys/un.h>
 #include <arpa/inet.h>
@@ -65,6 +70,9 @@ public:
         if (!connected_) {
             error_msg = std::strerror(errno);
         }
+        if (connected_) {
+            zero_copy_.OnConnected(fd_);
+        }
         return { connected_, error_msg };
     }
 
@@ -72,29 +80,54 @@ public:
 
     int GetNativeSocketFd() const { return fd_; }
 
-    IOResult Send(const uint8_t* data, size_t size)
+    IOStatus Send(const uint8_t* data, size_t size)
     {
-        std::string error_msg = "";
-
         ssize_t sent;
-        if ((sent = ::send(fd_, data, size, 0)) == -1) {
-            std::cout << ". Send() args: fd: " << fd_ << ", sent: " << sent
-                      << ", size: " << size << "\n";
-            error_msg = std::strerror(errno);
+        if ((sent = ::send(fd_, data, size, MSG_NOSIGNAL)) == -1) {
+            IOStatus status = IOStatus::FromErrno();
+            AIC_LOG(LIBVHAL_ERROR, "Send() args: fd: %d, sent: %zd, size: %zu, %s", fd_,
+                    sent, size, status.error.message().c_str());
+            return status;
         }
-        return { sent, error_msg };
+        return { sent, {} };
     }
 
-    IOResult Recv(uint8_t* data, size_t size)
+    IOStatus SendV(const struct iovec* iov, int iovcnt)
     {
-        std::string error_msg = "";
+        SendVProgress progress = SendMsgAll(iov, iovcnt, [this](struct msghdr* msg) -> ssize_t {
+            ssize_t n = ::sendmsg(fd_, msg, MSG_NOSIGNAL);
+            return n == -1 ? -errno : n;
+        });
+        if (progress.error) {
+            errno           = progress.error;
+            IOStatus status = IOStatus::FromErrno();
+            AIC_LOG(LIBVHAL_ERROR, "SendV() args: fd: %d, sent: %zu, size: %zu, %s", fd_,
+                    progress.sent, progress.total, status.error.message().c_str());
+            return status;
+        }
+        return { static_cast<ssize_t>(progress.sent), {} };
+    }
+
+    IOStatus Recv(uint8_t* data, size_t size, uint8_t flag)
+    {
+        if (flag & MSG_DONTWAIT) {
+            // Whatever is available, without waiting for the rest.
+            ssize_t received = ::recv(fd_, data, size, flag);
+            if (received == -1) {
+                return IOStatus::FromErrno();
+            }
+            return { received, {} };
+        }
+        IOStatus status;
         ssize_t left = size;
         while (left > 0 ) {
             ssize_t received = ::recv(fd_,data, left,0);
             if (received <= 0) {
-                std::cout << ". Recv() args: fd: " << fd_ << ", received: " << received
-                      << ", expected size: " << size << "\n";
-                error_msg = std::strerror(errno);
+                if (received == -1) {
+                    status.error = std::error_code(errno, std::system_category());
+                }
+                AIC_LOG(LIBVHAL_ERROR, "Recv() args: fd: %d, received: %zd, expected size: %zu",
+                        fd_, received, size);
                 break;
             }
             else {
@@ -102,18 +135,35 @@ public:
                 left -= received;
             }
         }
-        return { size-left, error_msg };
+        status.size = size - left;
+        return status;
     }
 
+    void SetZeroCopy(bool enable, IZeroCopySocketClient::ReleaseCallback on_release)
+    {
+        zero_copy_.SetEnabled(enable, std::move(on_release));
+    }
+
+    bool ZeroCopyActive() const { return zero_copy_.Active(); }
+
+    IOResult SendVZeroCopy(const struct iovec* iov, int iovcnt, uint64_t cookie)
+    {
+        return zero_copy_.SendV(iov, iovcnt, cookie);
+    }
+
+    int ProcessZeroCopyCompletions() { return zero_copy_.ProcessCompletions(); }
+
     void Close() {
         connected_ = false;
         if (fd_ < 0) return;
+        zero_copy_.OnClosed();
         shutdown(fd_, SHUT_RDWR);
         close(fd_);
         fd_ = -1;
     }
 
 private:
+    ZeroCopySender zero_copy_;
     int  fd_ = -1;
     bool connected_ = false;
     struct sockaddr_in tcp_sock_addr_;
@@ -52,16 +52,46 @@ UnixStreamSocketClient::GetNativeSocketFd() const
     return impl_->GetNativeSocketFd();
 }
 
+std::string
+UnixStreamSocketClient::GetRemotePath() const
+{
+    return impl_->GetRemotePath();
+}
+
 IOResult
 UnixStreamSocketClient::Send(const uint8_t* data, size_t size)
 {
-    return impl_->Send(data, size);
+    return ToIOResult(SendNoAlloc(data, size));
+}
+
+IOResult
+UnixStreamSocketClient::SendV(const struct iovec* iov, int iovcnt)
+{
+    return ToIOResult(SendVNoAlloc(iov, iovcnt));
 }
 
 IOResult
 UnixStreamSocketClient::Recv(uint8_t* data, size_t size, uint8_t flag)
 {
-    return impl_->Recv(data, size);
+    return ToIOResult(RecvNoAlloc(data, size, flag));
+}
+
+IOStatus
+UnixStreamSocketClient::SendNoAlloc(const uint8_t* data, size_t size)
+{
+    return impl_->Send(data, size);
+}
+
+IOStatus
+UnixStreamSocketClient::SendVNoAlloc(const struct iovec* iov, int iovcnt)
+{
+    return impl_->SendV(iov, iovcnt);
+}
+
+IOStatus
+UnixStreamSocketClient::RecvNoAlloc(uint8_t* data, size_t size, uint8_t flag)
+{
+    return impl_->Recv(data, size, flag);
 }
 
 void
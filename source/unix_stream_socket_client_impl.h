@@ -26,13 +26,17 @@
 #define UNIX_STREAM_SOCKET_CLIENT_IMPL_H
 
 #include "unix_stream_socket_client.h"
+#include "receiver_log.h"
+#include "sendv_util.h"
 #include <cerrno>
 #include <cstdlib>
 #include <cstring>
 #include <system_error>
+#include <vector>
 extern "C"
 {
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/types.h>
 #include <sys/un.h>
 #include <unistd.h>
@@ -66,9 +70,10 @@ public:
         }
         connected_ = ::connect(fd_, (struct sockaddr*)&remote_, len) == 0;
         if (!connected_) {
-            std::cout << "Connect() failed args: fd: " << fd_
-                      << ", remote server path: " << remote_.sun_path << "\n";
             error_msg = std::strerror(errno);
+            AIC_LOG_RATE_LIMITED(connect_log_limiter_, LIBVHAL_WARNING,
+                                 "Connect() failed args: fd: %d, remote server path: %s, %s",
+                                 fd_, remote_.sun_path, error_msg.c_str());
         }
         return { connected_, error_msg };
     }
@@ -77,30 +82,48 @@ public:
 
     int GetNativeSocketFd() const { return fd_; }
 
-    IOResult Send(const uint8_t* data, size_t size)
-    {
-        std::string error_msg = "";
+    std::string GetRemotePath() const { return remote_.sun_path; }
 
+    IOStatus Send(const uint8_t* data, size_t size)
+    {
         ssize_t sent;
-        if ((sent = ::send(fd_, data, size, 0)) == -1) {
-            std::cout << ". Send() args: fd: " << fd_ << ", sent: " << sent
-                      << ", size: " << size << "\n";
-            error_msg = std::strerror(errno);
+        if ((sent = ::send(fd_, data, size, MSG_NOSIGNAL)) == -1) {
+            IOStatus status = IOStatus::FromErrno();
+            AIC_LOG(LIBVHAL_ERROR, "Send() args: fd: %d, sent: %zd, size: %zu, %s", fd_,
+                    sent, size, status.error.message().c_str());
+            return status;
         }
-        return { sent, error_msg };
+        return { sent, {} };
     }
 
-    IOResult Recv(uint8_t* data, size_t size)
+    IOStatus SendV(const struct iovec* iov, int iovcnt)
     {
-        std::string error_msg = "";
+        SendVProgress progress = SendMsgAll(iov, iovcnt, [this](struct msghdr* msg) -> ssize_t {
+            ssize_t n = ::sendmsg(fd_, msg, MSG_NOSIGNAL);
+            return n == -1 ? -errno : n;
+        });
+        if (progress.error) {
+            errno           = progress.error;
+            IOStatus status = IOStatus::FromErrno();
+            AIC_LOG(LIBVHAL_ERROR, "SendV() args: fd: %d, sent: %zu, size: %zu, %s", fd_,
+                    progress.sent, progress.total, status.error.message().c_str());
+            return status;
+        }
+        return { static_cast<ssize_t>(progress.sent), {} };
+    }
 
+    IOStatus Recv(uint8_t* data, size_t size, uint8_t flag)
+    {
         ssize_t received;
-        if ((received = ::recv(fd_, data, size, 0)) == -1) {
-            std::cout << ". Recv() args: fd: " << fd_ << ", received: " << received
-                      << ", expected size: " << size << "\n";
-            error_msg = std::strerror(errno);
+        if ((received = ::recv(fd_, data, size, flag)) == -1) {
+            IOStatus status = IOStatus::FromErrno();
+            if (status.error != std::errc::resource_unavailable_try_again) {
+                AIC_LOG(LIBVHAL_ERROR, "Recv() args: fd: %d, received: %zd, expected size: %zu, %s",
+                        fd_, received, size, status.error.message().c_str());
+            }
+            return status;
         }
-        return { received, error_msg };
+        return { received, {} };
     }
 
     void Close() {
@@ -114,6 +137,7 @@ public:
 private:
     int  fd_ = -1;
     bool connected_ = false;
+    LogRateLimiter connect_log_limiter_{ std::chrono::seconds(30) };
 
     struct sockaddr_un remote_;
     std::string        remote_server_socket_path_;
@@ -24,6 +24,7 @@
 
 #include "video_sink.h"
 #include "video_sink_impl.h"
+#include "io_uring_stream_socket_client.h"
 #include "unix_stream_socket_client.h"
 #include "vsock_stream_socket_client.h"
 #include <functional>
@@ -37,7 +38,8 @@
 namespace vhal {
 namespace client {
 
-VideoSink::VideoSink(UnixConnectionInfo unix_conn_info, CameraCallback callback, const int32_t user_id)
+VideoSink::VideoSink(UnixConnectionInfo unix_conn_info, CameraCallback callback, const int32_t user_id,
+                     std::shared_ptr<Reactor> reactor)
 {
     auto sockPath = unix_conn_info.socket_dir;
     if (sockPath.length() == 0) {
@@ -50,21 +52,32 @@ VideoSink::VideoSink(UnixConnectionInfo unix_conn_info, CameraCallback callback,
     }
 
     //Creating interface to communicate to VHAL via libvhal
-    auto unix_sock_client =
+    std::unique_ptr<IStreamSocketClient> unix_sock_client =
       std::make_unique<UnixStreamSocketClient>(std::move(sockPath));
-    impl_ = std::make_unique<Impl>(std::move(unix_sock_client), callback, user_id);
+    if (unix_conn_info.io_uring) {
+        unix_sock_client = std::make_unique<IoUringStreamSocketClient>(
+          std::move(unix_sock_client), unix_conn_info.io_uring);
+    }
+    impl_ = std::make_unique<Impl>(std::move(unix_sock_client), callback, user_id,
+                                   std::move(reactor));
 }
 
-VideoSink::VideoSink(VsockConnectionInfo vsock_conn_info, CameraCallback callback)
+VideoSink::VideoSink(VsockConnectionInfo vsock_conn_info, CameraCallback callback,
+                     std::shared_ptr<Reactor> reactor)
 {
 
     if (vsock_conn_info.android_vm_cid == -1) {
         throw std::invalid_argument("Please set a valid socket_dir");
     }
     //Creating interface to communicate to VHAL via libvhal
-    auto vsock_sock_client =
+    std::unique_ptr<IStreamSocketClient> vsock_sock_client =
       std::make_unique<VsockStreamSocketClient>(std::move(vsock_conn_info.android_vm_cid));
-    impl_ = std::make_unique<Impl>(std::move(vsock_sock_client), callback);
+    if (vsock_conn_info.io_uring) {
+        vsock_sock_client = std::make_unique<IoUringStreamSocketClient>(
+          std::move(vsock_sock_client), vsock_conn_info.io_uring);
+    }
+    impl_ = std::make_unique<Impl>(std::move(vsock_sock_client), callback, -1,
+                                   std::move(reactor));
 }
 
 VideoSink::~VideoSink() {}
@@ -77,7 +90,59 @@ VideoSink::IsConnected()
 
 IOResult VideoSink::SendDataPacket(const uint8_t* packet, size_t size)
 {
-    return impl_->SendDataPacket(packet, size);
+    return impl_->SendDataPacket(packet, size, true);
+}
+
+IOResult VideoSink::SendDataPacket(const uint8_t* packet, size_t size, bool key_frame)
+{
+    return impl_->SendDataPacket(packet, size, key_frame);
+}
+
+IOStatus VideoSink::SendDataPacketNoAlloc(const uint8_t* packet, size_t size, bool key_frame)
+{
+    return impl_->SendDataPacketNoAlloc(packet, size, key_frame);
+}
+
+IOResult VideoSink::SendAccessUnit(const AnnexBPacketizer::access_unit_t& au)
+{
+    return impl_->SendDataPacket(au.data, au.size, au.key_frame);
+}
+
+bool VideoSink::EnableAsyncSend(const async_send_config_t& config)
+{
+    return impl_->EnableAsyncSend(config);
+}
+
+void VideoSink::DisableAsyncSend()
+{
+    impl_->DisableAsyncSend();
+}
+
+bool VideoSink::EnableCongestionControl(const congestion_config_t& config,
+                                        CongestionCallback         callback)
+{
+    return impl_->EnableCongestionControl(config, std::move(callback));
+}
+
+void VideoSink::DisableCongestionControl()
+{
+    impl_->DisableCongestionControl();
+}
+
+bool VideoSink::EnableZeroCopy(PacketReleaseCallback on_release)
+{
+    return impl_->EnableZeroCopy(std::move(on_release));
+}
+
+void VideoSink::DisableZeroCopy()
+{
+    impl_->DisableZeroCopy();
+}
+
+IOResult VideoSink::SendDataPacketZeroCopy(const uint8_t* packet, size_t size,
+                                           uint64_t cookie)
+{
+    return impl_->SendDataPacketZeroCopy(packet, size, cookie);
 }
 
 IOResult VideoSink::SendRawPacket(const uint8_t* packet, size_t size)
@@ -85,6 +150,11 @@ IOResult VideoSink::SendRawPacket(const uint8_t* packet, size_t size)
     return impl_->SendRawPacket(packet, size);
 }
 
+IOStatus VideoSink::SendRawPacketNoAlloc(const uint8_t* packet, size_t size)
+{
+    return impl_->SendRawPacketNoAlloc(packet, size);
+}
+
 std::shared_ptr<VideoSink::camera_capability_t>
 VideoSink::GetCameraCapabilty()
 {
@@ -96,5 +166,166 @@ VideoSink::SetCameraCapabilty(std::vector<camera_info_t> camera_info)
 {
     return impl_->SetCameraCapabilty(camera_info);
 }
+
+std::future<std::shared_ptr<VideoSink::camera_capability_t>>
+VideoSink::GetCameraCapabiltyAsync(std::chrono::milliseconds timeout)
+{
+    return impl_->GetCameraCapabiltyAsync(timeout);
+}
+
+std::future<bool>
+VideoSink::SetCameraCapabiltyAsync(std::vector<camera_info_t> camera_info,
+                                   std::chrono::milliseconds  timeout)
+{
+    return impl_->SetCameraCapabiltyAsync(camera_info, timeout);
+}
+
+double
+VideoSink::DefaultFps()
+{
+    return kDefaultFps;
+}
+
+bool
+VideoSink::StartFrameProducer(double fps, FrameProducer producer,
+                              FramePacer::OverrunPolicy policy)
+{
+    return impl_->StartFrameProducer(fps, std::move(producer), policy);
+}
+
+void
+VideoSink::StopFrameProducer()
+{
+    impl_->StopFrameProducer();
+}
+
+FramePacer::stats_t
+VideoSink::GetFramePacerStats()
+{
+    return impl_->GetFramePacerStats();
+}
+
+ConnectionStats
+VideoSink::GetConnectionStats()
+{
+    return impl_->GetConnectionStats();
+}
+
+bool
+VideoSink::EnableBufferPool(const buffer_pool_config_t& config)
+{
+    return impl_->EnableBufferPool(config);
+}
+
+void
+VideoSink::DisableBufferPool()
+{
+    impl_->DisableBufferPool();
+}
+
+bool
+VideoSink::AcquireFrameBuffer(frame_buffer_t& buffer, std::chrono::milliseconds timeout)
+{
+    return impl_->AcquireFrameBuffer(buffer, timeout);
+}
+
+IOResult
+VideoSink::SendFrameBuffer(uint32_t index, size_t size)
+{
+    return impl_->SendFrameBuffer(index, size);
+}
+
+IOResult
+VideoSink::SendRawFrame(const raw_image_t& image, bool downscale)
+{
+    return impl_->SendRawFrame(image, downscale);
+}
+
+VideoSink::camera_telemetry_t
+VideoSink::GetTelemetry()
+{
+    return impl_->GetTelemetry();
+}
+
+std::shared_ptr<VideoSink::CameraStream>
+VideoSink::OpenCameraStream(uint32_t camera_id, CameraCallback callback)
+{
+    auto stream = impl_->AddCameraStream(camera_id, std::move(callback));
+    if (!stream) {
+        return nullptr;
+    }
+    return std::shared_ptr<CameraStream>(new CameraStream(std::move(stream)));
+}
+
+VideoSink::CameraStream::CameraStream(std::shared_ptr<Impl> impl)
+  : impl_{ std::move(impl) }
+{}
+
+VideoSink::CameraStream::~CameraStream()
+{
+    impl_->Detach(true);
+}
+
+uint32_t
+VideoSink::CameraStream::CameraId() const
+{
+    return impl_->CameraId();
+}
+
+bool
+VideoSink::CameraStream::IsOpen() const
+{
+    return impl_->IsOpen();
+}
+
+IOResult
+VideoSink::CameraStream::SendDataPacket(const uint8_t* packet, size_t size,
+                                        bool key_frame)
+{
+    return impl_->SendDataPacket(packet, size, key_frame);
+}
+
+IOResult
+VideoSink::CameraStream::SendAccessUnit(const AnnexBPacketizer::access_unit_t& au)
+{
+    return impl_->SendDataPacket(au.data, au.size, au.key_frame);
+}
+
+bool
+VideoSink::CameraStream::EnableAsyncSend(const async_send_config_t& config)
+{
+    return impl_->EnableAsyncSend(config);
+}
+
+void
+VideoSink::CameraStream::DisableAsyncSend()
+{
+    impl_->DisableAsyncSend();
+}
+
+bool
+VideoSink::CameraStream::StartFrameProducer(double fps, FrameProducer producer,
+                                            FramePacer::OverrunPolicy policy)
+{
+    return impl_->StartFrameProducer(fps, std::move(producer), policy);
+}
+
+void
+VideoSink::CameraStream::StopFrameProducer()
+{
+    impl_->StopFrameProducer();
+}
+
+VideoSink::camera_stream_stats_t
+VideoSink::CameraStream::Stats() const
+{
+    return impl_->Stats();
+}
+
+VideoSink::camera_telemetry_t
+VideoSink::CameraStream::Telemetry() const
+{
+    return impl_->Telemetry();
+}
 }; // namespace client
 } // namespace vhal
@@ -25,22 +25,38 @@
 #ifndef VIDEO_SINK_IMPL_H
 #define VIDEO_SINK_IMPL_H
 
+#include "camera_negotiator.h"
+#include "camera_stream_impl.h"
+#include "congestion_monitor.h"
+#include "frame_buffer_pool.h"
+#include "frame_producer.h"
+#include "frame_send_queue.h"
+#include "framed_reader.h"
+#include "framed_writer.h"
 #include "istream_socket_client.h"
+#include "izero_copy_socket_client.h"
+#include "receiver_log.h"
+#include "send_telemetry.h"
+#include "stream_talker.h"
 #include "video_sink.h"
 #include <atomic>
 #include <chrono>
 #include <functional>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <string>
 #include <cstring>
 #include <system_error>
 extern "C"
 {
+#include <linux/sockios.h>
+#include <sys/ioctl.h>
 #include <sys/poll.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 }
 #include <thread>
 #include <tuple>
@@ -56,107 +72,42 @@ namespace client {
 class VideoSink::Impl
 {
 public:
-    Impl(unique_ptr<IStreamSocketClient> socket_client, CameraCallback callback, const int32_t user_id = -1)
-      : socket_client_{ move(socket_client) },
-        callback_{ move(callback) }
-    {
-        vhal_talker_thread_ = thread([this, user_id]() {
-            while (should_continue_) {
-                if (not socket_client_->Connected()) {
-                    if (auto [connected, error_msg] = socket_client_->Connect();
-                        !connected) {
-                        cout << "VideoSink Failed to connect to VHal: "
-                             << error_msg
-                             << ". Retry after 1s...\n";
-                        this_thread::sleep_for(1s);
-                        continue;
-                    }
-                    cout << "Connected to Camera VHal!, Sending user_id: " << user_id << "\n";
-                    if (user_id != -1) {
-                        camera_header_t header_packet{};
-                        header_packet.type = VideoSink::camera_packet_type_t::CAMERA_USER_ID;
-                        header_packet.size = sizeof(user_id);
-                        SendRawPacket((unsigned char*)&header_packet, sizeof(camera_header_t));
-                        SendRawPacket((unsigned char*)&user_id, sizeof(user_id));
-                    }
-                }
-
-                struct pollfd fds[1];
-                const int     timeout_ms = 1 * 1000; // 1 sec timeout
-                int           ret;
-
-                // watch socket for input
-                fds[0].fd     = socket_client_->GetNativeSocketFd();
-                fds[0].events = POLLIN;
-                cmd_capability_ = std::make_shared<camera_capability_t>();
-                // connected ...
-                do {
-                    ret = poll(fds, std::size(fds), timeout_ms);
-                    if (ret == -1) {
-                        throw system_error(errno, system_category());
-                    }
-                    if (!ret) {
-                        continue;
-                    }
-                    if (!(fds[0].revents & POLLIN)) {
-                        if (fds[0].revents & (POLLERR|POLLHUP|POLLNVAL)) {
-                            cout << "VideoSink Poll Fail event: "
-                                << fds[0].revents
-                                << ", reconnect\n";
-                            socket_client_->Close();
-                            break;
-                        }
-                        cout << "VideoSink : Poll revents " << fds[0].revents << "\n";
-                        continue;
-                    }
-                    cout << "Camera VHal has some message for us!\n";
-
-                    size_t header_size = sizeof(camera_header_t);
-                    camera_header_t cmd_header;
-                    std::tuple<ssize_t, std::string> response;
-  
-                    response = RecvPacket(
-                        reinterpret_cast<uint8_t*>(&cmd_header),
-                        header_size);
-                    if (get<0>(response) != header_size) {
-                        cout << "Failed to read camera_header_t from VideoSink: "
-                             << get<1>(response)
-                             << ", going to disconnect and reconnect.\n";
-                        socket_client_->Close();
-                        // FIXME: What to do ?? Exit ?
-                        continue;
-                    }
-                    switch(cmd_header.type) {
-                        case camera_packet_type_t::CAPABILITY:
-                            cout <<"received capability" <<"\n";
-                            if (!handle_capability())
-                                continue;
-                            break;
-
-                        case camera_packet_type_t::ACK:
-                            cout <<"received ack" <<"\n";
-                            if (!handle_ack())
-                                continue;
-                            break;
-
-                        case camera_packet_type_t::CAMERA_CONFIG:
-                            cout <<"received config" <<"\n";
-                            if (!handle_cmd())
-                                continue;
-                            break;
-                        default :
-                            cout <<"invalid header type received "<<"\n";
-                            break;
-                    }
-                } while (should_continue_);
-            }
-        });
+    Impl(unique_ptr<IStreamSocketClient> socket_client,
+         CameraCallback                  callback,
+         const int32_t                   user_id = -1,
+         shared_ptr<Reactor>             reactor = nullptr)
+      : callback_{ move(callback) },
+        socket_client_{ move(socket_client) },
+        user_id_{ user_id },
+        reader_{ socket_client_.get() },
+        talker_{ socket_client_.get(),
+                 "VideoSink",
+                 move(reactor),
+                 [this]() { OnConnected(); },
+                 [this]() { return OnMessage(); } }
+    {
+        talker_.Start();
     }
 
     ~Impl()
     {
-        should_continue_ = false;
-        vhal_talker_thread_.join();
+        StopFrameProducer();
+        talker_.Stop();
+        // Unblocks a writer stuck on a stalled VHal, and releases zero-copy
+        // packets in flight while the state they use is still there.
+        socket_client_->Close();
+        map<uint32_t, shared_ptr<CameraStream::Impl>> streams;
+        {
+            lock_guard<std::mutex> lock(streams_mutex_);
+            streams.swap(streams_);
+        }
+        for (auto& [id, stream] : streams) {
+            stream->Detach();
+        }
+        auto queue = TakeSendQueue(nullptr);
+        if (queue) {
+            queue->Stop();
+        }
     }
 
     bool IsConnected()
@@ -164,94 +115,355 @@ public:
         return socket_client_->Connected();
     }
 
-    IOResult SendDataPacket(const uint8_t* packet, size_t size)
+    ConnectionStats GetConnectionStats() { return talker_.Stats(); }
+
+    camera_telemetry_t GetTelemetry()
     {
-        std::string result_error_msg = "";
-        camera_header_t data_header = {VideoSink::camera_packet_type_t::CAMERA_DATA, size};
-        std::tuple<ssize_t, std::string> response;
-        // Write payload size
-        response = socket_client_->Send((uint8_t*)&data_header, sizeof(data_header));
-        if (get<0>(response) == -1) {
-                get<1>(response) = "Error in writing payload size to Camera VHal: "
-                  + get<1>(response);
-                return response;
+        auto telemetry           = telemetry_.Snapshot();
+        telemetry.socket_backlog = SocketBacklog();
+        return telemetry;
+    }
+
+    bool StartFrameProducer(double fps, FrameProducer producer,
+                            FramePacer::OverrunPolicy policy)
+    {
+        return producer_.Start(fps, move(producer), policy);
+    }
+
+    void StopFrameProducer() { producer_.Stop(); }
+
+    FramePacer::stats_t GetFramePacerStats() { return producer_.Stats(); }
+
+    bool EnableBufferPool(const buffer_pool_config_t& config)
+    {
+        // fds only travel over unix sockets.
+        if (socket_client_->GetRemotePath().empty()) {
+            AIC_LOG(LIBVHAL_ERROR, "Camera buffer pool needs the unix socket transport");
+            return false;
+        }
+        std::string error;
+        shared_ptr<FrameBufferPool> pool = FrameBufferPool::Create(config, error);
+        if (!pool) {
+            AIC_LOG(LIBVHAL_ERROR, "Failed to create camera buffer pool: %s", error.c_str());
+            return false;
+        }
+        auto old = TakeBufferPool(pool);
+        if (old) {
+            old->Shutdown();
+        }
+        if (socket_client_->Connected()) {
+            RegisterBufferPool(*pool);
+        }
+        return true;
+    }
+
+    void DisableBufferPool()
+    {
+        auto old = TakeBufferPool(nullptr);
+        if (old) {
+            old->Shutdown();
+        }
+    }
+
+    bool AcquireFrameBuffer(frame_buffer_t& buffer, std::chrono::milliseconds timeout)
+    {
+        auto pool = GetBufferPool();
+        return pool && pool->Acquire(buffer, timeout);
+    }
+
+    IOResult SendFrameBuffer(uint32_t index, size_t size)
+    {
+        auto pool = GetBufferPool();
+        if (!pool) {
+            return { -1, "No camera buffer pool enabled" };
+        }
+        if (!pool->MarkReady(index, size)) {
+            return { -1, "Camera buffer " + std::to_string(index)
+                           + " is not acquired or too small" };
+        }
+        NoteKeyFrame();
+        camera_header_t     header = { camera_packet_type_t::CAMERA_BUFFER_READY,
+                                       sizeof(camera_buffer_msg_t) };
+        camera_buffer_msg_t ready  = { pool->Generation(), index,
+                                       static_cast<uint32_t>(size), 0 };
+        struct iovec        iov[2] = { { &header, sizeof(header) },
+                                       { &ready, sizeof(ready) } };
+        auto start  = SendTelemetry::Clock::now();
+        auto status = writer_.Write(FramedWriter::Lane::kBulk, iov, std::size(iov));
+        if (status.size == -1) {
+            NoteSend(start, size, false);
+            pool->Release(index);
+            return ToPayloadResult(status);
+        }
+        NoteSend(start, size, true);
+        talker_.NoteFirstSend();
+        return { static_cast<ssize_t>(size), "" };
+    }
+
+    IOResult SendRawFrame(const raw_image_t& image, bool downscale)
+    {
+        const size_t size = I420FrameSize(image.width, image.height, downscale);
+        if (size == 0) {
+            return { -1, "Unsupported raw image dimensions" };
+        }
+        if (auto pool = GetBufferPool()) {
+            frame_buffer_t buffer;
+            if (!pool->Acquire(buffer, kFrameBufferWait)) {
+                return { -1, "No free camera buffer" };
             }
-        // Write payload
-        response = socket_client_->Send(packet, size);
-        if (get<0>(response) == -1) {
-                get<1>(response) = "Error in writing payload to Camera VHal: "
-                  + get<1>(response);
-                return response;
+            if (!ConvertToI420(image, buffer.data, buffer.size, downscale)) {
+                pool->Release(buffer.index);
+                return { -1, "Failed to convert raw image into camera buffer" };
             }
+            return SendFrameBuffer(buffer.index, size);
+        }
+        NoteKeyFrame();
+        lock_guard<std::mutex> lock(convert_mutex_);
+        convert_buffer_.resize(size);
+        if (!ConvertToI420(image, convert_buffer_.data(), size, downscale)) {
+            return { -1, "Failed to convert raw image" };
+        }
+        return SendRawPacket(convert_buffer_.data(), size);
+    }
 
-        // success
-        return response;
+    shared_ptr<CameraStream::Impl> AddCameraStream(uint32_t camera_id,
+                                                   CameraCallback callback)
+    {
+        lock_guard<std::mutex> lock(streams_mutex_);
+        if (streams_.count(camera_id)) {
+            return nullptr;
+        }
+        auto stream = make_shared<CameraStream::Impl>(
+          camera_id, move(callback),
+          [this](const uint8_t* data, size_t size) {
+              return WriteDataPacketNoAlloc(data, size);
+          },
+          [this]() { return GetCongestionMonitor(); },
+          [this, camera_id]() {
+              lock_guard<std::mutex> lock(streams_mutex_);
+              streams_.erase(camera_id);
+          });
+        streams_.emplace(camera_id, stream);
+        return stream;
     }
 
-    IOResult SendRawPacket(const uint8_t* packet, size_t size)
+    IOResult SendDataPacket(const uint8_t* packet, size_t size, bool key_frame)
     {
-      	std::tuple<ssize_t, std::string> response;
+        return ToPayloadResult(SendDataPacketNoAlloc(packet, size, key_frame));
+    }
 
-        // Write payload
-        response = socket_client_->Send(packet, size);
-        if (get<0>(response) == -1) {
-                get<1>(response) = "Error in writing payload to Camera VHal: "
-                  + get<1>(response);
-                return response;
+    IOStatus SendDataPacketNoAlloc(const uint8_t* packet, size_t size, bool key_frame)
+    {
+        if (CongestionDrop(key_frame)) {
+            return { 0, {} };
+        }
+        shared_ptr<FrameSendQueue> queue;
+        {
+            lock_guard<std::mutex> lock(send_queue_mutex_);
+            queue = send_queue_;
         }
+        if (!queue) {
+            return WriteDataPacketNoAlloc(packet, size);
+        }
+        queue->Push(packet, size, key_frame);
+        telemetry_.RecordQueueDepth(queue->Depth());
+        return { static_cast<ssize_t>(size), {} };
+    }
 
-        // success
-        return response;
+    bool EnableAsyncSend(const async_send_config_t& config)
+    {
+        if (config.queue_depth == 0) {
+            return false;
+        }
+        // Frames dropped by the queue need a key frame to resync the decoder.
+        async_send_config_t queue_config = config;
+        queue_config.on_complete = [this, on_complete = config.on_complete](
+                                     const send_completion_t& completion) {
+            if (completion.dropped) {
+                telemetry_.RecordDrop();
+                if (auto monitor = GetCongestionMonitor()) {
+                    monitor->OnDropped();
+                }
+            }
+            if (on_complete) {
+                on_complete(completion);
+            }
+        };
+        auto queue = make_shared<FrameSendQueue>(
+          queue_config, [this](const uint8_t* data, size_t size) {
+              return WriteDataPacket(data, size);
+          });
+        auto old = TakeSendQueue(move(queue));
+        if (old) {
+            old->Stop();
+        }
+        return true;
     }
 
-    std::shared_ptr<camera_capability_t> GetCameraCapabilty()
+    void DisableAsyncSend()
     {
-        std::tuple<ssize_t, std::string> response;
-        camera_header_t header_packet{};
+        auto old = TakeSendQueue(nullptr);
+        if (old) {
+            old->Stop();
+        }
+    }
 
-        header_packet.type = VideoSink::camera_packet_type_t::REQUEST_CAPABILITY;
-        response = SendRawPacket((unsigned char*)&header_packet, sizeof(camera_header_t));
-        if (get<0>(response) == -1) {
-            get<1>(response) = "Error in sending request capability header to Camera VHal: "
-              + get<1>(response);
-            return NULL;
+    bool EnableCongestionControl(const congestion_config_t& config,
+                                 CongestionCallback         callback)
+    {
+        if (config.congested_frames == 0 || config.clear_frames == 0) {
+            return false;
         }
+        auto monitor = make_shared<CongestionMonitor>(config, move(callback));
+        lock_guard<std::mutex> lock(congestion_mutex_);
+        congestion_monitor_ = move(monitor);
+        return true;
+    }
 
-        std::unique_lock<std::mutex> lck(mutex_);
-        wait_api_data.wait(lck);
+    void DisableCongestionControl()
+    {
+        lock_guard<std::mutex> lock(congestion_mutex_);
+        congestion_monitor_ = nullptr;
+    }
 
-        cout << " returning GetCameraCapabilty result" << "\n";
-        return cmd_capability_;
+    bool EnableZeroCopy(PacketReleaseCallback on_release)
+    {
+        auto zero_copy = dynamic_cast<IZeroCopySocketClient*>(socket_client_.get());
+        if (!zero_copy) {
+            return false;
+        }
+        {
+            lock_guard<std::mutex> lock(zero_copy_mutex_);
+            on_packet_release_ = move(on_release);
+        }
+        zero_copy->SetZeroCopy(true, [this](uint64_t id, bool) { OnZeroCopyRelease(id); });
+        zero_copy_ = zero_copy;
+        return true;
     }
 
-    bool SetCameraCapabilty(std::vector<camera_info_t> camera_info)
+    void DisableZeroCopy()
     {
-        std::tuple<ssize_t, std::string> response;
-        
-        camera_header_t header_packet;
-        header_packet.type = camera_packet_type_t::CAMERA_INFO;
-        header_packet.size = camera_info.size() * sizeof(camera_info_t);
+        if (zero_copy_) {
+            zero_copy_->SetZeroCopy(false, [this](uint64_t id, bool) { OnZeroCopyRelease(id); });
+        }
+    }
 
-        response = SendRawPacket((unsigned char*)&header_packet, sizeof(camera_header_t));
-        if (get<0>(response) == -1) {
-            get<1>(response) = "Error in sending config header to Camera VHal: "
-              + get<1>(response);
-            return false;
+    IOResult SendDataPacketZeroCopy(const uint8_t* packet, size_t size, uint64_t cookie)
+    {
+        bool queued;
+        {
+            lock_guard<std::mutex> lock(send_queue_mutex_);
+            queued = send_queue_ != nullptr;
+        }
+        if (!zero_copy_ || !zero_copy_->ZeroCopyActive() || queued
+            || size < kZeroCopyMinSize) {
+            auto response = SendDataPacket(packet, size, true);
+            PacketReleaseCallback on_release;
+            {
+                lock_guard<std::mutex> lock(zero_copy_mutex_);
+                on_release = on_packet_release_;
+            }
+            if (on_release) {
+                on_release(cookie);
+            }
+            return response;
         }
 
-        response = SendRawPacket((uint8_t *)(camera_info.data()),
-                                 camera_info.size() * sizeof(camera_info_t));
+        NoteKeyFrame();
+
+        // The header is sent without copy too, keep it until released.
+        camera_header_t* header;
+        uint64_t         id;
+        {
+            lock_guard<std::mutex> lock(zero_copy_mutex_);
+            id          = next_zero_copy_id_++;
+            auto& entry = zero_copy_packets_[id];
+            entry.cookie = cookie;
+            entry.header = { VideoSink::camera_packet_type_t::CAMERA_DATA,
+                             static_cast<uint32_t>(size) };
+            header = &entry.header;
+        }
+        struct iovec iov[2] = { { header, sizeof(*header) },
+                                { const_cast<uint8_t*>(packet), size } };
+        auto start    = SendTelemetry::Clock::now();
+        auto response = writer_.Exclusive(FramedWriter::Lane::kBulk, [&]() {
+            return zero_copy_->SendVZeroCopy(iov, std::size(iov), id);
+        });
         if (get<0>(response) == -1) {
-            get<1>(response) = "Error in sending config to Camera VHal: "
+            NoteSend(start, size, false);
+            get<1>(response) = "Error in writing payload to Camera VHal: "
               + get<1>(response);
-            return false;
+            return response;
         }
+        NoteSend(start, size, true);
+        talker_.NoteFirstSend();
+        return { size, "" };
+    }
 
-        std::unique_lock<std::mutex> lck(mutex_);
-        wait_api_data.wait(lck);
-        cout << " returning SetCameraCapabilty result" << "\n";
+    IOResult WriteDataPacket(const uint8_t* packet, size_t size)
+    {
+        return ToPayloadResult(WriteDataPacketNoAlloc(packet, size));
+    }
 
-        return true;
+    IOStatus WriteDataPacketNoAlloc(const uint8_t* packet, size_t size)
+    {
+        camera_header_t data_header = { VideoSink::camera_packet_type_t::CAMERA_DATA,
+                                        static_cast<uint32_t>(size) };
+        // Write header and payload in one go
+        struct iovec iov[2] = { { &data_header, sizeof(data_header) },
+                                { const_cast<uint8_t*>(packet), size } };
+        auto start  = SendTelemetry::Clock::now();
+        auto status = writer_.Write(FramedWriter::Lane::kBulk, iov, std::size(iov));
+        if (status.size == -1) {
+            NoteSend(start, size, false);
+            return status;
+        }
+        NoteSend(start, size, true);
+
+        // success
+        talker_.NoteFirstSend();
+        return { static_cast<ssize_t>(size), {} };
+    }
+
+    IOResult SendRawPacket(const uint8_t* packet, size_t size)
+    {
+        return ToPayloadResult(SendRawPacketNoAlloc(packet, size));
+    }
+
+    IOStatus SendRawPacketNoAlloc(const uint8_t* packet, size_t size)
+    {
+        // Write payload
+        auto start  = SendTelemetry::Clock::now();
+        auto status = writer_.Write(FramedWriter::Lane::kBulk, packet, size);
+        NoteSend(start, size, status.size != -1);
+        return status;
+    }
+
+    std::future<shared_ptr<camera_capability_t>>
+    GetCameraCapabiltyAsync(std::chrono::milliseconds timeout)
+    {
+        return negotiator_.RequestCapability(CameraNegotiator::Clock::now() + timeout);
+    }
+
+    std::future<bool> SetCameraCapabiltyAsync(const std::vector<camera_info_t>& camera_info,
+                                              std::chrono::milliseconds         timeout)
+    {
+        return negotiator_.SendCameraInfo(camera_info,
+                                          CameraNegotiator::Clock::now() + timeout);
+    }
+
+    std::shared_ptr<camera_capability_t> GetCameraCapabilty()
+    {
+        auto capability = GetCameraCapabiltyAsync(kNegotiationTimeout).get();
+        AIC_LOG(LIBVHAL_DEBUG, "returning GetCameraCapabilty result");
+        return capability;
+    }
+
+    bool SetCameraCapabilty(const std::vector<camera_info_t>& camera_info)
+    {
+        bool acked = SetCameraCapabiltyAsync(camera_info, kNegotiationTimeout).get();
+        AIC_LOG(LIBVHAL_DEBUG, "returning SetCameraCapabilty result");
+        return acked;
     }
 
     bool handle_ack()
@@ -264,13 +476,12 @@ public:
             reinterpret_cast<uint8_t*>(&ack_pkt),
             ack_pkt_size);
         if (get<0>(response) != ack_pkt_size) {
-            cout << "Failed to read ack_pkt from VideoSink: "
-                 << get<1>(response)
-                 << ", going to disconnect and reconnect.\n";
-            socket_client_->Close();
+            AIC_LOG(LIBVHAL_ERROR,
+                    "Failed to read ack_pkt from VideoSink: %s, going to disconnect and reconnect.",
+                    get<1>(response).c_str());
             return false;
         }
-        wait_api_data.notify_one();
+        negotiator_.OnAck(ack_pkt);
         return true;
     }
     bool handle_capability()
@@ -278,19 +489,21 @@ public:
         size_t capability_pkt_size = sizeof(camera_capability_t);
         std::tuple<ssize_t, std::string> response;
 
+        camera_capability_t capability;
         response = RecvPacket(
-            reinterpret_cast<uint8_t*>(cmd_capability_.get()),
+            reinterpret_cast<uint8_t*>(&capability),
             capability_pkt_size);
         if (get<0>(response) != capability_pkt_size) {
-            cout << "Failed to read capability from VideoSink: "
-                 << get<1>(response)
-                 << ", going to disconnect and reconnect.\n";
-            socket_client_->Close();
+            AIC_LOG(LIBVHAL_ERROR,
+                    "Failed to read capability from VideoSink: %s, going to disconnect and reconnect.",
+                    get<1>(response).c_str());
             return false;
             // FIXME: What to do ?? Exit ?
         }
-        cout <<"params: codec type:"<<cmd_capability_->codec_type <<", resolution:"<<cmd_capability_->resolution<<"\n";
-        wait_api_data.notify_one();
+        AIC_LOG(LIBVHAL_INFO, "params: codec type: %d, resolution: %d",
+                static_cast<int>(capability.codec_type),
+                static_cast<int>(capability.resolution));
+        negotiator_.OnCapability(capability);
 
         return true;
     }
@@ -304,36 +517,320 @@ public:
             reinterpret_cast<uint8_t*>(&cmd_pkt),
             cmd_pkt_size);
         if (get<0>(response) != cmd_pkt_size) {
-            cout << "Failed to read camera_config from VideoSink: "
-                 << get<1>(response)
-                 << ", going to disconnect and reconnect.\n";
-            socket_client_->Close();
+            AIC_LOG(LIBVHAL_ERROR,
+                    "Failed to read camera_config from VideoSink: %s, going to disconnect and reconnect.",
+                    get<1>(response).c_str());
             return false;
             // FIXME: What to do ?? Exit ?
         }
 
-        cout << "camera cmd received "<< (int)cmd_pkt.cmd <<"\n";
-        callback_(cref(cmd_pkt));
+        AIC_LOG(LIBVHAL_DEBUG, "camera cmd received %d for camera %u",
+                static_cast<int>(cmd_pkt.cmd), cmd_pkt.camera_config.cameraId);
+        auto stream = RouteCommand(cmd_pkt);
+        if (stream) {
+            stream->OnCommand(cmd_pkt);
+        } else if (callback_) {
+            callback_(cref(cmd_pkt));
+        }
         return true;
     }
 
 
+    bool handle_buffer_release()
+    {
+        camera_buffer_msg_t release;
+        auto response = RecvPacket(reinterpret_cast<uint8_t*>(&release), sizeof(release));
+        if (get<0>(response) != sizeof(release)) {
+            AIC_LOG(LIBVHAL_ERROR,
+                    "Failed to read buffer release from VideoSink: %s, going to disconnect and reconnect.",
+                    get<1>(response).c_str());
+            return false;
+        }
+        auto pool = GetBufferPool();
+        if (pool && pool->Generation() == release.generation
+            && !pool->ReleaseInFlight(release.index)) {
+            AIC_LOG(LIBVHAL_WARNING, "Camera VHal released buffer %u which is not in flight",
+                    release.index);
+        }
+        return true;
+    }
+
+    /**
+     * Tracks which camera the VHal streams from: data packets carry no
+     * camera id, they belong to the camera opened last. Returns the stream
+     * of the camera the command is for, if any.
+     */
+    shared_ptr<CameraStream::Impl> RouteCommand(const camera_config_cmd_t& cmd)
+    {
+        const uint32_t                 id = cmd.camera_config.cameraId;
+        shared_ptr<CameraStream::Impl> target;
+        lock_guard<std::mutex>         lock(streams_mutex_);
+        for (auto& [stream_id, stream] : streams_) {
+            if (cmd.cmd == camera_cmd_t::CMD_OPEN) {
+                stream->SetOpen(stream_id == id);
+            } else if (cmd.cmd == camera_cmd_t::CMD_CLOSE && stream_id == id) {
+                stream->SetOpen(false);
+            }
+            if (stream_id == id) {
+                target = stream;
+            }
+        }
+        return target;
+    }
+
+    void OnConnected()
+    {
+        telemetry_.RecordConnected();
+        reader_.Reset();
+        {
+            // A new VHal session starts with every camera closed.
+            lock_guard<std::mutex> lock(streams_mutex_);
+            for (auto& [id, stream] : streams_) {
+                stream->SetOpen(false);
+            }
+        }
+        AIC_LOG(LIBVHAL_INFO, "Connected to Camera VHal!, Sending user_id: %d", user_id_);
+        if (user_id_ != -1) {
+            camera_header_t header_packet{};
+            header_packet.type = VideoSink::camera_packet_type_t::CAMERA_USER_ID;
+            header_packet.size = sizeof(user_id_);
+            int32_t      id     = user_id_;
+            struct iovec iov[2] = { { &header_packet, sizeof(header_packet) },
+                                    { &id, sizeof(id) } };
+            writer_.Write(FramedWriter::Lane::kControl, iov, std::size(iov));
+        }
+        if (auto pool = GetBufferPool()) {
+            pool->ReleaseInFlight();
+            RegisterBufferPool(*pool);
+        }
+        // After the user id, which the VHal expects first.
+        negotiator_.OnConnected();
+    }
+
+    void RegisterBufferPool(const FrameBufferPool& pool)
+    {
+        auto status = writer_.Exclusive(FramedWriter::Lane::kControl, [&]() {
+            return pool.Register(socket_client_->GetNativeSocketFd());
+        });
+        if (status.size == -1) {
+            AIC_LOG(LIBVHAL_ERROR, "Failed to register camera buffer pool: %s",
+                    status.error.message().c_str());
+        }
+    }
+
+    StreamTalker::Status OnMessage()
+    {
+        AIC_LOG(LIBVHAL_DEBUG, "Camera VHal has some message for us!");
+
+        // Drain every message the last fill brought in; poll() won't report
+        // them again.
+        StreamTalker::Status status;
+        do {
+            status = HandleMessage();
+        } while (status == StreamTalker::Status::kContinue &&
+                 reader_.Buffered() >= sizeof(camera_header_t));
+        return status;
+    }
+
+    StreamTalker::Status HandleMessage()
+    {
+        size_t header_size = sizeof(camera_header_t);
+        camera_header_t cmd_header;
+        std::tuple<ssize_t, std::string> response;
+
+        response = RecvPacket(
+            reinterpret_cast<uint8_t*>(&cmd_header),
+            header_size);
+        if (get<0>(response) != (ssize_t)header_size) {
+            AIC_LOG(LIBVHAL_ERROR,
+                    "Failed to read camera_header_t from VideoSink: %s, going to disconnect and reconnect.",
+                    get<1>(response).c_str());
+            return StreamTalker::Status::kReconnect;
+        }
+        switch(cmd_header.type) {
+            case camera_packet_type_t::CAPABILITY:
+                AIC_LOG(LIBVHAL_DEBUG, "received capability");
+                if (!handle_capability())
+                    return StreamTalker::Status::kReconnect;
+                break;
+
+            case camera_packet_type_t::ACK:
+                AIC_LOG(LIBVHAL_DEBUG, "received ack");
+                if (!handle_ack())
+                    return StreamTalker::Status::kReconnect;
+                break;
+
+            case camera_packet_type_t::CAMERA_CONFIG:
+                AIC_LOG(LIBVHAL_DEBUG, "received config");
+                if (!handle_cmd())
+                    return StreamTalker::Status::kReconnect;
+                break;
+
+            case camera_packet_type_t::CAMERA_BUFFER_RELEASE:
+                if (!handle_buffer_release())
+                    return StreamTalker::Status::kReconnect;
+                break;
+            default :
+                AIC_LOG(LIBVHAL_WARNING, "invalid header type received");
+                break;
+        }
+        return StreamTalker::Status::kContinue;
+    }
+
 private:
     CameraCallback                  callback_ = nullptr;
     unique_ptr<IStreamSocketClient> socket_client_;
-    thread                          vhal_talker_thread_;
-    atomic<bool>                    should_continue_ = true;
+    int32_t                         user_id_ = -1;
+    FramedReader                    reader_;
+
+    std::mutex                 send_queue_mutex_;
+    shared_ptr<FrameSendQueue> send_queue_;
 
-    std::shared_ptr<camera_capability_t> cmd_capability_;
-    std::mutex mutex_;
-    std::condition_variable wait_api_data;
+    // Below this size copying is cheaper than the page pinning and
+    // completion handling of MSG_ZEROCOPY.
+    static constexpr size_t kZeroCopyMinSize = 16 * 1024;
+
+    struct zero_copy_packet_t {
+        uint64_t        cookie;
+        camera_header_t header;
+    };
+
+    IZeroCopySocketClient*                 zero_copy_ = nullptr;
+    std::mutex                             zero_copy_mutex_;
+    PacketReleaseCallback                  on_packet_release_;
+    std::map<uint64_t, zero_copy_packet_t> zero_copy_packets_;
+    uint64_t                               next_zero_copy_id_ = 0;
+
+    FrameProducerThread producer_;
+
+    std::mutex                  buffer_pool_mutex_;
+    shared_ptr<FrameBufferPool> buffer_pool_;
+
+    // One frame interval at kDefaultFps.
+    static constexpr auto kFrameBufferWait = 33ms;
+
+    std::mutex      convert_mutex_;
+    vector<uint8_t> convert_buffer_;
+
+    SendTelemetry telemetry_;
+
+    std::mutex                    congestion_mutex_;
+    shared_ptr<CongestionMonitor> congestion_monitor_;
+
+    // Every write to the VHal goes through here, control ahead of frames.
+    FramedWriter writer_{ *socket_client_ };
+
+    std::mutex                                    streams_mutex_;
+    map<uint32_t, shared_ptr<CameraStream::Impl>> streams_;
+
+    CameraNegotiator negotiator_{ [this](const std::vector<uint8_t>& message) {
+        return writer_.Write(FramedWriter::Lane::kControl, message.data(), message.size())
+                 .size != -1;
+    } };
+
+    // Declared last: stopped before the state its handlers use goes away.
+    StreamTalker talker_;
+
+    void OnZeroCopyRelease(uint64_t id)
+    {
+        uint64_t              cookie;
+        PacketReleaseCallback on_release;
+        {
+            lock_guard<std::mutex> lock(zero_copy_mutex_);
+            auto it = zero_copy_packets_.find(id);
+            if (it == zero_copy_packets_.end()) {
+                return;
+            }
+            cookie = it->second.cookie;
+            zero_copy_packets_.erase(it);
+            on_release = on_packet_release_;
+        }
+        if (on_release) {
+            on_release(cookie);
+        }
+    }
+
+    // The string API keeps its historical error message.
+    static IOResult ToPayloadResult(const IOStatus& status)
+    {
+        if (status.size == -1) {
+            return { -1, "Error in writing payload to Camera VHal: "
+                           + status.error.message() };
+        }
+        return ToIOResult(status);
+    }
+
+    shared_ptr<CongestionMonitor> GetCongestionMonitor()
+    {
+        lock_guard<std::mutex> lock(congestion_mutex_);
+        return congestion_monitor_;
+    }
+
+    // Asks the congestion monitor about a frame, counting it if dropped.
+    bool CongestionDrop(bool key_frame)
+    {
+        auto monitor = GetCongestionMonitor();
+        if (!monitor || !monitor->ShouldDrop(key_frame)) {
+            return false;
+        }
+        telemetry_.RecordDrop();
+        return true;
+    }
+
+    // Raw frames and zero-copy packets decode on their own: never dropped,
+    // they end the wait for a key frame like one.
+    void NoteKeyFrame()
+    {
+        if (auto monitor = GetCongestionMonitor()) {
+            monitor->ShouldDrop(true);
+        }
+    }
+
+    int64_t SocketBacklog()
+    {
+        int queued = 0;
+        int fd     = socket_client_->GetNativeSocketFd();
+        if (fd < 0 || ioctl(fd, SIOCOUTQ, &queued) != 0) {
+            return -1;
+        }
+        return queued;
+    }
+
+    void NoteSend(SendTelemetry::Clock::time_point start, size_t size, bool sent)
+    {
+        if (!sent) {
+            telemetry_.RecordError(start);
+            return;
+        }
+        telemetry_.RecordSend(size, start);
+        if (auto monitor = GetCongestionMonitor()) {
+            monitor->OnSent(SendTelemetry::Clock::now() - start, SocketBacklog());
+        }
+    }
+
+    shared_ptr<FrameSendQueue> TakeSendQueue(shared_ptr<FrameSendQueue> queue)
+    {
+        lock_guard<std::mutex> lock(send_queue_mutex_);
+        send_queue_.swap(queue);
+        return queue;
+    }
+
+    shared_ptr<FrameBufferPool> TakeBufferPool(shared_ptr<FrameBufferPool> pool)
+    {
+        lock_guard<std::mutex> lock(buffer_pool_mutex_);
+        buffer_pool_.swap(pool);
+        return pool;
+    }
+
+    shared_ptr<FrameBufferPool> GetBufferPool()
+    {
+        lock_guard<std::mutex> lock(buffer_pool_mutex_);
+        return buffer_pool_;
+    }
 
     IOResult RecvPacket(uint8_t* packet, size_t size)
     {
-        std::tuple<ssize_t, std::string> response;
-        response = socket_client_->Recv(
-            packet, size, MSG_WAITALL);
-        return response;
+        return reader_.Read(packet, size);
     }
 };
 
@@ -18,6 +18,7 @@
  */
 
 #include "virtual_gps_receiver.h"
+#include "connection_manager.h"
 #include "receiver_log.h"
 #include <arpa/inet.h>
 #include <errno.h>
@@ -53,6 +54,7 @@ VirtualGpsReceiver::~VirtualGpsReceiver()
         std::unique_lock<std::mutex> lock(mMutex);
         mStop = true;
     }
+    mStopCond.notify_all();
     if (mSockGps >= 0) {
         Disconnect();
     }
@@ -199,6 +201,7 @@ VirtualGpsReceiver::Read(uint8_t* buf, size_t len)
 void
 VirtualGpsReceiver::workThreadProc()
 {
+    ConnectBackoff backoff;
     while (true) {
         {
             std::unique_lock<std::mutex> lock(mMutex);
@@ -215,10 +218,12 @@ VirtualGpsReceiver::workThreadProc()
                     "Not connected to GPS server. Need to connect again.");
             IOResult ior = Connect();
             if (!std::get<0>(ior)) {
-                sleep(3);
-                AIC_LOG(LIBVHAL_ERROR, "Try to connect GPS server again");
+                std::unique_lock<std::mutex> lock(mMutex);
+                mStopCond.wait_for(lock, backoff.Next(), [this] { return mStop; });
+                AIC_LOG(LIBVHAL_DEBUG, "Try to connect GPS server again");
                 continue;
             } else {
+                backoff.Reset();
                 AIC_LOG(LIBVHAL_DEBUG, "Connected to GPS server.");
             }
         }
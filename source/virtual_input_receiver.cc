@@ -217,9 +217,8 @@ VirtualInputReceiver::ProcessOneCommand(const std::string& cmd)
                 (uint32_t)x > kMaxPositionX || y < 0 ||
                 (uint32_t)y > kMaxPositionY || pressure < 0 ||
                 (uint32_t)pressure > kMaxPressure) {
-                printf(
-                  "%s: Error: Parameter error. slot=%d x=%d y=%d pressure=%d\n",
-                  __func__,
+                AIC_LOG(LIBVHAL_ERROR,
+                  "Parameter error. slot=%d x=%d y=%d pressure=%d",
                   slot,
                   x,
                   y,
@@ -231,7 +230,7 @@ VirtualInputReceiver::ProcessOneCommand(const std::string& cmd)
         case 'u': // up
             sscanf(cmd.c_str(), "%c %d", &type, &slot);
             if (slot < 0 || (uint32_t)slot > kMaxSlot) {
-                printf("%s: Error: Parameter error. slot=%d\n", __func__, slot);
+                AIC_LOG(LIBVHAL_ERROR, "Parameter error. slot=%d", slot);
                 return false;
             }
             SendUp(slot);
@@ -248,9 +247,8 @@ VirtualInputReceiver::ProcessOneCommand(const std::string& cmd)
                 (uint32_t)x > kMaxPositionX || y < 0 ||
                 (uint32_t)y > kMaxPositionY || pressure < 0 ||
                 (uint32_t)pressure > kMaxPressure) {
-                printf(
-                  "%s: Error: Parameter error. slot=%d x=%d y=%d pressure=%d\n",
-                  __func__,
+                AIC_LOG(LIBVHAL_ERROR,
+                  "Parameter error. slot=%d x=%d y=%d pressure=%d",
                   slot,
                   x,
                   y,
@@ -262,7 +260,7 @@ VirtualInputReceiver::ProcessOneCommand(const std::string& cmd)
         case 'w': // wait ms
             sscanf(cmd.c_str(), "%c %d", &type, &ms);
             if (ms <= 0) {
-                printf("%s: Error: Parameter error. ms=%d\n", __func__, ms);
+                AIC_LOG(LIBVHAL_ERROR, "Parameter error. ms=%d", ms);
                 return false;
             }
             SendWait(ms);
@@ -336,7 +334,7 @@ bool
 VirtualInputReceiver::ProcessOneJoystickCommand(const std::string& cmd)
 {
     if (mDebug)
-        printf("%s\n", __func__);
+        AIC_LOG(LIBVHAL_DEBUG, "%s", __func__);
 
     char     type = 0;
     uint16_t code;
@@ -345,7 +343,7 @@ VirtualInputReceiver::ProcessOneJoystickCommand(const std::string& cmd)
     switch (cmd[0]) {
         case 'c': // Commit
             if (mDebug)
-                printf("SendCommit\n");
+                AIC_LOG(LIBVHAL_DEBUG, "SendCommit");
             SendCommit();
             break;
 
@@ -356,7 +354,7 @@ VirtualInputReceiver::ProcessOneJoystickCommand(const std::string& cmd)
                    &code,
                    &value);
             if (mDebug)
-                printf("code = %d, value = %d\n", code, value);
+                AIC_LOG(LIBVHAL_DEBUG, "code = %d, value = %d", code, value);
             SendEvent(EV_KEY, code, value);
             break;
 
@@ -367,7 +365,7 @@ VirtualInputReceiver::ProcessOneJoystickCommand(const std::string& cmd)
                    &code,
                    &value);
             if (mDebug)
-                printf("code = %d, value = %d\n", code, value);
+                AIC_LOG(LIBVHAL_DEBUG, "code = %d, value = %d", code, value);
             SendEvent(EV_MSC, code, value);
             break;
 
@@ -378,32 +376,32 @@ VirtualInputReceiver::ProcessOneJoystickCommand(const std::string& cmd)
                    &code,
                    &value);
             if (mDebug)
-                printf("code = %d, value = %d\n", code, value);
+                AIC_LOG(LIBVHAL_DEBUG, "code = %d, value = %d", code, value);
             SendEvent(EV_ABS, code, value);
             break;
         case 'i': // insert joystick
             if (mDebug)
-                printf("%s:%d enable joystick down\n", __func__, __LINE__);
+                AIC_LOG(LIBVHAL_DEBUG, "enable joystick down");
             SendEvent(EV_KEY, 631, 1);
             SendCommit();
 
             usleep(2000);
 
             if (mDebug)
-                printf("%s:%d enable joystick up\n", __func__, __LINE__);
+                AIC_LOG(LIBVHAL_DEBUG, "enable joystick up");
             SendEvent(EV_KEY, 631, 0);
             SendCommit();
             break;
         case 'p': // pull out joystick
             if (mDebug)
-                printf("%s:%d disable joystick down\n", __func__, __LINE__);
+                AIC_LOG(LIBVHAL_DEBUG, "disable joystick down");
             SendEvent(EV_KEY, 632, 1);
             SendCommit();
 
             usleep(2000);
 
             if (mDebug)
-                printf("%s:%d disable joystick up\n", __func__, __LINE__);
+                AIC_LOG(LIBVHAL_DEBUG, "disable joystick up");
             SendEvent(EV_KEY, 632, 0);
             SendCommit();
 
@@ -420,7 +418,7 @@ VirtualInputReceiver::onKeyCode(uint16_t scanCode, uint32_t mask)
     std::string error_msg = "";
 
     if (mDebug)
-        printf("%s\n", __func__);
+        AIC_LOG(LIBVHAL_DEBUG, "%s", __func__);
 
     if (mask & KEY_STATE_MASK::Shift) {
         SendEvent(EV_KEY, KEY_LEFTSHIFT, 1);
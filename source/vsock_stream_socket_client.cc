@@ -54,12 +54,35 @@ VsockStreamSocketClient::GetNativeSocketFd() const
 IOResult
 VsockStreamSocketClient::Send(const uint8_t* data, size_t size)
 {
+    return ToIOResult(SendNoAlloc(data, size));
+}
 
-    return impl_->Send(data, size);
+IOResult
+VsockStreamSocketClient::SendV(const struct iovec* iov, int iovcnt)
+{
+    return ToIOResult(SendVNoAlloc(iov, iovcnt));
 }
 
 IOResult
 VsockStreamSocketClient::Recv(uint8_t* data, size_t size, uint8_t flag)
+{
+    return ToIOResult(RecvNoAlloc(data, size, flag));
+}
+
+IOStatus
+VsockStreamSocketClient::SendNoAlloc(const uint8_t* data, size_t size)
+{
+    return impl_->Send(data, size);
+}
+
+IOStatus
+VsockStreamSocketClient::SendVNoAlloc(const struct iovec* iov, int iovcnt)
+{
+    return impl_->SendV(iov, iovcnt);
+}
+
+IOStatus
+VsockStreamSocketClient::RecvNoAlloc(uint8_t* data, size_t size, uint8_t flag)
 {
     return impl_->Recv(data, size, flag);
 }
@@ -70,5 +93,29 @@ VsockStreamSocketClient::Close()
     impl_->Close();
 }
 
+void
+VsockStreamSocketClient::SetZeroCopy(bool enable, ReleaseCallback on_release)
+{
+    impl_->SetZeroCopy(enable, std::move(on_release));
+}
+
+bool
+VsockStreamSocketClient::ZeroCopyActive() const
+{
+    return impl_->ZeroCopyActive();
+}
+
+IOResult
+VsockStreamSocketClient::SendVZeroCopy(const struct iovec* iov, int iovcnt, uint64_t cookie)
+{
+    return impl_->SendVZeroCopy(iov, iovcnt, cookie);
+}
+
+int
+VsockStreamSocketClient::ProcessZeroCopyCompletions()
+{
+    return impl_->ProcessZeroCopyCompletions();
+}
+
 } // namespace client
 } // namespace vhal
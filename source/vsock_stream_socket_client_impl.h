@@ -26,16 +26,21 @@
 #define VSOCK_STREAM_SOCKET_CLIENT_IMPL_H
 
 #include "vsock_stream_socket_client.h"
+#include "receiver_log.h"
+#include "sendv_util.h"
+#include "zero_copy_sender.h"
 #include <cerrno>
 #include <cstdlib>
 #include <cstring>
 #include <system_error>
+#include <vector>
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <linux/vm_sockets.h>
 extern "C"
 {
     #include <sys/socket.h>
+    #include <sys/uio.h>
     #include<netdb.h>	//hostent
     #include<arpa/inet.h>
     #include <sys/types.h>
@@ -65,7 +70,6 @@ public:
     ConnectionResult Connect()
     {
         std::string error_msg = "";
-        std::cout << "cid " << server_.svm_cid << " port " << server_.svm_port;
         if (fd_ >= 0) {
             Close();
         }
@@ -75,9 +79,13 @@ public:
         }
         connected_ = ::connect(fd_, (struct sockaddr*)&server_, sizeof(server_)) == 0;
         if (!connected_) {
-            std::cout << "Connect() failed args: fd: " << fd_
-                      << ", remote server path: ";
             error_msg = std::strerror(errno);
+            AIC_LOG_RATE_LIMITED(connect_log_limiter_, LIBVHAL_WARNING,
+                                 "Connect() failed args: fd: %d, cid %u port %u, %s", fd_,
+                                 server_.svm_cid, server_.svm_port, error_msg.c_str());
+        }
+        if (connected_) {
+            zero_copy_.OnConnected(fd_);
         }
         return { connected_, error_msg };
     }
@@ -86,44 +94,78 @@ public:
 
     int GetNativeSocketFd() const { return fd_; }
 
-    IOResult Send(const uint8_t* data, size_t size)
+    IOStatus Send(const uint8_t* data, size_t size)
     {
-        std::string error_msg = "";
-
-        ssize_t sent = ::send(fd_, data, size, 0);
+        ssize_t sent = ::send(fd_, data, size, MSG_NOSIGNAL);
         if (sent  == -1) {
-            std::cout << ". Send() args: fd: " << fd_ << ", sent: " << sent
-                      << ", size: " << size << "\n";
-            error_msg = std::strerror(errno);
+            IOStatus status = IOStatus::FromErrno();
+            AIC_LOG(LIBVHAL_ERROR, "Send() args: fd: %d, sent: %zd, size: %zu, %s", fd_,
+                    sent, size, status.error.message().c_str());
+            return status;
         }
-        return { sent, error_msg };
+        return { sent, {} };
     }
 
-    IOResult Recv(uint8_t* data, size_t size, uint8_t flag)
+    IOStatus SendV(const struct iovec* iov, int iovcnt)
+    {
+        SendVProgress progress = SendMsgAll(iov, iovcnt, [this](struct msghdr* msg) -> ssize_t {
+            ssize_t n = ::sendmsg(fd_, msg, MSG_NOSIGNAL);
+            return n == -1 ? -errno : n;
+        });
+        if (progress.error) {
+            errno           = progress.error;
+            IOStatus status = IOStatus::FromErrno();
+            AIC_LOG(LIBVHAL_ERROR, "SendV() args: fd: %d, sent: %zu, size: %zu, %s", fd_,
+                    progress.sent, progress.total, status.error.message().c_str());
+            return status;
+        }
+        return { static_cast<ssize_t>(progress.sent), {} };
+    }
+
+    IOStatus Recv(uint8_t* data, size_t size, uint8_t flag)
     {
-        std::string error_msg = "";
         ssize_t received = ::recv(fd_, data, size, flag);
         if (received  == -1) {
-            std::cout << ". Recv() args: fd: " << fd_ << ", received: " << received
-                      << ", size: " << size << "\n";
-            error_msg = std::strerror(errno);
+            IOStatus status = IOStatus::FromErrno();
+            if (status.error != std::errc::resource_unavailable_try_again) {
+                AIC_LOG(LIBVHAL_ERROR, "Recv() args: fd: %d, received: %zd, size: %zu, %s", fd_,
+                        received, size, status.error.message().c_str());
+            }
+            return status;
         }
-        return { received, error_msg };
+        return { received, {} };
+    }
+
+
+    void SetZeroCopy(bool enable, IZeroCopySocketClient::ReleaseCallback on_release)
+    {
+        zero_copy_.SetEnabled(enable, std::move(on_release));
+    }
+
+    bool ZeroCopyActive() const { return zero_copy_.Active(); }
+
+    IOResult SendVZeroCopy(const struct iovec* iov, int iovcnt, uint64_t cookie)
+    {
+        return zero_copy_.SendV(iov, iovcnt, cookie);
     }
 
+    int ProcessZeroCopyCompletions() { return zero_copy_.ProcessCompletions(); }
 
     void Close() {
         connected_ = false;
         if (fd_ < 0) return;
+        zero_copy_.OnClosed();
         shutdown(fd_, SHUT_RDWR);
         close(fd_);
         fd_ = -1;
     }
 
 private:
+    ZeroCopySender zero_copy_;
     int  fd_ = -1;
     bool connected_ = false;
     struct sockaddr_vm server_;
+    LogRateLimiter connect_log_limiter_{ std::chrono::seconds(30) };
 };
 
 } // namespace client
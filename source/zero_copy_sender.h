@@ -0,0 +1,293 @@
+/**
+ * @file zero_copy_sender.h
+ * @brief MSG_ZEROCOPY send path and completion tracking shared by TCP and vsock clients
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ZERO_COPY_SENDER_H
+#define ZERO_COPY_SENDER_H
+
+#include "izero_copy_socket_client.h"
+#include "receiver_log.h"
+#include "sendv_util.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <vector>
+extern "C"
+{
+#include <linux/errqueue.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+}
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief Per-socket MSG_ZEROCOPY state. The kernel numbers zero-copy
+ * sendmsg() calls from 0 on each socket and reports completed ranges of
+ * those numbers on the error queue; this maps them back to the cookies of
+ * SendVZeroCopy() calls. Assumes a single sending thread, completions may
+ * be processed from any thread.
+ */
+class ZeroCopySender
+{
+public:
+    void SetEnabled(bool enable, IZeroCopySocketClient::ReleaseCallback on_release)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        enabled_    = enable;
+        on_release_ = std::move(on_release);
+        if (fd_ >= 0) {
+            ApplyLocked();
+        }
+    }
+
+    void OnConnected(int fd)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fd_      = fd;
+        next_id_ = 0;
+        ApplyLocked();
+    }
+
+    /**
+     * Notifications of a closed socket are lost, release what is pending.
+     */
+    void OnClosed()
+    {
+        std::vector<Entry> released;
+        IZeroCopySocketClient::ReleaseCallback on_release;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            fd_     = -1;
+            active_ = false;
+            released.assign(pending_.begin(), pending_.end());
+            pending_.clear();
+            on_release = on_release_;
+        }
+        Release(on_release, released);
+    }
+
+    bool Active() const { return active_; }
+
+    IOResult SendV(const struct iovec* iov, int iovcnt, uint64_t cookie)
+    {
+        bool zero_copy = active_;
+        if (zero_copy) {
+            Drain(false);
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_.push_back({ cookie, next_id_, 0, 0, true, false });
+        }
+
+        SendVProgress progress = SendMsgAll(iov, iovcnt, [&](struct msghdr* msg) -> ssize_t {
+            int flags = MSG_NOSIGNAL;
+            if (zero_copy && active_) {
+                flags |= MSG_ZEROCOPY;
+            }
+            ssize_t n = ::sendmsg(fd_, msg, flags);
+            if (n == -1 && errno == ENOBUFS && (flags & MSG_ZEROCOPY)) {
+                // Too many notifications outstanding (optmem limit): reap
+                // them and copy this chunk.
+                Drain(false);
+                flags &= ~MSG_ZEROCOPY;
+                n = ::sendmsg(fd_, msg, flags);
+            }
+            if (n == -1) {
+                return -errno;
+            }
+            if (flags & MSG_ZEROCOPY) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                next_id_++;
+                pending_.back().issued++;
+            }
+            return n;
+        });
+        std::string error_msg = "";
+        if (progress.error) {
+            error_msg = std::strerror(progress.error);
+            AIC_LOG(LIBVHAL_ERROR, "SendVZeroCopy() args: fd: %d, sent: %zu, size: %zu, %s", fd_,
+                    progress.sent, progress.total, error_msg.c_str());
+        }
+
+        if (zero_copy) {
+            std::vector<Entry> released;
+            IZeroCopySocketClient::ReleaseCallback on_release;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto& e   = pending_.back();
+                e.sending = false;
+                e.copied |= e.issued == 0;
+                CollectLocked(released);
+                on_release = on_release_;
+            }
+            Release(on_release, released);
+        } else {
+            IZeroCopySocketClient::ReleaseCallback on_release;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                on_release = on_release_;
+            }
+            if (on_release) {
+                on_release(cookie, true);
+            }
+        }
+
+        if (!error_msg.empty()) {
+            return { -1, error_msg };
+        }
+        return { static_cast<ssize_t>(progress.sent), "" };
+    }
+
+    int ProcessCompletions() { return Drain(true); }
+
+private:
+    struct Entry
+    {
+        uint64_t cookie;
+        uint32_t first;   // id of the first zero-copy sendmsg
+        uint32_t issued;  // zero-copy sendmsg calls made
+        uint32_t done;    // of which completed
+        bool     sending; // more calls may follow
+        bool     copied;
+    };
+
+    std::mutex                             mutex_;
+    IZeroCopySocketClient::ReleaseCallback on_release_;
+    std::deque<Entry>                      pending_;
+    bool                                   enabled_ = false;
+    std::atomic<bool>                      active_{ false };
+    int                                    fd_      = -1;
+    uint32_t                               next_id_ = 0;
+
+    int Drain(bool check_error)
+    {
+        int                count = 0;
+        std::vector<Entry> released;
+        IZeroCopySocketClient::ReleaseCallback on_release;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (fd_ < 0) {
+                return 0;
+            }
+            char          control[128];
+            struct msghdr msg = {};
+            while (true) {
+                msg.msg_control    = control;
+                msg.msg_controllen = sizeof(control);
+                if (::recvmsg(fd_, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    break;
+                }
+                for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+                     cmsg      = CMSG_NXTHDR(&msg, cmsg)) {
+                    auto err = reinterpret_cast<const struct sock_extended_err*>(
+                      CMSG_DATA(cmsg));
+                    if (err->ee_errno != 0
+                        || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                        continue;
+                    }
+                    bool copied = err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED;
+                    Complete(err->ee_info, err->ee_data, copied);
+                    count++;
+                }
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                count = -1;
+            } else if (check_error) {
+                int       sock_err = 0;
+                socklen_t len      = sizeof(sock_err);
+                if (getsockopt(fd_, SOL_SOCKET, SO_ERROR, &sock_err, &len) == 0
+                    && sock_err != 0) {
+                    count = -1;
+                }
+            }
+            CollectLocked(released);
+            on_release = on_release_;
+        }
+        Release(on_release, released);
+        return count;
+    }
+
+    void ApplyLocked()
+    {
+        int one = 1;
+        active_ = enabled_ && fd_ >= 0
+                  && setsockopt(fd_, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+        if (enabled_ && fd_ >= 0 && !active_) {
+            AIC_LOG(LIBVHAL_WARNING, "SO_ZEROCOPY unsupported on fd: %d, %s, copying", fd_,
+                    std::strerror(errno));
+        }
+    }
+
+    // Ids in [lo, hi] completed.
+    void Complete(uint32_t lo, uint32_t hi, bool copied)
+    {
+        if (copied && active_) {
+            // Deferred copies cost more than plain ones, stop asking.
+            active_ = false;
+            AIC_LOG(LIBVHAL_WARNING, "MSG_ZEROCOPY fd: %d falls back to copies, copying from now on",
+                    fd_);
+        }
+        for (auto& e : pending_) {
+            uint64_t end = e.sending ? UINT32_MAX + 1ULL : (uint64_t)e.first + e.issued;
+            uint64_t from = std::max<uint64_t>(lo, e.first);
+            uint64_t to   = std::min<uint64_t>((uint64_t)hi + 1, end);
+            if (from < to) {
+                e.done += to - from;
+                e.copied |= copied;
+            }
+        }
+    }
+
+    void CollectLocked(std::vector<Entry>& released)
+    {
+        for (auto it = pending_.begin(); it != pending_.end();) {
+            if (!it->sending && it->done >= it->issued) {
+                released.push_back(*it);
+                it = pending_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    static void Release(const IZeroCopySocketClient::ReleaseCallback& on_release,
+                        const std::vector<Entry>&                    released)
+    {
+        if (!on_release) {
+            return;
+        }
+        for (auto& e : released) {
+            on_release(e.cookie, e.copied);
+        }
+    }
+};
+
+} // namespace client
+} // namespace vhal
+
+#endif /* ZERO_COPY_SENDER_H */
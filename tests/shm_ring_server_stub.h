@@ -0,0 +1,178 @@
+/**
+ * @file shm_ring_server_stub.h
+ * @brief Minimal ring-aware VHAL server used by the ShmRingStreamClient tests
+ * @version 1.0
+ *
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef SHM_RING_SERVER_STUB_H
+#define SHM_RING_SERVER_STUB_H
+
+#include "shm_ring.h"
+#include <cstring>
+#include <string>
+extern "C"
+{
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+}
+
+namespace vhal {
+namespace client {
+
+/**
+ * @brief Server side of the shm_ring.h handshake: accepts one client, maps
+ * its rings with the directions swapped and exposes blocking Send()/Recv().
+ */
+class ShmRingServerStub
+{
+public:
+    explicit ShmRingServerStub(const std::string& path) : path_{ path }
+    {
+        unlink(path_.c_str());
+        listen_fd_         = socket(AF_UNIX, SOCK_STREAM, 0);
+        struct sockaddr_un addr = {};
+        addr.sun_family    = AF_UNIX;
+        strncpy(addr.sun_path, path_.c_str(), sizeof(addr.sun_path) - 1);
+        bind(listen_fd_, (struct sockaddr*)&addr, sizeof(addr));
+        listen(listen_fd_, 1);
+    }
+
+    ~ShmRingServerStub()
+    {
+        Hangup();
+        close(listen_fd_);
+        unlink(path_.c_str());
+    }
+
+    /**
+     * @brief Accept a client and complete the handshake.
+     *
+     * @param ack_status status sent back, non zero to refuse the client.
+     */
+    bool Accept(int32_t ack_status = 0)
+    {
+        conn_fd_ = accept(listen_fd_, nullptr, nullptr);
+        if (conn_fd_ < 0) {
+            return false;
+        }
+
+        shm_ring_hello_t hello = {};
+        struct iovec     iov   = { &hello, sizeof(hello) };
+        char             cmsgbuf[CMSG_SPACE(sizeof(fds_))] = {};
+        struct msghdr    msg   = {};
+        msg.msg_iov            = &iov;
+        msg.msg_iovlen         = 1;
+        msg.msg_control        = cmsgbuf;
+        msg.msg_controllen     = sizeof(cmsgbuf);
+        if (recvmsg(conn_fd_, &msg, MSG_WAITALL) != sizeof(hello)
+            || hello.magic != kShmRingMagic
+            || hello.version != kShmRingVersion) {
+            return false;
+        }
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        if (cmsg == nullptr || cmsg->cmsg_type != SCM_RIGHTS
+            || cmsg->cmsg_len != CMSG_LEN(sizeof(fds_))) {
+            return false;
+        }
+        memcpy(fds_, CMSG_DATA(cmsg), sizeof(fds_));
+
+        map_size_ = ShmRingMapSize(hello.ring_size);
+        void* map = mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED,
+                         fds_[kShmRingMemFd], 0);
+        if (map == MAP_FAILED) {
+            return false;
+        }
+        map_          = static_cast<uint8_t*>(map);
+        auto layout   = reinterpret_cast<shm_ring_layout_t*>(map_);
+        uint8_t* data = map_ + ShmRingDataOffset();
+        rx_ = ShmRing(&layout->ctrl[0], data, hello.ring_size,
+                      fds_[kShmRingTxDataFd], fds_[kShmRingTxSpaceFd], conn_fd_);
+        tx_ = ShmRing(&layout->ctrl[1], data + hello.ring_size, hello.ring_size,
+                      fds_[kShmRingRxDataFd], fds_[kShmRingRxSpaceFd], conn_fd_);
+
+        shm_ring_ack_t ack = { kShmRingMagic, ack_status };
+        return send(conn_fd_, &ack, sizeof(ack), MSG_NOSIGNAL) == sizeof(ack);
+    }
+
+    ssize_t Send(const void* data, size_t size)
+    {
+        struct iovec iov = { const_cast<void*>(data), size };
+        return tx_.Write(&iov, 1);
+    }
+
+    ssize_t Recv(void* data, size_t size, bool nonblock = false)
+    {
+        return rx_.Read(static_cast<uint8_t*>(data), size, false, nonblock);
+    }
+
+    // Receives exactly size bytes unless the client hangs up.
+    bool RecvAll(void* data, size_t size)
+    {
+        auto ptr = static_cast<uint8_t*>(data);
+        while (size > 0) {
+            ssize_t n = Recv(ptr, size);
+            if (n <= 0) {
+                return false;
+            }
+            ptr += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    // For tests playing a misbehaving server.
+    shm_ring_layout_t* Layout() { return reinterpret_cast<shm_ring_layout_t*>(map_); }
+
+    void Hangup()
+    {
+        tx_ = ShmRing();
+        rx_ = ShmRing();
+        if (map_) {
+            munmap(map_, map_size_);
+            map_ = nullptr;
+        }
+        for (auto& fd : fds_) {
+            if (fd >= 0) {
+                close(fd);
+                fd = -1;
+            }
+        }
+        if (conn_fd_ >= 0) {
+            close(conn_fd_);
+            conn_fd_ = -1;
+        }
+    }
+
+private:
+    std::string path_;
+    int         listen_fd_           = -1;
+    int         conn_fd_             = -1;
+    int         fds_[kShmRingNumFds] = { -1, -1, -1, -1, -1 };
+    uint8_t*    map_                 = nullptr;
+    size_t      map_size_            = 0;
+    ShmRing     tx_;
+    ShmRing     rx_;
+};
+
+} // namespace client
+} // namespace vhal
+
+#endif /* SHM_RING_SERVER_STUB_H */
@@ -0,0 +1,197 @@
+/**
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "catch.hpp"
+#include "annexb_packetizer.h"
+#include "mapped_clip_source.h"
+#include "start_code_scan.h"
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace vhal::client;
+
+using Bytes = std::vector<uint8_t>;
+
+static void
+Append(Bytes& stream, Bytes nal, bool long_start_code = false)
+{
+    if (long_start_code) {
+        stream.push_back(0);
+    }
+    stream.insert(stream.end(), { 0, 0, 1 });
+    stream.insert(stream.end(), nal.begin(), nal.end());
+}
+
+// SPS, PPS, IDR in two slices, then two P frames.
+static Bytes
+H264Stream(std::vector<size_t>& au_sizes)
+{
+    Bytes stream;
+    Append(stream, { 0x67, 0x42, 0x00, 0x1e }, true);
+    Append(stream, { 0x68, 0xce, 0x3c, 0x80 }, true);
+    Append(stream, { 0x65, 0x88, 0x84, 0x21, 0xa0 }, true);
+    Append(stream, { 0x65, 0x48, 0x84, 0x21, 0xa0 });
+    au_sizes.push_back(stream.size());
+    for (int i = 0; i < 2; i++) {
+        size_t start = stream.size();
+        Append(stream, { 0x41, 0x9a, 0x02, 0x03 }, true);
+        au_sizes.push_back(stream.size() - start);
+    }
+    return stream;
+}
+
+static std::vector<AnnexBPacketizer::access_unit_t>
+Packetize(AnnexBPacketizer& packetizer, const Bytes& stream, size_t chunk,
+          std::vector<Bytes>& copies)
+{
+    std::vector<AnnexBPacketizer::access_unit_t> units;
+    AnnexBPacketizer::access_unit_t              au;
+    for (size_t i = 0; i < stream.size(); i += chunk) {
+        packetizer.Push(stream.data() + i, std::min(chunk, stream.size() - i));
+        while (packetizer.Next(au)) {
+            units.push_back(au);
+            copies.emplace_back(au.data, au.data + au.size);
+        }
+    }
+    packetizer.Flush();
+    while (packetizer.Next(au)) {
+        units.push_back(au);
+        copies.emplace_back(au.data, au.data + au.size);
+    }
+    return units;
+}
+
+TEST_CASE("SIMD start code search matches the scalar one", "[AnnexBPacketizer]")
+{
+    std::mt19937 rng(42);
+    for (int round = 0; round < 2000; round++) {
+        Bytes data(rng() % 300);
+        for (auto& byte : data) {
+            // Mostly zeros and ones, so that start codes are frequent.
+            byte = rng() % 4 == 0 ? rng() : rng() % 2;
+        }
+        for (size_t offset = 0; offset <= data.size(); offset += 1 + rng() % 40) {
+            size_t size     = data.size() - offset;
+            size_t expected = FindStartCodeScalar(data.data() + offset, size);
+            REQUIRE(FindStartCode(data.data() + offset, size) == expected);
+        }
+    }
+}
+
+TEST_CASE("H.264 stream is split into access units", "[AnnexBPacketizer]")
+{
+    std::vector<size_t> au_sizes;
+    Bytes               stream = H264Stream(au_sizes);
+
+    for (size_t chunk : { size_t(1), size_t(3), size_t(7), stream.size() }) {
+        AnnexBPacketizer   packetizer;
+        std::vector<Bytes> copies;
+        auto               units = Packetize(packetizer, stream, chunk, copies);
+        REQUIRE(units.size() == 3);
+        size_t offset = 0;
+        for (size_t i = 0; i < units.size(); i++) {
+            REQUIRE(copies[i].size() == au_sizes[i]);
+            REQUIRE(Bytes(stream.begin() + offset, stream.begin() + offset + au_sizes[i])
+                    == copies[i]);
+            offset += au_sizes[i];
+        }
+        REQUIRE(units[0].key_frame);
+        REQUIRE(units[0].parameter_sets);
+        REQUIRE_FALSE(units[1].key_frame);
+        REQUIRE_FALSE(units[2].parameter_sets);
+    }
+}
+
+TEST_CASE("H.265 IRAP pictures are key frames", "[AnnexBPacketizer]")
+{
+    Bytes stream;
+    Append(stream, { 0x40, 0x01, 0x0c }, true); // VPS
+    Append(stream, { 0x42, 0x01, 0x01 }, true); // SPS
+    Append(stream, { 0x44, 0x01, 0xc1 }, true); // PPS
+    Append(stream, { 0x26, 0x01, 0xaf, 0x09 }); // IDR_W_RADL
+    size_t first = stream.size();
+    Append(stream, { 0x02, 0x01, 0xd0, 0x09 }); // TRAIL_R
+    Append(stream, { 0x02, 0x01, 0x40, 0x09 }); // TRAIL_R, second slice segment
+
+    AnnexBPacketizer   packetizer(AnnexBPacketizer::Codec::kH265);
+    std::vector<Bytes> copies;
+    auto               units = Packetize(packetizer, stream, 5, copies);
+    REQUIRE(units.size() == 2);
+    REQUIRE(copies[0].size() == first);
+    REQUIRE(units[0].key_frame);
+    REQUIRE(units[0].parameter_sets);
+    REQUIRE(copies[1].size() == stream.size() - first);
+    REQUIRE_FALSE(units[1].key_frame);
+}
+
+TEST_CASE("Garbage before the first start code is dropped", "[AnnexBPacketizer]")
+{
+    std::vector<size_t> au_sizes;
+    Bytes               stream = { 0xde, 0xad, 0xbe, 0xef };
+    Bytes               body   = H264Stream(au_sizes);
+    stream.insert(stream.end(), body.begin(), body.end());
+
+    AnnexBPacketizer   packetizer;
+    std::vector<Bytes> copies;
+    auto               units = Packetize(packetizer, stream, 2, copies);
+    REQUIRE(units.size() == 3);
+    REQUIRE(copies[0] == Bytes(body.begin(), body.begin() + au_sizes[0]));
+}
+
+TEST_CASE("Mapped clip loops from the first key frame", "[MappedClipSource]")
+{
+    // A leading P frame, then the key frame and two P frames.
+    std::vector<size_t> au_sizes;
+    Bytes               stream;
+    Append(stream, { 0x41, 0x9a, 0x01 }, true);
+    size_t leading = stream.size();
+    Bytes  body    = H264Stream(au_sizes);
+    stream.insert(stream.end(), body.begin(), body.end());
+
+    const char* path = "/tmp/vhal-mapped-clip-test.h264";
+    FILE*       file = fopen(path, "wb");
+    REQUIRE(file);
+    fwrite(stream.data(), 1, stream.size(), file);
+    fclose(file);
+
+    MappedClipSource clip(path);
+    MappedClipSource other(path);
+    REQUIRE(clip.FrameCount() == 4);
+
+    auto first = clip.Next();
+    REQUIRE(first.size == leading);
+    REQUIRE_FALSE(first.key_frame);
+    auto key = clip.Next();
+    REQUIRE(key.key_frame);
+    REQUIRE(key.parameter_sets);
+    // Both sources read the same mapping.
+    other.SeekToKeyFrame(2);
+    REQUIRE(other.Next().data == key.data);
+
+    clip.Next();
+    clip.Next();
+    REQUIRE(clip.Loops() == 0);
+    auto looped = clip.Next();
+    REQUIRE(clip.Loops() == 1);
+    REQUIRE(looped.data == key.data);
+    REQUIRE(looped.size == au_sizes[0]);
+    remove(path);
+}
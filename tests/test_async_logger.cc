@@ -0,0 +1,209 @@
+/**
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "catch.hpp"
+#include "receiver_log.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace vhal::client;
+using namespace std::chrono_literals;
+
+/**
+ * Sink collecting the lines that reach it. Optionally holds the logging
+ * thread inside the first call until Open().
+ */
+class LogCapture
+{
+public:
+    explicit LogCapture(bool gated = false) : open_{ !gated }
+    {
+        SetLogSink([this](int level, const char* line) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            entered_ = true;
+            cv_.notify_all();
+            cv_.wait(lock, [this]() { return open_; });
+            lines_.push_back({ level, line });
+        });
+    }
+
+    ~LogCapture()
+    {
+        Open();
+        FlushLog();
+        SetLogSink(nullptr);
+        SetLogLevel(LIBVHAL_INFO);
+    }
+
+    void Open()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        open_ = true;
+        cv_.notify_all();
+    }
+
+    bool WaitEntered()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return cv_.wait_for(lock, 2s, [this]() { return entered_; });
+    }
+
+    // Lines containing text, after a flush.
+    std::vector<std::pair<int, std::string>> Lines(const std::string& text)
+    {
+        FlushLog();
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<std::pair<int, std::string>> lines;
+        for (auto& line : lines_) {
+            if (line.second.find(text) != std::string::npos) {
+                lines.push_back(line);
+            }
+        }
+        return lines;
+    }
+
+private:
+    std::mutex                               mutex_;
+    std::condition_variable                  cv_;
+    bool                                     open_;
+    bool                                     entered_ = false;
+    std::vector<std::pair<int, std::string>> lines_;
+};
+
+static std::vector<int>
+LevelsLogged(int threshold)
+{
+    LogCapture capture;
+    SetLogLevel(threshold);
+    AIC_LOG(LIBVHAL_DEBUG, "level test %d", threshold);
+    AIC_LOG(LIBVHAL_INFO, "level test %d", threshold);
+    AIC_LOG(LIBVHAL_WARNING, "level test %d", threshold);
+    AIC_LOG(LIBVHAL_ERROR, "level test %d", threshold);
+    std::vector<int> levels;
+    for (auto& line : capture.Lines("level test " + std::to_string(threshold))) {
+        levels.push_back(line.first);
+    }
+    return levels;
+}
+
+TEST_CASE("The log threshold filters by severity, not by value", "[AsyncLogger]")
+{
+    // DEBUG has a higher value than INFO but is less severe.
+    REQUIRE(LevelsLogged(LIBVHAL_DEBUG)
+            == std::vector{ LIBVHAL_DEBUG, LIBVHAL_INFO, LIBVHAL_WARNING, LIBVHAL_ERROR });
+    REQUIRE(LevelsLogged(LIBVHAL_INFO)
+            == std::vector{ LIBVHAL_INFO, LIBVHAL_WARNING, LIBVHAL_ERROR });
+    REQUIRE(LevelsLogged(LIBVHAL_WARNING) == std::vector{ LIBVHAL_WARNING, LIBVHAL_ERROR });
+    REQUIRE(LevelsLogged(LIBVHAL_ERROR) == std::vector{ LIBVHAL_ERROR });
+
+    SetLogLevel(LIBVHAL_WARNING);
+    REQUIRE(GetLogLevel() == LIBVHAL_WARNING);
+    REQUIRE_FALSE(AsyncLogger::Enabled(LIBVHAL_DEBUG));
+    REQUIRE_FALSE(AsyncLogger::Enabled(LIBVHAL_INFO));
+    REQUIRE(AsyncLogger::Enabled(LIBVHAL_ERROR));
+    SetLogLevel(LIBVHAL_INFO);
+}
+
+TEST_CASE("Rate limited messages are suppressed and counted", "[AsyncLogger]")
+{
+    LogCapture     capture;
+    LogRateLimiter limiter(100ms);
+
+    for (int i = 0; i < 10; ++i) {
+        AIC_LOG_RATE_LIMITED(limiter, LIBVHAL_WARNING, "retrying %d", i);
+    }
+    auto lines = capture.Lines("retrying");
+    REQUIRE(lines.size() == 1);
+    REQUIRE(lines[0].second.find("retrying 0") != std::string::npos);
+    REQUIRE(lines[0].second.find("suppressed") == std::string::npos);
+
+    // The first message after the interval tells how many were skipped.
+    std::this_thread::sleep_for(150ms);
+    AIC_LOG_RATE_LIMITED(limiter, LIBVHAL_WARNING, "retrying %d", 10);
+    lines = capture.Lines("retrying");
+    REQUIRE(lines.size() == 2);
+    REQUIRE(lines[1].second.find("retrying 10 (9 similar messages suppressed)")
+            != std::string::npos);
+}
+
+TEST_CASE("Filtered messages do not count as suppressed", "[AsyncLogger]")
+{
+    LogCapture     capture;
+    LogRateLimiter limiter(1h);
+
+    SetLogLevel(LIBVHAL_ERROR);
+    for (int i = 0; i < 5; ++i) {
+        AIC_LOG_RATE_LIMITED(limiter, LIBVHAL_WARNING, "filtered %d", i);
+    }
+    SetLogLevel(LIBVHAL_INFO);
+    AIC_LOG_RATE_LIMITED(limiter, LIBVHAL_WARNING, "filtered %d", 5);
+
+    auto lines = capture.Lines("filtered");
+    REQUIRE(lines.size() == 1);
+    REQUIRE(lines[0].second.find("filtered 5") != std::string::npos);
+    REQUIRE(lines[0].second.find("suppressed") == std::string::npos);
+}
+
+TEST_CASE("A full ring drops messages and reports how many", "[AsyncLogger]")
+{
+    LogCapture capture(true);
+
+    // Hold the logging thread in the sink, so nothing leaves the ring.
+    std::thread producer([&]() {
+        AIC_LOG(LIBVHAL_ERROR, "ring blocker");
+        if (!capture.WaitEntered()) {
+            return;
+        }
+        for (size_t i = 0; i < AsyncLogger::kRingSlots + 10; ++i) {
+            AIC_LOG(LIBVHAL_INFO, "ring filler %zu", i);
+        }
+        capture.Open();
+    });
+    producer.join();
+
+    // The blocker still holds its slot until the drain pass completes.
+    const size_t kept = AsyncLogger::kRingSlots - 1;
+    auto         lines = capture.Lines("ring filler");
+    REQUIRE(lines.size() == kept);
+    REQUIRE(lines.back().second.find("ring filler " + std::to_string(kept - 1))
+            != std::string::npos);
+
+    auto dropped = capture.Lines("log messages dropped");
+    REQUIRE(dropped.size() == 1);
+    REQUIRE(dropped[0].first == LIBVHAL_WARNING);
+    REQUIRE(dropped[0].second.find(" 11 log messages dropped") != std::string::npos);
+}
+
+TEST_CASE("Long lines are truncated", "[AsyncLogger]")
+{
+    LogCapture  capture;
+    std::string text(2 * AsyncLogger::kLineSize, 'x');
+    AIC_LOG(LIBVHAL_INFO, "long line %s", text.c_str());
+    auto lines = capture.Lines("long line");
+    REQUIRE(lines.size() == 1);
+    REQUIRE(lines[0].second.size() == AsyncLogger::kLineSize - 1);
+}
@@ -0,0 +1,169 @@
+/**
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "catch.hpp"
+#include "camera_negotiator.h"
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <vector>
+
+using namespace vhal::client;
+using namespace std::chrono_literals;
+
+using Clock = CameraNegotiator::Clock;
+
+/**
+ * Records the requests written, as their packet types, and fails the
+ * writes while offline.
+ */
+struct FakeSender
+{
+    std::mutex                                    mutex;
+    std::vector<VideoSink::camera_packet_type_t> sent;
+    bool                                          online = true;
+
+    CameraNegotiator::Sender Get()
+    {
+        return [this](const std::vector<uint8_t>& message) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!online) {
+                return false;
+            }
+            VideoSink::camera_header_t header;
+            memcpy(&header, message.data(), sizeof(header));
+            sent.push_back(header.type);
+            return true;
+        };
+    }
+
+    size_t Count()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return sent.size();
+    }
+};
+
+static VideoSink::camera_capability_t
+Capability(uint32_t max_cameras)
+{
+    VideoSink::camera_capability_t capability{};
+    capability.maxNumberOfCameras = max_cameras;
+    return capability;
+}
+
+template<typename T>
+static bool
+Ready(std::future<T>& future)
+{
+    return future.wait_for(0s) == std::future_status::ready;
+}
+
+TEST_CASE("Requests wait for the connection and go out in order", "[CameraNegotiator]")
+{
+    FakeSender       sender;
+    CameraNegotiator negotiator(sender.Get());
+    auto             deadline = Clock::now() + 10s;
+
+    auto capability = negotiator.RequestCapability(deadline);
+    auto ack        = negotiator.SendCameraInfo({ VideoSink::camera_info_t{} }, deadline);
+    REQUIRE(sender.Count() == 0);
+
+    negotiator.OnConnected();
+    REQUIRE(sender.sent == std::vector<VideoSink::camera_packet_type_t>{
+                             VideoSink::REQUEST_CAPABILITY, VideoSink::CAMERA_INFO });
+
+    // Each kind of answer goes to the oldest request of its kind.
+    negotiator.OnAck(VideoSink::CameraAck::ACK_CONFIG);
+    REQUIRE(ack.get() == true);
+    REQUIRE_FALSE(Ready(capability));
+    negotiator.OnCapability(Capability(2));
+    REQUIRE(capability.get()->maxNumberOfCameras == 2);
+}
+
+TEST_CASE("A late answer is dropped, not taken for the next request", "[CameraNegotiator]")
+{
+    FakeSender       sender;
+    CameraNegotiator negotiator(sender.Get());
+    negotiator.OnConnected();
+
+    auto first = negotiator.RequestCapability(Clock::now() + 20ms);
+    REQUIRE(first.wait_for(2s) == std::future_status::ready);
+    REQUIRE(first.get() == nullptr);
+
+    auto second = negotiator.RequestCapability(Clock::now() + 10s);
+    REQUIRE(sender.Count() == 2);
+    negotiator.OnCapability(Capability(1)); // the answer to the first one
+    REQUIRE_FALSE(Ready(second));
+    negotiator.OnCapability(Capability(2));
+    REQUIRE(second.get()->maxNumberOfCameras == 2);
+}
+
+TEST_CASE("A request that timed out unsent owes no answer", "[CameraNegotiator]")
+{
+    FakeSender       sender;
+    CameraNegotiator negotiator(sender.Get());
+
+    auto first = negotiator.RequestCapability(Clock::now() + 20ms);
+    REQUIRE(first.wait_for(2s) == std::future_status::ready);
+    REQUIRE(first.get() == nullptr);
+
+    negotiator.OnConnected();
+    auto second = negotiator.RequestCapability(Clock::now() + 10s);
+    REQUIRE(sender.Count() == 1);
+    negotiator.OnCapability(Capability(2));
+    REQUIRE(second.get()->maxNumberOfCameras == 2);
+}
+
+TEST_CASE("A failed write is retried on the next connection", "[CameraNegotiator]")
+{
+    FakeSender       sender;
+    CameraNegotiator negotiator(sender.Get());
+    negotiator.OnConnected();
+
+    sender.online = false;
+    auto ack      = negotiator.SendCameraInfo({}, Clock::now() + 10s);
+    REQUIRE(sender.Count() == 0);
+    // Nothing reached the VHal: an answer from it belongs to no request.
+    negotiator.OnAck(VideoSink::CameraAck::ACK_CONFIG);
+    REQUIRE_FALSE(Ready(ack));
+
+    sender.online = true;
+    negotiator.OnConnected();
+    REQUIRE(sender.Count() == 1);
+    negotiator.OnAck(VideoSink::CameraAck::ACK_CONFIG);
+    REQUIRE(ack.get() == true);
+}
+
+TEST_CASE("An answer may arrive while the request is being written", "[CameraNegotiator]")
+{
+    // The sender runs without the negotiator lock held, so a VHal answering
+    // before the write returns is matched to the request.
+    CameraNegotiator* self = nullptr;
+    CameraNegotiator  negotiator([&](const std::vector<uint8_t>&) {
+        self->OnCapability(Capability(4));
+        return true;
+    });
+    self = &negotiator;
+    negotiator.OnConnected();
+
+    auto capability = negotiator.RequestCapability(Clock::now() + 10s);
+    REQUIRE(capability.wait_for(2s) == std::future_status::ready);
+    REQUIRE(capability.get()->maxNumberOfCameras == 4);
+}
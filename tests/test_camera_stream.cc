@@ -0,0 +1,263 @@
+/**
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "catch.hpp"
+#include "video_sink.h"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace vhal::client;
+using namespace std::chrono_literals;
+
+static const std::string kSocketDir = "/tmp/vhal-camera-stream-test";
+
+/**
+ * Camera VHal end of the session: sends commands and drains whatever the
+ * sink writes.
+ */
+class CameraVhalStub
+{
+public:
+    CameraVhalStub()
+    {
+        mkdir(kSocketDir.c_str(), 0755);
+        std::string path = kSocketDir + "/camera-socket";
+        unlink(path.c_str());
+        listen_fd_              = socket(AF_UNIX, SOCK_STREAM, 0);
+        struct sockaddr_un addr = {};
+        addr.sun_family         = AF_UNIX;
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        bind(listen_fd_, (struct sockaddr*)&addr, sizeof(addr));
+        listen(listen_fd_, 1);
+    }
+
+    ~CameraVhalStub()
+    {
+        Hangup();
+        close(listen_fd_);
+    }
+
+    bool Accept()
+    {
+        struct pollfd pfd = { listen_fd_, POLLIN, 0 };
+        if (poll(&pfd, 1, 2000) != 1) {
+            return false;
+        }
+        fd_     = accept(listen_fd_, nullptr, nullptr);
+        drain_  = std::thread([this]() {
+            uint8_t buf[4096];
+            while (read(fd_, buf, sizeof(buf)) > 0) {
+            }
+        });
+        return fd_ >= 0;
+    }
+
+    void Send(VideoSink::camera_cmd_t cmd, uint32_t camera_id)
+    {
+        VideoSink::camera_header_t     header = { VideoSink::CAMERA_CONFIG,
+                                                  sizeof(VideoSink::camera_config_cmd_t) };
+        VideoSink::camera_config_cmd_t config = {};
+        config.cmd                            = cmd;
+        config.camera_config.cameraId         = camera_id;
+        write(fd_, &header, sizeof(header));
+        write(fd_, &config, sizeof(config));
+    }
+
+    void Hangup()
+    {
+        if (fd_ >= 0) {
+            shutdown(fd_, SHUT_RDWR);
+            drain_.join();
+            close(fd_);
+            fd_ = -1;
+        }
+    }
+
+private:
+    int         listen_fd_ = -1;
+    int         fd_        = -1;
+    std::thread drain_;
+};
+
+static bool
+WaitFor(const std::function<bool()>& condition)
+{
+    auto deadline = std::chrono::steady_clock::now() + 2s;
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+    return true;
+}
+
+static UnixConnectionInfo
+ConnectionInfo()
+{
+    UnixConnectionInfo info;
+    info.socket_dir = kSocketDir;
+    return info;
+}
+
+TEST_CASE("Only the camera opened last may send", "[CameraStream]")
+{
+    CameraVhalStub   vhal;
+    std::atomic<int> session_cmds   = 0;
+    std::atomic<int> stream_cmds[2] = { 0, 0 };
+    VideoSink        sink(ConnectionInfo(), [&](auto&) { session_cmds++; });
+    auto             front = sink.OpenCameraStream(0, [&](auto&) { stream_cmds[0]++; });
+    auto             back  = sink.OpenCameraStream(1, [&](auto&) { stream_cmds[1]++; });
+    REQUIRE(front);
+    REQUIRE(back);
+    REQUIRE(sink.OpenCameraStream(1, nullptr) == nullptr);
+    REQUIRE(vhal.Accept());
+
+    // Every camera starts closed: frames are dropped and counted.
+    uint8_t frame[100] = {};
+    REQUIRE(std::get<0>(front->SendDataPacket(frame, sizeof(frame))) == -1);
+    REQUIRE(front->Stats().frames_dropped == 1);
+
+    vhal.Send(VideoSink::CMD_OPEN, 1);
+    REQUIRE(WaitFor([&]() { return back->IsOpen(); }));
+    REQUIRE_FALSE(front->IsOpen());
+    REQUIRE(stream_cmds[1] == 1);
+    REQUIRE(std::get<0>(back->SendDataPacket(frame, sizeof(frame))) == sizeof(frame));
+    REQUIRE(std::get<0>(front->SendDataPacket(frame, sizeof(frame))) == -1);
+    REQUIRE(back->Stats().frames_sent == 1);
+    REQUIRE(front->Stats().frames_dropped == 2);
+
+    // Opening another camera closes the previous one.
+    vhal.Send(VideoSink::CMD_OPEN, 0);
+    REQUIRE(WaitFor([&]() { return front->IsOpen(); }));
+    REQUIRE_FALSE(back->IsOpen());
+    REQUIRE(std::get<0>(back->SendDataPacket(frame, sizeof(frame))) == -1);
+    REQUIRE(back->Stats().frames_dropped == 1);
+
+    // Closing a camera that is not open leaves the open one alone.
+    vhal.Send(VideoSink::CMD_CLOSE, 1);
+    REQUIRE(WaitFor([&]() { return stream_cmds[1] == 2; }));
+    REQUIRE(front->IsOpen());
+
+    vhal.Send(VideoSink::CMD_CLOSE, 0);
+    REQUIRE(WaitFor([&]() { return !front->IsOpen(); }));
+    REQUIRE(std::get<0>(front->SendDataPacket(frame, sizeof(frame))) == -1);
+
+    // Commands for a camera without a stream go to the session callback.
+    vhal.Send(VideoSink::CMD_OPEN, 7);
+    REQUIRE(WaitFor([&]() { return session_cmds == 1; }));
+    REQUIRE_FALSE(front->IsOpen());
+    REQUIRE_FALSE(back->IsOpen());
+    REQUIRE(stream_cmds[0] == 2);
+    REQUIRE(stream_cmds[1] == 2);
+}
+
+TEST_CASE("Destroying a stream unregisters its camera", "[CameraStream]")
+{
+    CameraVhalStub   vhal;
+    std::atomic<int> session_cmds = 0;
+    VideoSink        sink(ConnectionInfo(), [&](auto&) { session_cmds++; });
+    auto             stream = sink.OpenCameraStream(1, nullptr);
+    REQUIRE(vhal.Accept());
+
+    stream.reset();
+    vhal.Send(VideoSink::CMD_OPEN, 1);
+    REQUIRE(WaitFor([&]() { return session_cmds == 1; }));
+
+    stream = sink.OpenCameraStream(1, nullptr);
+    REQUIRE(stream);
+    REQUIRE_FALSE(stream->IsOpen());
+}
+
+TEST_CASE("A new VHal session closes every stream", "[CameraStream]")
+{
+    CameraVhalStub vhal;
+    VideoSink      sink(ConnectionInfo(), nullptr);
+    auto           front = sink.OpenCameraStream(0, nullptr);
+    auto           back  = sink.OpenCameraStream(1, nullptr);
+    REQUIRE(vhal.Accept());
+
+    vhal.Send(VideoSink::CMD_OPEN, 1);
+    REQUIRE(WaitFor([&]() { return back->IsOpen(); }));
+
+    vhal.Hangup();
+    REQUIRE(vhal.Accept());
+    REQUIRE(WaitFor([&]() { return !back->IsOpen(); }));
+    REQUIRE_FALSE(front->IsOpen());
+
+    uint8_t frame[100] = {};
+    REQUIRE(std::get<0>(back->SendDataPacket(frame, sizeof(frame))) == -1);
+    REQUIRE(back->Stats().frames_dropped == 1);
+
+    vhal.Send(VideoSink::CMD_OPEN, 0);
+    REQUIRE(WaitFor([&]() { return front->IsOpen(); }));
+    REQUIRE(std::get<0>(front->SendDataPacket(frame, sizeof(frame))) == sizeof(frame));
+}
+
+TEST_CASE("Congestion drops non key frames of every stream", "[CameraStream]")
+{
+    CameraVhalStub vhal;
+    VideoSink      sink(ConnectionInfo(), nullptr);
+    auto           stream = sink.OpenCameraStream(0, nullptr);
+    REQUIRE(vhal.Accept());
+    vhal.Send(VideoSink::CMD_OPEN, 0);
+    REQUIRE(WaitFor([&]() { return stream->IsOpen(); }));
+
+    // Every send is congested.
+    VideoSink::congestion_config_t config;
+    config.latency_threshold   = 0us;
+    config.congested_frames    = 1;
+    config.drop_when_congested = true;
+    std::vector<VideoSink::CongestionEvent> events;
+    REQUIRE(sink.EnableCongestionControl(
+      config, [&](const auto& signal) { events.push_back(signal.event); }));
+
+    uint8_t frame[100] = {};
+    REQUIRE(std::get<0>(stream->SendDataPacket(frame, sizeof(frame), true))
+            == sizeof(frame));
+    REQUIRE(events == std::vector{ VideoSink::CongestionEvent::kReduceBitrate });
+
+    // A dropped frame is counted, not an error.
+    auto [size, message] = stream->SendDataPacket(frame, sizeof(frame), false);
+    REQUIRE(size == 0);
+    REQUIRE(message.empty());
+    REQUIRE(events.back() == VideoSink::CongestionEvent::kRequestKeyFrame);
+    REQUIRE(std::get<0>(stream->SendDataPacket(frame, sizeof(frame), true))
+            == sizeof(frame));
+    auto stats = stream->Stats();
+    REQUIRE(stats.frames_sent == 2);
+    REQUIRE(stats.frames_dropped == 1);
+    REQUIRE(stats.send_errors == 0);
+    REQUIRE(stream->Telemetry().frames_dropped == 1);
+
+    // The session's own frames go through the same monitor.
+    auto status = sink.SendDataPacketNoAlloc(frame, sizeof(frame), false);
+    REQUIRE(status.size == 0);
+    REQUIRE_FALSE(status.error);
+    REQUIRE(sink.GetTelemetry().frames_dropped == 1);
+}
@@ -0,0 +1,208 @@
+/**
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "catch.hpp"
+#include "congestion_monitor.h"
+#include <chrono>
+#include <vector>
+
+using namespace vhal::client;
+using namespace std::chrono_literals;
+using Event = VideoSink::CongestionEvent;
+
+static constexpr auto kFast = 1ms;
+static constexpr auto kSlow = 50ms;
+
+/**
+ * Monitor recording every signal it emits.
+ */
+class MonitorFixture
+{
+public:
+    explicit MonitorFixture(VideoSink::congestion_config_t config)
+      : monitor{ config, [this](const VideoSink::congestion_signal_t& signal) {
+                    signals.push_back(signal);
+                } }
+    {}
+
+    static VideoSink::congestion_config_t Config()
+    {
+        VideoSink::congestion_config_t config;
+        config.latency_threshold = 20ms;
+        config.backlog_threshold = 1000;
+        config.congested_frames  = 3;
+        config.clear_frames      = 4;
+        config.min_interval      = 0ms;
+        return config;
+    }
+
+    std::vector<Event> Events() const
+    {
+        std::vector<Event> events;
+        for (auto& signal : signals) {
+            events.push_back(signal.event);
+        }
+        return events;
+    }
+
+    void Send(std::chrono::nanoseconds latency, int times = 1, int64_t backlog = -1)
+    {
+        for (int i = 0; i < times; ++i) {
+            monitor.OnSent(latency, backlog);
+        }
+    }
+
+    CongestionMonitor                           monitor;
+    std::vector<VideoSink::congestion_signal_t> signals;
+};
+
+TEST_CASE("A run of congested sends reduces the bitrate", "[CongestionMonitor]")
+{
+    MonitorFixture f(MonitorFixture::Config());
+
+    // A shorter run, broken by a clear send, is not congestion.
+    f.Send(kSlow, 2);
+    f.Send(kFast);
+    f.Send(kSlow, 2);
+    REQUIRE(f.signals.empty());
+
+    f.Send(kSlow);
+    REQUIRE(f.Events() == std::vector<Event>{ Event::kReduceBitrate });
+    REQUIRE(f.signals[0].bitrate_scale == Approx(0.75));
+    REQUIRE(f.signals[0].send_latency == kSlow);
+}
+
+TEST_CASE("Recovery needs a run of clear sends", "[CongestionMonitor]")
+{
+    MonitorFixture f(MonitorFixture::Config());
+    f.Send(kSlow, 3);
+    REQUIRE(f.signals.size() == 1);
+
+    // Hysteresis: a single clear send, or a shorter run, stays congested.
+    f.Send(kFast, 3);
+    f.Send(kSlow);
+    f.Send(kFast, 3);
+    REQUIRE(f.signals.size() == 1);
+
+    f.Send(kFast);
+    REQUIRE(f.Events() == std::vector<Event>{ Event::kReduceBitrate, Event::kRecovered });
+    REQUIRE(f.signals[1].bitrate_scale == 1.0);
+
+    // Clear sends after recovery are quiet.
+    f.Send(kFast, 10);
+    REQUIRE(f.signals.size() == 2);
+}
+
+TEST_CASE("Reductions repeat at most every min_interval", "[CongestionMonitor]")
+{
+    SECTION("Every congested send once the interval has passed")
+    {
+        MonitorFixture f(MonitorFixture::Config());
+        f.Send(kSlow, 3 + 5);
+        REQUIRE(f.signals.size() == 6);
+        REQUIRE(f.signals[1].bitrate_scale == Approx(0.75 * 0.75));
+        // The scale bottoms out.
+        REQUIRE(f.signals.back().bitrate_scale == Approx(0.25));
+    }
+
+    SECTION("Not within the interval")
+    {
+        auto config         = MonitorFixture::Config();
+        config.min_interval = 1h;
+        MonitorFixture f(config);
+        f.Send(kSlow, 20);
+        REQUIRE(f.signals.size() == 1);
+    }
+}
+
+TEST_CASE("A socket backlog counts as congestion", "[CongestionMonitor]")
+{
+    MonitorFixture f(MonitorFixture::Config());
+
+    // Unknown backlog is not congestion, one at the threshold is not either.
+    f.Send(kFast, 3, -1);
+    f.Send(kFast, 3, 1000);
+    REQUIRE(f.signals.empty());
+
+    f.Send(kFast, 3, 1001);
+    REQUIRE(f.Events() == std::vector<Event>{ Event::kReduceBitrate });
+    REQUIRE(f.signals[0].socket_backlog == 1001);
+}
+
+TEST_CASE("Dropped frames ask for one key frame", "[CongestionMonitor]")
+{
+    MonitorFixture f(MonitorFixture::Config());
+
+    f.monitor.OnDropped();
+    f.monitor.OnDropped();
+    REQUIRE(f.Events() == std::vector<Event>{ Event::kRequestKeyFrame });
+    REQUIRE(f.signals[0].frames_dropped == 1);
+
+    // Non key frames do not end the wait, a key frame does.
+    REQUIRE_FALSE(f.monitor.ShouldDrop(false));
+    f.monitor.OnDropped();
+    REQUIRE(f.signals.size() == 1);
+    REQUIRE_FALSE(f.monitor.ShouldDrop(true));
+    f.monitor.OnDropped();
+    REQUIRE(f.Events()
+            == std::vector<Event>{ Event::kRequestKeyFrame, Event::kRequestKeyFrame });
+    REQUIRE(f.signals[1].frames_dropped == 4);
+}
+
+TEST_CASE("Non key frames are dropped while congested", "[CongestionMonitor]")
+{
+    SECTION("Only with drop_when_congested")
+    {
+        MonitorFixture f(MonitorFixture::Config());
+        f.Send(kSlow, 3);
+        REQUIRE_FALSE(f.monitor.ShouldDrop(false));
+        REQUIRE(f.signals.size() == 1);
+    }
+
+    SECTION("Up to the next key frame")
+    {
+        auto config                = MonitorFixture::Config();
+        config.drop_when_congested = true;
+        MonitorFixture f(config);
+
+        REQUIRE_FALSE(f.monitor.ShouldDrop(false));
+        f.Send(kSlow, 3);
+        REQUIRE(f.monitor.ShouldDrop(false));
+        REQUIRE(f.monitor.ShouldDrop(false));
+        REQUIRE(f.Events()
+                == std::vector<Event>{ Event::kReduceBitrate, Event::kRequestKeyFrame });
+        REQUIRE(f.signals[1].frames_dropped == 1);
+
+        // Key frames always pass; while still congested the next non key
+        // frame starts another episode.
+        REQUIRE_FALSE(f.monitor.ShouldDrop(true));
+        REQUIRE(f.monitor.ShouldDrop(false));
+        REQUIRE(f.signals.size() == 3);
+        REQUIRE(f.signals[2].event == Event::kRequestKeyFrame);
+        REQUIRE(f.signals[2].frames_dropped == 3);
+
+        // After recovery only the pending key frame wait drops frames.
+        f.Send(kFast, 4);
+        REQUIRE(f.signals.back().event == Event::kRecovered);
+        REQUIRE(f.monitor.ShouldDrop(false));
+        REQUIRE_FALSE(f.monitor.ShouldDrop(true));
+        REQUIRE_FALSE(f.monitor.ShouldDrop(false));
+    }
+}
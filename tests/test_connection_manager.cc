@@ -0,0 +1,119 @@
+/**
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "catch.hpp"
+#include "connection_manager.h"
+#include "video_sink.h"
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace vhal::client;
+using namespace std::chrono_literals;
+
+static const std::string kSocketDir = "/tmp/vhal-connection-manager-test";
+
+static int
+Listen(const std::string& path)
+{
+    unlink(path.c_str());
+    int                fd   = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr = {};
+    addr.sun_family         = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    REQUIRE(bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0);
+    REQUIRE(listen(fd, 1) == 0);
+    return fd;
+}
+
+TEST_CASE("Backoff grows with jitter up to the cap", "[ConnectionManager]")
+{
+    ConnectBackoff backoff(10ms, 80ms);
+    auto           expected = 10ms;
+    for (int i = 0; i < 6; i++) {
+        auto delay = backoff.Next();
+        REQUIRE(delay >= expected / 2);
+        REQUIRE(delay <= expected);
+        expected = std::min(expected * 2, 80ms);
+    }
+    backoff.Reset();
+    REQUIRE(backoff.Next() <= 10ms);
+}
+
+TEST_CASE("Watch reports the socket being created", "[ConnectionManager]")
+{
+    mkdir(kSocketDir.c_str(), 0755);
+    std::string path = kSocketDir + "/watched-socket";
+    unlink(path.c_str());
+
+    ConnectionManager connection(path);
+    REQUIRE(connection.OnConnectFailed() == ConnectionManager::kWatchedDelay);
+    REQUIRE(connection.WatchFd() >= 0);
+    REQUIRE_FALSE(connection.ConsumeWatchEvents());
+
+    int other = Listen(kSocketDir + "/other-socket");
+    REQUIRE_FALSE(connection.ConsumeWatchEvents());
+    int fd = Listen(path);
+    REQUIRE(connection.ConsumeWatchEvents());
+
+    // The socket exists now, a refused connect falls back to the backoff.
+    REQUIRE(connection.OnConnectFailed() < ConnectionManager::kWatchedDelay);
+    close(fd);
+    close(other);
+}
+
+TEST_CASE("VideoSink connects as soon as the VHal socket appears", "[ConnectionManager]")
+{
+    mkdir(kSocketDir.c_str(), 0755);
+    std::string path = kSocketDir + "/camera-socket";
+    unlink(path.c_str());
+
+    UnixConnectionInfo info;
+    info.socket_dir = kSocketDir;
+    VideoSink sink(info, [](const VideoSink::camera_config_cmd_t&) {});
+    REQUIRE(sink.GetConnectionStats().time_to_connect.count() < 0);
+
+    // Longer than the backoff cap, shorter than the watched delay.
+    std::this_thread::sleep_for(1500ms);
+    int fd     = Listen(path);
+    auto start = std::chrono::steady_clock::now();
+    while (!sink.IsConnected() && std::chrono::steady_clock::now() - start < 2s) {
+        std::this_thread::sleep_for(1ms);
+    }
+    REQUIRE(sink.IsConnected());
+    REQUIRE(std::chrono::steady_clock::now() - start < 500ms);
+
+    int peer = accept(fd, nullptr, nullptr);
+    REQUIRE(peer >= 0);
+    uint8_t frame[16] = {};
+    REQUIRE(std::get<0>(sink.SendDataPacket(frame, sizeof(frame))) == sizeof(frame));
+
+    auto stats = sink.GetConnectionStats();
+    REQUIRE(stats.connections == 1);
+    REQUIRE(stats.time_to_connect >= 1500ms);
+    REQUIRE(stats.time_to_first_frame >= stats.time_to_connect);
+    close(peer);
+    close(fd);
+}
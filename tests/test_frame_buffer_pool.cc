@@ -0,0 +1,267 @@
+/**
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "catch.hpp"
+#include "frame_buffer_pool.h"
+#include <chrono>
+#include <cstring>
+#include <set>
+#include <thread>
+#include <vector>
+extern "C"
+{
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+}
+
+using namespace vhal::client;
+using namespace std::chrono_literals;
+
+static constexpr size_t kBufferSize = 4096;
+
+static std::unique_ptr<FrameBufferPool>
+CreatePool(uint32_t count, size_t buffer_size = kBufferSize)
+{
+    VideoSink::buffer_pool_config_t config;
+    config.count       = count;
+    config.buffer_size = buffer_size;
+    std::string error;
+    auto        pool = FrameBufferPool::Create(config, error);
+    INFO(error);
+    REQUIRE(pool);
+    return pool;
+}
+
+static size_t
+OpenFds()
+{
+    size_t count = 0;
+    DIR*   dir   = opendir("/proc/self/fd");
+    while (readdir(dir)) {
+        ++count;
+    }
+    closedir(dir);
+    return count;
+}
+
+TEST_CASE("Invalid buffer pool configs are rejected", "[FrameBufferPool]")
+{
+    VideoSink::buffer_pool_config_t config;
+    std::string                     error;
+
+    config.buffer_size = kBufferSize;
+    config.count       = 0;
+    REQUIRE_FALSE(FrameBufferPool::Create(config, error));
+    REQUIRE_FALSE(error.empty());
+
+    error.clear();
+    config.count = FrameBufferPool::kMaxBuffers + 1;
+    REQUIRE_FALSE(FrameBufferPool::Create(config, error));
+    REQUIRE_FALSE(error.empty());
+
+    error.clear();
+    config.count       = 4;
+    config.buffer_size = 0;
+    REQUIRE_FALSE(FrameBufferPool::Create(config, error));
+    REQUIRE_FALSE(error.empty());
+}
+
+TEST_CASE("Create fails on a buffer fd that can not be mapped", "[FrameBufferPool]")
+{
+    int pipe_fds[2];
+    REQUIRE(pipe(pipe_fds) == 0);
+    int memfd = memfd_create("test", MFD_CLOEXEC);
+    REQUIRE(ftruncate(memfd, kBufferSize) == 0);
+
+    const size_t fds_before = OpenFds();
+
+    VideoSink::buffer_pool_config_t config;
+    config.buffer_size = kBufferSize;
+    config.fds         = { memfd, pipe_fds[0] };
+    std::string error;
+    REQUIRE_FALSE(FrameBufferPool::Create(config, error));
+    REQUIRE_FALSE(error.empty());
+    // Neither the mapped duplicate nor the failed one leaks.
+    REQUIRE(OpenFds() == fds_before);
+
+    close(memfd);
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+}
+
+TEST_CASE("Buffers cycle through acquire, ready and release", "[FrameBufferPool]")
+{
+    auto pool = CreatePool(2);
+
+    VideoSink::frame_buffer_t a, b, c;
+    REQUIRE(pool->Acquire(a, 0ms));
+    REQUIRE(pool->Acquire(b, 0ms));
+    REQUIRE(a.index != b.index);
+    REQUIRE(a.size == kBufferSize);
+    REQUIRE(a.data != nullptr);
+    REQUIRE(b.data != nullptr);
+    std::memset(a.data, 0xaa, a.size);
+    std::memset(b.data, 0xbb, b.size);
+
+    // Memfds are sealed, the VHal may rely on their size.
+    int seals = fcntl(a.fd, F_GET_SEALS);
+    REQUIRE((seals & (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL))
+            == (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL));
+
+    SECTION("An empty pool times out")
+    {
+        auto start = std::chrono::steady_clock::now();
+        REQUIRE_FALSE(pool->Acquire(c, 20ms));
+        REQUIRE(std::chrono::steady_clock::now() - start >= 20ms);
+    }
+
+    SECTION("MarkReady needs an acquired buffer that fits")
+    {
+        REQUIRE_FALSE(pool->MarkReady(a.index, kBufferSize + 1));
+        REQUIRE_FALSE(pool->MarkReady(FrameBufferPool::kMaxBuffers, 1));
+        REQUIRE(pool->MarkReady(a.index, kBufferSize));
+        REQUIRE_FALSE(pool->MarkReady(a.index, kBufferSize));
+    }
+
+    SECTION("Only a buffer in flight is released by the VHal")
+    {
+        REQUIRE_FALSE(pool->ReleaseInFlight(a.index));
+        REQUIRE_FALSE(pool->Acquire(c, 0ms));
+
+        REQUIRE(pool->MarkReady(a.index, 16));
+        REQUIRE(pool->ReleaseInFlight(a.index));
+        REQUIRE_FALSE(pool->ReleaseInFlight(a.index));
+
+        REQUIRE(pool->Acquire(c, 0ms));
+        REQUIRE(c.index == a.index);
+        REQUIRE(c.data == a.data);
+        REQUIRE(c.data[0] == 0xaa);
+    }
+
+    SECTION("A lost connection releases every buffer in flight")
+    {
+        REQUIRE(pool->MarkReady(a.index, 16));
+        REQUIRE(pool->MarkReady(b.index, 16));
+        pool->ReleaseInFlight();
+
+        std::set<uint32_t> indexes;
+        REQUIRE(pool->Acquire(c, 0ms));
+        indexes.insert(c.index);
+        REQUIRE(pool->Acquire(c, 0ms));
+        indexes.insert(c.index);
+        REQUIRE(indexes == std::set<uint32_t>{ a.index, b.index });
+    }
+
+    SECTION("Release returns a buffer that could not be sent")
+    {
+        pool->Release(b.index);
+        REQUIRE(pool->Acquire(c, 0ms));
+        REQUIRE(c.index == b.index);
+    }
+
+    SECTION("A release wakes a blocked Acquire")
+    {
+        REQUIRE(pool->MarkReady(a.index, 16));
+        bool        acquired = false;
+        std::thread waiter([&]() { acquired = pool->Acquire(c, 5s); });
+        std::this_thread::sleep_for(20ms);
+        REQUIRE(pool->ReleaseInFlight(a.index));
+        waiter.join();
+        REQUIRE(acquired);
+        REQUIRE(c.index == a.index);
+    }
+
+    SECTION("Shutdown fails a blocked Acquire")
+    {
+        bool        acquired = true;
+        std::thread waiter([&]() { acquired = pool->Acquire(c, 5s); });
+        std::this_thread::sleep_for(20ms);
+        auto start = std::chrono::steady_clock::now();
+        pool->Shutdown();
+        waiter.join();
+        REQUIRE_FALSE(acquired);
+        REQUIRE(std::chrono::steady_clock::now() - start < 1s);
+
+        pool->Release(a.index);
+        REQUIRE_FALSE(pool->Acquire(c, 0ms));
+    }
+}
+
+TEST_CASE("Register passes every buffer fd over SCM_RIGHTS", "[FrameBufferPool]")
+{
+    const uint32_t kCount = 3;
+    auto           pool   = CreatePool(kCount);
+    auto           other  = CreatePool(1);
+    REQUIRE(pool->Generation() != other->Generation());
+
+    int fds[2];
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    auto status = pool->Register(fds[0]);
+    REQUIRE_FALSE(status.error);
+    REQUIRE(status.size
+            == sizeof(VideoSink::camera_header_t) + sizeof(VideoSink::camera_buffer_pool_t));
+
+    VideoSink::camera_header_t      header  = {};
+    VideoSink::camera_buffer_pool_t payload = {};
+    struct iovec  iov[2] = { { &header, sizeof(header) }, { &payload, sizeof(payload) } };
+    char          control[CMSG_SPACE(sizeof(int) * FrameBufferPool::kMaxBuffers)] = {};
+    struct msghdr msg = {};
+    msg.msg_iov        = iov;
+    msg.msg_iovlen     = 2;
+    msg.msg_control    = control;
+    msg.msg_controllen = sizeof(control);
+    REQUIRE(recvmsg(fds[1], &msg, MSG_CMSG_CLOEXEC) == status.size);
+    REQUIRE((msg.msg_flags & MSG_CTRUNC) == 0);
+
+    REQUIRE(header.type == VideoSink::camera_packet_type_t::CAMERA_BUFFER_POOL);
+    REQUIRE(header.size == sizeof(payload));
+    REQUIRE(payload.generation == pool->Generation());
+    REQUIRE(payload.count == kCount);
+    REQUIRE(payload.buffer_size == kBufferSize);
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    REQUIRE(cmsg);
+    REQUIRE(cmsg->cmsg_level == SOL_SOCKET);
+    REQUIRE(cmsg->cmsg_type == SCM_RIGHTS);
+    REQUIRE(cmsg->cmsg_len == CMSG_LEN(sizeof(int) * kCount));
+    std::vector<int> received(kCount);
+    std::memcpy(received.data(), CMSG_DATA(cmsg), sizeof(int) * kCount);
+
+    // The VHal side sees what the client writes into buffer i through fd i.
+    std::vector<VideoSink::frame_buffer_t> buffers(kCount);
+    for (auto& buffer : buffers) {
+        REQUIRE(pool->Acquire(buffer, 0ms));
+        std::memset(buffer.data, 0x10 + buffer.index, buffer.size);
+    }
+    for (uint32_t i = 0; i < kCount; ++i) {
+        void* data = mmap(nullptr, kBufferSize, PROT_READ, MAP_SHARED, received[i], 0);
+        REQUIRE(data != MAP_FAILED);
+        auto bytes = static_cast<const uint8_t*>(data);
+        CHECK(bytes[0] == 0x10 + i);
+        CHECK(bytes[kBufferSize - 1] == 0x10 + i);
+        munmap(data, kBufferSize);
+        close(received[i]);
+    }
+    close(fds[0]);
+    close(fds[1]);
+}
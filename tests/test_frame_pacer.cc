@@ -0,0 +1,120 @@
+/**
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "catch.hpp"
+#include "frame_pacer.h"
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+using namespace vhal::client;
+using namespace std::chrono;
+
+// 10 ms frames: short enough for a unit test, long enough for a loaded box.
+static constexpr double kFps = 100;
+
+TEST_CASE("TestFramePacerAbsoluteDeadlines", "[pacer]")
+{
+    FramePacer pacer(kFps);
+    REQUIRE(pacer.Interval() == 10ms);
+
+    auto start = steady_clock::now();
+    REQUIRE(pacer.Wait() == 0);
+    REQUIRE(steady_clock::now() - start < 5ms);
+
+    // Work shorter than a frame does not push the schedule back: frame 10
+    // is due 100 ms after the start, not 10 * (10 + 4) ms.
+    for (uint64_t i = 1; i <= 10; i++) {
+        std::this_thread::sleep_for(4ms);
+        REQUIRE(pacer.Wait() == i);
+    }
+    auto elapsed = steady_clock::now() - start;
+    REQUIRE(elapsed >= 100ms);
+    REQUIRE(elapsed < 130ms);
+
+    auto stats = pacer.Stats();
+    REQUIRE(stats.frames == 11);
+    REQUIRE(stats.skipped_frames == 0);
+    REQUIRE(stats.late_frames == 0);
+}
+
+TEST_CASE("TestFramePacerSkip", "[pacer]")
+{
+    FramePacer pacer(kFps, FramePacer::OverrunPolicy::kSkip);
+    REQUIRE(pacer.Wait() == 0);
+
+    // Five and a half frames late: frames 1 to 4 are dropped and the pacer
+    // resumes with the slot we are in.
+    std::this_thread::sleep_for(55ms);
+    uint64_t frame = pacer.Wait();
+    REQUIRE(frame >= 5);
+
+    auto stats = pacer.Stats();
+    REQUIRE(stats.frames == 2);
+    REQUIRE(stats.skipped_frames == frame - 1);
+    REQUIRE(stats.late_frames == 0);
+
+    // Back on schedule.
+    REQUIRE(pacer.Wait() == frame + 1);
+    REQUIRE(pacer.Stats().skipped_frames == frame - 1);
+}
+
+TEST_CASE("TestFramePacerCatchUp", "[pacer]")
+{
+    FramePacer pacer(kFps, FramePacer::OverrunPolicy::kCatchUp);
+    REQUIRE(pacer.Wait() == 0);
+
+    std::this_thread::sleep_for(55ms);
+    // The missed frames come back to back, in order.
+    auto late = steady_clock::now();
+    for (uint64_t i = 1; i <= 5; i++) {
+        REQUIRE(pacer.Wait() == i);
+    }
+    REQUIRE(steady_clock::now() - late < 5ms);
+
+    auto stats = pacer.Stats();
+    REQUIRE(stats.frames == 6);
+    REQUIRE(stats.skipped_frames == 0);
+    // Frames 1 to 4 left 45 to 15 ms late, a full interval or more.
+    REQUIRE(stats.late_frames >= 4);
+    REQUIRE(stats.max_lateness >= 45ms);
+    REQUIRE(stats.jitter > 0ns);
+}
+
+TEST_CASE("TestFramePacerReset", "[pacer]")
+{
+    FramePacer pacer(kFps);
+    REQUIRE(pacer.Wait() == 0);
+    REQUIRE(pacer.Wait() == 1);
+
+    // A paused stream starts a new schedule instead of skipping.
+    std::this_thread::sleep_for(30ms);
+    pacer.Reset();
+    auto start = steady_clock::now();
+    REQUIRE(pacer.Wait() == 0);
+    REQUIRE(steady_clock::now() - start < 5ms);
+    REQUIRE(pacer.Stats().frames == 3);
+    REQUIRE(pacer.Stats().skipped_frames == 0);
+}
+
+TEST_CASE("TestFramePacerInvalidRate", "[pacer]")
+{
+    REQUIRE_THROWS_AS(FramePacer(0), std::invalid_argument);
+    REQUIRE_THROWS_AS(FramePacer(-30), std::invalid_argument);
+}
@@ -0,0 +1,249 @@
+/**
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "catch.hpp"
+#include "frame_send_queue.h"
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace vhal::client;
+using namespace std::chrono_literals;
+using Policy = VideoSink::SendDropPolicy;
+
+/**
+ * Socket side of the queue: writes only as many frames as it was allowed to,
+ * and records every completion.
+ */
+class FrameSendQueueFixture
+{
+public:
+    FrameSendQueueFixture(Policy policy, size_t depth)
+    {
+        VideoSink::async_send_config_t config;
+        config.queue_depth = depth;
+        config.drop_policy = policy;
+        config.on_complete = [this](const VideoSink::send_completion_t& completion) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            completions_[completion.frame_id].push_back(completion);
+            cv_.notify_all();
+        };
+        queue = std::make_unique<FrameSendQueue>(
+          config, [this](const uint8_t* data, size_t size) -> IOResult {
+              std::unique_lock<std::mutex> lock(mutex_);
+              in_flight_ = true;
+              cv_.notify_all();
+              cv_.wait(lock, [this]() { return allowed_ > written_.size(); });
+              written_.push_back(data[0]);
+              in_flight_ = false;
+              return { static_cast<ssize_t>(size), "" };
+          });
+    }
+
+    // Frame payloads are their id, which is also the queue's frame id.
+    void Push(bool key_frame)
+    {
+        uint8_t id;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            id = static_cast<uint8_t>(pushed_++);
+        }
+        queue->Push(&id, 1, key_frame);
+    }
+
+    // Lets the writer through count more frames.
+    void Allow(size_t count)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        allowed_ += count;
+        cv_.notify_all();
+    }
+
+    // Waits until the writer blocks on a frame.
+    void WaitInFlight()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        REQUIRE(cv_.wait_for(lock, 1s, [this]() { return in_flight_; }));
+    }
+
+    // Waits for the completion of every frame pushed.
+    void WaitCompleted()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        REQUIRE(cv_.wait_for(lock, 1s, [this]() { return completions_.size() == pushed_; }));
+    }
+
+    std::vector<uint8_t> Written()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return written_;
+    }
+
+    // Ids reported dropped, checking every frame completed exactly once.
+    std::vector<uint64_t> Dropped()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<uint64_t> dropped;
+        for (auto& [id, completions] : completions_) {
+            REQUIRE(completions.size() == 1);
+            if (completions[0].dropped) {
+                REQUIRE(std::get<0>(completions[0].result) == -1);
+                dropped.push_back(id);
+            }
+        }
+        return dropped;
+    }
+
+    std::unique_ptr<FrameSendQueue> queue;
+
+private:
+    std::mutex                                                  mutex_;
+    std::condition_variable                                     cv_;
+    size_t                                                      allowed_   = 0;
+    bool                                                        in_flight_ = false;
+    size_t                                                      pushed_    = 0;
+    std::vector<uint8_t>                                        written_;
+    std::map<uint64_t, std::vector<VideoSink::send_completion_t>> completions_;
+};
+
+TEST_CASE("kDropOldest evicts the oldest queued frames", "[FrameSendQueue]")
+{
+    FrameSendQueueFixture f(Policy::kDropOldest, 2);
+    f.Push(true);
+    f.WaitInFlight();
+    for (int i = 0; i < 4; i++) {
+        f.Push(false);
+    }
+    REQUIRE(f.queue->Depth() == 2);
+
+    f.Allow(3);
+    f.WaitCompleted();
+    REQUIRE(f.Written() == std::vector<uint8_t>{ 0, 3, 4 });
+    REQUIRE(f.Dropped() == std::vector<uint64_t>{ 1, 2 });
+}
+
+TEST_CASE("kDropNonKeyFrame drops the rest of the GOP", "[FrameSendQueue]")
+{
+    FrameSendQueueFixture f(Policy::kDropNonKeyFrame, 2);
+    f.Push(true);
+    f.WaitInFlight();
+    f.Push(false);
+    f.Push(false);
+    // Full: dropped, and so is every non key frame up to the next key frame,
+    // room or not.
+    f.Push(false);
+    f.Allow(3);
+    f.WaitCompleted();
+    f.Push(false);
+    f.Push(true);
+    f.Push(false);
+    f.Allow(2);
+    f.WaitCompleted();
+    REQUIRE(f.Written() == std::vector<uint8_t>{ 0, 1, 2, 5, 6 });
+    REQUIRE(f.Dropped() == std::vector<uint64_t>{ 3, 4 });
+}
+
+TEST_CASE("kDropNonKeyFrame key frame supersedes the queue", "[FrameSendQueue]")
+{
+    FrameSendQueueFixture f(Policy::kDropNonKeyFrame, 2);
+    f.Push(true);
+    f.WaitInFlight();
+    f.Push(false);
+    f.Push(true);
+    f.Push(true);
+    REQUIRE(f.queue->Depth() == 1);
+
+    f.Allow(2);
+    f.WaitCompleted();
+    REQUIRE(f.Written() == std::vector<uint8_t>{ 0, 3 });
+    REQUIRE(f.Dropped() == std::vector<uint64_t>{ 1, 2 });
+}
+
+TEST_CASE("kBlock waits for room and drops nothing", "[FrameSendQueue]")
+{
+    FrameSendQueueFixture f(Policy::kBlock, 1);
+    f.Push(true);
+    f.WaitInFlight();
+    f.Push(false);
+
+    std::atomic<bool> pushed{ false };
+    std::thread       pusher([&]() {
+        f.Push(false);
+        pushed = true;
+    });
+    std::this_thread::sleep_for(50ms);
+    REQUIRE_FALSE(pushed);
+
+    f.Allow(3);
+    pusher.join();
+    f.WaitCompleted();
+    REQUIRE(f.Written() == std::vector<uint8_t>{ 0, 1, 2 });
+    REQUIRE(f.Dropped().empty());
+}
+
+TEST_CASE("Stop reports queued frames dropped, once", "[FrameSendQueue]")
+{
+    FrameSendQueueFixture f(Policy::kBlock, 2);
+    f.Push(true);
+    f.WaitInFlight();
+    f.Push(false);
+    f.Push(false);
+    // Blocked on the full queue until Stop().
+    std::thread pusher([&]() { f.Push(false); });
+    std::this_thread::sleep_for(20ms);
+
+    // Stop() waits for the frame being written.
+    std::thread stopper([&]() { f.queue->Stop(); });
+    std::this_thread::sleep_for(20ms);
+    f.Allow(1);
+    stopper.join();
+    pusher.join();
+    f.Push(false);
+    f.WaitCompleted();
+    REQUIRE(f.Written() == std::vector<uint8_t>{ 0 });
+    REQUIRE(f.Dropped() == std::vector<uint64_t>{ 1, 2, 3, 4 });
+
+    // Again, from the destructor: nothing is reported twice.
+    f.queue->Stop();
+    f.queue.reset();
+    REQUIRE(f.Dropped().size() == 4);
+}
+
+TEST_CASE("Destruction reports queued frames dropped", "[FrameSendQueue]")
+{
+    FrameSendQueueFixture f(Policy::kDropOldest, 4);
+    f.Push(true);
+    f.WaitInFlight();
+    f.Push(false);
+    f.Push(false);
+
+    // Let the frame on the wire finish once the writer was told to stop.
+    std::thread destroyer([&]() { f.queue.reset(); });
+    std::this_thread::sleep_for(20ms);
+    f.Allow(1);
+    destroyer.join();
+    f.WaitCompleted();
+    REQUIRE(f.Written() == std::vector<uint8_t>{ 0 });
+    REQUIRE(f.Dropped() == std::vector<uint64_t>{ 1, 2 });
+}
@@ -0,0 +1,246 @@
+/**
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "catch.hpp"
+#include "framed_reader.h"
+#include "unix_stream_socket_client.h"
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace vhal::client;
+
+static const std::string kServerPath = "/tmp/vhal-framed-reader-test-socket";
+
+struct test_msg_t
+{
+    uint32_t cmd;
+    uint32_t data;
+};
+
+// Accepts a single UnixStreamSocketClient and hands out the server side.
+class Peer
+{
+public:
+    Peer()
+    {
+        unlink(kServerPath.c_str());
+        listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+        struct sockaddr_un addr = {};
+        addr.sun_family         = AF_UNIX;
+        strncpy(addr.sun_path, kServerPath.c_str(), sizeof(addr.sun_path) - 1);
+        bind(listen_fd_, (struct sockaddr*)&addr, sizeof(addr));
+        listen(listen_fd_, 1);
+        auto [connected, error_msg] = client.Connect();
+        REQUIRE(connected);
+        fd = accept(listen_fd_, nullptr, nullptr);
+        REQUIRE(fd >= 0);
+    }
+
+    ~Peer()
+    {
+        client.Close();
+        close(fd);
+        close(listen_fd_);
+        unlink(kServerPath.c_str());
+    }
+
+    void SendWithFds(const void* data, size_t size, const int* fds, size_t count)
+    {
+        struct iovec iov     = { const_cast<void*>(data), size };
+        char         ctl[CMSG_SPACE(sizeof(int) * 4)] = {};
+        struct msghdr msg    = {};
+        msg.msg_iov          = &iov;
+        msg.msg_iovlen       = 1;
+        msg.msg_control      = ctl;
+        msg.msg_controllen   = CMSG_SPACE(sizeof(int) * count);
+        auto cmsg            = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level     = SOL_SOCKET;
+        cmsg->cmsg_type      = SCM_RIGHTS;
+        cmsg->cmsg_len       = CMSG_LEN(sizeof(int) * count);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * count);
+        REQUIRE(sendmsg(fd, &msg, 0) == (ssize_t)size);
+    }
+
+    UnixStreamSocketClient client{ std::string(kServerPath) };
+    int                    fd = -1;
+
+private:
+    int listen_fd_ = -1;
+};
+
+TEST_CASE("TestFramedReaderBatchesMessages", "[read]")
+{
+    Peer         peer;
+    FramedReader reader(&peer.client);
+
+    test_msg_t sent[8];
+    for (uint32_t i = 0; i < 8; ++i) {
+        sent[i] = { i, i * 10 };
+    }
+    REQUIRE(write(peer.fd, sent, sizeof(sent)) == sizeof(sent));
+
+    // One fill brings in the whole burst; the rest is served from the buffer.
+    test_msg_t msg;
+    REQUIRE(std::get<0>(reader.Read(&msg, sizeof(msg))) == sizeof(msg));
+    REQUIRE(reader.Buffered() == sizeof(msg) * 7);
+    for (uint32_t i = 1; i < 8; ++i) {
+        REQUIRE(std::get<0>(reader.Read(&msg, sizeof(msg))) == sizeof(msg));
+        REQUIRE(msg.cmd == i);
+        REQUIRE(msg.data == i * 10);
+    }
+    REQUIRE(reader.Buffered() == 0);
+}
+
+TEST_CASE("TestFramedReaderPartialMessage", "[read]")
+{
+    Peer         peer;
+    FramedReader reader(&peer.client, 16);
+
+    test_msg_t sent = { 0xCAFE, 0xBEEF };
+    auto       raw  = reinterpret_cast<const uint8_t*>(&sent);
+    REQUIRE(write(peer.fd, raw, 3) == 3);
+    std::thread writer([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        write(peer.fd, raw + 3, sizeof(sent) - 3);
+    });
+
+    test_msg_t msg{};
+    auto [received, error_msg] = reader.Read(&msg, sizeof(msg));
+    writer.join();
+    REQUIRE(received == sizeof(msg));
+    REQUIRE(msg.cmd == sent.cmd);
+    REQUIRE(msg.data == sent.data);
+}
+
+TEST_CASE("TestFramedReaderLargerThanCapacity", "[read]")
+{
+    Peer         peer;
+    FramedReader reader(&peer.client, 16);
+
+    std::vector<uint8_t> sent(4096);
+    for (size_t i = 0; i < sent.size(); ++i) {
+        sent[i] = static_cast<uint8_t>(i);
+    }
+    REQUIRE(write(peer.fd, sent.data(), sent.size()) == (ssize_t)sent.size());
+
+    std::vector<uint8_t> received(sent.size());
+    REQUIRE(std::get<0>(reader.Read(received.data(), received.size())) ==
+            (ssize_t)received.size());
+    REQUIRE(received == sent);
+}
+
+TEST_CASE("TestFramedReaderPullWholeMessage", "[read]")
+{
+    Peer         peer;
+    FramedReader reader(&peer.client, 16);
+
+    // Header and a body larger than the buffer, sent in one go.
+    test_msg_t           header = { 7, 64 };
+    std::vector<uint8_t> sent(sizeof(header) + header.data);
+    memcpy(sent.data(), &header, sizeof(header));
+    for (size_t i = sizeof(header); i < sent.size(); ++i) {
+        sent[i] = static_cast<uint8_t>(i);
+    }
+    REQUIRE(write(peer.fd, sent.data(), sent.size()) == (ssize_t)sent.size());
+
+    const uint8_t* data = nullptr;
+    REQUIRE(std::get<0>(reader.Pull(sizeof(header), &data)) == sizeof(header));
+    REQUIRE(memcmp(data, &header, sizeof(header)) == 0);
+    REQUIRE(std::get<0>(reader.Pull(header.data, &data)) == (ssize_t)header.data);
+    REQUIRE(memcmp(data, sent.data() + sizeof(header), header.data) == 0);
+    REQUIRE(reader.Buffered() == 0);
+}
+
+TEST_CASE("TestFramedReaderPeerClosed", "[read]")
+{
+    Peer         peer;
+    FramedReader reader(&peer.client);
+
+    uint16_t half = 1;
+    REQUIRE(write(peer.fd, &half, sizeof(half)) == sizeof(half));
+    shutdown(peer.fd, SHUT_WR);
+
+    test_msg_t msg;
+    REQUIRE(std::get<0>(reader.Read(&msg, sizeof(msg))) == 0);
+}
+
+TEST_CASE("TestFramedReaderFds", "[fds]")
+{
+    Peer         peer;
+    FramedReader reader(&peer.client, FramedReader::kDefaultCapacity, true);
+
+    int pipe_fds[2];
+    REQUIRE(pipe(pipe_fds) == 0);
+    test_msg_t header = { 1, 2 };
+    REQUIRE(write(peer.fd, &header, sizeof(header)) == sizeof(header));
+    int carrier[4] = {};
+    peer.SendWithFds(carrier, sizeof(carrier), pipe_fds, 2);
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+
+    test_msg_t msg;
+    REQUIRE(std::get<0>(reader.Read(&msg, sizeof(msg))) == sizeof(msg));
+    REQUIRE(std::get<0>(reader.Read(carrier, sizeof(carrier))) == sizeof(carrier));
+    int fds[2] = { -1, -1 };
+    REQUIRE(std::get<0>(reader.ReadFds(fds, 2)) == 2);
+
+    // The received pair is still connected.
+    char c = 'x';
+    REQUIRE(write(fds[1], &c, 1) == 1);
+    c = 0;
+    REQUIRE(read(fds[0], &c, 1) == 1);
+    REQUIRE(c == 'x');
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST_CASE("TestFramedReaderSkipAndDropFds", "[fds]")
+{
+    Peer         peer;
+    FramedReader reader(&peer.client, 16, true);
+
+    // A message we reject: larger than the buffer, carrying one end of a pair.
+    int pair[2];
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+    std::vector<uint8_t> rejected(64, 0xaa);
+    peer.SendWithFds(rejected.data(), rejected.size(), &pair[0], 1);
+    close(pair[0]);
+    test_msg_t next = { 3, 4 };
+    REQUIRE(write(peer.fd, &next, sizeof(next)) == sizeof(next));
+
+    REQUIRE(std::get<0>(reader.Skip(rejected.size())) == (ssize_t)rejected.size());
+    reader.DropFds();
+
+    // The received end is closed, and the stream is still in sync.
+    char c = 'x';
+    REQUIRE(send(pair[1], &c, 1, MSG_NOSIGNAL) == -1);
+    REQUIRE(errno == EPIPE);
+    close(pair[1]);
+    test_msg_t msg;
+    REQUIRE(std::get<0>(reader.Read(&msg, sizeof(msg))) == sizeof(msg));
+    REQUIRE(msg.cmd == next.cmd);
+    REQUIRE(msg.data == next.data);
+}
@@ -0,0 +1,226 @@
+/**
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "catch.hpp"
+#include "framed_writer.h"
+#include "sendv_util.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace vhal::client;
+using namespace std::chrono_literals;
+
+/**
+ * Client end of a socketpair with a small send buffer, so that every message
+ * below takes several send() calls and blocks until the VHal end reads.
+ */
+class SocketPairClient final : public IStreamSocketClient
+{
+public:
+    explicit SocketPairClient(int fd) : fd_{ fd }
+    {
+        int size = 4096;
+        setsockopt(fd_, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    }
+    ~SocketPairClient() { close(fd_); }
+
+    ConnectionResult Connect() override { return { true, "" }; }
+    bool             Connected() const override { return true; }
+    int              GetNativeSocketFd() const override { return fd_; }
+    IOResult Send(const uint8_t*, size_t) override { return { -1, "unused" }; }
+    IOResult SendV(const struct iovec*, int) override { return { -1, "unused" }; }
+    IOResult Recv(uint8_t*, size_t, uint8_t) override { return { -1, "unused" }; }
+
+    IOStatus SendNoAlloc(const uint8_t* data, size_t size) override
+    {
+        struct iovec iov = { const_cast<uint8_t*>(data), size };
+        return SendVNoAlloc(&iov, 1);
+    }
+
+    IOStatus SendVNoAlloc(const struct iovec* iov, int iovcnt) override
+    {
+        auto progress = SendMsgAll(iov, iovcnt, [this](struct msghdr* msg) -> ssize_t {
+            ssize_t n = sendmsg(fd_, msg, MSG_NOSIGNAL);
+            return n < 0 ? -errno : n;
+        });
+        if (progress.error) {
+            return { -1, std::error_code(progress.error, std::system_category()) };
+        }
+        return { static_cast<ssize_t>(progress.sent), {} };
+    }
+
+    IOStatus RecvNoAlloc(uint8_t*, size_t, uint8_t) override { return { -1, {} }; }
+    void     Close() override {}
+
+private:
+    int fd_;
+};
+
+// Payload bytes all equal the id, so an interleaved message shows.
+struct test_header_t
+{
+    uint32_t id;
+    uint32_t size;
+};
+
+struct FramedWriterFixture
+{
+    FramedWriterFixture()
+    {
+        int fds[2];
+        REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+        client = std::make_unique<SocketPairClient>(fds[0]);
+        vhal   = fds[1];
+        writer = std::make_unique<FramedWriter>(*client);
+    }
+
+    ~FramedWriterFixture()
+    {
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        close(vhal);
+    }
+
+    // Header and payload in two buffers, like a frame.
+    void WriteV(FramedWriter::Lane lane, uint32_t id, uint32_t size)
+    {
+        threads.emplace_back([this, lane, id, size]() {
+            test_header_t        header = { id, size };
+            std::vector<uint8_t> payload(size, uint8_t(id));
+            struct iovec         iov[2] = { { &header, sizeof(header) },
+                                            { payload.data(), payload.size() } };
+            writer->Write(lane, iov, 2);
+        });
+    }
+
+    // One contiguous packet, like SendRawPacket().
+    void Write(FramedWriter::Lane lane, uint32_t id, uint32_t size)
+    {
+        threads.emplace_back([this, lane, id, size]() {
+            std::vector<uint8_t> packet(sizeof(test_header_t) + size, uint8_t(id));
+            test_header_t        header = { id, size };
+            memcpy(packet.data(), &header, sizeof(header));
+            writer->Write(lane, packet.data(), packet.size());
+        });
+    }
+
+    // Id of the next message, after checking it arrived in one piece.
+    uint32_t Read()
+    {
+        test_header_t header = {};
+        REQUIRE(recv(vhal, &header, sizeof(header), MSG_WAITALL) == sizeof(header));
+        std::vector<uint8_t> payload(header.size);
+        REQUIRE(recv(vhal, payload.data(), payload.size(), MSG_WAITALL)
+                == (ssize_t)payload.size());
+        REQUIRE(std::all_of(payload.begin(), payload.end(),
+                            [&](uint8_t b) { return b == uint8_t(header.id); }));
+        return header.id;
+    }
+
+    std::unique_ptr<SocketPairClient> client;
+    int                               vhal = -1;
+    std::unique_ptr<FramedWriter>     writer;
+    std::vector<std::thread>          threads;
+};
+
+TEST_CASE("Queued control messages overtake queued frames", "[FramedWriter]")
+{
+    using Lane = FramedWriter::Lane;
+    FramedWriterFixture f;
+
+    // Blocked on the full socket until the VHal end reads.
+    f.WriteV(Lane::kBulk, 1, 256 * 1024);
+    std::this_thread::sleep_for(50ms);
+    // Queued behind it, each one after the previous took its ticket.
+    f.WriteV(Lane::kBulk, 2, 64 * 1024);
+    std::this_thread::sleep_for(20ms);
+    f.Write(Lane::kBulk, 3, 64 * 1024);
+    std::this_thread::sleep_for(20ms);
+    f.WriteV(Lane::kControl, 4, 100);
+    std::this_thread::sleep_for(20ms);
+    f.Write(Lane::kControl, 5, 100);
+    std::this_thread::sleep_for(20ms);
+
+    // The frame on the wire completes, then control, then frames in order.
+    std::vector<uint32_t> order;
+    for (int i = 0; i < 5; i++) {
+        order.push_back(f.Read());
+    }
+    REQUIRE(order == std::vector<uint32_t>{ 1, 4, 5, 2, 3 });
+}
+
+TEST_CASE("Exclusive holds the socket for the whole message", "[FramedWriter]")
+{
+    using Lane = FramedWriter::Lane;
+    FramedWriterFixture f;
+
+    // Header and payload in separate writes, as for ancillary data.
+    f.threads.emplace_back([&f]() {
+        f.writer->Exclusive(Lane::kBulk, [&f]() {
+            test_header_t        header = { 1, 64 * 1024 };
+            std::vector<uint8_t> payload(header.size, 1);
+            f.client->SendNoAlloc(reinterpret_cast<uint8_t*>(&header), sizeof(header));
+            return f.client->SendNoAlloc(payload.data(), payload.size());
+        });
+    });
+    std::this_thread::sleep_for(20ms);
+    f.Write(Lane::kControl, 2, 100);
+
+    REQUIRE(f.Read() == 1);
+    REQUIRE(f.Read() == 2);
+}
+
+TEST_CASE("Messages of concurrent writers never interleave", "[FramedWriter]")
+{
+    using Lane = FramedWriter::Lane;
+    FramedWriterFixture f;
+
+    constexpr int kWriters  = 8;
+    constexpr int kMessages = 20;
+    for (int w = 0; w < kWriters; w++) {
+        f.threads.emplace_back([&f, w]() {
+            auto lane = w % 2 ? Lane::kControl : Lane::kBulk;
+            for (int m = 0; m < kMessages; m++) {
+                test_header_t        header = { uint32_t(w), uint32_t(1000 + 3000 * m) };
+                std::vector<uint8_t> payload(header.size, uint8_t(w));
+                struct iovec         iov[2] = { { &header, sizeof(header) },
+                                                { payload.data(), payload.size() } };
+                f.writer->Write(lane, iov, 2);
+            }
+        });
+    }
+
+    int count[kWriters] = {};
+    for (int i = 0; i < kWriters * kMessages; i++) {
+        auto id = f.Read();
+        REQUIRE(id < uint32_t(kWriters));
+        ++count[id];
+    }
+    for (auto n : count) {
+        REQUIRE(n == kMessages);
+    }
+}
@@ -0,0 +1,195 @@
+/**
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "catch.hpp"
+#include "hwc_vhal_impl.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <poll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace vhal::client;
+
+/**
+ * Client end of a socketpair, all HwcEventChannel needs from a socket.
+ */
+class SocketPairClient final : public IStreamSocketClient
+{
+public:
+    explicit SocketPairClient(int fd) : fd_{ fd } {}
+    ~SocketPairClient() { close(fd_); }
+
+    ConnectionResult Connect() override { return { true, "" }; }
+    bool             Connected() const override { return true; }
+    int              GetNativeSocketFd() const override { return fd_; }
+    // HwcEventChannel writes straight to the fd.
+    IOResult Send(const uint8_t*, size_t) override { return { -1, "unused" }; }
+    IOResult SendV(const struct iovec*, int) override { return { -1, "unused" }; }
+    IOResult Recv(uint8_t*, size_t, uint8_t) override { return { -1, "unused" }; }
+    IOStatus SendNoAlloc(const uint8_t*, size_t) override { return { -1, {} }; }
+    IOStatus SendVNoAlloc(const struct iovec*, int) override { return { -1, {} }; }
+    IOStatus RecvNoAlloc(uint8_t*, size_t, uint8_t) override { return { -1, {} }; }
+    void     Close() override {}
+
+private:
+    int fd_;
+};
+
+/**
+ * HWC VHal end: the channel under test writes to the client end.
+ */
+struct HwcEventChannelFixture
+{
+    HwcEventChannelFixture(shared_ptr<ProfileLogger> log = make_shared<ProfileLogger>())
+    {
+        int fds[2];
+        REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+        client  = std::make_unique<SocketPairClient>(fds[0]);
+        vhal    = fds[1];
+        channel = make_shared<HwcEventChannel>(client.get(), log);
+    }
+
+    ~HwcEventChannelFixture()
+    {
+        channel->Detach();
+        close(vhal);
+    }
+
+    DisplayReleaseToken Display(uint64_t remote_handle)
+    {
+        buffer_info_event_t ev = {};
+        ev.event.type          = VHAL_DD_EVENT_DISPLAY_REQ;
+        ev.info.remote_handle  = remote_handle;
+        auto generation        = channel->BeginDisplay(2);
+        return DisplayReleaseToken(
+          make_shared<DisplayReleaseToken::Pending>(channel, generation, ev, nullptr));
+    }
+
+    // Remote handle of the next DISPLAY_ACK, 0 if none arrives in time.
+    uint64_t ReadAck(int timeout_ms = 1000)
+    {
+        struct pollfd pfd = { vhal, POLLIN, 0 };
+        if (poll(&pfd, 1, timeout_ms) != 1) {
+            return 0;
+        }
+        buffer_info_event_t ev = {};
+        REQUIRE(recv(vhal, &ev, sizeof(ev), MSG_WAITALL) == sizeof(ev));
+        REQUIRE(ev.event.type == VHAL_DD_EVENT_DISPLAY_ACK);
+        REQUIRE(ev.event.size == sizeof(ev));
+        return ev.info.remote_handle;
+    }
+
+    std::unique_ptr<SocketPairClient> client;
+    int                               vhal = -1;
+    shared_ptr<HwcEventChannel>       channel;
+};
+
+TEST_CASE("Release from another thread sends the ACK once", "[HwcEventChannel]")
+{
+    HwcEventChannelFixture fixture;
+    auto                   token = fixture.Display(0x1000);
+    REQUIRE(token);
+    REQUIRE(fixture.ReadAck(0) == 0);
+
+    std::thread([copy = token]() mutable { copy.Release(); }).join();
+    REQUIRE(fixture.ReadAck() == 0x1000);
+
+    // Copies share one release.
+    token.Release();
+    REQUIRE_FALSE(token);
+    REQUIRE(fixture.ReadAck(50) == 0);
+}
+
+TEST_CASE("Destroying the last copy sends the ACK", "[HwcEventChannel]")
+{
+    HwcEventChannelFixture fixture;
+    {
+        auto token = fixture.Display(0x2000);
+        {
+            auto copy = token;
+        }
+        REQUIRE(fixture.ReadAck(50) == 0);
+    }
+    REQUIRE(fixture.ReadAck() == 0x2000);
+}
+
+TEST_CASE("Releases owed to an old session are dropped", "[HwcEventChannel]")
+{
+    HwcEventChannelFixture fixture;
+    auto                   stale = fixture.Display(0x3000);
+    fixture.channel->NewSession();
+    auto current = fixture.Display(0x4000);
+
+    stale.Release();
+    current.Release();
+    REQUIRE(fixture.ReadAck() == 0x4000);
+    REQUIRE(fixture.ReadAck(50) == 0);
+
+    // Once the socket is gone nothing is sent, whenever the release comes.
+    auto late = fixture.Display(0x5000);
+    fixture.channel->Detach();
+    late.Release();
+    REQUIRE(fixture.ReadAck(50) == 0);
+    buffer_info_event_t ev = {};
+    REQUIRE(fixture.channel->Send(&ev, sizeof(ev)) == -1);
+    REQUIRE(errno == ENOTCONN);
+}
+
+TEST_CASE("Releases while the talker holds the log mutex", "[HwcEventChannel]")
+{
+    // The log mutex is only taken with event logging on.
+    setenv("ENABLE_PROFILE_YMLLOG", "1", 1);
+    setenv("YMLLOG_PATH", "/tmp/vhal-hwc-event-channel-test.yml", 1);
+    auto log = make_shared<ProfileLogger>();
+    log->Initialize();
+    unsetenv("ENABLE_PROFILE_YMLLOG");
+    REQUIRE(log->IsEnabled());
+
+    HwcEventChannelFixture fixture(log);
+    auto                   own     = fixture.Display(0x6000);
+    auto                   foreign = fixture.Display(0x7000);
+
+    // The talker dispatches a frame with the log mutex held.
+    log->AcquireMutex();
+    fixture.channel->SetDispatching(true);
+
+    // A release from the handler, on the talker thread, must not lock it
+    // again.
+    own.Release();
+    REQUIRE(fixture.ReadAck() == 0x6000);
+
+    // One from another thread is sent right away, and logged once the
+    // talker is done.
+    std::atomic<bool> released = false;
+    std::thread       encoder([&]() {
+        foreign.Release();
+        released = true;
+    });
+    REQUIRE(fixture.ReadAck() == 0x7000);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    REQUIRE_FALSE(released);
+
+    fixture.channel->SetDispatching(false);
+    log->ReleaseMutex();
+    encoder.join();
+    REQUIRE(released);
+}
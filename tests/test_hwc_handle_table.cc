@@ -0,0 +1,91 @@
+/**
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "catch.hpp"
+#include "hwc_handle_table.h"
+#include <map>
+#include <random>
+#include <set>
+
+using namespace vhal::client;
+
+TEST_CASE("Handle table matches a map under random churn", "[hwc_handle_table]")
+{
+    HwcHandlePool                             pool;
+    HwcHandleTable                            table(4);
+    std::map<uint64_t, cros_gralloc_handle_t> expected;
+    std::mt19937_64                           rng(7);
+
+    for (int i = 0; i < 20000; i++) {
+        // Few distinct keys, page aligned like guest pointers, so that
+        // clusters form and erasure has to shift entries back.
+        uint64_t remote = (rng() % 96) << 12;
+        if (rng() % 3) {
+            auto local = pool.Acquire();
+            auto old   = table.Insert(remote, local);
+            auto it    = expected.find(remote);
+            REQUIRE(old == (it == expected.end() ? nullptr : it->second));
+            if (old) {
+                pool.Release(old);
+            }
+            expected[remote] = local;
+        } else {
+            auto local = table.Erase(remote);
+            auto it    = expected.find(remote);
+            REQUIRE(local == (it == expected.end() ? nullptr : it->second));
+            if (local) {
+                pool.Release(local);
+                expected.erase(it);
+            }
+        }
+        REQUIRE(table.Size() == expected.size());
+    }
+    for (auto& [remote, local] : expected) {
+        REQUIRE(table.Find(remote) == local);
+    }
+    size_t visited = 0;
+    table.ForEach([&](uint64_t remote, cros_gralloc_handle_t local) {
+        REQUIRE(expected.at(remote) == local);
+        visited++;
+    });
+    REQUIRE(visited == expected.size());
+    REQUIRE(table.Find(1) == nullptr);
+}
+
+TEST_CASE("Handle pool reuses released handles", "[hwc_handle_table]")
+{
+    HwcHandlePool                   pool;
+    std::set<cros_gralloc_handle_t> first;
+    for (size_t i = 0; i < HwcHandlePool::kChunkHandles; i++) {
+        auto handle         = pool.Acquire();
+        handle->base.numFds  = 1;
+        first.insert(handle);
+    }
+    for (auto handle : first) {
+        pool.Release(handle);
+    }
+    for (size_t i = 0; i < HwcHandlePool::kChunkHandles; i++) {
+        auto handle = pool.Acquire();
+        REQUIRE(first.count(handle) == 1);
+        REQUIRE(handle->base.numFds == 0);
+    }
+    // Past the first chunk, the pool grows instead of failing.
+    REQUIRE(pool.Acquire() != nullptr);
+}
@@ -0,0 +1,188 @@
+/**
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "catch.hpp"
+#include "hwc_mailbox.h"
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace vhal::client;
+
+/**
+ * What the handler saw and which frames were released, in order, e.g.
+ * "create 1", "display 1", "ack 1", "done 1".
+ */
+class EventLog
+{
+public:
+    void Add(std::string event)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            events_.push_back(std::move(event));
+        }
+        cv_.notify_all();
+    }
+
+    std::vector<std::string> WaitFor(size_t count)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait_for(lock, std::chrono::seconds(2), [&]() { return events_.size() >= count; });
+        return events_;
+    }
+
+    std::vector<std::string> Get()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return events_;
+    }
+
+private:
+    std::mutex               mutex_;
+    std::condition_variable  cv_;
+    std::vector<std::string> events_;
+};
+
+namespace vhal {
+namespace client {
+
+// Stands in for the DISPLAY_ACK of the receiver: logs the release.
+class DisplayReleaseToken::Pending
+{
+public:
+    Pending(EventLog& log, int id) : log_{ log }, id_{ id } {}
+    ~Pending() { log_.Add("ack " + std::to_string(id_)); }
+
+private:
+    EventLog& log_;
+    int       id_;
+};
+
+} // namespace client
+} // namespace vhal
+
+// Fake gralloc handles, told apart by address only.
+static cros_gralloc_handle kBuffers[3];
+
+static int
+Id(cros_gralloc_handle_t handle)
+{
+    return static_cast<int>(handle - kBuffers);
+}
+
+struct HwcMailboxFixture
+{
+    EventLog   log;
+    HwcMailbox mailbox{ [this](CommandType cmd, const frame_info_t* frame,
+                               DisplayReleaseToken token) {
+        static const char* kNames[] = { "create ", "remove ", "display " };
+        log.Add(kNames[cmd] + std::to_string(Id(frame->handle)));
+        // token is dropped on return, which releases the frame.
+    } };
+
+    void Create(int id) { mailbox.Create(&kBuffers[id], nullptr); }
+
+    void Remove(int id)
+    {
+        mailbox.Remove(&kBuffers[id], nullptr,
+                       [this, id]() { log.Add("done " + std::to_string(id)); });
+    }
+
+    void Display(int id)
+    {
+        frame_info_t frame = { &kBuffers[id], nullptr, nullptr };
+        mailbox.Display(frame, DisplayReleaseToken(
+                                 std::make_shared<DisplayReleaseToken::Pending>(log, id)));
+    }
+};
+
+using Events = std::vector<std::string>;
+
+TEST_CASE("A newer frame supersedes the pending one", "[hwc_mailbox]")
+{
+    HwcMailboxFixture f;
+    f.Display(0);
+    f.Display(1);
+    // Released right away, never shown.
+    REQUIRE(f.log.Get() == Events{ "ack 0" });
+
+    f.mailbox.Start();
+    REQUIRE(f.log.WaitFor(3) == Events{ "ack 0", "display 1", "ack 1" });
+    f.mailbox.Stop();
+    REQUIRE(f.mailbox.Stats().delivered == 1);
+    REQUIRE(f.mailbox.Stats().dropped == 1);
+}
+
+TEST_CASE("Commands and the frame are delivered in sequence", "[hwc_mailbox]")
+{
+    HwcMailboxFixture f;
+    f.Create(0);
+    f.Display(0);
+    f.Create(1);
+    f.mailbox.Start();
+    REQUIRE(f.log.WaitFor(4) == Events{ "create 0", "display 0", "ack 0", "create 1" });
+    f.mailbox.Stop();
+
+    // A frame superseded after a command still lets the command through
+    // first, and its replacement comes after the commands before it.
+    HwcMailboxFixture g;
+    g.Create(0);
+    g.Display(0);
+    g.Create(1);
+    g.Display(1);
+    g.mailbox.Start();
+    REQUIRE(g.log.WaitFor(5)
+            == Events{ "ack 0", "create 0", "create 1", "display 1", "ack 1" });
+    g.mailbox.Stop();
+    REQUIRE(g.mailbox.Stats().dropped == 1);
+}
+
+TEST_CASE("Removing a buffer drops its pending frame", "[hwc_mailbox]")
+{
+    HwcMailboxFixture f;
+    f.Display(0);
+    f.Remove(1);
+    // Another buffer's removal leaves the frame alone.
+    REQUIRE(f.log.Get().empty());
+    f.Remove(0);
+    REQUIRE(f.log.Get() == Events{ "ack 0" });
+
+    f.mailbox.Start();
+    // done frees the handle: only after the handler saw the removal.
+    REQUIRE(f.log.WaitFor(5) == Events{ "ack 0", "remove 1", "done 1", "remove 0", "done 0" });
+    f.mailbox.Stop();
+    REQUIRE(f.mailbox.Stats().delivered == 0);
+    REQUIRE(f.mailbox.Stats().dropped == 1);
+}
+
+TEST_CASE("Stop delivers the pending commands", "[hwc_mailbox]")
+{
+    HwcMailboxFixture f;
+    f.Create(0);
+    f.Display(0);
+    f.Remove(2);
+    // Never started: Stop() delivers on this thread, the frame is dropped.
+    f.mailbox.Stop();
+    REQUIRE(f.log.Get() == Events{ "ack 0", "create 0", "remove 2", "done 2" });
+    REQUIRE(f.mailbox.Stats().dropped == 1);
+}
@@ -0,0 +1,111 @@
+/**
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "catch.hpp"
+#include "hwc_plane_mapping.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace vhal::client;
+
+static constexpr uint32_t kWidth  = 64;
+static constexpr uint32_t kHeight = 32;
+
+// memfd standing in for a dma-buf, filled with a byte pattern.
+static int
+PatternFd(size_t size, uint8_t seed)
+{
+    int fd = memfd_create("hwc-plane", MFD_CLOEXEC);
+    REQUIRE(fd >= 0);
+    std::vector<uint8_t> bytes(size);
+    for (size_t i = 0; i < size; i++) {
+        bytes[i] = static_cast<uint8_t>(seed + i);
+    }
+    REQUIRE(write(fd, bytes.data(), size) == (ssize_t)size);
+    return fd;
+}
+
+TEST_CASE("NV12 planes sharing one fd", "[hwc_plane_mapping]")
+{
+    const uint32_t y_size  = kWidth * kHeight;
+    const uint32_t uv_size = kWidth * kHeight / 2;
+
+    cros_gralloc_handle handle{};
+    handle.base.numFds = 1;
+    handle.fds[0]      = PatternFd(y_size + uv_size, 0);
+    handle.strides[0]  = handle.strides[1] = kWidth;
+    handle.offsets[1]  = y_size;
+    handle.sizes[0]    = y_size;
+    handle.sizes[1]    = uv_size;
+
+    std::string error;
+    auto        mapping = HwcPlaneMapping::Create(handle, error);
+    REQUIRE(mapping);
+    REQUIRE_FALSE(mapping->IsDmaBuf());
+    // The mapping keeps its own fd.
+    close(handle.fds[0]);
+
+    auto view = mapping->View();
+    REQUIRE(view->num_planes == 2);
+    REQUIRE(view->planes[0].stride == kWidth);
+    REQUIRE(view->planes[1].size == uv_size);
+    mapping->BeginAccess();
+    REQUIRE(view->planes[0].data[5] == 5);
+    REQUIRE(view->planes[1].data[0] == static_cast<uint8_t>(y_size));
+    REQUIRE(view->planes[1].data[3] == static_cast<uint8_t>(y_size + 3));
+    mapping->EndAccess();
+}
+
+TEST_CASE("One fd per plane", "[hwc_plane_mapping]")
+{
+    cros_gralloc_handle handle{};
+    handle.base.numFds = 2;
+    handle.fds[0]      = PatternFd(kWidth * kHeight, 10);
+    handle.fds[1]      = PatternFd(4096 + kWidth * kHeight / 2, 20);
+    handle.strides[0]  = handle.strides[1] = kWidth;
+    handle.offsets[1]  = 4096;
+    handle.sizes[0]    = kWidth * kHeight;
+    handle.sizes[1]    = kWidth * kHeight / 2;
+
+    std::string error;
+    auto        mapping = HwcPlaneMapping::Create(handle, error);
+    REQUIRE(mapping);
+    auto view = mapping->View();
+    REQUIRE(view->planes[0].data[0] == 10);
+    REQUIRE(view->planes[1].data[0] == static_cast<uint8_t>(20 + 4096));
+    close(handle.fds[0]);
+    close(handle.fds[1]);
+}
+
+TEST_CASE("Invalid buffers fail to map", "[hwc_plane_mapping]")
+{
+    cros_gralloc_handle handle{};
+    handle.base.numFds = 1;
+    handle.fds[0]      = -1;
+    handle.sizes[0]    = 4096;
+
+    std::string error;
+    REQUIRE_FALSE(HwcPlaneMapping::Create(handle, error));
+    REQUIRE_FALSE(error.empty());
+
+    handle.sizes[0] = 0;
+    REQUIRE_FALSE(HwcPlaneMapping::Create(handle, error));
+}
@@ -0,0 +1,230 @@
+/**
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "catch.hpp"
+#include "io_uring_stream_socket_client.h"
+#include "unix_stream_socket_client.h"
+#include <cerrno>
+#include <cstring>
+#include <numeric>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace vhal::client;
+
+static const std::string kServerPath = "/tmp/vhal-io-uring-test-socket";
+
+// Accepts IoUringStreamSocketClients over a Unix socket.
+class Server
+{
+public:
+    Server()
+    {
+        unlink(kServerPath.c_str());
+        listen_fd_              = socket(AF_UNIX, SOCK_STREAM, 0);
+        struct sockaddr_un addr = {};
+        addr.sun_family         = AF_UNIX;
+        strncpy(addr.sun_path, kServerPath.c_str(), sizeof(addr.sun_path) - 1);
+        bind(listen_fd_, (struct sockaddr*)&addr, sizeof(addr));
+        listen(listen_fd_, 8);
+    }
+
+    ~Server()
+    {
+        close(listen_fd_);
+        unlink(kServerPath.c_str());
+    }
+
+    // Connects a client through queue, returns the server side.
+    int Connect(IoUringStreamSocketClient& client)
+    {
+        auto [connected, error_msg] = client.Connect();
+        REQUIRE(connected);
+        int fd = accept(listen_fd_, nullptr, nullptr);
+        REQUIRE(fd >= 0);
+        return fd;
+    }
+
+private:
+    int listen_fd_ = -1;
+};
+
+static std::unique_ptr<IoUringStreamSocketClient>
+MakeClient(std::shared_ptr<IoUringQueue> queue)
+{
+    return std::make_unique<IoUringStreamSocketClient>(
+      std::make_unique<UnixStreamSocketClient>(std::string(kServerPath)), std::move(queue));
+}
+
+static bool
+RecvAll(int fd, void* data, size_t size)
+{
+    return recv(fd, data, size, MSG_WAITALL) == (ssize_t)size;
+}
+
+// Send, SendV and Recv round trips, and a hang up reported as EPIPE.
+static void
+CheckRoundTrip(IoUringStreamSocketClient& client, int fd, uint8_t* buf, size_t size)
+{
+    std::iota(buf, buf + size, 0);
+    REQUIRE(client.SendNoAlloc(buf, size).size == (ssize_t)size);
+    std::vector<uint8_t> received(size);
+    REQUIRE(RecvAll(fd, received.data(), size));
+    REQUIRE(memcmp(received.data(), buf, size) == 0);
+
+    uint32_t     header = 0xCAFE;
+    struct iovec iov[2] = { { &header, sizeof(header) }, { buf, size } };
+    REQUIRE(client.SendVNoAlloc(iov, 2).size == ssize_t(sizeof(header) + size));
+    REQUIRE(RecvAll(fd, &header, sizeof(header)));
+    REQUIRE(header == 0xCAFE);
+    REQUIRE(RecvAll(fd, received.data(), size));
+
+    // The recv() flags hold for registered buffers too.
+    auto status = client.RecvNoAlloc(buf, size, MSG_DONTWAIT);
+    REQUIRE(status.size == -1);
+    REQUIRE(status.error == std::errc::resource_unavailable_try_again);
+    REQUIRE(send(fd, "ping", 4, 0) == 4);
+    REQUIRE(client.RecvNoAlloc(buf, 2, MSG_PEEK).size == 2);
+    REQUIRE(client.RecvNoAlloc(buf, 4).size == 4);
+    REQUIRE(memcmp(buf, "ping", 4) == 0);
+
+    // The default SIGPIPE action would end the test here.
+    close(fd);
+    status = client.SendNoAlloc(buf, size);
+    REQUIRE(status.size == -1);
+    REQUIRE(status.error == std::errc::broken_pipe);
+    status = client.SendVNoAlloc(iov, 2);
+    REQUIRE(status.size == -1);
+    REQUIRE(status.error == std::errc::broken_pipe);
+}
+
+TEST_CASE("TestIoUringFallback", "[fallback]")
+{
+    // io_uring_setup() refuses an empty ring, like on a kernel without it.
+    auto queue = std::make_shared<IoUringQueue>(0);
+    REQUIRE(queue->Available() == false);
+    uint8_t buf[64];
+    struct iovec iov = { buf, sizeof(buf) };
+    REQUIRE(queue->RegisterBuffers(&iov, 1) == false);
+
+    Server server;
+    auto   client = MakeClient(queue);
+    CheckRoundTrip(*client, server.Connect(*client), buf, sizeof(buf));
+}
+
+TEST_CASE("TestIoUringFixedFiles", "[fixed_file]")
+{
+    // One slot: the first client gets a fixed file, the second the plain fd.
+    auto queue = std::make_shared<IoUringQueue>(64, 1);
+    if (!queue->Available()) {
+        WARN("io_uring unavailable");
+        return;
+    }
+    Server  server;
+    auto    fixed  = MakeClient(queue);
+    auto    plain  = MakeClient(queue);
+    int     fd     = server.Connect(*fixed);
+    uint8_t buf[64];
+    CheckRoundTrip(*plain, server.Connect(*plain), buf, sizeof(buf));
+    CheckRoundTrip(*fixed, fd, buf, sizeof(buf));
+
+    // Reconnecting frees the slot and takes it again.
+    fixed->Close();
+    CheckRoundTrip(*fixed, server.Connect(*fixed), buf, sizeof(buf));
+}
+
+TEST_CASE("TestIoUringRegisteredBuffers", "[fixed_buffer]")
+{
+    auto queue = std::make_shared<IoUringQueue>();
+    if (!queue->Available()) {
+        WARN("io_uring unavailable");
+        return;
+    }
+    std::vector<uint8_t> registered(64 * 1024);
+    struct iovec         iov = { registered.data(), registered.size() };
+    REQUIRE(queue->RegisterBuffers(&iov, 1));
+
+    Server server;
+    auto   client = MakeClient(queue);
+    // From within the registered buffer, not at its start.
+    CheckRoundTrip(*client, server.Connect(*client), registered.data() + 100, 4096);
+    queue->UnregisterBuffers();
+}
+
+TEST_CASE("TestIoUringConcurrentSessions", "[batch]")
+{
+    auto queue = std::make_shared<IoUringQueue>(8);
+    if (!queue->Available()) {
+        WARN("io_uring unavailable");
+        return;
+    }
+    // More sessions than submission slots, each one sending while another
+    // thread waits in the kernel for a receive.
+    constexpr int kSessions = 16;
+    constexpr int kMessages = 200;
+    Server        server;
+    std::vector<std::unique_ptr<IoUringStreamSocketClient>> clients;
+    std::vector<int>                                       fds;
+    for (int i = 0; i < kSessions; i++) {
+        clients.push_back(MakeClient(queue));
+        fds.push_back(server.Connect(*clients.back()));
+    }
+    uint8_t     reply = 0;
+    ssize_t     received = 0;
+    std::thread receiver([&]() { received = clients[0]->RecvNoAlloc(&reply, 1).size; });
+
+    // Catch assertions are not thread safe, check the results afterwards.
+    std::vector<int>         sent(kSessions);
+    std::vector<std::thread> senders;
+    for (int i = 0; i < kSessions; i++) {
+        senders.emplace_back([&, i]() {
+            for (uint32_t m = 0; m < kMessages; m++) {
+                uint32_t     msg[2] = { uint32_t(i), m };
+                struct iovec iov[2] = { { &msg[0], sizeof(msg[0]) }, { &msg[1], sizeof(msg[1]) } };
+                sent[i] += clients[i]->SendVNoAlloc(iov, 2).size == sizeof(msg);
+            }
+        });
+    }
+    for (int i = 0; i < kSessions; i++) {
+        for (uint32_t m = 0; m < kMessages; m++) {
+            uint32_t msg[2];
+            REQUIRE(RecvAll(fds[i], msg, sizeof(msg)));
+            REQUIRE(msg[0] == uint32_t(i));
+            REQUIRE(msg[1] == m);
+        }
+    }
+    for (auto& sender : senders) {
+        sender.join();
+    }
+    for (auto n : sent) {
+        REQUIRE(n == kMessages);
+    }
+    REQUIRE(send(fds[0], "x", 1, 0) == 1);
+    receiver.join();
+    REQUIRE(received == 1);
+    REQUIRE(reply == 'x');
+    for (int fd : fds) {
+        close(fd);
+    }
+}
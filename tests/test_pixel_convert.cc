@@ -0,0 +1,156 @@
+/**
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "catch.hpp"
+#include "pixel_convert.h"
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace vhal::client;
+
+using Bytes = std::vector<uint8_t>;
+
+struct Source
+{
+    Bytes       planes[2];
+    raw_image_t image;
+};
+
+// Random image with a row padding, so that strides are exercised.
+static Source
+RandomImage(PixelFormat format, uint32_t width, uint32_t height)
+{
+    static const size_t bpp[] = { 1, 2, 2, 3, 4 };
+    std::mt19937        rng(width * 31 + height);
+    Source              src;
+    src.image.format    = format;
+    src.image.width     = width;
+    src.image.height    = height;
+    src.image.stride[0] = width * bpp[static_cast<int>(format)] + 8;
+    src.image.stride[1] = width + 8;
+    src.planes[0].resize(src.image.stride[0] * height);
+    src.planes[1].resize(src.image.stride[1] * height / 2);
+    for (auto& plane : src.planes) {
+        for (auto& b : plane) {
+            b = rng();
+        }
+    }
+    src.image.data[0] = src.planes[0].data();
+    src.image.data[1] = src.planes[1].data();
+    return src;
+}
+
+static Bytes
+Convert(const raw_image_t& image, bool downscale)
+{
+    Bytes out(I420FrameSize(image.width, image.height, downscale));
+    REQUIRE(ConvertToI420(image, out.data(), out.size(), downscale) == out.size());
+    return out;
+}
+
+TEST_CASE("SIMD conversions match the scalar ones", "[PixelConvert]")
+{
+    const PixelFormat formats[] = { PixelFormat::kNV12, PixelFormat::kYUYV,
+                                    PixelFormat::kUYVY, PixelFormat::kRGB24,
+                                    PixelFormat::kRGBA };
+    for (auto format : formats) {
+        // 200 leaves tails behind every SIMD loop.
+        for (uint32_t width : { 64u, 200u, 1920u }) {
+            auto src = RandomImage(format, width, 12);
+            for (bool downscale : { false, true }) {
+                SetPixelConvertSimdLevel(SimdLevel::kScalar);
+                Bytes expected = Convert(src.image, downscale);
+                for (auto level : { SimdLevel::kSse41, SimdLevel::kAvx2 }) {
+                    SetPixelConvertSimdLevel(level);
+                    CHECK(Convert(src.image, downscale) == expected);
+                }
+            }
+        }
+    }
+    SetPixelConvertSimdLevel(SimdLevel::kAvx2);
+}
+
+TEST_CASE("RGB uses BT.601 limited range", "[PixelConvert]")
+{
+    Bytes       rgba(4 * 4 * 2);
+    raw_image_t image;
+    image.format  = PixelFormat::kRGBA;
+    image.width   = 4;
+    image.height  = 2;
+    image.data[0] = rgba.data();
+    for (size_t i = 0; i < rgba.size(); i += 4) {
+        // Left half white, right half black.
+        uint8_t c   = (i / 4) % 4 < 2 ? 255 : 0;
+        rgba[i]     = c;
+        rgba[i + 1] = c;
+        rgba[i + 2] = c;
+    }
+    Bytes i420 = Convert(image, false);
+    CHECK(i420[0] == 235);
+    CHECK(i420[3] == 16);
+    CHECK(i420[8] == 128);  // U
+    CHECK(i420[10] == 128); // V
+}
+
+TEST_CASE("Invalid dimensions are refused", "[PixelConvert]")
+{
+    uint8_t     pixel[64] = {};
+    raw_image_t image;
+    image.format  = PixelFormat::kYUYV;
+    image.width   = 3;
+    image.height  = 2;
+    image.data[0] = pixel;
+    CHECK(I420FrameSize(3, 2) == 0);
+    CHECK(ConvertToI420(image, pixel, sizeof(pixel)) == 0);
+    CHECK(I420FrameSize(6, 2, true) == 0);
+    CHECK(I420FrameSize(8, 4, true) == 12);
+}
+
+TEST_CASE("The SIMD level may change while other threads convert", "[PixelConvert]")
+{
+    auto src = RandomImage(PixelFormat::kYUYV, 200, 12);
+    SetPixelConvertSimdLevel(SimdLevel::kScalar);
+    const Bytes expected = Convert(src.image, true);
+
+    std::atomic<bool> done       = false;
+    std::atomic<int>  mismatches = 0;
+    std::vector<std::thread> converters;
+    for (int i = 0; i < 4; ++i) {
+        converters.emplace_back([&]() {
+            Bytes out(expected.size());
+            while (!done) {
+                ConvertToI420(src.image, out.data(), out.size(), true);
+                mismatches += out != expected;
+            }
+        });
+    }
+    const SimdLevel levels[] = { SimdLevel::kScalar, SimdLevel::kSse41, SimdLevel::kAvx2 };
+    for (int i = 0; i < 3000; ++i) {
+        SetPixelConvertSimdLevel(levels[i % 3]);
+    }
+    done = true;
+    for (auto& converter : converters) {
+        converter.join();
+    }
+    CHECK(mismatches == 0);
+    SetPixelConvertSimdLevel(SimdLevel::kAvx2);
+}
@@ -0,0 +1,285 @@
+/**
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "catch.hpp"
+#include "reactor.h"
+#include "stream_talker.h"
+#include "unix_stream_socket_client.h"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace vhal::client;
+using namespace std::chrono_literals;
+
+// Runs fn on the reactor thread and waits for it.
+template <typename Fn>
+static void
+RunOnLoop(Reactor& reactor, Fn&& fn)
+{
+    std::promise<void> done;
+    reactor.Post([&]() {
+        fn();
+        done.set_value();
+    });
+    done.get_future().wait();
+}
+
+static void
+Signal(int fd)
+{
+    uint64_t one = 1;
+    REQUIRE(write(fd, &one, sizeof(one)) == sizeof(one));
+}
+
+static void
+Drain(int fd)
+{
+    uint64_t count;
+    while (read(fd, &count, sizeof(count)) > 0) {
+    }
+}
+
+// Makes the reactor's epoll_wait() fail, by putting a pipe in place of its
+// epoll fd: the only one in this process.
+static void
+BreakEpoll(Reactor& reactor)
+{
+    int epoll_fd = -1;
+    for (int fd = 0; fd < 1024; fd++) {
+        char link[64], target[256] = {};
+        snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+        if (readlink(link, target, sizeof(target) - 1) > 0
+            && strcmp(target, "anon_inode:[eventpoll]") == 0) {
+            epoll_fd = fd;
+        }
+    }
+    REQUIRE(epoll_fd >= 0);
+    int pipe_fds[2];
+    REQUIRE(pipe(pipe_fds) == 0);
+    REQUIRE(dup2(pipe_fds[0], epoll_fd) == epoll_fd);
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    // Wake the loop out of the old epoll instance.
+    reactor.Post([]() {});
+}
+
+TEST_CASE("Fd handlers run on the loop thread until removed", "[Reactor]")
+{
+    Reactor          reactor;
+    int              fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    std::atomic<int> calls{ 0 };
+    std::atomic<bool> in_loop{ false };
+    REQUIRE(reactor.AddFd(fd, EPOLLIN, [&](uint32_t events) {
+        in_loop = reactor.InLoopThread() && (events & EPOLLIN);
+        Drain(fd);
+        ++calls;
+    }));
+    REQUIRE_FALSE(reactor.AddFd(fd, EPOLLIN, [](uint32_t) {}));
+    REQUIRE_FALSE(reactor.InLoopThread());
+
+    Signal(fd);
+    for (int i = 0; i < 100 && calls == 0; i++) {
+        std::this_thread::sleep_for(5ms);
+    }
+    REQUIRE(calls == 1);
+    REQUIRE(in_loop);
+
+    reactor.RemoveFd(fd);
+    Signal(fd);
+    RunOnLoop(reactor, []() {});
+    std::this_thread::sleep_for(20ms);
+    REQUIRE(calls == 1);
+    close(fd);
+}
+
+TEST_CASE("RemoveFd waits for a running handler", "[Reactor]")
+{
+    Reactor           reactor;
+    int               fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    std::atomic<bool> running{ false };
+    std::atomic<bool> finished{ false };
+    REQUIRE(reactor.AddFd(fd, EPOLLIN, [&](uint32_t) {
+        Drain(fd);
+        running = true;
+        std::this_thread::sleep_for(50ms);
+        finished = true;
+    }));
+    Signal(fd);
+    while (!running) {
+        std::this_thread::sleep_for(1ms);
+    }
+    reactor.RemoveFd(fd);
+    REQUIRE(finished);
+    close(fd);
+}
+
+TEST_CASE("Events fetched for a removed fd are not delivered", "[Reactor]")
+{
+    Reactor reactor;
+    int     fds[2] = { eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC),
+                       eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC) };
+    int     handled    = 0;
+    int     stale      = 0;
+    bool    reused     = false;
+    // Whichever runs first replaces the other fd with a new one, which gets
+    // the same number and is not readable.
+    for (int i = 0; i < 2; i++) {
+        REQUIRE(reactor.AddFd(fds[i], EPOLLIN, [&, i](uint32_t) {
+            ++handled;
+            Drain(fds[i]);
+            int other = fds[1 - i];
+            reactor.RemoveFd(other);
+            close(other);
+            int fresh = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            reused    = fresh == other;
+            reactor.AddFd(fresh, EPOLLIN, [&](uint32_t) { ++stale; });
+            fds[1 - i] = fresh;
+        }));
+    }
+
+    // Both become readable while the loop is busy, so they are fetched in
+    // the same epoll_wait().
+    RunOnLoop(reactor, [&]() {
+        Signal(fds[0]);
+        Signal(fds[1]);
+    });
+    RunOnLoop(reactor, []() {});
+    RunOnLoop(reactor, [&]() {
+        REQUIRE(handled == 1);
+        REQUIRE(reused);
+        REQUIRE(stale == 0);
+    });
+    reactor.RemoveFd(fds[0]);
+    reactor.RemoveFd(fds[1]);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST_CASE("Timers fire in deadline order unless cancelled", "[Reactor]")
+{
+    Reactor           reactor;
+    std::mutex        mutex;
+    std::vector<int>  fired;
+    auto              record = [&](int n) {
+        return [&, n]() {
+            std::lock_guard<std::mutex> lock(mutex);
+            fired.push_back(n);
+        };
+    };
+    auto start = std::chrono::steady_clock::now();
+    reactor.RunAfter(60ms, record(3));
+    reactor.RunAfter(20ms, record(1));
+    auto cancelled = reactor.RunAfter(40ms, record(2));
+    REQUIRE(cancelled != 0);
+    reactor.CancelTimer(cancelled);
+
+    std::promise<void> done;
+    reactor.RunAfter(80ms, [&]() { done.set_value(); });
+    done.get_future().wait();
+    REQUIRE(std::chrono::steady_clock::now() - start >= 80ms);
+    std::lock_guard<std::mutex> lock(mutex);
+    REQUIRE(fired == std::vector<int>{ 1, 3 });
+}
+
+TEST_CASE("Posted tasks run in order on the loop thread", "[Reactor]")
+{
+    Reactor          reactor;
+    std::vector<int> order;
+    RunOnLoop(reactor, [&]() {
+        REQUIRE(reactor.InLoopThread());
+        // Posted from a task: runs after the ones already queued.
+        reactor.Post([&]() { order.push_back(3); });
+        order.push_back(0);
+    });
+    reactor.Post([&]() { order.push_back(1); });
+    reactor.Post([&]() { order.push_back(2); });
+    RunOnLoop(reactor, []() {});
+    RunOnLoop(reactor, [&]() { REQUIRE(order == std::vector<int>{ 0, 3, 1, 2 }); });
+}
+
+TEST_CASE("A failed epoll_wait goes through the fd handlers", "[Reactor]")
+{
+    Reactor           reactor;
+    int               fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    std::atomic<uint32_t> reported{ 0 };
+    REQUIRE(reactor.AddFd(fd, EPOLLIN, [&](uint32_t events) { reported = events; }));
+
+    BreakEpoll(reactor);
+    for (int i = 0; i < 100 && !reported; i++) {
+        std::this_thread::sleep_for(5ms);
+    }
+    REQUIRE(reported == EPOLLERR);
+    REQUIRE(reactor.Failed());
+    REQUIRE_FALSE(reactor.AddFd(fd, EPOLLIN, [](uint32_t) {}));
+
+    // Tasks and timers still run.
+    RunOnLoop(reactor, []() {});
+    std::promise<void> fired;
+    reactor.RunAfter(10ms, [&]() { fired.set_value(); });
+    REQUIRE(fired.get_future().wait_for(1s) == std::future_status::ready);
+    reactor.RemoveFd(fd);
+    close(fd);
+}
+
+TEST_CASE("Talkers stop talking when their reactor fails", "[Reactor]")
+{
+    const std::string path = "/tmp/vhal-reactor-test-socket";
+    unlink(path.c_str());
+    int                listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr      = {};
+    addr.sun_family              = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    REQUIRE(bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) == 0);
+    REQUIRE(listen(listen_fd, 1) == 0);
+
+    auto                   reactor = std::make_shared<Reactor>();
+    UnixStreamSocketClient client(path);
+    std::promise<void>     connected;
+    StreamTalker           talker(
+      &client, "test", reactor, [&]() { connected.set_value(); },
+      []() { return StreamTalker::Status::kContinue; });
+    talker.Start();
+    REQUIRE(connected.get_future().wait_for(1s) == std::future_status::ready);
+    int vhal = accept(listen_fd, nullptr, nullptr);
+
+    BreakEpoll(*reactor);
+    for (int i = 0; i < 100 && client.Connected(); i++) {
+        std::this_thread::sleep_for(5ms);
+    }
+    REQUIRE_FALSE(client.Connected());
+    // The VHal sees the hang up, and Stop() does not hang.
+    char byte;
+    REQUIRE(recv(vhal, &byte, 1, 0) == 0);
+    talker.Stop();
+
+    close(vhal);
+    close(listen_fd);
+    unlink(path.c_str());
+}
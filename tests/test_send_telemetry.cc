@@ -0,0 +1,141 @@
+/**
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "catch.hpp"
+#include "hdr_histogram.h"
+#include "send_telemetry.h"
+#include <chrono>
+#include <limits>
+#include <thread>
+
+using namespace vhal::client;
+using namespace std::chrono_literals;
+
+TEST_CASE("Values below the sub-bucket count are exact", "[HdrHistogram]")
+{
+    for (uint64_t v = 0; v < HdrHistogram::kSubBuckets; v++) {
+        REQUIRE(HdrHistogram::Index(v) == int(v));
+        REQUIRE(HdrHistogram::HighestEquivalent(int(v)) == v);
+    }
+
+    HdrHistogram histogram;
+    REQUIRE(histogram.Summary().count == 0);
+    for (uint64_t v = 1; v <= 10; v++) {
+        histogram.Record(v);
+    }
+    auto summary = histogram.Summary();
+    REQUIRE(summary.count == 10);
+    REQUIRE(summary.min == 1);
+    REQUIRE(summary.max == 10);
+    REQUIRE(summary.mean == Approx(5.5));
+    REQUIRE(summary.p50 == 5);
+    REQUIRE(summary.p90 == 9);
+    REQUIRE(summary.p99 == 10);
+}
+
+TEST_CASE("Buckets start at powers of two", "[HdrHistogram]")
+{
+    for (int k = HdrHistogram::kSubBits; k < 64; k++) {
+        const uint64_t power = uint64_t(1) << k;
+        const int      index = HdrHistogram::Index(power);
+        // The previous bucket ends right below the power of two...
+        REQUIRE(HdrHistogram::Index(power - 1) == index - 1);
+        REQUIRE(HdrHistogram::HighestEquivalent(index - 1) == power - 1);
+        // ...and the bucket holding it is 1/kSubBuckets of it wide.
+        const uint64_t width = power / HdrHistogram::kSubBuckets;
+        REQUIRE(HdrHistogram::HighestEquivalent(index) == power + width - 1);
+        REQUIRE(HdrHistogram::Index(power + width - 1) == index);
+        REQUIRE(HdrHistogram::Index(power + width) == index + 1);
+    }
+    REQUIRE(HdrHistogram::Index(std::numeric_limits<uint64_t>::max())
+            == HdrHistogram::kBuckets - 1);
+    REQUIRE(HdrHistogram::HighestEquivalent(HdrHistogram::kBuckets - 1)
+            == std::numeric_limits<uint64_t>::max());
+}
+
+TEST_CASE("Percentiles are within one bucket", "[HdrHistogram]")
+{
+    HdrHistogram histogram;
+    for (uint64_t v = 1; v <= 1000; v++) {
+        histogram.Record(v);
+    }
+    auto summary = histogram.Summary();
+    REQUIRE(summary.count == 1000);
+    REQUIRE(summary.mean == Approx(500.5));
+    // Reported as the highest value of the bucket, at most 1/16 above.
+    REQUIRE(summary.p50 >= 500);
+    REQUIRE(summary.p50 <= 500 + 500 / HdrHistogram::kSubBuckets);
+    REQUIRE(summary.p99 >= 990);
+    REQUIRE(summary.p99 <= 990 + 990 / HdrHistogram::kSubBuckets);
+    // Never above the largest value recorded.
+    REQUIRE(summary.p999 == 1000);
+}
+
+static void
+SleepToNextSecond()
+{
+    auto now  = SendTelemetry::Clock::now().time_since_epoch();
+    auto next = std::chrono::duration_cast<std::chrono::seconds>(now) + 1s;
+    // A little after the boundary, so the calls below stay in that second.
+    std::this_thread::sleep_for(next - now + 50ms);
+}
+
+TEST_CASE("Rates come from the last full second only", "[SendTelemetry]")
+{
+    SendTelemetry telemetry;
+    SleepToNextSecond();
+    for (int i = 0; i < 5; i++) {
+        telemetry.RecordSend(1000, SendTelemetry::Clock::now());
+    }
+    // The current second does not count yet.
+    REQUIRE(telemetry.Snapshot().fps == 0);
+
+    SleepToNextSecond();
+    auto t = telemetry.Snapshot();
+    REQUIRE(t.fps == 5);
+    REQUIRE(t.bitrate == 8.0 * 5000);
+    REQUIRE(t.frames_sent == 5);
+    REQUIRE(t.bytes_sent == 5000);
+
+    // Nothing sent during the last second: its slot is stale and reads 0.
+    SleepToNextSecond();
+    t = telemetry.Snapshot();
+    REQUIRE(t.fps == 0);
+    REQUIRE(t.bitrate == 0);
+    REQUIRE(t.frames_sent == 5);
+}
+
+TEST_CASE("A reused slot starts over", "[SendTelemetry]")
+{
+    SendTelemetry telemetry;
+    SleepToNextSecond();
+    for (int i = 0; i < 5; i++) {
+        telemetry.RecordSend(1000, SendTelemetry::Clock::now());
+    }
+    // Four seconds later the same slot comes around, still tagged with the
+    // old second.
+    for (int i = 0; i < 4; i++) {
+        SleepToNextSecond();
+    }
+    telemetry.RecordSend(100, SendTelemetry::Clock::now());
+    SleepToNextSecond();
+    auto t = telemetry.Snapshot();
+    REQUIRE(t.fps == 1);
+    REQUIRE(t.bitrate == 8.0 * 100);
+}
@@ -0,0 +1,147 @@
+/**
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "catch.hpp"
+#include "sendv_util.h"
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <numeric>
+#include <pthread.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace vhal::client;
+using namespace std::chrono_literals;
+
+// What one sendmsg() call was asked to send.
+static std::string
+Flatten(const struct msghdr* msg)
+{
+    std::string out;
+    for (size_t i = 0; i < msg->msg_iovlen; i++) {
+        out.append(static_cast<const char*>(msg->msg_iov[i].iov_base), msg->msg_iov[i].iov_len);
+    }
+    return out;
+}
+
+TEST_CASE("Short writes resume across iovec boundaries", "[SendMsgAll]")
+{
+    std::string  a = "abc", b = "", c = "defgh", d = "ij";
+    struct iovec iov[4] = { { &a[0], a.size() }, { &b[0], b.size() },
+                            { &c[0], c.size() }, { &d[0], d.size() } };
+
+    // Each call sends this many bytes, or fails with -errno.
+    std::vector<ssize_t>     script = { -EINTR, 2, 3, -EINTR, 4, 1 };
+    std::vector<std::string> asked;
+    size_t                   call     = 0;
+    auto                     progress = SendMsgAll(iov, 4, [&](struct msghdr* msg) {
+        asked.push_back(Flatten(msg));
+        return script.at(call++);
+    });
+
+    REQUIRE(progress.error == 0);
+    REQUIRE(progress.sent == 10);
+    REQUIRE(progress.total == 10);
+    REQUIRE(asked == std::vector<std::string>{ "abcdefghij", "abcdefghij", "cdefghij",
+                                               "fghij", "fghij", "j" });
+    // The caller's array is left alone.
+    REQUIRE(iov[0].iov_base == &a[0]);
+    REQUIRE(iov[0].iov_len == 3);
+    REQUIRE(iov[2].iov_len == 5);
+}
+
+TEST_CASE("An error stops the send with what went out", "[SendMsgAll]")
+{
+    std::string  a = "abcd", b = "efgh";
+    struct iovec iov[2] = { { &a[0], a.size() }, { &b[0], b.size() } };
+
+    std::vector<ssize_t> script = { 5, -EPIPE };
+    size_t               call   = 0;
+    auto progress = SendMsgAll(iov, 2, [&](struct msghdr*) { return script.at(call++); });
+    REQUIRE(progress.error == EPIPE);
+    REQUIRE(progress.sent == 5);
+    REQUIRE(progress.total == 8);
+}
+
+TEST_CASE("Slow reader and signals on a real socket", "[SendMsgAll]")
+{
+    int fds[2];
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    int size = 4096;
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+
+    // No SA_RESTART: a blocked sendmsg() returns EINTR or a short count.
+    struct sigaction sa = {}, old = {};
+    sa.sa_handler       = [](int) {};
+    sigaction(SIGUSR1, &sa, &old);
+
+    // Segments of odd sizes, so short writes end inside and across them.
+    std::vector<std::vector<uint8_t>> segments;
+    std::vector<struct iovec>         iov;
+    uint8_t                           next = 0;
+    for (size_t len : { 1, 1000, 7, 30000, 0, 4093, 65536, 3 }) {
+        segments.emplace_back(len);
+        for (auto& byte : segments.back()) {
+            byte = next++;
+        }
+    }
+    std::vector<uint8_t> sent;
+    for (auto& segment : segments) {
+        iov.push_back({ segment.data(), segment.size() });
+        sent.insert(sent.end(), segment.begin(), segment.end());
+    }
+
+    std::atomic<int> calls{ 0 };
+    SendVProgress    progress;
+    std::atomic<bool> done{ false };
+    std::thread       sender([&]() {
+        progress = SendMsgAll(iov.data(), iov.size(), [&](struct msghdr* msg) -> ssize_t {
+            ++calls;
+            ssize_t n = sendmsg(fds[0], msg, MSG_NOSIGNAL);
+            return n < 0 ? -errno : n;
+        });
+        done = true;
+    });
+
+    std::vector<uint8_t> received;
+    uint8_t              buf[1500];
+    while (received.size() < sent.size()) {
+        if (!done) {
+            pthread_kill(sender.native_handle(), SIGUSR1);
+        }
+        std::this_thread::sleep_for(100us);
+        ssize_t n = recv(fds[1], buf, sizeof(buf), 0);
+        REQUIRE(n > 0);
+        received.insert(received.end(), buf, buf + n);
+    }
+    sender.join();
+    sigaction(SIGUSR1, &old, nullptr);
+
+    REQUIRE(progress.error == 0);
+    REQUIRE(progress.sent == sent.size());
+    REQUIRE(calls > 1);
+    REQUIRE(received == sent);
+    close(fds[0]);
+    close(fds[1]);
+}
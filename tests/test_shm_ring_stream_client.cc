@@ -0,0 +1,232 @@
+/**
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "catch.hpp"
+#include "shm_ring_server_stub.h"
+#include "shm_ring_stream_client.h"
+#include <algorithm>
+#include <numeric>
+#include <poll.h>
+#include <thread>
+#include <vector>
+
+using namespace vhal::client;
+
+static const std::string kServerPath = "/tmp/vhal-shm-ring-test-socket";
+
+TEST_CASE("TestShmRingConnect", "[connect]")
+{
+    ShmRingServerStub   server(kServerPath);
+    ShmRingStreamClient client(kServerPath);
+
+    bool        accepted = false;
+    std::thread accept_thread([&]() { accepted = server.Accept(); });
+    auto [connected, error_msg] = client.Connect();
+    accept_thread.join();
+
+    REQUIRE(accepted == true);
+    REQUIRE(connected == true);
+    REQUIRE(client.Connected() == true);
+    REQUIRE(client.GetNativeSocketFd() >= 0);
+    // The epoll fd is no unix socket, fd passing users must not take it for one.
+    REQUIRE(client.GetRemotePath().empty());
+}
+
+TEST_CASE("TestShmRingConnectRefused", "[connect]")
+{
+    ShmRingServerStub   server(kServerPath);
+    ShmRingStreamClient client(kServerPath);
+
+    std::thread accept_thread([&server]() { server.Accept(ENOMEM); });
+    auto [connected, error_msg] = client.Connect();
+    accept_thread.join();
+
+    REQUIRE(connected == false);
+    REQUIRE(client.Connected() == false);
+}
+
+TEST_CASE("TestShmRingSendRecv", "[send][recv]")
+{
+    ShmRingServerStub   server(kServerPath);
+    ShmRingStreamClient client(kServerPath);
+
+    std::thread accept_thread([&server]() { server.Accept(); });
+    client.Connect();
+    accept_thread.join();
+
+    uint32_t     header     = 0xCAFE;
+    uint8_t      payload[3] = { 1, 2, 3 };
+    struct iovec iov[2]     = { { &header, sizeof(header) },
+                                { payload, sizeof(payload) } };
+    REQUIRE(std::get<0>(client.SendV(iov, 2)) == 7);
+
+    uint8_t received[7] = {};
+    REQUIRE(server.RecvAll(received, sizeof(received)));
+    REQUIRE(memcmp(received, &header, sizeof(header)) == 0);
+    REQUIRE(memcmp(received + 4, payload, sizeof(payload)) == 0);
+
+    // Nothing queued: not readable, MSG_DONTWAIT does not block.
+    struct pollfd pfd = { client.GetNativeSocketFd(), POLLIN, 0 };
+    REQUIRE(poll(&pfd, 1, 0) == 0);
+    uint8_t byte = 0;
+    REQUIRE(std::get<0>(client.Recv(&byte, 1, MSG_DONTWAIT)) == -1);
+
+    REQUIRE(server.Send("ack", 3) == 3);
+    REQUIRE(poll(&pfd, 1, 1000) == 1);
+    char reply[3] = {};
+    REQUIRE(std::get<0>(client.Recv((uint8_t*)reply, 1, MSG_PEEK)) == 1);
+    REQUIRE(reply[0] == 'a');
+    REQUIRE(std::get<0>(client.Recv((uint8_t*)reply, 3)) == 3);
+    REQUIRE(memcmp(reply, "ack", 3) == 0);
+}
+
+TEST_CASE("TestShmRingLargerThanRing", "[send][recv]")
+{
+    ShmRingServerStub   server(kServerPath);
+    ShmRingStreamClient client(kServerPath, 4096);
+
+    std::thread accept_thread([&server]() { server.Accept(); });
+    client.Connect();
+    accept_thread.join();
+
+    std::vector<uint8_t> frame(1024 * 1024);
+    std::iota(frame.begin(), frame.end(), 0);
+    // Catch assertions are not thread safe, check the results afterwards.
+    ssize_t     sent[4] = {};
+    std::thread sender([&]() {
+        for (auto& n : sent) {
+            n = std::get<0>(client.Send(frame.data(), frame.size()));
+        }
+    });
+    std::vector<uint8_t> received(frame.size());
+    for (int i = 0; i < 4; i++) {
+        REQUIRE(server.RecvAll(received.data(), received.size()));
+        REQUIRE(received == frame);
+    }
+    sender.join();
+    for (auto n : sent) {
+        REQUIRE(n == (ssize_t)frame.size());
+    }
+}
+
+TEST_CASE("TestShmRingConcurrentSenders", "[send][recv]")
+{
+    ShmRingServerStub   server(kServerPath);
+    ShmRingStreamClient client(kServerPath, 4096);
+
+    std::thread accept_thread([&server]() { server.Accept(); });
+    client.Connect();
+    accept_thread.join();
+
+    // Header and payload in separate iovecs, larger than the ring, so that
+    // every message has to wait for space half way through.
+    constexpr int      kSenders  = 4;
+    constexpr int      kMessages = 50;
+    constexpr size_t   kPayload  = 6000;
+    std::vector<std::thread> senders;
+    ssize_t            sent[kSenders][kMessages] = {};
+    for (int s = 0; s < kSenders; s++) {
+        senders.emplace_back([&, s]() {
+            std::vector<uint8_t> payload(kPayload);
+            for (int m = 0; m < kMessages; m++) {
+                uint32_t header = (s << 16) | m;
+                std::fill(payload.begin(), payload.end(), uint8_t(header));
+                struct iovec iov[2] = { { &header, sizeof(header) },
+                                        { payload.data(), payload.size() } };
+                sent[s][m] = std::get<0>(client.SendV(iov, 2));
+            }
+        });
+    }
+
+    int                  next[kSenders] = {};
+    std::vector<uint8_t> received(sizeof(uint32_t) + kPayload);
+    for (int i = 0; i < kSenders * kMessages; i++) {
+        REQUIRE(server.RecvAll(received.data(), received.size()));
+        uint32_t header;
+        memcpy(&header, received.data(), sizeof(header));
+        int s = header >> 16;
+        REQUIRE(s < kSenders);
+        REQUIRE(int(header & 0xFFFF) == next[s]++);
+        auto payload = received.begin() + sizeof(header);
+        REQUIRE(std::all_of(payload, received.end(),
+                            [&](uint8_t b) { return b == uint8_t(header); }));
+    }
+    for (auto& sender : senders) {
+        sender.join();
+    }
+    for (auto& messages : sent) {
+        for (auto n : messages) {
+            REQUIRE(n == ssize_t(sizeof(uint32_t) + kPayload));
+        }
+    }
+}
+
+TEST_CASE("TestShmRingCorruptCounters", "[close]")
+{
+    ShmRingServerStub   server(kServerPath);
+    ShmRingStreamClient client(kServerPath, 4096);
+
+    std::thread accept_thread([&server]() { server.Accept(); });
+    client.Connect();
+    accept_thread.join();
+
+    auto    layout = server.Layout();
+    uint8_t buf[16] = {};
+    SECTION("more than a ring of data published")
+    {
+        layout->ctrl[1].head.store(3 * 4096);
+        auto status = client.RecvNoAlloc(buf, sizeof(buf), MSG_DONTWAIT);
+        REQUIRE(status.size == -1);
+        REQUIRE(status.error == std::errc::protocol_error);
+    }
+    SECTION("consumed ahead of the data")
+    {
+        layout->ctrl[0].tail.store(1);
+        auto status = client.SendNoAlloc(buf, sizeof(buf));
+        REQUIRE(status.size == -1);
+        REQUIRE(status.error == std::errc::protocol_error);
+        // Put it back for the server's own reads below.
+        layout->ctrl[0].tail.store(0);
+    }
+
+    // The client hangs up on a ring it can no longer trust.
+    REQUIRE(client.Connected() == false);
+    REQUIRE(server.Recv(buf, 1) == 0);
+}
+
+TEST_CASE("TestShmRingHangup", "[close]")
+{
+    ShmRingServerStub   server(kServerPath);
+    ShmRingStreamClient client(kServerPath);
+
+    std::thread accept_thread([&server]() { server.Accept(); });
+    client.Connect();
+    accept_thread.join();
+
+    server.Hangup();
+    struct pollfd pfd = { client.GetNativeSocketFd(), POLLIN, 0 };
+    REQUIRE(poll(&pfd, 1, 1000) == 1);
+    uint8_t byte = 0;
+    REQUIRE(std::get<0>(client.Recv(&byte, 1)) == 0);
+
+    client.Close();
+    REQUIRE(client.Connected() == false);
+    REQUIRE(std::get<0>(client.Send(&byte, 1)) == -1);
+}
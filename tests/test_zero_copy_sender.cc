@@ -0,0 +1,254 @@
+/**
+ * Copyright (C) 2021-2022 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define CATCH_CONFIG_MAIN // This tells Catch to provide a main() - only do this
+                          // in one cpp file
+#include "catch.hpp"
+#include "tcp_stream_socket_client.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+extern "C"
+{
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+}
+
+using namespace vhal::client;
+using namespace std::chrono_literals;
+
+static constexpr size_t kPacketSize = 64 * 1024;
+
+/**
+ * Loopback TCP peer: drains the connection, or resets it on request.
+ */
+class TcpPeer
+{
+public:
+    TcpPeer()
+    {
+        listen_fd_              = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr = {};
+        addr.sin_family         = AF_INET;
+        addr.sin_addr.s_addr    = htonl(INADDR_LOOPBACK);
+        bind(listen_fd_, (struct sockaddr*)&addr, sizeof(addr));
+        listen(listen_fd_, 1);
+        socklen_t len = sizeof(addr);
+        getsockname(listen_fd_, (struct sockaddr*)&addr, &len);
+        port_ = ntohs(addr.sin_port);
+    }
+
+    ~TcpPeer()
+    {
+        Reset();
+        close(listen_fd_);
+    }
+
+    int Port() const { return port_; }
+
+    bool Accept(bool drain = true)
+    {
+        struct pollfd pfd = { listen_fd_, POLLIN, 0 };
+        if (poll(&pfd, 1, 2000) != 1) {
+            return false;
+        }
+        fd_ = accept(listen_fd_, nullptr, nullptr);
+        if (drain) {
+            drain_ = std::thread([this]() {
+                std::vector<uint8_t> buf(kPacketSize);
+                while (read(fd_, buf.data(), buf.size()) > 0) {
+                }
+            });
+        }
+        return fd_ >= 0;
+    }
+
+    // Closes with an RST, so that the next sends fail.
+    void Reset()
+    {
+        if (fd_ < 0) {
+            return;
+        }
+        struct linger linger = { 1, 0 };
+        setsockopt(fd_, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+        shutdown(fd_, SHUT_RD);
+        if (drain_.joinable()) {
+            drain_.join();
+        }
+        close(fd_);
+        fd_ = -1;
+    }
+
+private:
+    int         listen_fd_ = -1;
+    int         fd_        = -1;
+    int         port_      = 0;
+    std::thread drain_;
+};
+
+/**
+ * Client with zero-copy enabled, counting releases per cookie.
+ */
+class ZeroCopyFixture
+{
+public:
+    ZeroCopyFixture(bool drain = true)
+      : client{ "127.0.0.1", peer.Port() }, buffers(kPacketCount)
+    {
+        client.SetZeroCopy(true, OnRelease());
+        REQUIRE(std::get<0>(client.Connect()));
+        REQUIRE(peer.Accept(drain));
+        for (auto& buffer : buffers) {
+            buffer.resize(kPacketSize);
+        }
+    }
+
+    IZeroCopySocketClient::ReleaseCallback OnRelease()
+    {
+        return [this](uint64_t cookie, bool) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            releases_[cookie]++;
+        };
+    }
+
+    IOResult Send(uint64_t cookie)
+    {
+        struct iovec iov = { buffers[cookie].data(), buffers[cookie].size() };
+        return client.SendVZeroCopy(&iov, 1, cookie);
+    }
+
+    std::map<uint64_t, int> Releases()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return releases_;
+    }
+
+    // Processes completions until count cookies are released.
+    bool WaitForReleases(size_t count)
+    {
+        auto deadline = std::chrono::steady_clock::now() + 2s;
+        while (Releases().size() < count) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            client.ProcessZeroCopyCompletions();
+            std::this_thread::sleep_for(1ms);
+        }
+        return true;
+    }
+
+    static bool ReleasedOnce(const std::map<uint64_t, int>& releases, uint64_t count)
+    {
+        if (releases.size() != count) {
+            return false;
+        }
+        for (uint64_t cookie = 0; cookie < count; ++cookie) {
+            auto it = releases.find(cookie);
+            if (it == releases.end() || it->second != 1) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static constexpr uint64_t kPacketCount = 64;
+
+    TcpPeer                           peer;
+    TcpStreamSocketClient             client;
+    std::vector<std::vector<uint8_t>> buffers;
+
+private:
+    std::mutex              mutex_;
+    std::map<uint64_t, int> releases_;
+};
+
+TEST_CASE("Every zero-copy send is released once", "[ZeroCopySender]")
+{
+    ZeroCopyFixture f;
+    REQUIRE(f.client.ZeroCopyActive());
+
+    for (uint64_t cookie = 0; cookie < f.kPacketCount; ++cookie) {
+        REQUIRE(std::get<0>(f.Send(cookie)) == kPacketSize);
+    }
+    REQUIRE(f.WaitForReleases(f.kPacketCount));
+    // Late notifications release nothing twice.
+    std::this_thread::sleep_for(20ms);
+    f.client.ProcessZeroCopyCompletions();
+    REQUIRE(ZeroCopyFixture::ReleasedOnce(f.Releases(), f.kPacketCount));
+
+    // Loopback copies anyway, which turns zero-copy off.
+    REQUIRE_FALSE(f.client.ZeroCopyActive());
+}
+
+TEST_CASE("A failed zero-copy send is released", "[ZeroCopySender]")
+{
+    ZeroCopyFixture f;
+    f.peer.Reset();
+
+    uint64_t sent = 0;
+    while (sent < f.kPacketCount && std::get<0>(f.Send(sent)) != -1) {
+        ++sent;
+        std::this_thread::sleep_for(1ms);
+    }
+    REQUIRE(sent < f.kPacketCount);
+
+    // Sends up to the failed one, included, are released; the rest never
+    // started.
+    REQUIRE(f.WaitForReleases(sent + 1));
+    REQUIRE(ZeroCopyFixture::ReleasedOnce(f.Releases(), sent + 1));
+    f.client.Close();
+    REQUIRE(ZeroCopyFixture::ReleasedOnce(f.Releases(), sent + 1));
+}
+
+TEST_CASE("Closing releases zero-copy sends in flight", "[ZeroCopySender]")
+{
+    // Nobody reads: the sends stay in the socket, their notifications are
+    // not processed before the close.
+    ZeroCopyFixture f(false);
+    REQUIRE(std::get<0>(f.Send(0)) == kPacketSize);
+    REQUIRE(std::get<0>(f.Send(1)) == kPacketSize);
+    f.client.Close();
+    REQUIRE(ZeroCopyFixture::ReleasedOnce(f.Releases(), 2));
+
+    REQUIRE(f.client.ProcessZeroCopyCompletions() == 0);
+    REQUIRE(ZeroCopyFixture::ReleasedOnce(f.Releases(), 2));
+}
+
+TEST_CASE("Disabling zero-copy still releases sends in flight", "[ZeroCopySender]")
+{
+    ZeroCopyFixture f;
+    REQUIRE(std::get<0>(f.Send(0)) == kPacketSize);
+    REQUIRE(f.Releases().empty());
+
+    f.client.SetZeroCopy(false, f.OnRelease());
+    REQUIRE_FALSE(f.client.ZeroCopyActive());
+    REQUIRE(f.WaitForReleases(1));
+
+    // From now on sends copy, and release before they return.
+    REQUIRE(std::get<0>(f.Send(1)) == kPacketSize);
+    REQUIRE(ZeroCopyFixture::ReleasedOnce(f.Releases(), 2));
+    f.client.Close();
+    REQUIRE(ZeroCopyFixture::ReleasedOnce(f.Releases(), 2));
+}